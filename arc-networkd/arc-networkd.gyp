@@ -40,4 +40,39 @@
       ],
     },
   ],
+  'conditions': [
+    ['USE_test == 1', {
+      'targets': [
+        {
+          'target_name': 'arc-networkd_testrunner',
+          'type': 'executable',
+          'includes': ['../common-mk/common_test.gypi'],
+          'sources': [
+            'multicast_socket.cc',
+            'multicast_socket_unittest.cc',
+            'testrunner.cc',
+          ],
+        },
+        # Times sendmmsg/recvmmsg batches against single datagrams; run by hand.
+        {
+          'target_name': 'multicast_socket_benchmark',
+          'type': 'executable',
+          'sources': [
+            'multicast_socket.cc',
+            'multicast_socket_benchmark.cc',
+          ],
+        },
+        # Changes host routes and iptables rules, so it must be run by hand as
+        # root on a test device.
+        {
+          'target_name': 'arc_ip_config_benchmark',
+          'type': 'executable',
+          'sources': [
+            'arc_ip_config.cc',
+            'arc_ip_config_benchmark.cc',
+          ],
+        },
+      ],
+    }],
+  ],
 }
@@ -20,12 +20,17 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <random>
+#include <set>
 
+#include <base/files/file_util.h>
 #include <base/files/scoped_file.h>
 #include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/strings/string_split.h>
 #include <base/strings/stringprintf.h>
 #include <brillo/minijail/minijail.h>
 #include <brillo/process.h>
@@ -39,11 +44,22 @@ const int kInvalidTableId = -1;
 
 // These match what is used in iptables.cc in firewalld.
 const char kIpPath[] = "/bin/ip";
-const char kIp6TablesPath[] = "/sbin/ip6tables";
+const char kIp6TablesRestorePath[] = "/sbin/ip6tables-restore";
 const char kUnprivilegedUser[] = "nobody";
 const uint64_t kIpTablesCapMask =
     CAP_TO_MASK(CAP_NET_ADMIN) | CAP_TO_MASK(CAP_NET_RAW);
 
+// Returns the elements of |a| that are not in |b|, in their order in |a|.
+template <typename T>
+std::vector<T> Subtract(const std::vector<T>& a, const std::vector<T>& b) {
+  std::vector<T> result;
+  for (const auto& element : a) {
+    if (std::find(b.begin(), b.end(), element) == b.end())
+      result.push_back(element);
+  }
+  return result;
+}
+
 }  // namespace
 
 namespace arc_networkd {
@@ -193,6 +209,13 @@ bool ArcIpConfig::GetV6Address(const std::string& ifname,
 // Returns "raw" status on success, or -1 if the program could not be executed.
 int ArcIpConfig::StartProcessInMinijail(const std::vector<std::string>& argv,
                                         bool log_failures) {
+  return StartProcessInMinijail(argv, "", log_failures, nullptr);
+}
+
+int ArcIpConfig::StartProcessInMinijail(const std::vector<std::string>& argv,
+                                        const std::string& input,
+                                        bool log_failures,
+                                        std::string* error_output) {
   brillo::Minijail* m = brillo::Minijail::GetInstance();
   minijail* jail = m->New();
 
@@ -206,7 +229,33 @@ int ArcIpConfig::StartProcessInMinijail(const std::vector<std::string>& argv,
   args.push_back(nullptr);
 
   int status;
-  bool ran = m->RunSyncAndDestroy(jail, args, &status);
+  bool ran;
+  if (input.empty()) {
+    ran = m->RunSyncAndDestroy(jail, args, &status);
+  } else {
+    pid_t pid;
+    int stdin_fd;
+    int stderr_fd;
+    ran = m->RunPipesAndDestroy(jail, args, &pid, &stdin_fd, nullptr,
+                                error_output ? &stderr_fd : nullptr);
+    if (ran) {
+      base::ScopedFD stdin_closer(stdin_fd);
+      if (!base::WriteFileDescriptor(stdin_fd, input.data(), input.size()))
+        PLOG(ERROR) << "Could not write to " << args.front();
+      stdin_closer.reset();
+      if (error_output) {
+        // |input| has been written in full, so the process can't be blocked
+        // on it while its errors are read.
+        base::ScopedFD stderr_closer(stderr_fd);
+        error_output->clear();
+        char buf[1024];
+        ssize_t len;
+        while ((len = HANDLE_EINTR(read(stderr_fd, buf, sizeof(buf)))) > 0)
+          error_output->append(buf, len);
+      }
+      ran = HANDLE_EINTR(waitpid(pid, &status, 0)) == pid;
+    }
+  }
 
   if (!ran) {
     LOG(ERROR) << "Could not execute " << args.front();
@@ -226,12 +275,111 @@ int ArcIpConfig::StartProcessInMinijail(const std::vector<std::string>& argv,
   return ran && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
 }
 
+std::vector<ArcIpConfig::IpObject> ArcIpConfig::ApplyIpObjects(
+    const std::vector<IpObject>& del,
+    const std::vector<IpObject>& replace) {
+  if (del.empty() && replace.empty())
+    return std::vector<IpObject>();
+
+  std::string batch;
+  for (auto it = del.rbegin(); it != del.rend(); ++it)
+    batch += it->first + " del " + it->second + "\n";
+  for (const auto& object : replace)
+    batch += object.first + " replace " + object.second + "\n";
+
+  // Deletions often fail because the kernel or ARC already removed the entry,
+  // and replacements can fail if the interface disappears (e.g. hot-unplug).
+  // -force keeps going after such errors, and "ip" reports the line number of
+  // each failed command so that the objects that were set up can be told
+  // apart from the ones that weren't.
+  std::string errors;
+  if (StartProcessInMinijail({kIpPath, "-6", "-force", "-batch", "-"}, batch,
+                             false /* log_failures */, &errors) < 0) {
+    return std::vector<IpObject>();
+  }
+
+  std::set<size_t> failed_lines;
+  for (const auto& line : base::SplitString(errors, "\n",
+                                            base::TRIM_WHITESPACE,
+                                            base::SPLIT_WANT_NONEMPTY)) {
+    int line_number;
+    if (sscanf(line.c_str(), "Command failed -:%d", &line_number) == 1)
+      failed_lines.insert(line_number);
+  }
+
+  std::vector<IpObject> replaced;
+  bool replace_failed = false;
+  for (size_t i = 0; i < replace.size(); ++i) {
+    // Line numbers start at 1, and the deletions come first.
+    if (failed_lines.count(del.size() + i + 1))
+      replace_failed = true;
+    else
+      replaced.push_back(replace[i]);
+  }
+  if (replace_failed)
+    LOG(WARNING) << "Could not set up all IPv6 entries: " << errors;
+  return replaced;
+}
+
+std::vector<ArcIpConfig::IpObject> ArcIpConfig::ApplyIpObjectConfig(
+    const std::vector<IpObject>& applied,
+    const std::vector<IpObject>& desired) {
+  // Every desired object is replaced, not just the new ones, so that entries
+  // that went missing or failed to be set up earlier are restored.
+  const std::vector<IpObject> replaced =
+      ApplyIpObjects(Subtract(applied, desired), desired);
+
+  // A failed deletion is forgotten as well: it almost always means the entry
+  // was already gone. An object whose replacement failed is only kept if it
+  // was set up before, since it may still be in place.
+  std::vector<IpObject> result;
+  for (const auto& object : desired) {
+    if (std::find(replaced.begin(), replaced.end(), object) != replaced.end() ||
+        std::find(applied.begin(), applied.end(), object) != applied.end()) {
+      result.push_back(object);
+    }
+  }
+  return result;
+}
+
+void ArcIpConfig::ApplyConfig(const NetConfig& config) {
+  if (!config.con_objects.empty() || !applied_.con_objects.empty()) {
+    PCHECK(setns(con_netns_fd_.get(), CLONE_NEWNET) == 0);
+    applied_.con_objects =
+        ApplyIpObjectConfig(applied_.con_objects, config.con_objects);
+    PCHECK(setns(self_netns_fd_.get(), CLONE_NEWNET) == 0);
+  }
+
+  applied_.host_objects =
+      ApplyIpObjectConfig(applied_.host_objects, config.host_objects);
+
+  // ip6tables-restore has no way to replace a rule, so only the rules that
+  // changed are touched. They are changed in one transaction, which either
+  // succeeds or leaves the chain as it was.
+  const std::vector<std::string> rules_del =
+      Subtract(applied_.forward_rules, config.forward_rules);
+  const std::vector<std::string> rules_add =
+      Subtract(config.forward_rules, applied_.forward_rules);
+  if (!rules_del.empty() || !rules_add.empty()) {
+    std::string rules = "*filter\n";
+    for (auto it = rules_del.rbegin(); it != rules_del.rend(); ++it)
+      rules += "-D " + *it + "\n";
+    for (const auto& rule : rules_add)
+      rules += "-A " + rule + "\n";
+    rules += "COMMIT\n";
+    if (StartProcessInMinijail({kIp6TablesRestorePath, "--noflush", "-w"},
+                               rules, true /* log_failures */, nullptr) == 0) {
+      applied_.forward_rules = config.forward_rules;
+    } else {
+      LOG(ERROR) << "Could not update the IPv6 forwarding rules";
+    }
+  }
+}
+
 bool ArcIpConfig::Set(const struct in6_addr& address,
                       int prefix_len,
                       const struct in6_addr& router_addr,
                       const std::string& lan_ifname) {
-  Clear();
-
   if (!con_netns_fd_.is_valid() || !self_netns_fd_.is_valid()) {
     LOG(ERROR) << "Cannot set IPv6 address: no netns configured";
     return false;
@@ -251,149 +399,37 @@ bool ArcIpConfig::Set(const struct in6_addr& address,
   char buf[INET6_ADDRSTRLEN];
 
   CHECK(inet_ntop(AF_INET6, &address, buf, sizeof(buf)));
-  current_address_ = buf;
-  current_address_full_ = current_address_;
-  current_address_full_.append("/" + std::to_string(prefix_len));
+  const std::string address_str = buf;
+  const std::string address_full =
+      address_str + "/" + std::to_string(prefix_len);
 
   CHECK(inet_ntop(AF_INET6, &router_addr, buf, sizeof(buf)));
-  current_router_ = buf;
-
-  current_lan_ifname_ = lan_ifname;
-
-  PCHECK(setns(con_netns_fd_.get(), CLONE_NEWNET) == 0);
-
-  // These can fail if the interface disappears (e.g. hot-unplug).
-  // If that happens, the error will be logged, because sometimes it
-  // might help in debugging a real issue.
-
-  StartProcessInMinijail({
-      kIpPath, "-6",
-      "addr", "add", current_address_full_,
-      "dev", con_ifname_
-  }, true /* log_failures */);
-
-  StartProcessInMinijail({
-      kIpPath, "-6",
-      "route", "add", current_router_,
-      "dev", con_ifname_,
-      "table", std::to_string(routing_table_id_)
-  }, true);
-
-  StartProcessInMinijail({
-      kIpPath, "-6",
-      "route", "add", "default",
-      "via", current_router_,
-      "dev", con_ifname_,
-      "table", std::to_string(routing_table_id_)
-  }, true);
-
-  PCHECK(setns(self_netns_fd_.get(), CLONE_NEWNET) == 0);
-
-  StartProcessInMinijail({
-      kIpPath, "-6",
-      "route", "add", current_address_full_,
-      "dev", int_ifname_
-  }, true);
-
-  StartProcessInMinijail({
-      kIpPath, "-6",
-      "neigh", "add", "proxy", current_address_,
-      "dev", current_lan_ifname_
-  }, true);
-
-  // These should never fail.
-
-  CHECK_EQ(StartProcessInMinijail({
-      kIp6TablesPath,
-      "-A", "FORWARD",
-      "-i", current_lan_ifname_,
-      "-o", int_ifname_,
-      "-j", "ACCEPT",
-      "-w"
-  }, true), 0);
-
-  CHECK_EQ(StartProcessInMinijail({
-      kIp6TablesPath,
-      "-A", "FORWARD",
-      "-i", int_ifname_,
-      "-o", current_lan_ifname_,
-      "-j", "ACCEPT",
-      "-w"
-  }, true), 0);
-
-  is_configured_ = true;
+  const std::string router = buf;
+
+  const std::string table = std::to_string(routing_table_id_);
+
+  NetConfig config;
+  config.con_objects = {
+      {"addr", address_full + " dev " + con_ifname_},
+      {"route", router + " dev " + con_ifname_ + " table " + table},
+      {"route",
+       "default via " + router + " dev " + con_ifname_ + " table " + table},
+  };
+  config.host_objects = {
+      {"route", address_full + " dev " + int_ifname_},
+      {"neigh", "proxy " + address_str + " dev " + lan_ifname},
+  };
+  config.forward_rules = {
+      "FORWARD -i " + lan_ifname + " -o " + int_ifname_ + " -j ACCEPT",
+      "FORWARD -i " + int_ifname_ + " -o " + lan_ifname + " -j ACCEPT",
+  };
+
+  ApplyConfig(config);
   return true;
 }
 
 bool ArcIpConfig::Clear() {
-  if (!is_configured_)
-    return true;
-
-  // These should never fail.
-
-  CHECK_EQ(StartProcessInMinijail({
-      kIp6TablesPath,
-      "-D", "FORWARD",
-      "-i", int_ifname_,
-      "-o", current_lan_ifname_,
-      "-j", "ACCEPT",
-      "-w"
-  }, true), 0);
-
-  CHECK_EQ(StartProcessInMinijail({
-      kIp6TablesPath,
-      "-D", "FORWARD",
-      "-i", current_lan_ifname_,
-      "-o", int_ifname_,
-      "-j", "ACCEPT",
-      "-w"
-  }, true), 0);
-
-  // This often fails because the kernel removes the proxy entry automatically.
-
-  StartProcessInMinijail({
-      kIpPath, "-6",
-      "neigh", "del", "proxy", current_address_,
-      "dev", current_lan_ifname_
-  }, false /* log_failures */);
-
-  // This can fail if the interface disappears (e.g. hot-unplug).  Rare.
-
-  StartProcessInMinijail({
-      kIpPath, "-6",
-      "route", "del", current_address_full_,
-      "dev", int_ifname_
-  }, true);
-
-  PCHECK(setns(con_netns_fd_.get(), CLONE_NEWNET) == 0);
-
-  StartProcessInMinijail({
-      kIpPath, "-6",
-      "route", "del", "default",
-      "via", current_router_,
-      "dev", con_ifname_,
-      "table", std::to_string(routing_table_id_)
-  }, true);
-
-  StartProcessInMinijail({
-      kIpPath, "-6",
-      "route", "del", current_router_,
-      "dev", con_ifname_,
-      "table", std::to_string(routing_table_id_)
-  }, true);
-
-  // This often fails because ARC tries to delete the address on its own
-  // when it is notified that the LAN is down.
-
-  StartProcessInMinijail({
-      kIpPath, "-6",
-      "addr", "del", current_address_full_,
-      "dev", con_ifname_
-  }, false);
-
-  PCHECK(setns(self_netns_fd_.get(), CLONE_NEWNET) == 0);
-
-  is_configured_ = false;
+  ApplyConfig(NetConfig());
   return true;
 }
 
@@ -10,6 +10,7 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <base/files/scoped_file.h>
@@ -20,7 +21,13 @@ namespace arc_networkd {
 // Sets up IPv6 addresses, routing, and NDP proxying between the guest's
 // interface |con_ifname| in network namespace |con_netns|, the internal
 // host<->guest interface |int_ifname|, and the external LAN interface
-// |current_lan_ifname_|.
+// |lan_ifname| passed to Set().
+//
+// Changes are applied in batches: all of the addresses and routes for a
+// namespace go through one "ip -batch" process, and all of the firewall rules
+// through one "ip6tables-restore" transaction. Addresses and routes are
+// replaced on every Set(); only the firewall rules that differ from the
+// current configuration are touched.
 class ArcIpConfig {
  public:
   ArcIpConfig(const std::string& int_ifname,
@@ -51,9 +58,48 @@ class ArcIpConfig {
                              int prefix_len);
 
  protected:
+  // An "ip -6" command without its add/del verb, e.g. {"addr", "<addr> dev
+  // <ifname>"}.
+  using IpObject = std::pair<std::string, std::string>;
+
+  // Everything that Set() configures. Entries are listed in the order they
+  // must be added, and are deleted in the reverse order.
+  struct NetConfig {
+    // Addresses and routes in the container's namespace.
+    std::vector<IpObject> con_objects;
+    // Routes and neighbor proxies in the host's namespace.
+    std::vector<IpObject> host_objects;
+    // Rules for the host's ip6tables FORWARD chain, without "-A"/"-D".
+    std::vector<std::string> forward_rules;
+  };
+
   int ReadTableId(const std::string& table_name);
+
+  // Changes the configuration from |applied_| to |config|. Afterwards,
+  // |applied_| only holds the entries that are known to have been set up.
+  void ApplyConfig(const NetConfig& config);
+
+  // Deletes |del| and replaces |replace| in the current network namespace
+  // using a single "ip" process. Returns the objects from |replace| that were
+  // set up successfully.
+  std::vector<IpObject> ApplyIpObjects(const std::vector<IpObject>& del,
+                                       const std::vector<IpObject>& replace);
+
+  // Deletes the objects in |applied| that are not in |desired| and replaces
+  // the ones in |desired|. Returns the objects that are now set up.
+  std::vector<IpObject> ApplyIpObjectConfig(
+      const std::vector<IpObject>& applied,
+      const std::vector<IpObject>& desired);
+
   int StartProcessInMinijail(const std::vector<std::string>& argv,
                              bool log_failures);
+  // Like StartProcessInMinijail(), but also writes |input| to the standard
+  // input of the process. If |error_output| is non-null, the standard error
+  // of the process is stored in it.
+  int StartProcessInMinijail(const std::vector<std::string>& argv,
+                             const std::string& input,
+                             bool log_failures,
+                             std::string* error_output);
 
   std::string int_ifname_;
   std::string con_ifname_;
@@ -63,11 +109,7 @@ class ArcIpConfig {
   base::ScopedFD self_netns_fd_;
   int routing_table_id_;
 
-  bool is_configured_{false};
-  std::string current_address_;
-  std::string current_address_full_;
-  std::string current_router_;
-  std::string current_lan_ifname_;
+  NetConfig applied_;
 };
 
 }  // namespace arc_networkd
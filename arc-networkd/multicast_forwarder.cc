@@ -21,6 +21,7 @@ namespace {
 
 const int kNumTempSockets = 4;
 const int kBufSize = 1536;
+const int kMaxBatchesPerWakeup = 4;
 const int kCleanupIntervalMs = 5000;
 const int kCleanupTimeSeconds = 30;
 
@@ -28,6 +29,28 @@ const int kCleanupTimeSeconds = 30;
 
 namespace arc_networkd {
 
+const unsigned int MulticastForwarder::kBatchSize;
+
+MulticastForwarder::MulticastForwarder() : recv_buf_(kBatchSize * kBufSize) {
+  memset(recv_msgs_, 0, sizeof(recv_msgs_));
+  for (unsigned int i = 0; i < kBatchSize; i++) {
+    recv_iovs_[i].iov_base = &recv_buf_[i * kBufSize];
+    recv_iovs_[i].iov_len = kBufSize;
+    recv_msgs_[i].msg_hdr.msg_name = &recv_addrs_[i];
+    recv_msgs_[i].msg_hdr.msg_iov = &recv_iovs_[i];
+    recv_msgs_[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+MulticastForwarder::~MulticastForwarder() {
+  if (int_stats_.packets || lan_stats_.packets) {
+    LOG(INFO) << "Forwarded " << int_stats_.packets << " packets ("
+              << int_stats_.bytes << " bytes) to " << int_ifname_ << " and "
+              << lan_stats_.packets << " packets (" << lan_stats_.bytes
+              << " bytes) to " << lan_ifname_;
+  }
+}
+
 bool MulticastForwarder::Start(const std::string& int_ifname,
                                const std::string& lan_ifname,
                                const std::string& mcast_addr,
@@ -58,13 +81,28 @@ bool MulticastForwarder::Start(const std::string& int_ifname,
 // This callback is registered as part of MulticastSocket::Bind().
 // All of our sockets use this function as a common callback.
 void MulticastForwarder::OnFileCanReadWithoutBlocking(int fd) {
-  char data[kBufSize];
-  struct sockaddr_in fromaddr;
+  // Stop after a few batches so that a storm on one socket can't starve the
+  // others; the watcher fires again for whatever is left.
+  for (int i = 0; i < kMaxBatchesPerWakeup; i++) {
+    int count = MulticastSocket::RecvManyFromFd(fd, recv_msgs_, kBatchSize);
+    if (count <= 0)
+      return;
 
-  ssize_t bytes = MulticastSocket::RecvFromFd(fd, data, kBufSize, &fromaddr);
-  if (bytes < 0)
-    return;
+    for (int j = 0; j < count; j++)
+      ForwardPacket(fd, j);
+    FlushSends();
 
+    if (count < static_cast<int>(kBatchSize))
+      return;
+  }
+}
+
+void MulticastForwarder::ForwardPacket(int fd, unsigned int index) {
+  if (recv_msgs_[index].msg_hdr.msg_namelen != sizeof(struct sockaddr_in)) {
+    LOG(WARNING) << "recvmmsg returned an unexpected address";
+    return;
+  }
+  const struct sockaddr_in& fromaddr = recv_addrs_[index];
   unsigned short port = ntohs(fromaddr.sin_port);
 
   struct sockaddr_in dst = {0};
@@ -75,11 +113,11 @@ void MulticastForwarder::OnFileCanReadWithoutBlocking(int fd) {
   // Forward traffic that is part of an existing connection.
   for (auto& temp : temp_sockets_) {
     if (fd == temp->fd()) {
-      int_socket_->SendTo(data, bytes, temp->int_addr);
+      QueueSend(int_socket_.get(), index, temp->int_addr);
       return;
     } else if (fd == int_socket_->fd() &&
                fromaddr.sin_port == temp->int_addr.sin_port) {
-      temp->SendTo(data, bytes, dst);
+      QueueSend(temp.get(), index, dst);
       return;
     }
   }
@@ -87,10 +125,10 @@ void MulticastForwarder::OnFileCanReadWithoutBlocking(int fd) {
   // Forward stateless traffic.
   if (allow_stateless_ && port == port_) {
     if (fd == int_socket_->fd()) {
-      lan_socket_->SendTo(data, bytes, dst);
+      QueueSend(lan_socket_.get(), index, dst);
       return;
     } else if (fd == lan_socket_->fd()) {
-      int_socket_->SendTo(data, bytes, dst);
+      QueueSend(int_socket_.get(), index, dst);
       return;
     }
   }
@@ -105,7 +143,8 @@ void MulticastForwarder::OnFileCanReadWithoutBlocking(int fd) {
     return;
   memcpy(&new_sock->int_addr, &fromaddr, sizeof(new_sock->int_addr));
 
-  new_sock->SendTo(data, bytes, dst);
+  // Queued datagrams may be waiting on a socket that is about to be dropped.
+  FlushSends();
 
   // This should ideally delete the LRU entry, but since idle entries are
   // purged by CleanupTask, the limit will only really be reached if
@@ -113,6 +152,51 @@ void MulticastForwarder::OnFileCanReadWithoutBlocking(int fd) {
   while (temp_sockets_.size() > kNumTempSockets)
     temp_sockets_.pop_back();
   temp_sockets_.push_front(std::move(new_sock));
+
+  QueueSend(temp_sockets_.front().get(), index, dst);
+}
+
+void MulticastForwarder::QueueSend(MulticastSocket* socket,
+                                   unsigned int index,
+                                   const struct sockaddr_in& dst) {
+  CHECK_LT(num_sends_, kBatchSize);
+  unsigned int i = num_sends_++;
+
+  send_addrs_[i] = dst;
+  send_iovs_[i].iov_base = recv_iovs_[index].iov_base;
+  send_iovs_[i].iov_len = recv_msgs_[index].msg_len;
+  memset(&send_msgs_[i], 0, sizeof(send_msgs_[i]));
+  send_msgs_[i].msg_hdr.msg_name = &send_addrs_[i];
+  send_msgs_[i].msg_hdr.msg_namelen = sizeof(send_addrs_[i]);
+  send_msgs_[i].msg_hdr.msg_iov = &send_iovs_[i];
+  send_msgs_[i].msg_hdr.msg_iovlen = 1;
+  send_sockets_[i] = socket;
+}
+
+void MulticastForwarder::FlushSends() {
+  struct mmsghdr msgs[kBatchSize];
+
+  // Send everything queued for each socket with a single call, keeping the
+  // order in which the datagrams were received.
+  for (unsigned int i = 0; i < num_sends_; i++) {
+    MulticastSocket* socket = send_sockets_[i];
+    if (!socket)
+      continue;
+
+    unsigned int len = 0;
+    for (unsigned int j = i; j < num_sends_; j++) {
+      if (send_sockets_[j] == socket) {
+        msgs[len++] = send_msgs_[j];
+        send_sockets_[j] = nullptr;
+      }
+    }
+
+    Stats& stats = socket == int_socket_.get() ? int_stats_ : lan_stats_;
+    stats.packets += socket->SendMany(msgs, len);
+    for (unsigned int j = 0; j < len; j++)
+      stats.bytes += msgs[j].msg_len;
+  }
+  num_sends_ = 0;
 }
 
 void MulticastForwarder::CleanupTask() {
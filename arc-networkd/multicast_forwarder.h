@@ -6,12 +6,15 @@
 #define ARC_NETWORKD_MULTICAST_FORWARDER_H_
 
 #include <netinet/ip.h>
+#include <stdint.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <time.h>
 
 #include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <base/macros.h>
 #include <base/memory/weak_ptr.h>
@@ -27,10 +30,20 @@ namespace arc_networkd {
 // network interfaces.  Handles stateless mDNS messages (src port and
 // dst port are both 5353) and stateful mDNS/SSDP messages (src port
 // is random, so the forwarder needs to keep a table of open sessions).
+//
+// Each wakeup drains a batch of datagrams with one recvmmsg() call and sends
+// them on with one sendmmsg() call per outgoing socket, using buffers that are
+// allocated once.
 class MulticastForwarder : public MessageLoopForIO::Watcher {
  public:
-  MulticastForwarder() {}
-  virtual ~MulticastForwarder() {}
+  // Traffic forwarded in one direction.
+  struct Stats {
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+  };
+
+  MulticastForwarder();
+  virtual ~MulticastForwarder();
 
   // Start forwarding multicast packets between the container's P2P link
   // |int_ifname| and the external LAN interface |lan_ifname|.  This
@@ -51,9 +64,29 @@ class MulticastForwarder : public MessageLoopForIO::Watcher {
   void OnFileCanReadWithoutBlocking(int fd) override;
   void OnFileCanWriteWithoutBlocking(int fd) override {}
 
+  // Traffic forwarded towards the container and towards the LAN.
+  const Stats& int_stats() const { return int_stats_; }
+  const Stats& lan_stats() const { return lan_stats_; }
+
  protected:
+  // The number of datagrams read with each recvmmsg() call.
+  static const unsigned int kBatchSize = 32;
+
   void CleanupTask();
 
+  // Decides where datagram |index| of the current batch, received on |fd|,
+  // should go and queues it.
+  void ForwardPacket(int fd, unsigned int index);
+
+  // Queues datagram |index| of the current batch to be sent from |socket| to
+  // |dst|.
+  void QueueSend(MulticastSocket* socket,
+                 unsigned int index,
+                 const struct sockaddr_in& dst);
+
+  // Sends all queued datagrams.
+  void FlushSends();
+
   std::string int_ifname_;
   std::string lan_ifname_;
   struct in_addr mcast_addr_;
@@ -64,6 +97,24 @@ class MulticastForwarder : public MessageLoopForIO::Watcher {
   std::unique_ptr<MulticastSocket> lan_socket_;
   std::deque<std::unique_ptr<MulticastSocket>> temp_sockets_;
 
+  // The datagrams of the current batch.
+  std::vector<char> recv_buf_;
+  struct iovec recv_iovs_[kBatchSize];
+  struct sockaddr_in recv_addrs_[kBatchSize];
+  struct mmsghdr recv_msgs_[kBatchSize];
+
+  // Datagrams waiting to be sent, and the sockets to send them from. Each
+  // received datagram is sent at most once, so these never hold more than a
+  // batch.
+  struct iovec send_iovs_[kBatchSize];
+  struct sockaddr_in send_addrs_[kBatchSize];
+  struct mmsghdr send_msgs_[kBatchSize];
+  MulticastSocket* send_sockets_[kBatchSize];
+  unsigned int num_sends_ = 0;
+
+  Stats int_stats_;
+  Stats lan_stats_;
+
   base::WeakPtrFactory<MulticastForwarder> weak_factory_{this};
 
  private:
@@ -5,6 +5,7 @@
 #include "arc-networkd/multicast_socket.h"
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <net/if.h>
 #include <string.h>
 #include <sys/ioctl.h>
@@ -13,6 +14,7 @@
 #include <utility>
 
 #include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
 
 namespace arc_networkd {
 
@@ -119,6 +121,13 @@ bool MulticastSocket::SendTo(const void* data,
   }
 }
 
+int MulticastSocket::SendMany(struct mmsghdr* msgs, unsigned int len) {
+  int sent = SendManyToFd(fd_.get(), msgs, len);
+  if (sent > 0)
+    last_used_ = time(NULL);
+  return sent;
+}
+
 // static
 ssize_t MulticastSocket::RecvFromFd(int fd,
                                     void* data,
@@ -135,4 +144,46 @@ ssize_t MulticastSocket::RecvFromFd(int fd,
   return bytes;
 }
 
+// static
+int MulticastSocket::RecvManyFromFd(int fd,
+                                    struct mmsghdr* msgs,
+                                    unsigned int len) {
+  // The kernel overwrites msg_namelen with the size of each address.
+  for (unsigned int i = 0; i < len; i++)
+    msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+
+  int count = HANDLE_EINTR(recvmmsg(fd, msgs, len, MSG_DONTWAIT, nullptr));
+  if (count < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return 0;
+    PLOG(WARNING) << "recvmmsg failed";
+    return -1;
+  }
+  return count;
+}
+
+// static
+int MulticastSocket::SendManyToFd(int fd,
+                                  struct mmsghdr* msgs,
+                                  unsigned int len) {
+  for (unsigned int i = 0; i < len; i++)
+    msgs[i].msg_len = 0;
+
+  // sendmmsg() stops at the first datagram that fails. Skip it and carry on
+  // with the rest, as separate sendto() calls would.
+  int sent = 0;
+  unsigned int i = 0;
+  while (i < len) {
+    int count = HANDLE_EINTR(sendmmsg(fd, msgs + i, len - i, 0));
+    if (count <= 0) {
+      PLOG(WARNING) << "sendmmsg failed";
+      i++;
+    } else {
+      sent += count;
+      i += count;
+    }
+  }
+  return sent;
+}
+
 }  // namespace arc_networkd
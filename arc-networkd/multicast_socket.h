@@ -33,11 +33,21 @@ class MulticastSocket {
             MessageLoopForIO::Watcher* parent);
   bool SendTo(const void* data, size_t len, const struct sockaddr_in& addr);
 
+  // Sends the |len| datagrams in |msgs|, each to its own msg_name. Returns the
+  // number of datagrams sent; msg_len is 0 for the ones that failed.
+  int SendMany(struct mmsghdr* msgs, unsigned int len);
+
   static ssize_t RecvFromFd(int fd,
                             void* data,
                             size_t len,
                             struct sockaddr_in* addr);
 
+  // Receives up to |len| datagrams into |msgs| without blocking. The msg_name
+  // of each entry must point to a struct sockaddr_in. Returns the number of
+  // datagrams received, which is 0 if none are queued, or -1 on error.
+  static int RecvManyFromFd(int fd, struct mmsghdr* msgs, unsigned int len);
+  static int SendManyToFd(int fd, struct mmsghdr* msgs, unsigned int len);
+
   int fd() const { return fd_.get(); }
   time_t last_used() const { return last_used_; }
 
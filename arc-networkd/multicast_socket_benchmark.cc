@@ -0,0 +1,114 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Sends kRounds * kBatchSize UDP datagrams between two loopback sockets,
+// first with one sendto() and one RecvFromFd() per datagram, then with one
+// SendManyToFd() and one RecvManyFromFd() per batch of kBatchSize. The two
+// times printed differ only in the number of system calls, which is what the
+// mDNS and SSDP forwarders save per burst of multicast traffic.
+
+#include "arc-networkd/multicast_socket.h"
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <vector>
+
+#include <base/files/scoped_file.h>
+#include <base/logging.h>
+#include <base/time/time.h>
+
+namespace {
+
+const int kBatchSize = 32;
+const int kPacketSize = 512;
+const int kRounds = 500;
+
+// Opens a UDP socket bound to an ephemeral port on the loopback interface and
+// stores its address in |addr|.
+base::ScopedFD OpenLoopbackSocket(struct sockaddr_in* addr) {
+  base::ScopedFD fd(socket(AF_INET, SOCK_DGRAM, 0));
+  CHECK(fd.is_valid());
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  CHECK_EQ(0, bind(fd.get(), reinterpret_cast<struct sockaddr*>(addr),
+                   sizeof(*addr)));
+  socklen_t len = sizeof(*addr);
+  CHECK_EQ(0, getsockname(fd.get(), reinterpret_cast<struct sockaddr*>(addr),
+                          &len));
+  return fd;
+}
+
+// Preallocated buffers for a batch of datagrams, set up the way
+// MulticastForwarder uses them.
+struct Batch {
+  Batch() : buf(kBatchSize * kPacketSize) {
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < kBatchSize; i++) {
+      iovs[i].iov_base = &buf[i * kPacketSize];
+      iovs[i].iov_len = kPacketSize;
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+  }
+
+  std::vector<char> buf;
+  struct iovec iovs[kBatchSize];
+  struct sockaddr_in addrs[kBatchSize];
+  struct mmsghdr msgs[kBatchSize];
+};
+
+}  // namespace
+
+int main() {
+  using arc_networkd::MulticastSocket;
+
+  struct sockaddr_in rx_addr;
+  struct sockaddr_in tx_addr;
+  base::ScopedFD rx = OpenLoopbackSocket(&rx_addr);
+  base::ScopedFD tx = OpenLoopbackSocket(&tx_addr);
+  char data[kPacketSize] = {0};
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int round = 0; round < kRounds; round++) {
+    for (int i = 0; i < kBatchSize; i++) {
+      CHECK_EQ(kPacketSize,
+               sendto(tx.get(), data, kPacketSize, 0,
+                      reinterpret_cast<struct sockaddr*>(&rx_addr),
+                      sizeof(rx_addr)));
+    }
+    for (int i = 0; i < kBatchSize; i++) {
+      struct sockaddr_in from;
+      CHECK_EQ(kPacketSize, MulticastSocket::RecvFromFd(rx.get(), data,
+                                                        kPacketSize, &from));
+    }
+  }
+  const base::TimeDelta single_time = base::TimeTicks::Now() - start;
+
+  Batch out;
+  for (int i = 0; i < kBatchSize; i++)
+    out.addrs[i] = rx_addr;
+  Batch in;
+  start = base::TimeTicks::Now();
+  for (int round = 0; round < kRounds; round++) {
+    CHECK_EQ(kBatchSize,
+             MulticastSocket::SendManyToFd(tx.get(), out.msgs, kBatchSize));
+    CHECK_EQ(kBatchSize,
+             MulticastSocket::RecvManyFromFd(rx.get(), in.msgs, kBatchSize));
+  }
+  const base::TimeDelta batch_time = base::TimeTicks::Now() - start;
+
+  printf("%d datagrams of %d bytes: %" PRId64 " us one at a time, %" PRId64
+         " us in batches of %d\n",
+         kRounds * kBatchSize, kPacketSize, single_time.InMicroseconds(),
+         batch_time.InMicroseconds(), kBatchSize);
+  return 0;
+}
@@ -0,0 +1,94 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "arc-networkd/multicast_socket.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <vector>
+
+#include <base/files/scoped_file.h>
+#include <base/logging.h>
+#include <gtest/gtest.h>
+
+namespace arc_networkd {
+
+namespace {
+
+const int kBatchSize = 32;
+const int kPacketSize = 512;
+
+// Opens a UDP socket bound to an ephemeral port on the loopback interface and
+// stores its address in |addr|.
+base::ScopedFD OpenLoopbackSocket(struct sockaddr_in* addr) {
+  base::ScopedFD fd(socket(AF_INET, SOCK_DGRAM, 0));
+  CHECK(fd.is_valid());
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  CHECK_EQ(0, bind(fd.get(), reinterpret_cast<struct sockaddr*>(addr),
+                   sizeof(*addr)));
+  socklen_t len = sizeof(*addr);
+  CHECK_EQ(0, getsockname(fd.get(), reinterpret_cast<struct sockaddr*>(addr),
+                          &len));
+  return fd;
+}
+
+// Preallocated buffers for a batch of datagrams, set up the way
+// MulticastForwarder uses them.
+struct Batch {
+  Batch() : buf(kBatchSize * kPacketSize) {
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < kBatchSize; i++) {
+      iovs[i].iov_base = &buf[i * kPacketSize];
+      iovs[i].iov_len = kPacketSize;
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+  }
+
+  std::vector<char> buf;
+  struct iovec iovs[kBatchSize];
+  struct sockaddr_in addrs[kBatchSize];
+  struct mmsghdr msgs[kBatchSize];
+};
+
+}  // namespace
+
+TEST(MulticastSocketTest, SendAndReceiveMany) {
+  struct sockaddr_in rx_addr;
+  struct sockaddr_in tx_addr;
+  base::ScopedFD rx = OpenLoopbackSocket(&rx_addr);
+  base::ScopedFD tx = OpenLoopbackSocket(&tx_addr);
+
+  Batch out;
+  for (int i = 0; i < kBatchSize; i++) {
+    out.addrs[i] = rx_addr;
+    memset(out.iovs[i].iov_base, i, kPacketSize);
+    out.iovs[i].iov_len = i + 1;
+  }
+  EXPECT_EQ(kBatchSize,
+            MulticastSocket::SendManyToFd(tx.get(), out.msgs, kBatchSize));
+
+  Batch in;
+  ASSERT_EQ(kBatchSize,
+            MulticastSocket::RecvManyFromFd(rx.get(), in.msgs, kBatchSize));
+  for (int i = 0; i < kBatchSize; i++) {
+    EXPECT_EQ(out.msgs[i].msg_len, in.msgs[i].msg_len);
+    EXPECT_EQ(i + 1, static_cast<int>(in.msgs[i].msg_len));
+    EXPECT_EQ(static_cast<char>(i), in.buf[i * kPacketSize]);
+    EXPECT_EQ(sizeof(struct sockaddr_in), in.msgs[i].msg_hdr.msg_namelen);
+    EXPECT_EQ(tx_addr.sin_port, in.addrs[i].sin_port);
+  }
+
+  // Nothing is left, and receiving doesn't block.
+  EXPECT_EQ(0, MulticastSocket::RecvManyFromFd(rx.get(), in.msgs, kBatchSize));
+}
+
+}  // namespace arc_networkd
@@ -37,4 +37,21 @@
       'sources': ['tools/fake_biometric_tool.cc'],
     },
   ],
+  'conditions': [
+    ['USE_test == 1', {
+      'targets': [
+        {
+          'target_name': 'biod_test_runner',
+          'type': 'executable',
+          'includes': ['../common-mk/common_test.gypi'],
+          'sources': [
+            'biod_storage.cc',
+            'biod_storage_unittest.cc',
+            'scoped_umask.cc',
+            'testrunner.cc',
+          ],
+        },
+      ],
+    }],
+  ],
 }
@@ -8,10 +8,13 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <string.h>
+
 #include <algorithm>
 #include <sstream>
 #include <utility>
 
+#include <base/base64.h>
 #include <base/files/file_enumerator.h>
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
@@ -20,6 +23,7 @@
 #include <base/json/json_string_value_serializer.h>
 #include <base/memory/ptr_util.h>
 #include <base/message_loop/message_loop.h>
+#include <base/strings/string_piece.h>
 #include <base/strings/string_util.h>
 #include <base/values.h>
 
@@ -30,10 +34,261 @@ using base::FilePath;
 namespace {
 const char kRootPath[] = "/home/root";
 const char kRecordFileName[] = "Record";
+const char kTemplateFileName[] = "Template";
+const char kIndexFileName[] = "Index";
 const char kBiod[] = "biod";
 const char kLabel[] = "label";
 const char kRecordId[] = "record_id";
 const char kData[] = "data";
+
+// The binary files are only ever read back on the device that wrote them, so
+// integers are stored in native byte order.
+const uint32_t kTemplateMagic = 0x6c706d74;  // "tmpl"
+const uint32_t kIndexMagic = 0x78646e69;     // "indx"
+const uint32_t kFormatVersion = 1;
+
+// A template file is this header followed by the label and the template data.
+// The label duplicates the index entry so a lost index can be rebuilt.
+struct TemplateHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t label_size;
+  uint32_t data_size;
+};
+
+// An index file is this header followed by |count| entries, each a uint32_t
+// record ID size, the record ID, a uint32_t label size and the label.
+struct IndexHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+};
+
+void AppendBytes(std::string* out, const void* data, size_t size) {
+  out->append(static_cast<const char*>(data), size);
+}
+
+void AppendString(std::string* out, const std::string& str) {
+  uint32_t size = str.size();
+  AppendBytes(out, &size, sizeof(size));
+  out->append(str);
+}
+
+// Reads a length-prefixed string at |*offset| of |buffer| and advances
+// |*offset| past it.
+bool ReadString(const std::string& buffer, size_t* offset, std::string* str) {
+  uint32_t size;
+  if (buffer.size() - *offset < sizeof(size))
+    return false;
+  memcpy(&size, buffer.data() + *offset, sizeof(size));
+  *offset += sizeof(size);
+  if (buffer.size() - *offset < size)
+    return false;
+  str->assign(buffer, *offset, size);
+  *offset += size;
+  return true;
+}
+
+// Validates the template file in |buffer| and returns pointers to its label
+// and data.
+bool ParseTemplate(const uint8_t* buffer,
+                   size_t size,
+                   base::StringPiece* label,
+                   const uint8_t** data,
+                   size_t* data_size) {
+  TemplateHeader header;
+  if (size < sizeof(header))
+    return false;
+  memcpy(&header, buffer, sizeof(header));
+  if (header.magic != kTemplateMagic || header.version != kFormatVersion)
+    return false;
+  if (size - sizeof(header) <
+      static_cast<size_t>(header.label_size) + header.data_size)
+    return false;
+  const uint8_t* label_start = buffer + sizeof(header);
+  *label = base::StringPiece(reinterpret_cast<const char*>(label_start),
+                             header.label_size);
+  *data = label_start + header.label_size;
+  *data_size = header.data_size;
+  return true;
+}
+
+bool WriteTemplateFile(const FilePath& path,
+                       const std::string& label,
+                       const std::vector<uint8_t>& data) {
+  TemplateHeader header = {kTemplateMagic, kFormatVersion,
+                           static_cast<uint32_t>(label.size()),
+                           static_cast<uint32_t>(data.size())};
+  std::string contents;
+  contents.reserve(sizeof(header) + label.size() + data.size());
+  AppendBytes(&contents, &header, sizeof(header));
+  contents.append(label);
+  AppendBytes(&contents, data.data(), data.size());
+  if (!base::ImportantFileWriter::WriteFileAtomically(path, contents)) {
+    LOG(ERROR) << "Failed to write template file: " << path.value() << ".";
+    return false;
+  }
+  return true;
+}
+
+// Reads the label stored in a template file without keeping its data.
+bool ReadTemplateLabel(const FilePath& path, std::string* label) {
+  base::MemoryMappedFile file;
+  if (!file.Initialize(path))
+    return false;
+  base::StringPiece label_sp;
+  const uint8_t* data;
+  size_t data_size;
+  if (!ParseTemplate(file.data(), file.length(), &label_sp, &data, &data_size))
+    return false;
+  label_sp.CopyToString(label);
+  return true;
+}
+
+// Returns false if the index exists but is corrupt. A missing index reads as
+// empty.
+bool ReadIndexFile(const FilePath& path,
+                   std::map<std::string, std::string>* index) {
+  index->clear();
+  if (!base::PathExists(path))
+    return true;
+
+  std::string buffer;
+  if (!base::ReadFileToString(path, &buffer)) {
+    LOG(ERROR) << "Failed to read index file: " << path.value() << ".";
+    return false;
+  }
+  IndexHeader header;
+  if (buffer.size() < sizeof(header)) {
+    LOG(ERROR) << "Index file " << path.value() << " is truncated.";
+    return false;
+  }
+  memcpy(&header, buffer.data(), sizeof(header));
+  if (header.magic != kIndexMagic || header.version != kFormatVersion) {
+    LOG(ERROR) << "Index file " << path.value() << " has unknown format.";
+    return false;
+  }
+  size_t offset = sizeof(header);
+  for (uint32_t i = 0; i < header.count; i++) {
+    std::string record_id;
+    std::string label;
+    if (!ReadString(buffer, &offset, &record_id) ||
+        !ReadString(buffer, &offset, &label)) {
+      LOG(ERROR) << "Index file " << path.value() << " is truncated.";
+      index->clear();
+      return false;
+    }
+    (*index)[record_id] = std::move(label);
+  }
+  return true;
+}
+
+bool WriteIndexFile(const FilePath& path,
+                    const std::map<std::string, std::string>& index) {
+  IndexHeader header = {kIndexMagic, kFormatVersion,
+                        static_cast<uint32_t>(index.size())};
+  std::string contents;
+  AppendBytes(&contents, &header, sizeof(header));
+  for (const auto& entry : index) {
+    AppendString(&contents, entry.first);
+    AppendString(&contents, entry.second);
+  }
+  if (!base::ImportantFileWriter::WriteFileAtomically(path, contents)) {
+    LOG(ERROR) << "Failed to write index file: " << path.value() << ".";
+    return false;
+  }
+  return true;
+}
+
+// Parses a legacy JSON record. Its data is a string, base64 encoded by the
+// FPC biometrics manager and plain text for the fake one.
+bool ReadLegacyRecord(const FilePath& record_path,
+                      std::string* label,
+                      std::string* record_id,
+                      std::vector<uint8_t>* data) {
+  std::string json_string;
+  if (!base::ReadFileToString(record_path, &json_string)) {
+    LOG(ERROR) << "Failed to read the string from " << record_path.value()
+               << ".";
+    return false;
+  }
+
+  JSONStringValueDeserializer json_deserializer(json_string);
+  json_deserializer.set_allow_trailing_comma(true);
+  int error_code;
+  std::string error_message;
+  std::unique_ptr<base::Value> record_value(
+      json_deserializer.Deserialize(&error_code, &error_message));
+
+  if (!record_value) {
+    LOG_IF(ERROR, error_code) << "Error in deserializing JSON from path "
+                              << record_path.value() << " with code "
+                              << error_code << ".";
+    LOG_IF(ERROR, !error_message.empty())
+        << "JSON error message: " << error_message << ".";
+    return false;
+  }
+
+  base::DictionaryValue* record_dictionary;
+
+  if (!record_value->GetAsDictionary(&record_dictionary)) {
+    LOG(ERROR) << "Cannot cast " << record_path.value()
+               << " to a dictionary value.";
+    return false;
+  }
+
+  if (!record_dictionary->GetString(kLabel, label)) {
+    LOG(ERROR) << "Cannot read label from " << record_path.value() << ".";
+    return false;
+  }
+
+  if (!(record_dictionary->GetString(kRecordId, record_id))) {
+    LOG(ERROR) << "Cannot read record id from " << record_path.value() << ".";
+    return false;
+  }
+
+  std::string data_string;
+
+  if (!(record_dictionary->GetString(kData, &data_string))) {
+    LOG(ERROR) << "Cannot read data from " << record_path.value() << ".";
+    return false;
+  }
+
+  std::string decoded;
+  if (base::Base64Decode(data_string, &decoded))
+    data_string.swap(decoded);
+  data->assign(data_string.begin(), data_string.end());
+  return true;
+}
+}  // namespace
+
+BiodStorage::RecordData::RecordData(std::vector<uint8_t> data)
+    : buffer_(std::move(data)), data_(buffer_.data()), size_(buffer_.size()) {}
+
+BiodStorage::RecordData::RecordData(const FilePath& template_path)
+    : template_path_(template_path) {}
+
+BiodStorage::RecordData::~RecordData() {}
+
+bool BiodStorage::RecordData::Load() {
+  if (data_ || template_path_.empty())
+    return data_ != nullptr;
+
+  if (!mapped_file_.Initialize(template_path_)) {
+    LOG(ERROR) << "Failed to map template file: " << template_path_.value()
+               << ".";
+    return false;
+  }
+  base::StringPiece label;
+  if (!ParseTemplate(
+          mapped_file_.data(), mapped_file_.length(), &label, &data_, &size_)) {
+    LOG(ERROR) << "Template file " << template_path_.value()
+               << " is corrupt.";
+    data_ = nullptr;
+    size_ = 0;
+    return false;
+  }
+  return true;
 }
 
 BiodStorage::BiodStorage(const std::string& biometrics_manager_path,
@@ -42,42 +297,46 @@ BiodStorage::BiodStorage(const std::string& biometrics_manager_path,
       biometrics_manager_path_(biometrics_manager_path),
       load_record_(load_record) {}
 
+FilePath BiodStorage::GetUserPath(const std::string& user_id) const {
+  return root_path_.Append(user_id).Append(kBiod).Append(
+      biometrics_manager_path_);
+}
+
 bool BiodStorage::WriteRecord(const BiometricsManager::Record& record,
-                              std::unique_ptr<base::Value> data) {
+                              const std::vector<uint8_t>& data) {
   const std::string& record_id(record.GetId());
-  base::DictionaryValue record_value;
-  record_value.SetString(kLabel, record.GetLabel());
-  record_value.SetString(kRecordId, record_id);
-  record_value.Set(kData, std::move(data));
-
-  std::string json_string;
-  JSONStringValueSerializer json_serializer(&json_string);
-  if (!json_serializer.Serialize(record_value)) {
-    LOG(ERROR) << "Failed to serialize record with id " << record_id
-               << " to JSON.";
-    return false;
-  }
+  std::string label(record.GetLabel());
+  FilePath user_path = GetUserPath(record.GetUserId());
 
   std::unique_ptr<ScopedUmask> owner_only_umask(new ScopedUmask(~(0700)));
 
-  FilePath record_storage_filename = root_path_.Append(record.GetUserId())
-                                         .Append(kBiod)
-                                         .Append(biometrics_manager_path_)
-                                         .Append(kRecordFileName + record_id);
-  if (!base::CreateDirectory(record_storage_filename.DirName())) {
-    LOG(ERROR) << "Cannot create directory: "
-               << record_storage_filename.DirName().value() << ".";
+  if (!base::CreateDirectory(user_path)) {
+    LOG(ERROR) << "Cannot create directory: " << user_path.value() << ".";
     return false;
   }
 
   owner_only_umask.reset(new ScopedUmask(~(0600)));
 
-  if (!base::ImportantFileWriter::WriteFileAtomically(record_storage_filename,
-                                                      json_string)) {
-    LOG(ERROR) << "Failed to write JSON file: "
-               << record_storage_filename.value() << ".";
+  // The template file goes first; a template that is missing from the index is
+  // picked up again the next time the records are read.
+  if (!WriteTemplateFile(
+          user_path.Append(kTemplateFileName + record_id), label, data))
     return false;
+
+  FilePath index_path = user_path.Append(kIndexFileName);
+  RecordIndex index;
+  if (!ReadIndexFile(index_path, &index))
+    LOG(WARNING) << "Rewriting corrupt index " << index_path.value() << ".";
+  auto entry = index.find(record_id);
+  if (entry == index.end() || entry->second != label) {
+    index[record_id] = std::move(label);
+    if (!WriteIndexFile(index_path, index))
+      return false;
   }
+
+  // A legacy copy of this record is stale now.
+  base::DeleteFile(user_path.Append(kRecordFileName + record_id), false);
+
   LOG(INFO) << "Done writing record with id " << record_id
             << " to file successfully. ";
   return true;
@@ -92,97 +351,144 @@ bool BiodStorage::ReadRecords(const std::unordered_set<std::string>& user_ids) {
 }
 
 bool BiodStorage::ReadRecordsForSingleUser(const std::string& user_id) {
-  FilePath biod_path =
-      root_path_.Append(user_id).Append(kBiod).Append(biometrics_manager_path_);
-  base::FileEnumerator enum_records(biod_path,
-                                    false,
-                                    base::FileEnumerator::FILES,
-                                    FILE_PATH_LITERAL("Record*"));
+  FilePath user_path = GetUserPath(user_id);
+  FilePath index_path = user_path.Append(kIndexFileName);
   bool read_all_records_successfully = true;
-  for (FilePath record_path = enum_records.Next(); !record_path.empty();
-       record_path = enum_records.Next()) {
-    std::string json_string;
-    if (!base::ReadFileToString(record_path, &json_string)) {
-      LOG(ERROR) << "Failed to read the string from " << record_path.value()
+
+  RecordIndex index;
+  bool index_changed = !ReadIndexFile(index_path, &index);
+
+  // Reconcile the index with the template files on disk. Only template files
+  // that the index does not know about are opened.
+  std::unordered_set<std::string> template_ids;
+  base::FileEnumerator enum_templates(
+      user_path,
+      false,
+      base::FileEnumerator::FILES,
+      std::string(kTemplateFileName) + FILE_PATH_LITERAL("*"));
+  for (FilePath template_path = enum_templates.Next(); !template_path.empty();
+       template_path = enum_templates.Next()) {
+    std::string record_id =
+        template_path.BaseName().value().substr(strlen(kTemplateFileName));
+    template_ids.insert(record_id);
+    if (index.count(record_id))
+      continue;
+    std::string label;
+    if (!ReadTemplateLabel(template_path, &label)) {
+      LOG(ERROR) << "Cannot read template file " << template_path.value()
                  << ".";
       read_all_records_successfully = false;
       continue;
     }
-
-    JSONStringValueDeserializer json_deserializer(json_string);
-    json_deserializer.set_allow_trailing_comma(true);
-    int error_code;
-    std::string error_message;
-    std::unique_ptr<base::Value> record_value(
-        json_deserializer.Deserialize(&error_code, &error_message));
-
-    if (!record_value) {
-      LOG_IF(ERROR, error_code) << "Error in deserializing JSON from path "
-                                << record_path.value() << " with code "
-                                << error_code << ".";
-      LOG_IF(ERROR, !error_message.empty())
-          << "JSON error message: " << error_message << ".";
-      read_all_records_successfully = false;
+    LOG(INFO) << "Adding record " << record_id << " back to the index.";
+    index[record_id] = std::move(label);
+    index_changed = true;
+  }
+  for (auto it = index.begin(); it != index.end();) {
+    if (template_ids.count(it->first)) {
+      ++it;
       continue;
     }
+    LOG(ERROR) << "Template file of record " << it->first << " is missing.";
+    read_all_records_successfully = false;
+    it = index.erase(it);
+    index_changed = true;
+  }
 
-    base::DictionaryValue* record_dictionary;
+  std::vector<FilePath> migrated_paths;
+  read_all_records_successfully &=
+      MigrateLegacyRecords(user_id, &index, &migrated_paths);
+  index_changed |= !migrated_paths.empty();
 
-    if (!record_value->GetAsDictionary(&record_dictionary)) {
-      LOG(ERROR) << "Cannot cast " << record_path.value()
-                 << " to a dictionary value.";
-      read_all_records_successfully = false;
-      continue;
+  if (index_changed) {
+    std::unique_ptr<ScopedUmask> owner_only_umask(new ScopedUmask(~(0600)));
+    if (WriteIndexFile(index_path, index)) {
+      for (const FilePath& path : migrated_paths)
+        base::DeleteFile(path, false);
     }
+  }
 
-    std::string label;
-
-    if (!record_dictionary->GetString(kLabel, &label)) {
-      LOG(ERROR) << "Cannot read label from " << record_path.value() << ".";
+  for (const auto& entry : index) {
+    std::shared_ptr<RecordData> data(
+        new RecordData(user_path.Append(kTemplateFileName + entry.first)));
+    if (!load_record_.Run(user_id, entry.second, entry.first, data)) {
+      LOG(ERROR) << "Cannot load record " << entry.first << ".";
       read_all_records_successfully = false;
       continue;
     }
+  }
+  return read_all_records_successfully;
+}
 
+bool BiodStorage::MigrateLegacyRecords(const std::string& user_id,
+                                       RecordIndex* index,
+                                       std::vector<FilePath>* migrated_paths) {
+  FilePath user_path = GetUserPath(user_id);
+  base::FileEnumerator enum_records(
+      user_path,
+      false,
+      base::FileEnumerator::FILES,
+      std::string(kRecordFileName) + FILE_PATH_LITERAL("*"));
+  std::unique_ptr<ScopedUmask> owner_only_umask(new ScopedUmask(~(0600)));
+  bool migrated_all_records = true;
+  for (FilePath record_path = enum_records.Next(); !record_path.empty();
+       record_path = enum_records.Next()) {
+    std::string label;
     std::string record_id;
-
-    if (!(record_dictionary->GetString(kRecordId, &record_id))) {
-      LOG(ERROR) << "Cannot read record id from " << record_path.value() << ".";
-      read_all_records_successfully = false;
+    std::vector<uint8_t> data;
+    if (!ReadLegacyRecord(record_path, &label, &record_id, &data)) {
+      migrated_all_records = false;
       continue;
     }
 
-    base::Value* data;
-
-    if (!(record_dictionary->Get(kData, &data))) {
-      LOG(ERROR) << "Cannot read data from " << record_path.value() << ".";
-      read_all_records_successfully = false;
+    if (WriteTemplateFile(user_path.Append(kTemplateFileName + record_id),
+                          label,
+                          data)) {
+      LOG(INFO) << "Migrated record " << record_id << " to binary format.";
+      (*index)[record_id] = std::move(label);
+      migrated_paths->push_back(record_path);
       continue;
     }
 
-    if (!load_record_.Run(user_id, label, record_id, data)) {
+    // Keep the legacy file around for the next attempt but still make the
+    // record usable now.
+    index->erase(record_id);
+    std::shared_ptr<RecordData> record_data(new RecordData(std::move(data)));
+    if (!load_record_.Run(user_id, label, record_id, record_data)) {
       LOG(ERROR) << "Cannot load record from " << record_path.value() << ".";
-      read_all_records_successfully = false;
-      continue;
+      migrated_all_records = false;
     }
   }
-  return read_all_records_successfully;
+  return migrated_all_records;
 }
 
 bool BiodStorage::DeleteRecord(const std::string& user_id,
                                const std::string& record_id) {
-  FilePath record_storage_filename = root_path_.Append(user_id)
-                                         .Append(kBiod)
-                                         .Append(biometrics_manager_path_)
-                                         .Append(kRecordFileName + record_id);
-
-  if (!base::PathExists(record_storage_filename)) {
-    LOG(INFO) << "Trying to delete record " << record_id
-              << " which does not exist on disk.";
-    return true;
+  FilePath user_path = GetUserPath(user_id);
+
+  // The files go first. If one cannot be deleted the index still lists the
+  // record, which stays usable. If the index cannot be updated afterwards, the
+  // entry without a template file is dropped the next time the records are
+  // read. The legacy file is removed before the template file so a failure
+  // cannot leave behind a legacy record that would be migrated again.
+  for (const char* prefix : {kRecordFileName, kTemplateFileName}) {
+    FilePath record_path = user_path.Append(prefix + record_id);
+    if (!base::PathExists(record_path))
+      continue;
+    if (!base::DeleteFile(record_path, false)) {
+      LOG(ERROR) << "Fail to delete record " << record_id << " from disk.";
+      return false;
+    }
   }
-  if (!base::DeleteFile(record_storage_filename, false)) {
-    LOG(ERROR) << "Fail to delete record " << record_id << " from disk.";
-    return false;
+
+  FilePath index_path = user_path.Append(kIndexFileName);
+  RecordIndex index;
+  if (ReadIndexFile(index_path, &index) && index.erase(record_id) > 0) {
+    std::unique_ptr<ScopedUmask> owner_only_umask(new ScopedUmask(~(0600)));
+    if (!WriteIndexFile(index_path, index)) {
+      LOG(WARNING) << "Fail to delete record " << record_id
+                   << " from index; it is dropped on the next read.";
+    }
   }
   LOG(INFO) << "Done deleting record " << record_id << " from disk.";
   return true;
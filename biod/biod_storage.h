@@ -5,41 +5,83 @@
 #ifndef BIOD_BIOD_STORAGE_H_
 #define BIOD_BIOD_STORAGE_H_
 
+#include <stdint.h>
+
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <base/callback.h>
 #include <base/files/file_path.h>
-#include <base/values.h>
+#include <base/files/memory_mapped_file.h>
+#include <base/macros.h>
 
 #include "biod/biometrics_manager.h"
 #include "biod/scoped_umask.h"
 
 namespace biod {
 
+// Records are stored per user under
+// /home/root/<hash of user id>/biod/<BiometricsManager>/ as one binary
+// TemplateUUID file per record plus an Index file listing the ID and label of
+// every record. Reading the records of a user only reads the index; the
+// template files are memory-mapped when their data is first needed.
+//
+// Records written by older versions of biod as RecordUUID JSON files are
+// converted to the binary format the first time they are read.
 class BiodStorage {
  public:
-  using ReadRecordsCallback = base::Callback<bool(std::string user_id,
-                                                  std::string label,
-                                                  std::string record_id,
-                                                  base::Value* data)>;
+  // The template data of one record.
+  class RecordData {
+   public:
+    // Data that is already in memory.
+    explicit RecordData(std::vector<uint8_t> data);
+    // Data in a template file, which is not mapped until Load() is called.
+    explicit RecordData(const base::FilePath& template_path);
+    ~RecordData();
+
+    // Makes data() and size() available. Returns false if the template file
+    // cannot be mapped or is invalid.
+    bool Load();
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+   private:
+    base::FilePath template_path_;
+    std::vector<uint8_t> buffer_;
+    base::MemoryMappedFile mapped_file_;
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(RecordData);
+  };
+
+  using ReadRecordsCallback =
+      base::Callback<bool(std::string user_id,
+                          std::string label,
+                          std::string record_id,
+                          const std::shared_ptr<RecordData>& data)>;
 
-  // Constructor set the file path to be
-  // /home/root/<hash of user id>/biod/<BiometricsManager>/RecordUUID.
   explicit BiodStorage(const std::string& biometrics_manager_path,
                        const ReadRecordsCallback& load_record);
 
+  // Stores records under |root_path| instead of /home/root.
+  void set_root_path_for_testing(const base::FilePath& root_path) {
+    root_path_ = root_path;
+  }
+
   // Write one record to file in per user stateful. This is called whenever
-  // we enroll a new record.
+  // we enroll a new record or change an existing one.
   bool WriteRecord(const BiometricsManager::Record& record,
-                   std::unique_ptr<base::Value> data);
+                   const std::vector<uint8_t>& data);
 
   // Read all records from file for all users in the set. Called whenever biod
   // starts or when a new user logs in.
   bool ReadRecords(const std::unordered_set<std::string>& user_ids);
 
-  // Delete one record file. User will be able to do this via UI. True if
+  // Delete the files of one record. User will be able to do this via UI. True if
   // this record does not exist on disk.
   bool DeleteRecord(const std::string& user_id, const std::string& record_id);
 
@@ -49,14 +91,28 @@ class BiodStorage {
   std::string GenerateNewRecordId();
 
  private:
+  // Maps record IDs to labels.
+  using RecordIndex = std::map<std::string, std::string>;
+
   base::FilePath root_path_;
   base::FilePath biometrics_manager_path_;
   ReadRecordsCallback load_record_;
 
-  // Read all records from disk for a single user. Uses a file enumerator to
-  // enumerate through all record files. Called whenever biod starts or when
-  // a new user logs in.
+  base::FilePath GetUserPath(const std::string& user_id) const;
+
+  // Read all records from disk for a single user. The index is reconciled with
+  // the template files present on disk and legacy JSON records are migrated.
+  // Called whenever biod starts or when a new user logs in.
   bool ReadRecordsForSingleUser(const std::string& user_id);
+
+  // Converts the legacy JSON records of |user_id| to template files and adds
+  // them to |index|. Records that cannot be converted are handed to
+  // load_record_ straight from memory. Paths of converted JSON files are
+  // appended to |migrated_paths| so they can be deleted once the index is
+  // written.
+  bool MigrateLegacyRecords(const std::string& user_id,
+                            RecordIndex* index,
+                            std::vector<base::FilePath>* migrated_paths);
 };
 }  // namespace biod
 
@@ -0,0 +1,131 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "biod/biod_storage.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <base/bind.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <gtest/gtest.h>
+
+namespace biod {
+
+namespace {
+
+const char kBiometricsManagerPath[] = "TestBiometricsManager";
+const char kUserId[] = "0123456789";
+
+class TestRecord : public BiometricsManager::Record {
+ public:
+  TestRecord(const std::string& id,
+             const std::string& user_id,
+             const std::string& label)
+      : id_(id), user_id_(user_id), label_(label) {}
+
+  // BiometricsManager::Record overrides:
+  const std::string& GetId() const override { return id_; }
+  const std::string& GetUserId() const override { return user_id_; }
+  const std::string& GetLabel() const override { return label_; }
+  bool SetLabel(std::string label) override { return false; }
+  bool Remove() override { return false; }
+
+ private:
+  std::string id_;
+  std::string user_id_;
+  std::string label_;
+};
+
+}  // namespace
+
+class BiodStorageTest : public ::testing::Test {
+ public:
+  BiodStorageTest()
+      : storage_(kBiometricsManagerPath,
+                 base::Bind(&BiodStorageTest::LoadRecord,
+                            base::Unretained(this))) {}
+
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    storage_.set_root_path_for_testing(temp_dir_.path());
+    user_path_ =
+        temp_dir_.path().Append(kUserId).Append("biod").Append(
+            kBiometricsManagerPath);
+  }
+
+ protected:
+  bool LoadRecord(std::string user_id,
+                  std::string label,
+                  std::string record_id,
+                  const std::shared_ptr<BiodStorage::RecordData>& data) {
+    loaded_records_[record_id] = label;
+    return true;
+  }
+
+  bool WriteRecord(const std::string& record_id, const std::string& label) {
+    return storage_.WriteRecord(TestRecord(record_id, kUserId, label),
+                                std::vector<uint8_t>(16, 0xab));
+  }
+
+  // Reads the records of kUserId back from disk.
+  std::map<std::string, std::string> ReadRecords() {
+    loaded_records_.clear();
+    storage_.ReadRecords({kUserId});
+    return loaded_records_;
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath user_path_;
+  BiodStorage storage_;
+  std::map<std::string, std::string> loaded_records_;
+};
+
+TEST_F(BiodStorageTest, DeleteRecord) {
+  ASSERT_TRUE(WriteRecord("record0", "finger0"));
+  ASSERT_TRUE(WriteRecord("record1", "finger1"));
+
+  EXPECT_TRUE(storage_.DeleteRecord(kUserId, "record0"));
+  EXPECT_FALSE(base::PathExists(user_path_.Append("Templaterecord0")));
+  std::map<std::string, std::string> expected = {{"record1", "finger1"}};
+  EXPECT_EQ(expected, ReadRecords());
+
+  // Deleting a record that does not exist succeeds.
+  EXPECT_TRUE(storage_.DeleteRecord(kUserId, "record0"));
+}
+
+TEST_F(BiodStorageTest, DeleteRecordKeepsIndexWhenUnlinkFails) {
+  ASSERT_TRUE(WriteRecord("record0", "finger0"));
+  const base::FilePath index_path = user_path_.Append("Index");
+  std::string index_before;
+  ASSERT_TRUE(base::ReadFileToString(index_path, &index_before));
+
+  // A non-empty directory in place of the template file cannot be unlinked,
+  // even by root.
+  const base::FilePath template_path = user_path_.Append("Templaterecord0");
+  ASSERT_TRUE(base::DeleteFile(template_path, false));
+  ASSERT_TRUE(base::CreateDirectory(template_path));
+  ASSERT_EQ(1, base::WriteFile(template_path.Append("busy"), "x", 1));
+
+  EXPECT_FALSE(storage_.DeleteRecord(kUserId, "record0"));
+  std::string index_after;
+  ASSERT_TRUE(base::ReadFileToString(index_path, &index_after));
+  EXPECT_EQ(index_before, index_after);
+}
+
+TEST_F(BiodStorageTest, StaleIndexEntryIsDropped) {
+  ASSERT_TRUE(WriteRecord("record0", "finger0"));
+  ASSERT_TRUE(WriteRecord("record1", "finger1"));
+  // As if DeleteRecord() removed the template file but could not write the
+  // index.
+  ASSERT_TRUE(base::DeleteFile(user_path_.Append("Templaterecord0"), false));
+
+  std::map<std::string, std::string> expected = {{"record1", "finger1"}};
+  EXPECT_EQ(expected, ReadRecords());
+  EXPECT_EQ(expected, ReadRecords());
+}
+
+}  // namespace biod
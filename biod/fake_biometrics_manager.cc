@@ -5,6 +5,7 @@
 #include "biod/fake_biometrics_manager.h"
 
 #include <fcntl.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <uuid/uuid.h>
@@ -21,6 +22,16 @@
 
 namespace biod {
 
+namespace {
+
+// The fake has no real templates; every record stores the same bytes.
+std::vector<uint8_t> FakeTemplateData() {
+  const char kData[] = "Hello, world!";
+  return std::vector<uint8_t>(kData, kData + strlen(kData));
+}
+
+}  // namespace
+
 const std::string& FakeBiometricsManager::Record::GetId() const {
   return id_;
 }
@@ -45,8 +56,7 @@ bool FakeBiometricsManager::Record::SetLabel(std::string label) {
     internal->label = std::move(label);
     // Set label by overwriting records in file.
     return biometrics_manager_->biod_storage_.WriteRecord(
-        *this,
-        std::unique_ptr<base::Value>(new base::StringValue("Hello, world!")));
+        *this, FakeTemplateData());
   }
   LOG(ERROR) << "Attempt to set label for invalid BiometricsManager Record";
   return false;
@@ -290,10 +300,8 @@ void FakeBiometricsManager::OnFileCanReadWithoutBlocking(int fd) {
           records_[record_id] = std::move(next_internal_record_);
           Record current_record(weak_factory_.GetWeakPtr(), record_id);
 
-          if (!biod_storage_.WriteRecord(
-                  current_record,
-                  std::unique_ptr<base::Value>(
-                      new base::StringValue("Hello, world!")))) {
+          if (!biod_storage_.WriteRecord(current_record,
+                                         FakeTemplateData())) {
             records_.erase(record_id);
           }
           mode_ = Mode::kNone;
@@ -312,10 +320,11 @@ void FakeBiometricsManager::OnFileCanReadWithoutBlocking(int fd) {
   }
 }
 
-bool FakeBiometricsManager::LoadRecord(std::string user_id,
-                                       std::string label,
-                                       std::string record_id,
-                                       base::Value* data) {
+bool FakeBiometricsManager::LoadRecord(
+    std::string user_id,
+    std::string label,
+    std::string record_id,
+    const std::shared_ptr<BiodStorage::RecordData>& data) {
   InternalRecord internal_record = {std::move(user_id), std::move(label)};
   records_[record_id] = std::move(internal_record);
   LOG(INFO) << "Load record " << record_id << " from disk.";
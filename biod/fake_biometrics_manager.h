@@ -107,7 +107,7 @@ class FakeBiometricsManager : public BiometricsManager,
   bool LoadRecord(std::string user_id,
                   std::string label,
                   std::string record_id,
-                  base::Value* data);
+                  const std::shared_ptr<BiodStorage::RecordData>& data);
 
   DISALLOW_COPY_AND_ASSIGN(FakeBiometricsManager);
 };
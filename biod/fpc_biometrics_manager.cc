@@ -10,10 +10,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
-#include <base/base64.h>
 #include <base/bind.h>
 #include <base/logging.h>
-#include <base/strings/string_piece.h>
 #include <base/threading/thread_task_runner_handle.h>
 
 #include "biod/fpc/fp_sensor.h"
@@ -227,11 +225,22 @@ bool FpcBiometricsManager::Record::SetLabel(std::string label) {
   CHECK(WithInternal([&](RecordIterator i) {
     old_label = i->second.label;
     i->second.label = std::move(label);
-    (i->second.tmpl).Serialize(&serialized_tmpl);
+    // Copy the stored bytes rather than loading a template that was never
+    // used for matching.
+    const auto& stored_data = i->second.stored_data;
+    if (stored_data && stored_data->Load()) {
+      serialized_tmpl.assign(stored_data->data(),
+                             stored_data->data() + stored_data->size());
+    } else if (i->second.tmpl) {
+      (i->second.tmpl).Serialize(&serialized_tmpl);
+    } else {
+      LOG(ERROR) << "No template to save with the new label";
+    }
   })) << ": Attempted to reset label for invalid BiometricsManager Record";
 
-  if (!biometrics_manager_->WriteRecord(
-          *this, serialized_tmpl.data(), serialized_tmpl.size())) {
+  if (serialized_tmpl.empty() ||
+      !biometrics_manager_->biod_storage_.WriteRecord(*this,
+                                                      serialized_tmpl)) {
     CHECK(WithInternal(
         [&](RecordIterator i) { i->second.label = std::move(old_label); }));
     return false;
@@ -582,8 +591,7 @@ void FpcBiometricsManager::OnEnrollSessionComplete(
             std::move(user_id), std::move(label), std::move(*tmpl.get())});
   }
   Record current_record(weak_factory_.GetWeakPtr(), record_id);
-  if (!WriteRecord(
-          current_record, serialized_tmpl.data(), serialized_tmpl.size())) {
+  if (!biod_storage_.WriteRecord(current_record, serialized_tmpl)) {
     {
       base::AutoLock guard(records_lock_);
       records_.erase(record_id);
@@ -619,9 +627,7 @@ void FpcBiometricsManager::DoAuthSessionTask(
 
       base::AutoLock guard(records_lock_);
       for (auto& kv : records_) {
-        InternalRecord& record = kv.second;
-
-        int match_result = record.tmpl.MatchImage(scan.image);
+        int match_result = MatchRecordLocked(scan.image, kv.first, &kv.second);
         switch (match_result) {
           case BIO_TEMPLATE_NO_MATCH:
             break;
@@ -629,7 +635,7 @@ void FpcBiometricsManager::DoAuthSessionTask(
             updated_record_ids->insert(kv.first);
           case BIO_TEMPLATE_MATCH: {
             auto emplace_result =
-                matches.emplace(record.user_id, std::vector<std::string>());
+                matches.emplace(kv.second.user_id, std::vector<std::string>());
             emplace_result.first->second.emplace_back(kv.first);
             break;
           }
@@ -686,8 +692,7 @@ void FpcBiometricsManager::OnAuthSessionComplete(
     }
 
     Record current_record(weak_factory_.GetWeakPtr(), record_id);
-    if (!WriteRecord(
-            current_record, serialized_tmpl.data(), serialized_tmpl.size())) {
+    if (!biod_storage_.WriteRecord(current_record, serialized_tmpl)) {
       LOG(ERROR) << "Cannot update record " << record_id
                  << " in storage during AuthSession because writing failed.";
     }
@@ -699,25 +704,44 @@ void FpcBiometricsManager::OnTaskComplete() {
   running_task_ = false;
 }
 
-bool FpcBiometricsManager::LoadRecord(std::string user_id,
-                                      std::string label,
-                                      std::string record_id,
-                                      base::Value* data) {
-  std::string tmpl_data_base64;
-  if (!data->GetAsString(&tmpl_data_base64)) {
-    LOG(ERROR) << "Cannot load data string from record " << record_id << ".";
+int FpcBiometricsManager::MatchRecordLocked(const BioImage& image,
+                                            const std::string& record_id,
+                                            InternalRecord* record) {
+  if (!LoadTemplateLocked(record_id, record))
+    return BIO_TEMPLATE_NO_MATCH;
+  return record->tmpl.MatchImage(image);
+}
+
+bool FpcBiometricsManager::LoadTemplateLocked(const std::string& record_id,
+                                              InternalRecord* record) {
+  if (record->tmpl || !record->stored_data)
+    return static_cast<bool>(record->tmpl);
+
+  if (!record->stored_data->Load()) {
+    LOG(ERROR) << "Cannot read template of record " << record_id << ".";
     return false;
   }
+  std::vector<uint8_t> tmpl_data(
+      record->stored_data->data(),
+      record->stored_data->data() + record->stored_data->size());
+  record->tmpl = bio_lib_->DeserializeTemplate(tmpl_data);
+  if (!record->tmpl) {
+    LOG(ERROR) << "Cannot deserialize template of record " << record_id << ".";
+    return false;
+  }
+  // The library keeps its own copy, so the mapping can go.
+  record->stored_data.reset();
+  return true;
+}
 
-  base::StringPiece tmpl_data_base64_sp(tmpl_data_base64);
-  std::string tmpl_data_str;
-  base::Base64Decode(tmpl_data_base64_sp, &tmpl_data_str);
-
-  std::vector<uint8_t> tmpl_data_vector(tmpl_data_str.begin(),
-                                        tmpl_data_str.end());
-  BioTemplate tmpl(bio_lib_->DeserializeTemplate(tmpl_data_vector));
+bool FpcBiometricsManager::LoadRecord(
+    std::string user_id,
+    std::string label,
+    std::string record_id,
+    const std::shared_ptr<BiodStorage::RecordData>& data) {
+  // The template is deserialized the first time it is matched against.
   InternalRecord internal_record = {
-      std::move(user_id), std::move(label), std::move(tmpl)};
+      std::move(user_id), std::move(label), BioTemplate(), data};
   {
     base::AutoLock guard(records_lock_);
     records_[record_id] = std::move(internal_record);
@@ -726,15 +750,4 @@ bool FpcBiometricsManager::LoadRecord(std::string user_id,
   return true;
 }
 
-bool FpcBiometricsManager::WriteRecord(const BiometricsManager::Record& record,
-                                       uint8_t* tmpl_data,
-                                       size_t tmpl_size) {
-  base::StringPiece tmpl_sp(reinterpret_cast<char*>(tmpl_data), tmpl_size);
-  std::string tmpl_base64;
-  base::Base64Encode(tmpl_sp, &tmpl_base64);
-
-  return biod_storage_.WriteRecord(
-      record, std::unique_ptr<base::Value>(new base::StringValue(tmpl_base64)));
-}
-
 }  // namespace biod
@@ -86,7 +86,10 @@ class FpcBiometricsManager : public BiometricsManager {
   struct InternalRecord {
     std::string user_id;
     std::string label;
+    // Empty until LoadTemplateLocked() deserializes |stored_data|.
     BioTemplate tmpl;
+    // The serialized template as stored on disk, or null once |tmpl| is set.
+    std::shared_ptr<BiodStorage::RecordData> stored_data;
   };
 
   // Our Record implementation is just a proxy for InternalRecord, which are all
@@ -170,13 +173,20 @@ class FpcBiometricsManager : public BiometricsManager {
 
   void OnTaskComplete();
 
+  // Matches |image| against the template of |record|, which has |record_id|.
+  // Only call on the sensor thread while the records_lock_ is held.
+  int MatchRecordLocked(const BioImage& image,
+                        const std::string& record_id,
+                        InternalRecord* record);
+
+  // Deserializes the template of |record| if that has not happened yet. Only
+  // call while the records_lock_ is held.
+  bool LoadTemplateLocked(const std::string& record_id, InternalRecord* record);
+
   bool LoadRecord(std::string user_id,
                   std::string label,
                   std::string record_id,
-                  base::Value* data);
-  bool WriteRecord(const BiometricsManager::Record& record,
-                   uint8_t* tmpl_data,
-                   size_t tmpl_size);
+                  const std::shared_ptr<BiodStorage::RecordData>& data);
 
   // The following variables are const after Init and therefore totally thread
   // safe.
@@ -40,6 +40,17 @@
             'log_unit_tests.cc',
           ],
         },
+        # Prints the per-event cost of bootstat_log(); not part of the tests.
+        {
+          'target_name': 'bootstat_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'libbootstat',
+          ],
+          'sources': [
+            'bootstat_benchmark.cc',
+          ],
+        },
       ],
     }],
   ],
@@ -0,0 +1,66 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Calls bootstat_log() for 1000 differently named events (or the number
+// given as the only argument), writing the event files into a temporary
+// directory, and prints the average time per call.  The kernel bootstage
+// mark and the disk statistics are the real ones, so the result is the
+// cost a boot script pays per event, minus starting the bootstat command.
+
+#include "bootstat/bootstat.h"
+#include "bootstat/bootstat_test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace {
+
+const int kDefaultNumEvents = 1000;
+
+double Now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int num_events = kDefaultNumEvents;
+  if (argc > 2 || (argc == 2 && (num_events = atoi(argv[1])) <= 0)) {
+    fprintf(stderr, "Usage: %s [<number-of-events>]\n", argv[0]);
+    return 1;
+  }
+
+  char dir_template[] = "/tmp/bootstat_benchmark_XXXXXX";
+  if (!mkdtemp(dir_template)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  const std::string dir(dir_template);
+  bootstat_set_output_directory_for_test(dir.c_str());
+
+  // Each event gets its own name so that every call creates its files, as
+  // during boot.
+  const double start = Now();
+  for (int i = 0; i < num_events; i++)
+    bootstat_log(("event-" + std::to_string(i)).c_str());
+  const double elapsed = Now() - start;
+
+  printf("%d events: %.1f us/event\n", num_events,
+         elapsed * 1e6 / num_events);
+
+  for (int i = 0; i < num_events; i++) {
+    const std::string name = "-event-" + std::to_string(i);
+    unlink((dir + "/uptime" + name).c_str());
+    unlink((dir + "/disk" + name).c_str());
+  }
+  bootstat_set_output_directory_for_test(nullptr);
+  rmdir(dir.c_str());
+  return 0;
+}
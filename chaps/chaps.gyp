@@ -146,6 +146,7 @@
             '-ltspi',
           ],
           'sources': [
+            'key_slot_cache.cc',
             'tpm_utility_impl.cc',
           ],
         }],
@@ -251,6 +252,21 @@
             'session_test.cc',
           ],
         },
+        {
+          # Prints MB/s for large digest, HMAC and AES operations. It is built
+          # with the tests but not run by them.
+          'target_name': 'session_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'libchaps_static',
+            'libchaps_test',
+          ],
+          'includes': ['../common-mk/common_test.gypi'],
+          'sources': [
+            'session_benchmark.cc',
+            'session_impl.cc',
+          ],
+        },
         {
           'target_name': 'object_test',
           'type': 'executable',
@@ -335,6 +351,18 @@
             'opencryptoki_importer_test.cc',
           ],
         },
+        {
+          'target_name': 'key_slot_cache_test',
+          'type': 'executable',
+          'dependencies': [
+            'libchaps_static',
+          ],
+          'includes': ['../common-mk/common_test.gypi'],
+          'sources': [
+            'key_slot_cache.cc',
+            'key_slot_cache_test.cc',
+          ],
+        },
         {
           'target_name': 'isolate_login_client_test',
           'type': 'executable',
@@ -398,6 +426,34 @@
                 '-ltspi',
               ],
               'sources': [
+                'key_slot_cache.cc',
+                'tpm_utility_impl.cc',
+              ],
+            }],
+          ],
+        },
+        {
+          'target_name': 'tpm_utility_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'libchaps_static',
+          ],
+          'sources': ['tpm_utility_benchmark.cc',],
+          'conditions': [
+            ['USE_tpm2 == 1', {
+              'libraries': [
+                '-ltrunks',
+              ],
+              'sources': [
+                'tpm2_utility_impl.cc',
+              ],
+            }],
+            ['USE_tpm2 == 0', {
+              'libraries': [
+                '-ltspi',
+              ],
+              'sources': [
+                'key_slot_cache.cc',
                 'tpm_utility_impl.cc',
               ],
             }],
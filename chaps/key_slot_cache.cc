@@ -0,0 +1,125 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/key_slot_cache.h"
+
+#include <base/logging.h>
+
+using std::vector;
+
+namespace chaps {
+
+KeySlotCache::KeySlotCache(size_t capacity) : capacity_(capacity) {}
+
+KeySlotCache::~KeySlotCache() {}
+
+bool KeySlotCache::Touch(int key_handle) {
+  auto resident_it = resident_index_.find(key_handle);
+  if (resident_it != resident_index_.end()) {
+    resident_.splice(resident_.begin(), resident_, resident_it->second);
+    ++stats_.hits;
+    return true;
+  }
+  auto evicted_it = evicted_index_.find(key_handle);
+  if (evicted_it == evicted_index_.end())
+    return true;
+  evicted_.splice(evicted_.begin(), evicted_, evicted_it->second);
+  ++stats_.misses;
+  return false;
+}
+
+void KeySlotCache::Insert(int key_handle, vector<int>* evicted) {
+  InsertInternal(key_handle, evicted);
+}
+
+void KeySlotCache::InsertPrefetched(int key_handle, vector<int>* evicted) {
+  ++stats_.prefetches;
+  InsertInternal(key_handle, evicted);
+}
+
+void KeySlotCache::Remove(int key_handle) {
+  auto resident_it = resident_index_.find(key_handle);
+  if (resident_it != resident_index_.end()) {
+    resident_.erase(resident_it->second);
+    resident_index_.erase(resident_it);
+  }
+  auto evicted_it = evicted_index_.find(key_handle);
+  if (evicted_it != evicted_index_.end()) {
+    evicted_.erase(evicted_it->second);
+    evicted_index_.erase(evicted_it);
+  }
+}
+
+void KeySlotCache::Pin(int key_handle) {
+  ++pins_[key_handle];
+}
+
+void KeySlotCache::Unpin(int key_handle) {
+  auto it = pins_.find(key_handle);
+  if (it == pins_.end())
+    return;
+  if (--it->second == 0)
+    pins_.erase(it);
+}
+
+bool KeySlotCache::IsTracked(int key_handle) const {
+  return IsResident(key_handle) ||
+         evicted_index_.find(key_handle) != evicted_index_.end();
+}
+
+bool KeySlotCache::IsResident(int key_handle) const {
+  return resident_index_.find(key_handle) != resident_index_.end();
+}
+
+vector<int> KeySlotCache::GetPrefetchCandidates(size_t max_count) const {
+  vector<int> candidates;
+  if (capacity_ == 0 || resident_.size() >= capacity_)
+    return candidates;
+  size_t free_slots = capacity_ - resident_.size();
+  for (int key_handle : evicted_) {
+    if (candidates.size() >= free_slots || candidates.size() >= max_count)
+      break;
+    candidates.push_back(key_handle);
+  }
+  return candidates;
+}
+
+void KeySlotCache::InsertInternal(int key_handle, vector<int>* evicted) {
+  CHECK(evicted);
+  auto evicted_it = evicted_index_.find(key_handle);
+  if (evicted_it != evicted_index_.end()) {
+    evicted_.erase(evicted_it->second);
+    evicted_index_.erase(evicted_it);
+  }
+  auto resident_it = resident_index_.find(key_handle);
+  if (resident_it != resident_index_.end()) {
+    resident_.splice(resident_.begin(), resident_, resident_it->second);
+  } else {
+    resident_.push_front(key_handle);
+    resident_index_[key_handle] = resident_.begin();
+  }
+  EvictAsNeeded(key_handle, evicted);
+}
+
+void KeySlotCache::EvictAsNeeded(int keep_handle, vector<int>* evicted) {
+  if (capacity_ == 0)
+    return;
+  // Walk from the least recently used key, skipping pinned ones. If every
+  // resident key is pinned, the cache stays over capacity.
+  auto it = resident_.end();
+  while (resident_.size() > capacity_ && it != resident_.begin()) {
+    --it;
+    int victim = *it;
+    if (victim == keep_handle || pins_.find(victim) != pins_.end())
+      continue;
+    it = resident_.erase(it);
+    resident_index_.erase(victim);
+    evicted_.push_front(victim);
+    evicted_index_[victim] = evicted_.begin();
+    evicted->push_back(victim);
+    ++stats_.evictions;
+  }
+}
+
+}  // namespace chaps
@@ -0,0 +1,95 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHAPS_KEY_SLOT_CACHE_H_
+#define CHAPS_KEY_SLOT_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <base/macros.h>
+
+namespace chaps {
+
+// KeySlotCache tracks which key handles are resident in the TPM and in which
+// order they were last used. It does not talk to the TPM itself; the TPM
+// utility asks it which keys to evict when a new key is loaded and whether a
+// key must be reloaded before it is used. Evicted handles are remembered so
+// the most recently used ones can be prefetched when slots become available
+// again.
+//
+// This class is not thread-safe; callers are expected to hold their own lock.
+class KeySlotCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t prefetches = 0;
+  };
+
+  // A |capacity| of zero means that the number of resident keys is not bounded
+  // and no key is ever evicted.
+  explicit KeySlotCache(size_t capacity);
+  ~KeySlotCache();
+
+  size_t capacity() const { return capacity_; }
+  const Stats& stats() const { return stats_; }
+
+  // Records a use of |key_handle| and makes it the most recently used key.
+  // Returns true if the key is resident. Returns false if the key has been
+  // evicted and must be reloaded (followed by a call to Insert) before use.
+  // Untracked handles are ignored and reported as resident.
+  bool Touch(int key_handle);
+
+  // Marks |key_handle| as resident and most recently used. Handles that must be
+  // unloaded to respect the capacity are appended to |evicted|; they remain
+  // tracked as evicted until Remove is called.
+  void Insert(int key_handle, std::vector<int>* evicted);
+
+  // Like Insert, but counts the load as a prefetch rather than a miss.
+  void InsertPrefetched(int key_handle, std::vector<int>* evicted);
+
+  // Stops tracking |key_handle|, whether it is resident or evicted.
+  void Remove(int key_handle);
+
+  // Pinned keys are never chosen for eviction, e.g. because keys loaded under
+  // them may need them to be reloaded. Pins are counted, so a key stays pinned
+  // until Unpin has been called as many times as Pin.
+  void Pin(int key_handle);
+  void Unpin(int key_handle);
+
+  bool IsTracked(int key_handle) const;
+  bool IsResident(int key_handle) const;
+  size_t resident_count() const { return resident_.size(); }
+
+  // Returns up to |max_count| evicted handles, most recently used first, that
+  // would fit in the currently free capacity.
+  std::vector<int> GetPrefetchCandidates(size_t max_count) const;
+
+ private:
+  void InsertInternal(int key_handle, std::vector<int>* evicted);
+  void EvictAsNeeded(int keep_handle, std::vector<int>* evicted);
+
+  const size_t capacity_;
+  Stats stats_;
+  // Resident handles, most recently used first.
+  std::list<int> resident_;
+  std::map<int, std::list<int>::iterator> resident_index_;
+  // Evicted handles, most recently used first.
+  std::list<int> evicted_;
+  std::map<int, std::list<int>::iterator> evicted_index_;
+  // The number of pins of each pinned handle.
+  std::map<int, int> pins_;
+
+  DISALLOW_COPY_AND_ASSIGN(KeySlotCache);
+};
+
+}  // namespace chaps
+
+#endif  // CHAPS_KEY_SLOT_CACHE_H_
@@ -0,0 +1,142 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/key_slot_cache.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using std::vector;
+
+namespace chaps {
+
+TEST(TestKeySlotCache, UnboundedNeverEvicts) {
+  KeySlotCache cache(0);
+  vector<int> evicted;
+  for (int i = 1; i <= 100; ++i)
+    cache.Insert(i, &evicted);
+  EXPECT_TRUE(evicted.empty());
+  EXPECT_EQ(100, cache.resident_count());
+  EXPECT_TRUE(cache.Touch(1));
+  EXPECT_EQ(1, cache.stats().hits);
+  EXPECT_EQ(0, cache.stats().evictions);
+  EXPECT_TRUE(cache.GetPrefetchCandidates(10).empty());
+}
+
+TEST(TestKeySlotCache, EvictsLeastRecentlyUsed) {
+  KeySlotCache cache(2);
+  vector<int> evicted;
+  cache.Insert(1, &evicted);
+  cache.Insert(2, &evicted);
+  EXPECT_TRUE(cache.Touch(1));
+  cache.Insert(3, &evicted);
+  ASSERT_EQ(1, evicted.size());
+  EXPECT_EQ(2, evicted[0]);
+  EXPECT_TRUE(cache.IsResident(1));
+  EXPECT_FALSE(cache.IsResident(2));
+  EXPECT_TRUE(cache.IsTracked(2));
+  EXPECT_TRUE(cache.IsResident(3));
+  EXPECT_EQ(1, cache.stats().evictions);
+}
+
+TEST(TestKeySlotCache, MissAndReload) {
+  KeySlotCache cache(1);
+  vector<int> evicted;
+  cache.Insert(1, &evicted);
+  cache.Insert(2, &evicted);
+  EXPECT_FALSE(cache.Touch(1));
+  EXPECT_EQ(1, cache.stats().misses);
+  evicted.clear();
+  cache.Insert(1, &evicted);
+  ASSERT_EQ(1, evicted.size());
+  EXPECT_EQ(2, evicted[0]);
+  EXPECT_TRUE(cache.Touch(1));
+  EXPECT_EQ(1, cache.stats().hits);
+  EXPECT_EQ(2, cache.stats().evictions);
+}
+
+TEST(TestKeySlotCache, UntrackedHandles) {
+  KeySlotCache cache(1);
+  EXPECT_TRUE(cache.Touch(42));
+  EXPECT_FALSE(cache.IsTracked(42));
+  EXPECT_EQ(0, cache.stats().hits);
+  EXPECT_EQ(0, cache.stats().misses);
+}
+
+TEST(TestKeySlotCache, Remove) {
+  KeySlotCache cache(1);
+  vector<int> evicted;
+  cache.Insert(1, &evicted);
+  cache.Insert(2, &evicted);
+  cache.Remove(1);
+  cache.Remove(2);
+  EXPECT_FALSE(cache.IsTracked(1));
+  EXPECT_FALSE(cache.IsTracked(2));
+  EXPECT_EQ(0, cache.resident_count());
+  EXPECT_TRUE(cache.GetPrefetchCandidates(10).empty());
+}
+
+TEST(TestKeySlotCache, PinnedKeysAreNotEvicted) {
+  KeySlotCache cache(2);
+  vector<int> evicted;
+  cache.Insert(1, &evicted);
+  cache.Pin(1);
+  cache.Pin(1);
+  cache.Insert(2, &evicted);
+  cache.Insert(3, &evicted);
+  ASSERT_EQ(1, evicted.size());
+  EXPECT_EQ(2, evicted[0]);
+  EXPECT_TRUE(cache.IsResident(1));
+
+  // The key stays pinned until every pin is released.
+  cache.Unpin(1);
+  evicted.clear();
+  cache.Insert(4, &evicted);
+  ASSERT_EQ(1, evicted.size());
+  EXPECT_EQ(3, evicted[0]);
+  cache.Unpin(1);
+  evicted.clear();
+  cache.Insert(5, &evicted);
+  ASSERT_EQ(1, evicted.size());
+  EXPECT_EQ(1, evicted[0]);
+}
+
+TEST(TestKeySlotCache, AllPinnedExceedsCapacity) {
+  KeySlotCache cache(1);
+  vector<int> evicted;
+  cache.Insert(1, &evicted);
+  cache.Pin(1);
+  cache.Insert(2, &evicted);
+  EXPECT_TRUE(evicted.empty());
+  EXPECT_EQ(2, cache.resident_count());
+}
+
+TEST(TestKeySlotCache, PrefetchRecentlyUsed) {
+  KeySlotCache cache(2);
+  vector<int> evicted;
+  for (int i = 1; i <= 4; ++i)
+    cache.Insert(i, &evicted);
+  // 1 and 2 are evicted; a use of 1 makes it the best prefetch candidate.
+  EXPECT_FALSE(cache.Touch(1));
+  cache.Remove(3);
+  cache.Remove(4);
+  vector<int> candidates = cache.GetPrefetchCandidates(10);
+  ASSERT_EQ(2, candidates.size());
+  EXPECT_EQ(1, candidates[0]);
+  EXPECT_EQ(2, candidates[1]);
+  EXPECT_EQ(1, cache.GetPrefetchCandidates(1).size());
+  evicted.clear();
+  cache.InsertPrefetched(candidates[0], &evicted);
+  EXPECT_TRUE(evicted.empty());
+  EXPECT_EQ(1, cache.stats().prefetches);
+  EXPECT_TRUE(cache.Touch(1));
+}
+
+}  // namespace chaps
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
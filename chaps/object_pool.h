@@ -60,6 +60,11 @@ class ObjectPool {
   // Imports an object from an external source. Like 'Insert', this method takes
   // ownership of the 'object' pointer on success.
   virtual bool Import(Object* object) = 0;
+  // Imports a batch of objects from an external source. The objects are
+  // committed to persistent storage in a single atomic write and become visible
+  // together; if any object cannot be imported, none are. This method takes
+  // ownership of all the 'objects' pointers on success.
+  virtual bool ImportBatch(const std::vector<Object*>& objects) = 0;
   // Deletes an existing object.
   virtual bool Delete(const Object* object) = 0;
   // Deletes all existing objects.
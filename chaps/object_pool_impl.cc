@@ -129,6 +129,39 @@ bool ObjectPoolImpl::Import(Object* object) {
   return true;
 }
 
+bool ObjectPoolImpl::ImportBatch(const vector<Object*>& objects) {
+  AutoLock lock(lock_);
+  ObjectSet batch;
+  for (size_t i = 0; i < objects.size(); ++i) {
+    if (objects_.find(objects[i]) != objects_.end() ||
+        !batch.insert(objects[i]).second)
+      return false;
+  }
+  if (store_.get()) {
+    vector<ObjectBlob> serialized(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+      if (!Serialize(objects[i], &serialized[i]))
+        return false;
+      // Parsing the serialized blob will normalize the object attribute values.
+      if (!Parse(serialized[i], objects[i]))
+        return false;
+    }
+    vector<int> store_ids;
+    if (!store_->InsertObjectBlobs(serialized, &store_ids) ||
+        store_ids.size() != objects.size())
+      return false;
+    for (size_t i = 0; i < objects.size(); ++i)
+      objects[i]->set_store_id(store_ids[i]);
+  }
+  for (size_t i = 0; i < objects.size(); ++i) {
+    objects[i]->set_handle(handle_generator_->CreateHandle());
+    objects_.insert(objects[i]);
+    handle_object_map_[objects[i]->handle()] =
+        shared_ptr<const Object>(objects[i]);
+  }
+  return true;
+}
+
 bool ObjectPoolImpl::Delete(const Object* object) {
   AutoLock lock(lock_);
   if (objects_.find(object) == objects_.end())
@@ -45,6 +45,7 @@ class ObjectPoolImpl : public ObjectPool {
   virtual bool SetEncryptionKey(const brillo::SecureBlob& key);
   virtual bool Insert(Object* object);
   virtual bool Import(Object* object);
+  virtual bool ImportBatch(const std::vector<Object*>& objects);
   virtual bool Delete(const Object* object);
   virtual bool DeleteAll();
   virtual bool Find(const Object* search_template,
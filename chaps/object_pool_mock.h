@@ -27,6 +27,7 @@ class ObjectPoolMock : public ObjectPool {
   MOCK_METHOD1(SetEncryptionKey, bool(const brillo::SecureBlob&));
   MOCK_METHOD1(Insert, bool(Object*));  // NOLINT(readability/function)
   MOCK_METHOD1(Import, bool(Object*));  // NOLINT(readability/function)
+  MOCK_METHOD1(ImportBatch, bool(const std::vector<Object*>&));
   MOCK_METHOD1(Delete, bool(const Object*));
   MOCK_METHOD0(DeleteAll, bool());
   MOCK_METHOD2(Find, bool(const Object*, std::vector<const Object*>*));
@@ -39,6 +40,9 @@ class ObjectPoolMock : public ObjectPool {
         .WillByDefault(testing::Invoke(this, &ObjectPoolMock::FakeInsert));
     ON_CALL(*this, Import(testing::_))
         .WillByDefault(testing::Invoke(this, &ObjectPoolMock::FakeInsert));
+    ON_CALL(*this, ImportBatch(testing::_))
+        .WillByDefault(testing::Invoke(this,
+                                       &ObjectPoolMock::FakeImportBatch));
     ON_CALL(*this, Delete(testing::_))
         .WillByDefault(testing::Invoke(this, &ObjectPoolMock::FakeDelete));
     ON_CALL(*this, Find(testing::_, testing::_))
@@ -54,6 +58,11 @@ class ObjectPoolMock : public ObjectPool {
     o->set_handle(++last_handle_);
     return true;
   }
+  bool FakeImportBatch(const std::vector<Object*>& objects) {
+    for (size_t i = 0; i < objects.size(); ++i)
+      FakeInsert(objects[i]);
+    return true;
+  }
   bool FakeDelete(const Object* o) {
     for (size_t i = 0; i < v_.size(); ++i) {
       if (o == v_[i]) {
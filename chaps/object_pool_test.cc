@@ -237,6 +237,33 @@ TEST_F(TestObjectPool, DuplicateObject) {
   EXPECT_FALSE(pool2_->Insert(o2));
 }
 
+// Test that a batch import is committed to the store in one write.
+TEST_F(TestObjectPool, ImportBatch) {
+  vector<int> ids;
+  ids.push_back(4);
+  ids.push_back(5);
+  EXPECT_CALL(*store_, InsertObjectBlobs(_, _))
+      .WillOnce(Return(false))
+      .WillOnce(DoAll(SetArgumentPointee<1>(ids), Return(true)));
+  vector<Object*> batch;
+  batch.push_back(CreateObjectMock());
+  batch.push_back(CreateObjectMock());
+  vector<const Object*> v;
+  std::unique_ptr<Object> find_all(CreateObjectMock());
+  EXPECT_FALSE(pool_->ImportBatch(batch));
+  EXPECT_TRUE(pool_->Find(find_all.get(), &v));
+  EXPECT_EQ(0, v.size());
+  EXPECT_TRUE(pool_->ImportBatch(batch));
+  EXPECT_TRUE(pool_->Find(find_all.get(), &v));
+  EXPECT_EQ(2, v.size());
+  // Objects already in the pool cannot be imported again.
+  EXPECT_FALSE(pool_->ImportBatch(batch));
+  Object* o = CreateObjectMock();
+  vector<Object*> duplicates(2, o);
+  EXPECT_FALSE(pool2_->ImportBatch(duplicates));
+  delete o;
+}
+
 TEST_F(TestObjectPool, DeleteAll) {
   EXPECT_CALL(*store_, InsertObjectBlob(_, _))
       .WillRepeatedly(DoAll(SetArgumentPointee<1>(3), Return(true)));
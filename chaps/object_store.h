@@ -7,6 +7,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <brillo/secure_blob.h>
 
@@ -46,6 +47,11 @@ class ObjectStore {
   // Inserts a new blob.
   virtual bool InsertObjectBlob(const ObjectBlob& blob,
                                 int* blob_id) = 0;
+  // Inserts a batch of new blobs in a single atomic write; either all blobs are
+  // inserted or none are. On success, 'blob_ids' holds the identifier of each
+  // blob in the same order as 'blobs'.
+  virtual bool InsertObjectBlobs(const std::vector<ObjectBlob>& blobs,
+                                 std::vector<int>* blob_ids) = 0;
   // Deletes an existing object blob.
   virtual bool DeleteObjectBlob(int blob_id) = 0;
   // Deletes all object blobs.
@@ -18,6 +18,7 @@
 #include <brillo/secure_blob.h>
 #include <leveldb/db.h>
 #include <leveldb/env.h>
+#include <leveldb/write_batch.h>
 #ifndef NO_MEMENV
 #include <leveldb/helpers/memenv.h>
 #endif
@@ -194,6 +195,52 @@ bool ObjectStoreImpl::InsertObjectBlob(const ObjectBlob& blob,
   return UpdateObjectBlob(*handle, blob);
 }
 
+bool ObjectStoreImpl::InsertObjectBlobs(const vector<ObjectBlob>& blobs,
+                                        vector<int>* handles) {
+  int first_id = 0;
+  if (!ReadInt(kIDTrackerKey, &first_id)) {
+    LOG(ERROR) << "Failed to read ID tracker.";
+    return false;
+  }
+  if (blobs.size() >
+      static_cast<size_t>(std::numeric_limits<int>::max() - first_id)) {
+    LOG(ERROR) << "Object ID overflow.";
+    return false;
+  }
+  // All blobs and the ID tracker update go into one batch so a failure or crash
+  // part way through never leaves a partially imported set of objects.
+  leveldb::WriteBatch batch;
+  vector<int> new_handles;
+  for (size_t i = 0; i < blobs.size(); ++i) {
+    if (blobs[i].is_private && key_.empty()) {
+      LOG(ERROR) << "The store encryption key has not been initialized.";
+      return false;
+    }
+    ObjectBlob encrypted_blob;
+    if (!Encrypt(blobs[i], &encrypted_blob)) {
+      LOG(ERROR) << "Failed to encrypt object blob.";
+      return false;
+    }
+    int handle = first_id + static_cast<int>(i);
+    BlobType type = blobs[i].is_private ? kPrivate : kPublic;
+    batch.Put(CreateBlobKey(type, handle), encrypted_blob.blob);
+    new_handles.push_back(handle);
+  }
+  batch.Put(kIDTrackerKey,
+            base::IntToString(first_id + static_cast<int>(blobs.size())));
+  leveldb::WriteOptions options;
+  options.sync = true;
+  leveldb::Status status = db_->Write(options, &batch);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to write object blobs: " << status.ToString();
+    return false;
+  }
+  for (size_t i = 0; i < blobs.size(); ++i)
+    blob_type_map_[new_handles[i]] = blobs[i].is_private ? kPrivate : kPublic;
+  handles->swap(new_handles);
+  return true;
+}
+
 bool ObjectStoreImpl::DeleteObjectBlob(int handle) {
   leveldb::WriteOptions options;
   options.sync = true;
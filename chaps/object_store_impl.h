@@ -36,6 +36,8 @@ class ObjectStoreImpl : public ObjectStore {
   virtual bool SetInternalBlob(int blob_id, const std::string& blob);
   virtual bool SetEncryptionKey(const brillo::SecureBlob& key);
   virtual bool InsertObjectBlob(const ObjectBlob& blob, int* handle);
+  virtual bool InsertObjectBlobs(const std::vector<ObjectBlob>& blobs,
+                                 std::vector<int>* handles);
   virtual bool DeleteObjectBlob(int handle);
   virtual bool DeleteAllObjectBlobs();
   virtual bool UpdateObjectBlob(int handle, const ObjectBlob& blob);
@@ -9,6 +9,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <gmock/gmock.h>
 
@@ -26,6 +27,8 @@ class ObjectStoreMock : public ObjectStore {
       bool(const brillo::SecureBlob& key));
   MOCK_METHOD2(InsertObjectBlob,
       bool(const ObjectBlob& blob, int* blob_id));
+  MOCK_METHOD2(InsertObjectBlobs,
+      bool(const std::vector<ObjectBlob>& blobs, std::vector<int>* blob_ids));
   MOCK_METHOD1(DeleteObjectBlob,
       bool(int blob_id));
   MOCK_METHOD0(DeleteAllObjectBlobs,
@@ -6,6 +6,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <openssl/err.h>
@@ -15,6 +16,7 @@ using base::FilePath;
 using brillo::SecureBlob;
 using std::map;
 using std::string;
+using std::vector;
 
 namespace chaps {
 
@@ -184,6 +186,39 @@ TEST(TestObjectStore, UpdateDelete) {
   EXPECT_EQ(0, objects.size());
 }
 
+TEST(TestObjectStore, InsertBatch) {
+  ObjectStoreImpl store;
+  const FilePath::CharType database[] = FILE_PATH_LITERAL(":memory:");
+  ASSERT_TRUE(store.Init(FilePath(database)));
+  vector<ObjectBlob> blobs;
+  ObjectBlob blob1 = {"blob1", false};
+  ObjectBlob blob2 = {"blob2", true};
+  blobs.push_back(blob1);
+  blobs.push_back(blob2);
+  vector<int> handles;
+  // A private blob cannot be stored without a key, so nothing is inserted.
+  EXPECT_FALSE(store.InsertObjectBlobs(blobs, &handles));
+  map<int, ObjectBlob> objects, objects2;
+  EXPECT_TRUE(store.LoadPublicObjectBlobs(&objects));
+  EXPECT_EQ(0, objects.size());
+  string tmp(32, 'A');
+  SecureBlob key(tmp.begin(), tmp.end());
+  EXPECT_TRUE(store.SetEncryptionKey(key));
+  EXPECT_TRUE(store.InsertObjectBlobs(blobs, &handles));
+  ASSERT_EQ(2, handles.size());
+  EXPECT_NE(handles[0], handles[1]);
+  EXPECT_TRUE(store.LoadPublicObjectBlobs(&objects));
+  EXPECT_TRUE(store.LoadPrivateObjectBlobs(&objects2));
+  EXPECT_EQ(1, objects.size());
+  EXPECT_EQ(1, objects2.size());
+  EXPECT_TRUE(blob1.blob == objects[handles[0]].blob);
+  EXPECT_TRUE(blob2.blob == objects2[handles[1]].blob);
+  // Identifiers keep increasing after a batch.
+  int handle3;
+  EXPECT_TRUE(store.InsertObjectBlob(blob1, &handle3));
+  EXPECT_GT(handle3, handles[1]);
+}
+
 TEST(TestObjectStore, InternalBlobs) {
   ObjectStoreImpl store;
   const FilePath::CharType database[] = FILE_PATH_LITERAL(":memory:");
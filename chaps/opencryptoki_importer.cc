@@ -4,15 +4,22 @@
 
 #include "chaps/opencryptoki_importer.h"
 
+#include <algorithm>
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <base/bind.h>
+#include <base/callback.h>
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
 #include <base/logging.h>
 #include <base/strings/string_split.h>
 #include <base/strings/string_util.h>
+#include <base/sys_info.h>
+#include <base/threading/platform_thread.h>
 
 #include "chaps/chaps_factory.h"
 #include "chaps/chaps_utility.h"
@@ -24,11 +31,18 @@
 using base::FilePath;
 using brillo::SecureBlob;
 using std::map;
+using std::pair;
 using std::string;
 using std::vector;
 
 namespace {
 
+// The maximum number of threads used to decrypt encrypted objects.
+const size_t kMaxDecryptThreads = 4;
+
+// How often, in objects, progress is logged while converting pending objects.
+const size_t kProgressInterval = 25;
+
 // Extracts a 32-bit integer by reinterpreting bytes.
 uint32_t ExtractUint32(const void* data) {
   uint32_t value;
@@ -36,6 +50,18 @@ uint32_t ExtractUint32(const void* data) {
   return value;
 }
 
+// Runs a closure on a joinable worker thread.
+class ClosureThread : public base::PlatformThread::Delegate {
+ public:
+  explicit ClosureThread(const base::Closure& closure) : closure_(closure) {}
+  void ThreadMain() override { closure_.Run(); }
+
+ private:
+  base::Closure closure_;
+
+  DISALLOW_COPY_AND_ASSIGN(ClosureThread);
+};
+
 }  // namespace
 
 namespace chaps {
@@ -120,7 +146,7 @@ bool OpencryptokiImporter::ImportObjects(ObjectPool* object_pool) {
             << ready_for_import.size() << " public.";
   // Objects that have opencryptoki internal attributes such as tpm-protected
   // blobs need to be moved to the chaps format.
-  int num_imported = 0;
+  vector<AttributeMap> public_objects;
   for (size_t i = 0; i < ready_for_import.size(); ++i) {
     if (IsPrivateKey(ready_for_import[i])) {
       // Private keys need authorization data decrypted which requires the TPM.
@@ -128,14 +154,9 @@ bool OpencryptokiImporter::ImportObjects(ObjectPool* object_pool) {
       unflattened_objects_.push_back(ready_for_import[i]);
       continue;
     }
-    Object* object = NULL;
-    if (!CreateObjectInstance(ready_for_import[i], &object)) {
-      LOG(WARNING) << "Failed to create an object instance.";
-      continue;
-    }
-    if (object_pool->Import(object))
-      ++num_imported;
+    public_objects.push_back(ready_for_import[i]);
   }
+  int num_imported = ImportAsBatch(public_objects, object_pool);
   LOG(INFO) << "Imported: " << num_imported << "; Pending: "
             << encrypted_objects_.size() + unflattened_objects_.size();
   return true;
@@ -149,22 +170,54 @@ bool OpencryptokiImporter::FinishImportAsync(ObjectPool* object_pool) {
   }
   // Objects that have opencryptoki internal attributes such as tpm-protected
   // blobs need to be moved to the chaps format.
-  int num_imported = 0;
+  vector<AttributeMap> converted;
   for (size_t i = 0; i < unflattened_objects_.size(); ++i) {
+    if ((i + 1) % kProgressInterval == 0) {
+      LOG(INFO) << "Converted " << i + 1 << " of "
+                << unflattened_objects_.size() << " pending objects.";
+    }
     if (!ConvertToChapsFormat(&unflattened_objects_[i])) {
       LOG(WARNING) << "Failed to convert an object to Chaps format.";
       continue;
     }
+    converted.push_back(unflattened_objects_[i]);
+  }
+  int num_imported = ImportAsBatch(converted, object_pool);
+  LOG(INFO) << "Finished importing " << num_imported << " pending objects.";
+  return true;
+}
+
+int OpencryptokiImporter::ImportAsBatch(const vector<AttributeMap>& attributes,
+                                        ObjectPool* object_pool) {
+  vector<Object*> objects;
+  for (size_t i = 0; i < attributes.size(); ++i) {
     Object* object = NULL;
-    if (!CreateObjectInstance(unflattened_objects_[i], &object)) {
+    if (!CreateObjectInstance(attributes[i], &object)) {
       LOG(WARNING) << "Failed to create an object instance.";
+      delete object;
       continue;
     }
-    if (object_pool->Import(object))
+    objects.push_back(object);
+  }
+  if (objects.empty())
+    return 0;
+  if (object_pool->ImportBatch(objects))
+    return objects.size();
+
+  // The import only runs once, so a single bad object must not cost all the
+  // others. Fall back to importing the objects one at a time.
+  LOG(WARNING) << "Failed to import a batch of " << objects.size()
+               << " objects; importing them one at a time.";
+  int num_imported = 0;
+  for (size_t i = 0; i < objects.size(); ++i) {
+    if (object_pool->Import(objects[i])) {
       ++num_imported;
+    } else {
+      LOG(WARNING) << "Failed to import an object.";
+      delete objects[i];
+    }
   }
-  LOG(INFO) << "Finished importing " << num_imported << " pending objects.";
-  return true;
+  return num_imported;
 }
 
 bool OpencryptokiImporter::ExtractObjectData(const string& object_file_content,
@@ -460,24 +513,73 @@ bool OpencryptokiImporter::DecryptPendingObjects() {
       LOG(ERROR) << "Failed to decrypt the master key.";
       return false;
     }
-    for (map<string, string>::iterator iter = encrypted_objects_.begin();
-         iter != encrypted_objects_.end();
-         ++iter) {
-      string flat_object;
-      if (!DecryptObject(master_key, iter->second, &flat_object)) {
-        LOG(WARNING) << "Failed to decrypt an encrypted object: "
-                     << iter->first;
+    vector<pair<string, string>> pending(encrypted_objects_.begin(),
+                                         encrypted_objects_.end());
+    vector<AttributeMap> results(pending.size());
+    vector<int> succeeded(pending.size(), 0);
+    size_t num_threads = std::min(
+        std::min(kMaxDecryptThreads,
+                 static_cast<size_t>(base::SysInfo::NumberOfProcessors())),
+        pending.size());
+    LOG(INFO) << "Decrypting " << pending.size() << " objects with "
+              << num_threads << " threads.";
+    // The first share is decrypted on this thread; the rest on workers.
+    vector<std::unique_ptr<ClosureThread>> workers;
+    vector<base::PlatformThreadHandle> handles;
+    for (size_t i = 1; i < num_threads; ++i) {
+      base::Closure work = base::Bind(
+          &OpencryptokiImporter::DecryptObjectRange, base::Unretained(this),
+          master_key, base::ConstRef(pending), i, num_threads,
+          base::Unretained(&results), base::Unretained(&succeeded));
+      std::unique_ptr<ClosureThread> worker(new ClosureThread(work));
+      base::PlatformThreadHandle handle;
+      if (!base::PlatformThread::Create(0, worker.get(), &handle)) {
+        LOG(WARNING) << "Failed to create decrypt thread; decrypting inline.";
+        work.Run();
         continue;
       }
-      AttributeMap attributes;
-      if (!UnflattenObject(flat_object, iter->first, true, &attributes)) {
-        LOG(WARNING) << "Failed to parse object attributes: " << iter->first;
+      workers.push_back(std::move(worker));
+      handles.push_back(handle);
+    }
+    DecryptObjectRange(master_key, pending, 0, std::max<size_t>(num_threads, 1),
+                       &results, &succeeded);
+    for (size_t i = 0; i < handles.size(); ++i)
+      base::PlatformThread::Join(handles[i]);
+    size_t num_decrypted = 0;
+    for (size_t i = 0; i < pending.size(); ++i) {
+      if (!succeeded[i])
         continue;
-      }
-      unflattened_objects_.push_back(attributes);
+      unflattened_objects_.push_back(results[i]);
+      ++num_decrypted;
     }
+    LOG(INFO) << "Decrypted " << num_decrypted << " of "
+              << pending.size() << " objects.";
   }
   return true;
 }
 
+void OpencryptokiImporter::DecryptObjectRange(
+    const SecureBlob& master_key,
+    const vector<pair<string, string>>& pending,
+    size_t first,
+    size_t stride,
+    vector<AttributeMap>* results,
+    vector<int>* succeeded) {
+  for (size_t i = first; i < pending.size(); i += stride) {
+    string flat_object;
+    if (!DecryptObject(master_key, pending[i].second, &flat_object)) {
+      LOG(WARNING) << "Failed to decrypt an encrypted object: "
+                   << pending[i].first;
+      continue;
+    }
+    if (!UnflattenObject(flat_object, pending[i].first, true,
+                         &(*results)[i])) {
+      LOG(WARNING) << "Failed to parse object attributes: "
+                   << pending[i].first;
+      continue;
+    }
+    (*succeeded)[i] = 1;
+  }
+}
+
 }  // namespace chaps
@@ -9,6 +9,7 @@
 
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <base/files/file_path.h>
@@ -83,9 +84,28 @@ class OpencryptokiImporter : public ObjectImporter {
   // Returns whether a given set of attributes represents a private key.
   bool IsPrivateKey(const AttributeMap& attributes);
 
-  // Decrypts and unflattens all pending encrypted objects.
+  // Decrypts and unflattens all pending encrypted objects. The work is spread
+  // across several threads since it does not need the TPM.
   bool DecryptPendingObjects();
 
+  // Decrypts and unflattens every |stride|-th object of |pending|, starting at
+  // |first|, into the matching entry of |results|. An object that fails to
+  // decrypt or parse leaves a zero in |succeeded|. Each worker thread writes to
+  // disjoint entries so no locking is required.
+  void DecryptObjectRange(
+      const brillo::SecureBlob& master_key,
+      const std::vector<std::pair<std::string, std::string>>& pending,
+      size_t first,
+      size_t stride,
+      std::vector<AttributeMap>* results,
+      std::vector<int>* succeeded);
+
+  // Creates object instances for |attributes| and imports them into the pool as
+  // one atomic batch. If the batch fails, imports them one at a time instead.
+  // Returns the number of imported objects.
+  int ImportAsBatch(const std::vector<AttributeMap>& attributes,
+                    ObjectPool* object_pool);
+
   // The token slot id. We need this to associate with our key handles.
   int slot_;
   base::FilePath path_;
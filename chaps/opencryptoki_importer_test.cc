@@ -29,6 +29,7 @@ using std::vector;
 using testing::_;
 using testing::AnyNumber;
 using testing::DoAll;
+using testing::DoDefault;
 using testing::Invoke;
 using testing::Return;
 using testing::SetArgumentPointee;
@@ -165,6 +166,7 @@ class TestImporterBase {
     pool_.SetupFake(0);
     EXPECT_CALL(pool_, Insert(_)).Times(AnyNumber());
     EXPECT_CALL(pool_, Import(_)).Times(AnyNumber());
+    EXPECT_CALL(pool_, ImportBatch(_)).Times(AnyNumber());
     EXPECT_CALL(pool_, Find(_, _)).Times(AnyNumber());
     EXPECT_CALL(pool_, SetInternalBlob(3, _)).WillRepeatedly(Return(true));
     EXPECT_CALL(pool_, SetInternalBlob(4, _)).WillRepeatedly(Return(true));
@@ -351,6 +353,34 @@ ModifierResult RandomizeObjectAttributes(const char* object_path) {
 INSTANTIATE_TEST_CASE_P(RandomizedTests,
                         TestImporterWithModifier,
                         Values(RandomizeFile, RandomizeObjectAttributes));
+
+class TestImporter : public TestImporterBase, public testing::Test {};
+
+// Objects of a batch that fails to commit are imported one at a time.
+TEST_F(TestImporter, ImportSampleBatchFailure) {
+  PrepareSampleToken();
+  EXPECT_CALL(pool_, ImportBatch(_)).WillRepeatedly(Return(false));
+  EXPECT_TRUE(importer_->ImportObjects(&pool_));
+  EXPECT_TRUE(importer_->FinishImportAsync(&pool_));
+  vector<const Object*> objects;
+  pool_.Find(NULL, &objects);
+  EXPECT_EQ(kPublicSampleObjects + kPrivateSampleObjects, objects.size());
+}
+
+// An object that can't be imported doesn't prevent the others from being
+// imported.
+TEST_F(TestImporter, ImportSampleOneBadObject) {
+  PrepareSampleToken();
+  EXPECT_CALL(pool_, ImportBatch(_)).WillRepeatedly(Return(false));
+  EXPECT_CALL(pool_, Import(_))
+      .WillOnce(Return(false))
+      .WillRepeatedly(DoDefault());
+  EXPECT_TRUE(importer_->ImportObjects(&pool_));
+  EXPECT_TRUE(importer_->FinishImportAsync(&pool_));
+  vector<const Object*> objects;
+  pool_.Find(NULL, &objects);
+  EXPECT_EQ(kPublicSampleObjects + kPrivateSampleObjects - 1, objects.size());
+}
 }  // namespace chaps
 
 int main(int argc, char** argv) {
@@ -123,6 +123,12 @@ CK_RV SessionImpl::DestroyObject(int object_handle) {
   CHECK(object);
   std::shared_ptr<ObjectPool> pool = object->IsTokenObject() ? token_object_pool_
       : session_object_pool_;
+  // Operations using the key end with it, so that no key material of the
+  // object is left in their OpenSSL contexts.
+  for (int i = 0; i < kNumOperationTypes; ++i) {
+    if (operation_context_[i].key_ == object)
+      operation_context_[i].Clear();
+  }
   if (!pool->Delete(object))
     return CKR_GENERAL_ERROR;
   return CKR_OK;
@@ -264,20 +270,13 @@ CK_RV SessionImpl::OperationInit(OperationType operation,
     // It is valid for GetOpenSSLDigest to return NULL (e.g. CKM_RSA_PKCS).
     const EVP_MD* digest = GetOpenSSLDigest(mechanism);
     if (IsHMAC(mechanism)) {
-      string key_material = key->GetAttributeString(CKA_VALUE);
-      HMAC_CTX_init(&context->hmac_context_);
-      HMAC_Init_ex(&context->hmac_context_,
-                   key_material.data(),
-                   key_material.length(),
-                   digest,
-                   NULL);
+      HMACInit(context, digest, key->GetAttributeString(CKA_VALUE));
       context->is_hmac_ = true;
     } else if (digest) {
-      EVP_DigestInit(&context->digest_context_, digest);
+      DigestInit(context, digest);
       context->is_digest_ = true;
     }
-    if (IsRSA(mechanism))
-      context->key_ = key;
+    context->key_ = key;
     context->is_valid_ = true;
   }
   return CKR_OK;
@@ -376,17 +375,19 @@ CK_RV SessionImpl::OperationFinalInternal(OperationType operation,
       CK_RV result = CipherFinal(context);
       if (result != CKR_OK)
         return result;
+      // The output is complete; don't keep the key schedule around.
+      context->ReleaseContext();
     } else if (context->is_digest_) {
       unsigned char buffer[kMaxDigestOutputBytes];
       unsigned int out_length = 0;
-      EVP_DigestFinal(&context->digest_context_, buffer, &out_length);
-      context->data_ = string(reinterpret_cast<char*>(buffer), out_length);
+      EVP_DigestFinal_ex(&context->digest_context_, buffer, &out_length);
+      context->data_.assign(reinterpret_cast<char*>(buffer), out_length);
     } else if (context->is_hmac_) {
       unsigned char buffer[kMaxDigestOutputBytes];
       unsigned int out_length = 0;
       HMAC_Final(&context->hmac_context_, buffer, &out_length);
-      HMAC_CTX_cleanup(&context->hmac_context_);
-      context->data_ = string(reinterpret_cast<char*>(buffer), out_length);
+      context->data_.assign(reinterpret_cast<char*>(buffer), out_length);
+      context->ReleaseContext();
     }
     // Some RSA mechanisms use a digest so it's important to finish the digest
     // before finishing the RSA computation.
@@ -466,7 +467,8 @@ CK_RV SessionImpl::OperationSinglePart(OperationType operation,
     result = OperationFinalInternal(operation, &max, &final);
     if (result != CKR_OK)
       return result;
-    context->data_ = update + final;
+    update.append(final);
+    context->data_.swap(update);
     context->is_finished_ = true;
   }
   context->is_valid_ = false;
@@ -767,8 +769,8 @@ CK_RV SessionImpl::CipherInit(bool is_encrypt,
                               const string& mechanism_parameter,
                               const Object* key) {
   OperationType operation = is_encrypt ? kEncrypt : kDecrypt;
-  EVP_CIPHER_CTX* context =
-      &operation_context_[operation].cipher_context_;
+  OperationContext* operation_context = &operation_context_[operation];
+  EVP_CIPHER_CTX* context = &operation_context->cipher_context_;
   string key_material = key->GetAttributeString(CKA_VALUE);
   const EVP_CIPHER* cipher_type = GetOpenSSLCipher(mechanism,
                                                    key_material.size());
@@ -788,15 +790,21 @@ CK_RV SessionImpl::CipherInit(bool is_encrypt,
     LOG(ERROR) << "Key size not supported: " << key_material.size();
     return CKR_KEY_SIZE_RANGE;
   }
-  if (!EVP_CipherInit(context,
-                      cipher_type,
-                      ConvertStringToByteBuffer(key_material.c_str()),
-                      ConvertStringToByteBuffer(mechanism_parameter.c_str()),
-                      is_encrypt)) {
-    LOG(ERROR) << "EVP_CipherInit failed: " << GetOpenSSLError();
+  operation_context->ReleaseContext();
+  EVP_CIPHER_CTX_init(context);
+  operation_context->live_context_ = OperationContext::kCipherContext;
+  if (!EVP_CipherInit_ex(context,
+                         cipher_type,
+                         NULL,
+                         ConvertStringToByteBuffer(key_material.c_str()),
+                         ConvertStringToByteBuffer(mechanism_parameter.c_str()),
+                         is_encrypt)) {
+    LOG(ERROR) << "EVP_CipherInit_ex failed: " << GetOpenSSLError();
+    operation_context->ReleaseContext();
     return CKR_FUNCTION_FAILED;
   }
   EVP_CIPHER_CTX_set_padding(context, IsPaddingEnabled(mechanism));
+  operation_context->key_ = key;
   operation_context_[operation].is_valid_ = true;
   operation_context_[operation].is_cipher_ = true;
   return CKR_OK;
@@ -819,7 +827,7 @@ CK_RV SessionImpl::CipherUpdate(OperationContext* context,
         &out_length,
         ConvertStringToByteBuffer(data_in.c_str()),
         in_length)) {
-      EVP_CIPHER_CTX_cleanup(&context->cipher_context_);
+      context->ReleaseContext();
       context->is_valid_ = false;
       LOG(ERROR) << "EVP_CipherUpdate failed: " << GetOpenSSLError();
       return CKR_FUNCTION_FAILED;
@@ -835,20 +843,43 @@ CK_RV SessionImpl::CipherFinal(OperationContext* context) {
   if (context->data_.empty()) {
     int out_length = kMaxCipherBlockBytes * 2;
     context->data_.resize(out_length);
-    if (!EVP_CipherFinal(
+    if (!EVP_CipherFinal_ex(
         &context->cipher_context_,
         ConvertStringToByteBuffer(context->data_.c_str()),
         &out_length)) {
-      LOG(ERROR) << "EVP_CipherFinal failed: " << GetOpenSSLError();
-      EVP_CIPHER_CTX_cleanup(&context->cipher_context_);
+      LOG(ERROR) << "EVP_CipherFinal_ex failed: " << GetOpenSSLError();
+      context->ReleaseContext();
       return CKR_FUNCTION_FAILED;
     }
-    EVP_CIPHER_CTX_cleanup(&context->cipher_context_);
     context->data_.resize(out_length);
   }
   return CKR_OK;
 }
 
+void SessionImpl::DigestInit(OperationContext* context, const EVP_MD* digest) {
+  if (context->live_context_ != OperationContext::kDigestContext) {
+    context->ReleaseContext();
+    EVP_MD_CTX_init(&context->digest_context_);
+    context->live_context_ = OperationContext::kDigestContext;
+  }
+  // When the digest type is unchanged this reuses the existing digest state
+  // buffer.
+  EVP_DigestInit_ex(&context->digest_context_, digest, NULL);
+}
+
+void SessionImpl::HMACInit(OperationContext* context,
+                           const EVP_MD* digest,
+                           const string& key_material) {
+  context->ReleaseContext();
+  HMAC_CTX_init(&context->hmac_context_);
+  HMAC_Init_ex(&context->hmac_context_,
+               key_material.data(),
+               key_material.length(),
+               digest,
+               NULL);
+  context->live_context_ = OperationContext::kHMACContext;
+}
+
 CK_RV SessionImpl::CreateObjectInternal(const CK_ATTRIBUTE_PTR attributes,
                                         int num_attributes,
                                         const Object* copy_from_object,
@@ -962,7 +993,7 @@ CK_RV SessionImpl::GetOperationOutput(OperationContext* context,
   *required_out_length = out_length;
   if (max_length < out_length)
     return CKR_BUFFER_TOO_SMALL;
-  *data_out = context->data_;
+  data_out->swap(context->data_);
   context->data_.clear();
   return CKR_OK;
 }
@@ -1361,22 +1392,19 @@ SessionImpl::OperationContext::OperationContext() : is_valid_(false),
                                                     is_digest_(false),
                                                     is_hmac_(false),
                                                     is_finished_(false),
-                                                    key_(NULL) {}
+                                                    key_(NULL),
+                                                    live_context_(kNoContext) {}
 
 SessionImpl::OperationContext::~OperationContext() {
   Clear();
+  ReleaseContext();
 }
 
 void SessionImpl::OperationContext::Clear() {
-  if (is_valid_ && !is_finished_) {
-    if (is_cipher_) {
-      EVP_CIPHER_CTX_cleanup(&cipher_context_);
-    } else if (is_digest_) {
-      EVP_MD_CTX_cleanup(&digest_context_);
-    } else if (is_hmac_) {
-      HMAC_CTX_cleanup(&hmac_context_);
-    }
-  }
+  // Cipher and HMAC contexts hold the key and its expanded schedule, so they
+  // never outlive the operation. Only a digest context is kept for reuse.
+  if (live_context_ != kDigestContext)
+    ReleaseContext();
   is_valid_ = false;
   is_cipher_ = false;
   is_digest_ = false;
@@ -1388,4 +1416,21 @@ void SessionImpl::OperationContext::Clear() {
   parameter_.clear();
 }
 
+void SessionImpl::OperationContext::ReleaseContext() {
+  switch (live_context_) {
+    case kCipherContext:
+      EVP_CIPHER_CTX_cleanup(&cipher_context_);
+      break;
+    case kDigestContext:
+      EVP_MD_CTX_cleanup(&digest_context_);
+      break;
+    case kHMACContext:
+      HMAC_CTX_cleanup(&hmac_context_);
+      break;
+    case kNoContext:
+      break;
+  }
+  live_context_ = kNoContext;
+}
+
 }  // namespace chaps
@@ -123,11 +123,26 @@ class SessionImpl : public Session {
     const Object* key_;
     CK_MECHANISM_TYPE mechanism_;
     std::string parameter_;  // The mechanism parameter (if any).
+    // Tracks which member of the union above holds an initialized OpenSSL
+    // context. A digest context outlives the operation so the next digest
+    // can reuse it instead of paying for a full init / cleanup cycle. Cipher
+    // and HMAC contexts hold key material and are cleaned up when their
+    // operation ends.
+    enum ContextType {
+      kNoContext,
+      kCipherContext,
+      kDigestContext,
+      kHMACContext
+    };
+    ContextType live_context_;
 
     OperationContext();
     ~OperationContext();
 
+    // Resets the operation state. A live digest context is kept.
     void Clear();
+    // Cleans up the live OpenSSL context, if any.
+    void ReleaseContext();
   };
 
   bool IsValidKeyType(OperationType operation,
@@ -151,6 +166,12 @@ class SessionImpl : public Session {
                      int* required_out_length,
                      std::string* data_out);
   CK_RV CipherFinal(OperationContext* context);
+  // Prepares the digest or HMAC context of |context| for a new operation. A
+  // live digest context is reused.
+  void DigestInit(OperationContext* context, const EVP_MD* digest);
+  void HMACInit(OperationContext* context,
+                const EVP_MD* digest,
+                const std::string& key_material);
   CK_RV CreateObjectInternal(const CK_ATTRIBUTE_PTR attributes,
                              int num_attributes,
                              const Object* copy_from_object,
@@ -4,6 +4,7 @@
 
 #include "chaps/session_impl.h"
 
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -440,6 +441,68 @@ TEST_F(TestSession, HMAC) {
   EXPECT_EQ(CKR_OK, session_->VerifyFinal(out));
 }
 
+// Test that repeated operations on a reused OpenSSL context give the same
+// results as fresh ones, including after a key or mechanism change.
+TEST_F(TestSession, ContextReuse) {
+  const Object* key1 = NULL;
+  const Object* key2 = NULL;
+  GenerateSecretKey(CKM_AES_KEY_GEN, 32, &key1);
+  GenerateSecretKey(CKM_AES_KEY_GEN, 32, &key2);
+  string in(40, 'A');
+  string out1, out2, out3;
+  int len = std::numeric_limits<int>::max();
+  EXPECT_EQ(CKR_OK, session_->OperationInit(kEncrypt, CKM_AES_CBC_PAD,
+                                            string(16, 'B'), key1));
+  EXPECT_EQ(CKR_OK, session_->OperationSinglePart(kEncrypt, in, &len, &out1));
+  // Same key with a cancelled operation in between.
+  EXPECT_EQ(CKR_OK, session_->OperationInit(kEncrypt, CKM_AES_CBC_PAD,
+                                            string(16, 'B'), key1));
+  EXPECT_EQ(CKR_OK, session_->OperationUpdate(kEncrypt, in, &len, &out2));
+  session_->OperationCancel(kEncrypt);
+  len = std::numeric_limits<int>::max();
+  EXPECT_EQ(CKR_OK, session_->OperationInit(kEncrypt, CKM_AES_CBC_PAD,
+                                            string(16, 'B'), key1));
+  EXPECT_EQ(CKR_OK, session_->OperationSinglePart(kEncrypt, in, &len, &out2));
+  EXPECT_TRUE(out1 == out2);
+  // A different key must not reuse the previous key schedule.
+  len = std::numeric_limits<int>::max();
+  EXPECT_EQ(CKR_OK, session_->OperationInit(kEncrypt, CKM_AES_CBC_PAD,
+                                            string(16, 'B'), key2));
+  EXPECT_EQ(CKR_OK, session_->OperationSinglePart(kEncrypt, in, &len, &out3));
+  EXPECT_FALSE(out1 == out3);
+  // Switching between digest types reuses the digest context.
+  string sha1, sha256, sha1_again;
+  len = std::numeric_limits<int>::max();
+  EXPECT_EQ(CKR_OK, session_->OperationInit(kDigest, CKM_SHA_1, "", NULL));
+  EXPECT_EQ(CKR_OK, session_->OperationSinglePart(kDigest, in, &len, &sha1));
+  len = std::numeric_limits<int>::max();
+  EXPECT_EQ(CKR_OK, session_->OperationInit(kDigest, CKM_SHA256, "", NULL));
+  EXPECT_EQ(CKR_OK, session_->OperationSinglePart(kDigest, in, &len, &sha256));
+  len = std::numeric_limits<int>::max();
+  EXPECT_EQ(CKR_OK, session_->OperationInit(kDigest, CKM_SHA_1, "", NULL));
+  EXPECT_EQ(CKR_OK,
+            session_->OperationSinglePart(kDigest, in, &len, &sha1_again));
+  EXPECT_EQ(20, sha1.length());
+  EXPECT_EQ(32, sha256.length());
+  EXPECT_TRUE(sha1 == sha1_again);
+}
+
+// Test that destroying a key ends the operations that use it.
+TEST_F(TestSession, DestroyKeyInUse) {
+  const Object* key = NULL;
+  GenerateSecretKey(CKM_AES_KEY_GEN, 32, &key);
+  string in(16, 'A');
+  string out;
+  int len = std::numeric_limits<int>::max();
+  EXPECT_EQ(CKR_OK, session_->OperationInit(kEncrypt, CKM_AES_CBC_PAD,
+                                            string(16, 'B'), key));
+  EXPECT_EQ(CKR_OK, session_->OperationUpdate(kEncrypt, in, &len, &out));
+  EXPECT_EQ(CKR_OK, session_->DestroyObject(key->handle()));
+  len = std::numeric_limits<int>::max();
+  EXPECT_EQ(CKR_OPERATION_NOT_INITIALIZED,
+            session_->OperationUpdate(kEncrypt, in, &len, &out));
+}
+
 // Test empty multi-part operation.
 TEST_F(TestSession, FinalWithNoUpdate) {
   EXPECT_EQ(CKR_OK, session_->OperationInit(kDigest, CKM_SHA_1, "", NULL));
@@ -0,0 +1,126 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Signs round-robin with more keys than the TPM can hold at once and prints
+// the per-operation latency. This needs a live TPM (or tpm2-simulator) and is
+// meant to compare the key slot cache behavior across changes. It is not run
+// as part of the unit tests.
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/command_line.h>
+#include <base/logging.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/time/time.h>
+#include <brillo/secure_blob.h>
+#include <openssl/bn.h>
+#include <openssl/rand.h>
+#include <openssl/rsa.h>
+
+#include "chaps/chaps_utility.h"
+
+#if USE_TPM2
+#include "chaps/tpm2_utility_impl.h"
+#else
+#include "chaps/tpm_utility_impl.h"
+#endif
+
+using base::TimeDelta;
+using base::TimeTicks;
+using std::string;
+
+namespace {
+
+const int kKeySizeBits = 2048;
+const int kSlot = 0;
+
+string ConvertFromBIGNUM(const BIGNUM* bignum) {
+  string big_integer(BN_num_bytes(bignum), 0);
+  BN_bn2bin(bignum, chaps::ConvertStringToByteBuffer(big_integer.data()));
+  return big_integer;
+}
+
+// Wraps a new software-generated key under the SRK and returns its handle, or
+// -1 on failure.
+int InjectKey(chaps::TPMUtility* tpm, const brillo::SecureBlob& auth) {
+  const string exponent("\x1\x0\x1", 3);
+  RSA* key = RSA_generate_key(kKeySizeBits, 0x10001, NULL, NULL);
+  if (!key)
+    return -1;
+  string n = ConvertFromBIGNUM(key->n);
+  string p = ConvertFromBIGNUM(key->p);
+  RSA_free(key);
+  string blob;
+  int key_handle = -1;
+  if (!tpm->WrapKey(kSlot, exponent, n, p, auth, &blob, &key_handle))
+    return -1;
+  return key_handle;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* cl = base::CommandLine::ForCurrentProcess();
+  int num_keys = 12;
+  int num_rounds = 4;
+  if ((cl->HasSwitch("keys") &&
+       !base::StringToInt(cl->GetSwitchValueASCII("keys"), &num_keys)) ||
+      (cl->HasSwitch("rounds") &&
+       !base::StringToInt(cl->GetSwitchValueASCII("rounds"), &num_rounds)) ||
+      num_keys <= 0 || num_rounds <= 0) {
+    printf("Usage: tpm_utility_benchmark [--keys=N] [--rounds=N]\n");
+    return 1;
+  }
+
+#if USE_TPM2
+  std::unique_ptr<chaps::TPMUtility> tpm(new chaps::TPM2UtilityImpl());
+#else
+  std::unique_ptr<chaps::TPMUtility> tpm(new chaps::TPMUtilityImpl(""));
+#endif
+  if (!tpm->Init()) {
+    LOG(ERROR) << "Failed to initialize the TPM utility.";
+    return 1;
+  }
+
+  unsigned char random[20];
+  RAND_bytes(random, sizeof(random));
+  brillo::SecureBlob auth(std::begin(random), std::end(random));
+  std::vector<int> keys;
+  for (int i = 0; i < num_keys; ++i) {
+    int key_handle = InjectKey(tpm.get(), auth);
+    if (key_handle < 0) {
+      LOG(ERROR) << "Failed to inject key " << i;
+      return 1;
+    }
+    keys.push_back(key_handle);
+  }
+
+  string input("input"), signature;
+  TimeDelta total;
+  TimeDelta worst;
+  for (int round = 0; round < num_rounds; ++round) {
+    for (int key_handle : keys) {
+      TimeTicks start = TimeTicks::Now();
+      if (!tpm->Sign(key_handle, input, &signature)) {
+        LOG(ERROR) << "Failed to sign with key " << key_handle;
+        return 1;
+      }
+      TimeDelta elapsed = TimeTicks::Now() - start;
+      total += elapsed;
+      if (elapsed > worst)
+        worst = elapsed;
+    }
+  }
+  tpm->UnloadKeysForSlot(kSlot);
+
+  printf("Sign latency over %d keys: average %.1f ms, worst %.1f ms\n",
+         num_keys, total.InMillisecondsF() / (num_keys * num_rounds),
+         worst.InMillisecondsF());
+  return 0;
+}
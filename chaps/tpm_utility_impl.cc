@@ -8,6 +8,7 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
@@ -31,9 +32,23 @@ using std::map;
 using std::set;
 using std::string;
 using std::stringstream;
+using std::vector;
 
 namespace chaps {
 
+namespace {
+
+// The number of keys chaps keeps resident in the TPM at once. TPM 1.2 devices
+// have very few key slots; beyond this, the least recently used key is
+// unloaded and transparently reloaded from its blob on its next use.
+const size_t kMaxResidentKeys = 8;
+
+// The maximum number of evicted keys reloaded ahead of use when key slots are
+// freed.
+const size_t kMaxPrefetchKeys = 2;
+
+}  // namespace
+
 // TSSEncryptedData wraps a TSS encrypted data object. The underlying TSS object
 // will be closed when this object falls out of scope.
 typedef ScopedTssObject<TSS_HENCDATA> ScopedTssEncData;
@@ -140,21 +155,17 @@ TPMUtilityImpl::TPMUtilityImpl(const string& srk_auth_data)
       srk_auth_data_(srk_auth_data),
       srk_public_loaded_(false),
       default_exponent_("\x1\x0\x1", 3),
+      key_cache_(kMaxResidentKeys),
       last_handle_(0),
       is_enabled_(false),
       is_enabled_ready_(false) {}
 
 TPMUtilityImpl::~TPMUtilityImpl() {
   LOG(INFO) << "Unloading keys for all slots.";
-  map<int, HandleInfo>::iterator it;
-  set<int>::iterator it2;
-  for (it = slot_handles_.begin(); it != slot_handles_.end(); ++it) {
-    set<int>* slot_handles = &it->second.handles_;
-    for (it2 = slot_handles->begin(); it2 != slot_handles->end(); ++it2) {
-      Tspi_Key_UnloadKey(GetTssHandle(*it2));
-      Tspi_Context_CloseObject(tsp_context_, GetTssHandle(*it2));
-    }
-  }
+  // This includes released keys kept for their children.
+  map<int, KeyInfo>::iterator it;
+  for (it = handle_info_.begin(); it != handle_info_.end(); ++it)
+    EvictKey(it->first);
   // These can't use ScopedTssObject because they must be closed before the
   // context (tsp_context_) closes.
   if (srk_)
@@ -321,6 +332,8 @@ bool TPMUtilityImpl::ChangeAuthData(int slot_id,
     return false;
   // Change the secret.
   AutoLock lock(lock_);
+  if (!EnsureKeyLoaded(key_handle))
+    return false;
   TSS_RESULT result = TSS_SUCCESS;
   ScopedTssPolicy policy(tsp_context_);
   result = Tspi_Context_CreateObject(tsp_context_,
@@ -445,7 +458,7 @@ bool TPMUtilityImpl::GenerateKey(int slot,
   }
   if (!GetKeyBlob(key, key_blob))
     return false;
-  *key_handle = CreateHandle(slot, key.release(), *key_blob, auth_data);
+  *key_handle = CreateHandle(slot, key.release(), *key_blob, auth_data, srk_);
   VLOG(1) << "TPMUtilityImpl::GenerateKey success";
   return true;
 }
@@ -457,6 +470,8 @@ bool TPMUtilityImpl::GetPublicKey(int key_handle,
   AutoLock lock(lock_);
   if (!InitSRK())
     return false;
+  if (!EnsureKeyLoaded(key_handle))
+    return false;
   if (!GetKeyAttributeData(GetTssHandle(key_handle),
                            TSS_TSPATTRIB_RSAKEY_INFO,
                            TSS_TSPATTRIB_KEYINFO_RSA_EXPONENT,
@@ -545,7 +560,7 @@ bool TPMUtilityImpl::WrapKey(int slot,
   }
   if (!GetKeyBlob(key, key_blob))
     return false;
-  *key_handle = CreateHandle(slot, key.release(), *key_blob, auth_data);
+  *key_handle = CreateHandle(slot, key.release(), *key_blob, auth_data, srk_);
   VLOG(1) << "TPMUtilityImpl::WrapKey success";
   return true;
 }
@@ -569,11 +584,14 @@ bool TPMUtilityImpl::LoadKeyWithParent(int slot,
   if (IsAlreadyLoaded(slot, key_blob, key_handle))
     return true;
   VLOG(1) << "TPMUtilityImpl::LoadKeyWithParent enter";
+  if (!EnsureKeyLoaded(parent_key_handle))
+    return false;
   ScopedTssKey key(tsp_context_);
   if (!LoadKeyInternal(GetTssHandle(parent_key_handle), key_blob, auth_data,
                        key.ptr()))
     return false;
-  *key_handle = CreateHandle(slot, key.release(), key_blob, auth_data);
+  *key_handle = CreateHandle(slot, key.release(), key_blob, auth_data,
+                             parent_key_handle);
   VLOG(1) << "TPMUtilityImpl::LoadKeyWithParent success";
   return true;
 }
@@ -585,12 +603,16 @@ void TPMUtilityImpl::UnloadKeysForSlot(int slot) {
     return;
   set<int>* handles = &slot_handles_[slot].handles_;
   set<int>::iterator it;
-  for (it = handles->begin(); it != handles->end(); ++it) {
-    Tspi_Key_UnloadKey(GetTssHandle(*it));
-    Tspi_Context_CloseObject(tsp_context_, GetTssHandle(*it));
-  }
+  for (it = handles->begin(); it != handles->end(); ++it)
+    ReleaseKey(*it);
   slot_handles_.erase(slot);
   LOG(INFO) << "Unloaded keys for slot " << slot;
+  PrefetchEvictedKeys();
+  const KeySlotCache::Stats& stats = key_cache_.stats();
+  VLOG(1) << "Key slot cache: hits=" << stats.hits
+          << " misses=" << stats.misses
+          << " evictions=" << stats.evictions
+          << " prefetches=" << stats.prefetches;
   VLOG(1) << "TPMUtilityImpl::UnloadKeysForSlot success";
 }
 
@@ -601,6 +623,8 @@ bool TPMUtilityImpl::Bind(int key_handle,
   AutoLock lock(lock_);
   if (!InitSRK())
     return false;
+  if (!EnsureKeyLoaded(key_handle))
+    return false;
   TSSEncryptedData encrypted(tsp_context_);
   if (!encrypted.Create())
     return false;
@@ -630,6 +654,8 @@ bool TPMUtilityImpl::Unbind(int key_handle,
     return false;
   if (!encrypted.SetData(input))
     return false;
+  if (!EnsureKeyLoaded(key_handle))
+    return false;
   UINT32 length = 0;
   BYTE* buffer = NULL;
   TSS_RESULT result = Tspi_Data_Unbind(encrypted, GetTssHandle(key_handle),
@@ -639,7 +665,7 @@ bool TPMUtilityImpl::Unbind(int key_handle,
     // evicted. If this occurs, we can attempt to reload the key manually and
     // then try the operation again.
     LOG(WARNING) << "TCS load failure: attempting to reload key.";
-    if (!ReloadKey(key_handle))
+    if (!ReloadKey(key_handle, false))
       return false;
     result = Tspi_Data_Unbind(encrypted, GetTssHandle(key_handle), &length,
                               &buffer);
@@ -664,6 +690,8 @@ bool TPMUtilityImpl::Sign(int key_handle,
   TSSHash hash(tsp_context_);
   if (!hash.Create(input))
     return false;
+  if (!EnsureKeyLoaded(key_handle))
+    return false;
   UINT32 length = 0;
   BYTE* buffer = NULL;
   TSS_RESULT result = Tspi_Hash_Sign(hash, GetTssHandle(key_handle), &length,
@@ -673,7 +701,7 @@ bool TPMUtilityImpl::Sign(int key_handle,
     // evicted. If this occurs, we can attempt to reload the key manually and
     // then try the operation again.
     LOG(WARNING) << "TCS load failure: attempting to reload key.";
-    if (!ReloadKey(key_handle))
+    if (!ReloadKey(key_handle, false))
       return false;
     result = Tspi_Hash_Sign(hash, GetTssHandle(key_handle), &length, &buffer);
   }
@@ -697,6 +725,8 @@ bool TPMUtilityImpl::Verify(int key_handle,
   TSSHash hash(tsp_context_);
   if (!hash.Create(input))
     return false;
+  if (!EnsureKeyLoaded(key_handle))
+    return false;
   TSS_RESULT result = Tspi_Hash_VerifySignature(
       hash,
       GetTssHandle(key_handle),
@@ -719,7 +749,8 @@ bool TPMUtilityImpl::IsSRKReady() {
 int TPMUtilityImpl::CreateHandle(int slot,
                                  TSS_HKEY key,
                                  const string& key_blob,
-                                 const SecureBlob& auth_data) {
+                                 const SecureBlob& auth_data,
+                                 int parent_handle) {
   int handle = ++last_handle_;
   HandleInfo* handle_info = &slot_handles_[slot];
   handle_info->handles_.insert(handle);
@@ -728,6 +759,15 @@ int TPMUtilityImpl::CreateHandle(int slot,
   key_info->tss_handle = key;
   key_info->blob = key_blob;
   key_info->auth_data = auth_data;
+  key_info->parent_handle = parent_handle;
+  key_info->num_children = 0;
+  key_info->is_released = false;
+  map<int, KeyInfo>::iterator parent_it = handle_info_.find(parent_handle);
+  if (parent_it != handle_info_.end() &&
+      parent_it->second.num_children++ == 0) {
+    key_cache_.Pin(parent_handle);
+  }
+  TrackResidentKey(handle, false);
   return handle;
 }
 
@@ -946,23 +986,88 @@ bool TPMUtilityImpl::LoadKeyInternal(TSS_HKEY parent,
   return true;
 }
 
-bool TPMUtilityImpl::ReloadKey(int key_handle) {
-  KeyInfo* key_info = &handle_info_[key_handle];
+bool TPMUtilityImpl::ReloadKey(int key_handle, bool is_prefetch) {
+  map<int, KeyInfo>::iterator it = handle_info_.find(key_handle);
+  if (it == handle_info_.end())
+    return false;
   // Unload the current handle.
-  Tspi_Key_UnloadKey(key_info->tss_handle);
-  Tspi_Context_CloseObject(tsp_context_, key_info->tss_handle);
-  key_info->tss_handle = 0;
-  // Load the same key blob again.
+  EvictKey(key_handle);
+  // The parent must be resident to load the key blob under it.
+  int parent_handle = it->second.parent_handle;
+  if (!EnsureKeyLoaded(parent_handle))
+    return false;
+  // Load the same key blob again. Loading the parent may have evicted keys,
+  // but |handle_info_| entries are never erased by eviction so |it| is valid.
+  KeyInfo* key_info = &it->second;
   ScopedTssKey scoped_key(tsp_context_);
-  if (!LoadKeyInternal(srk_, key_info->blob, key_info->auth_data,
-                       scoped_key.ptr())) {
+  if (!LoadKeyInternal(GetTssHandle(parent_handle), key_info->blob,
+                       key_info->auth_data, scoped_key.ptr())) {
     LOG(ERROR) << "Failed to reload key.";
     return false;
   }
   key_info->tss_handle = scoped_key.release();
+  TrackResidentKey(key_handle, is_prefetch);
   return true;
 }
 
+bool TPMUtilityImpl::EnsureKeyLoaded(int key_handle) {
+  if (key_cache_.Touch(key_handle))
+    return true;
+  VLOG(1) << "Key " << key_handle << " was evicted, reloading.";
+  return ReloadKey(key_handle, false);
+}
+
+void TPMUtilityImpl::TrackResidentKey(int key_handle, bool is_prefetch) {
+  vector<int> evicted;
+  if (is_prefetch)
+    key_cache_.InsertPrefetched(key_handle, &evicted);
+  else
+    key_cache_.Insert(key_handle, &evicted);
+  for (size_t i = 0; i < evicted.size(); ++i)
+    EvictKey(evicted[i]);
+}
+
+void TPMUtilityImpl::EvictKey(int key_handle) {
+  map<int, KeyInfo>::iterator it = handle_info_.find(key_handle);
+  if (it == handle_info_.end() || !it->second.tss_handle)
+    return;
+  Tspi_Key_UnloadKey(it->second.tss_handle);
+  Tspi_Context_CloseObject(tsp_context_, it->second.tss_handle);
+  it->second.tss_handle = 0;
+}
+
+void TPMUtilityImpl::PrefetchEvictedKeys() {
+  vector<int> candidates = key_cache_.GetPrefetchCandidates(kMaxPrefetchKeys);
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (!ReloadKey(candidates[i], true))
+      LOG(WARNING) << "Failed to prefetch key " << candidates[i];
+  }
+}
+
+void TPMUtilityImpl::ReleaseKey(int key_handle) {
+  map<int, KeyInfo>::iterator it = handle_info_.find(key_handle);
+  if (it == handle_info_.end())
+    return;
+  if (it->second.num_children > 0) {
+    // Keys still in use, possibly in other slots, were loaded under this
+    // one. Keep it resident and pinned until they are released.
+    it->second.is_released = true;
+    return;
+  }
+  int parent_handle = it->second.parent_handle;
+  EvictKey(key_handle);
+  key_cache_.Remove(key_handle);
+  handle_info_.erase(it);
+
+  map<int, KeyInfo>::iterator parent_it = handle_info_.find(parent_handle);
+  if (parent_it == handle_info_.end() ||
+      --parent_it->second.num_children > 0)
+    return;
+  key_cache_.Unpin(parent_handle);
+  if (parent_it->second.is_released)
+    ReleaseKey(parent_handle);
+}
+
 string TPMUtilityImpl::ResultToString(TSS_RESULT result) {
   if (result == TSS_SUCCESS)
     return "TSS_SUCCESS";
@@ -16,6 +16,8 @@
 //#include <trousers/scoped_tss_type.h>
 //#include <trousers/tss.h>
 
+#include "chaps/key_slot_cache.h"
+
 namespace chaps {
 
 class TPMUtilityImpl : public TPMUtility {
@@ -87,17 +89,29 @@ class TPMUtilityImpl : public TPMUtility {
     std::map<std::string, int> blob_handle_;
   };
 
-  // Holds key information for each key handle.
+  // Holds key information for each key handle. A |tss_handle| of zero means
+  // the key has been evicted from the TPM by the key slot cache.
   struct KeyInfo {
     TSS_HKEY tss_handle;
     std::string blob;
     brillo::SecureBlob auth_data;
+    // The key handle of the parent; this is |srk_| for keys loaded under the
+    // SRK.
+    int parent_handle;
+    // The number of key handles loaded under this one. While it is not zero,
+    // the key is pinned in the key slot cache so that its children can be
+    // reloaded under it.
+    int num_children;
+    // Whether the slot of the key was unloaded while it still had children.
+    // The key is then kept until its last child is released.
+    bool is_released;
   };
 
   int CreateHandle(int slot,
                    TSS_HKEY key,
                    const std::string& key_blob,
-                   const brillo::SecureBlob& auth_data);
+                   const brillo::SecureBlob& auth_data,
+                   int parent_handle);
   bool CreateKeyPolicy(TSS_HKEY key,
                        const brillo::SecureBlob& auth_data,
                        bool auth_only);
@@ -114,7 +128,23 @@ class TPMUtilityImpl : public TPMUtility {
                        const std::string& key_blob,
                        const brillo::SecureBlob& auth_data,
                        TSS_HKEY* key);
-  bool ReloadKey(int key_handle);
+  // Reloads the key, and its parent chain if necessary, from the key blob. If
+  // |is_prefetch| is true the load is accounted as a prefetch rather than a
+  // miss.
+  bool ReloadKey(int key_handle, bool is_prefetch);
+  // Makes sure |key_handle| is resident in the TPM before it is used.
+  bool EnsureKeyLoaded(int key_handle);
+  // Inserts |key_handle| into the key slot cache and unloads any keys the cache
+  // decides to evict.
+  void TrackResidentKey(int key_handle, bool is_prefetch);
+  // Unloads and closes the TSS key object of |key_handle|, keeping the blob
+  // so the key can be reloaded later.
+  void EvictKey(int key_handle);
+  // Reloads recently used keys that were evicted, while there is room.
+  void PrefetchEvictedKeys();
+  // Unloads |key_handle| and forgets it, unless keys loaded under it remain.
+  // Releasing the last child of a released parent releases the parent too.
+  void ReleaseKey(int key_handle);
   bool InitSRK();
 
   bool is_initialized_;
@@ -127,6 +157,7 @@ class TPMUtilityImpl : public TPMUtility {
   const std::string default_exponent_;
   std::map<int, HandleInfo> slot_handles_;
   std::map<int, KeyInfo> handle_info_;
+  KeySlotCache key_cache_;
   base::Lock lock_;
   int last_handle_;
   bool is_enabled_;
@@ -61,6 +61,7 @@
         'mount_info.cc',
         'mount_manager.cc',
         'mount_options.cc',
+        'mount_worker_pool.cc',
         'mounter.cc',
         'ntfs_mounter.cc',
         'platform.cc',
@@ -104,6 +105,7 @@
             'mount_info_unittest.cc',
             'mount_manager_unittest.cc',
             'mount_options_unittest.cc',
+            'mount_worker_pool_unittest.cc',
             'mounter_unittest.cc',
             'platform_unittest.cc',
             'process_unittest.cc',
@@ -112,6 +114,19 @@
             'usb_device_info_unittest.cc',
           ],
         },
+        # Timings of the event queue and the mount worker pool; the tests don't
+        # run this binary, as its output is only meaningful to compare by hand.
+        {
+          'target_name': 'disks_benchmark',
+          'type': 'executable',
+          'dependencies': ['libdisks'],
+          'includes': ['../common-mk/common_test.gypi'],
+          'sources': [
+            'device_event_queue_benchmark.cc',
+            'disks_testrunner.cc',
+            'mount_worker_pool_benchmark.cc',
+          ],
+        },
       ],
     }],
   ],
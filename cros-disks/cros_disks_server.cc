@@ -4,6 +4,7 @@
 
 #include "cros-disks/cros_disks_server.h"
 
+#include <base/bind.h>
 #include <base/logging.h>
 #include <chromeos/dbus/service_constants.h>
 
@@ -80,20 +81,24 @@ void CrosDisksServer::Mount(const string& path,
                             const string& filesystem_type,
                             const vector<string>& options,
                             DBus::Error& error) {  // NOLINT
-  MountErrorType error_type = MOUNT_ERROR_INVALID_PATH;
-  MountSourceType source_type = MOUNT_SOURCE_INVALID;
   string source_path;
-  string mount_path;
-
   if (platform_->GetRealPath(path, &source_path)) {
     MountManager* mounter = FindMounter(source_path);
     if (mounter) {
-      source_type = mounter->GetMountSourceType();
-      error_type =
-          mounter->Mount(source_path, filesystem_type, options, &mount_path);
+      mounter->MountAsync(source_path, filesystem_type, options, "",
+                          base::Bind(&CrosDisksServer::OnMountCompleted,
+                                     base::Unretained(this), path,
+                                     mounter->GetMountSourceType()));
+      return;
     }
   }
+  OnMountCompleted(path, MOUNT_SOURCE_INVALID, MOUNT_ERROR_INVALID_PATH, "");
+}
 
+void CrosDisksServer::OnMountCompleted(const string& path,
+                                       MountSourceType source_type,
+                                       MountErrorType error_type,
+                                       const string& mount_path) {
   if (error_type != MOUNT_ERROR_NONE) {
     LOG(ERROR) << "Failed to mount '" << path << "'";
   }
@@ -69,7 +69,8 @@ class CrosDisksServer : public org::chromium::CrosDisks_adaptor,
   // A method for checking if the daemon is running. Always returns true.
   bool IsAlive(DBus::Error& error) override;  // NOLINT
 
-  // Mounts a path when invoked.
+  // Mounts a path when invoked. On completion, a MountCompleted signal is
+  // emitted, possibly after this method returns.
   void Mount(const std::string& path,
              const std::string& filesystem_type,
              const std::vector<std::string>& options,
@@ -137,6 +138,12 @@ class CrosDisksServer : public org::chromium::CrosDisks_adaptor,
   // one can.
   MountManager* FindMounter(const std::string& source_path) const;
 
+  // Emits a MountCompleted signal for the request to mount |path|.
+  void OnMountCompleted(const std::string& path,
+                        MountSourceType source_type,
+                        MountErrorType error_type,
+                        const std::string& mount_path);
+
   // Unmounts all paths mounted by Mount().
   void DoUnmountAll();
 
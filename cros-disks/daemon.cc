@@ -9,13 +9,18 @@ namespace {
 const char kArchiveMountRootDirectory[] = "/media/archive";
 const char kDiskMountRootDirectory[] = "/media/removable";
 const char kNonPrivilegedMountUser[] = "chronos";
+// Maximum number of disks mounted at the same time. Mounting mostly waits
+// for the device or a mount helper, so this only needs to cover the
+// partitions of a typical drive.
+const size_t kMaxConcurrentMounts = 4;
 
 }  // namespace
 
 namespace cros_disks {
 
 Daemon::Daemon(DBus::Connection* dbus_connection, bool has_session_manager)
-    : archive_manager_(kArchiveMountRootDirectory, &platform_, &metrics_),
+    : mount_worker_pool_(kMaxConcurrentMounts),
+      archive_manager_(kArchiveMountRootDirectory, &platform_, &metrics_),
       disk_manager_(kDiskMountRootDirectory, &platform_, &metrics_,
                     &device_ejector_),
       server_(*dbus_connection, &platform_, &disk_manager_, &format_manager_),
@@ -27,6 +32,7 @@ void Daemon::Initialize() {
   // Register mount managers with the commonly used ones come first.
   server_.RegisterMountManager(&disk_manager_);
   server_.RegisterMountManager(&archive_manager_);
+  disk_manager_.set_worker_pool(&mount_worker_pool_);
 
   CHECK(platform_.SetMountUser(kNonPrivilegedMountUser))
       << "'" << kNonPrivilegedMountUser
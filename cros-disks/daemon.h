@@ -14,6 +14,7 @@
 #include "cros-disks/disk_manager.h"
 #include "cros-disks/format_manager.h"
 #include "cros-disks/metrics.h"
+#include "cros-disks/mount_worker_pool.h"
 #include "cros-disks/platform.h"
 #include "cros-disks/session_manager_proxy.h"
 
@@ -38,6 +39,7 @@ class Daemon {
  private:
   Metrics metrics_;
   Platform platform_;
+  MountWorkerPool mount_worker_pool_;
   ArchiveManager archive_manager_;
   DeviceEjector device_ejector_;
   DiskManager disk_manager_;
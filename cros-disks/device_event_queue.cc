@@ -4,6 +4,8 @@
 
 #include "cros-disks/device_event_queue.h"
 
+#include <iterator>
+
 #include <base/logging.h>
 
 #include "cros-disks/device_event.h"
@@ -11,8 +13,23 @@
 namespace cros_disks {
 
 void DeviceEventQueue::Remove() {
-  if (!events_.empty())
-    events_.pop_back();
+  if (events_.empty())
+    return;
+
+  EventIndex* index = GetIndex(events_.back());
+  EventIndex::iterator related = index->find(events_.back().device_path);
+  DCHECK(related != index->end());
+  DCHECK(related->second.front() == std::prev(events_.end()));
+  related->second.erase(related->second.begin());
+  if (related->second.empty())
+    index->erase(related);
+
+  events_.pop_back();
+}
+
+DeviceEventQueue::EventIndex* DeviceEventQueue::GetIndex(
+    const DeviceEvent& event) {
+  return event.IsDiskEvent() ? &disk_events_ : &device_events_;
 }
 
 void DeviceEventQueue::Add(const DeviceEvent& event) {
@@ -21,20 +38,19 @@ void DeviceEventQueue::Add(const DeviceEvent& event) {
       event.event_type == DeviceEvent::kDeviceScanned)
     return;
 
-  for (DeviceEventList::iterator last_event_iterator = events_.begin();
-       last_event_iterator != events_.end(); ++last_event_iterator) {
-    const DeviceEvent& last_event = *last_event_iterator;
+  EventIndex* index = GetIndex(event);
+  std::vector<DeviceEventList::iterator>& related = (*index)[event.device_path];
 
-    // Skip an unrelated event.
-    if (event.device_path != last_event.device_path ||
-        event.IsDiskEvent() != last_event.IsDiskEvent())
-      continue;
+  // Visit the related events from the latest to the oldest.
+  for (size_t i = related.size(); i-- > 0;) {
+    DeviceEventList::iterator last_event_iterator = related[i];
+    const DeviceEvent& last_event = *last_event_iterator;
 
     // Combine events of the same type and device path and keep the latest one.
     if (event.event_type == last_event.event_type) {
       events_.erase(last_event_iterator);
-      events_.push_front(event);
-      return;
+      related.erase(related.begin() + i);
+      break;
     }
 
     // Discard a Removed event and its last related event, which is an
@@ -46,6 +62,9 @@ void DeviceEventQueue::Add(const DeviceEvent& event) {
             last_event.event_type != DeviceEvent::kDiskRemoved)
           << "Last event should not be a Removed event";
       events_.erase(last_event_iterator);
+      related.erase(related.begin() + i);
+      if (related.empty())
+        index->erase(event.device_path);
       return;
     }
 
@@ -57,6 +76,7 @@ void DeviceEventQueue::Add(const DeviceEvent& event) {
   }
 
   events_.push_front(event);
+  related.push_back(events_.begin());
 }
 
 const DeviceEvent* DeviceEventQueue::Head() const {
@@ -5,6 +5,10 @@
 #ifndef CROS_DISKS_DEVICE_EVENT_QUEUE_H_
 #define CROS_DISKS_DEVICE_EVENT_QUEUE_H_
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include <base/macros.h>
 
 #include "cros-disks/device_event.h"
@@ -45,6 +49,9 @@ class DeviceEventQueue {
   //    in the queue. This is because both events are deferred and thus
   //    the DiskChanged event, which signals some property changes in the
   //    disk, can be absorbed into the DiskAdded event.
+  //
+  // Only the events with the same device path are examined, so the cost of
+  // adding an event does not depend on the length of the queue.
   void Add(const DeviceEvent& event);
 
   // Returns a pointer to the oldest device event at the head of event
@@ -55,10 +62,24 @@ class DeviceEventQueue {
   const DeviceEventList& events() const { return events_; }
 
  private:
+  // Maps a device path to the events for that path in |events_|, from the
+  // oldest to the latest. Since events of the same type are combined, there
+  // are never more than a few events per path.
+  using EventIndex =
+      std::unordered_map<std::string, std::vector<DeviceEventList::iterator>>;
+
+  // Returns the index that holds events of the same kind as |event|.
+  EventIndex* GetIndex(const DeviceEvent& event);
+
   // A list of events in the event queue.
   // The latest event is inserted at the beginning of the list.
   DeviceEventList events_;
 
+  // Disk and device events in |events_| are unrelated even if they have the
+  // same device path, so they are indexed separately.
+  EventIndex disk_events_;
+  EventIndex device_events_;
+
   DISALLOW_COPY_AND_ASSIGN(DeviceEventQueue);
 };
 
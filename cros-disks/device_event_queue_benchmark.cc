@@ -0,0 +1,94 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Queues an add and then a change event for each of 2000 disks, as a large
+// hub or card reader produces on hotplug, into DeviceEventQueue and into a
+// copy of the old Add() that looked for related events by walking the list.
+// The first time printed grows with the square of the burst, the second
+// should grow linearly; both queues must end up the same size.
+
+#include "cros-disks/device_event_queue.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <base/strings/stringprintf.h>
+#include <base/time/time.h>
+#include <gtest/gtest.h>
+
+#include "cros-disks/device_event.h"
+
+namespace cros_disks {
+
+namespace {
+
+// The implementation of DeviceEventQueue::Add that scanned the whole queue
+// for related events.
+void AddToUnindexedQueue(DeviceEventList* events, const DeviceEvent& event) {
+  if (event.event_type == DeviceEvent::kIgnored ||
+      event.event_type == DeviceEvent::kDeviceScanned)
+    return;
+
+  for (DeviceEventList::iterator last_event_iterator = events->begin();
+       last_event_iterator != events->end(); ++last_event_iterator) {
+    const DeviceEvent& last_event = *last_event_iterator;
+    if (event.device_path != last_event.device_path ||
+        event.IsDiskEvent() != last_event.IsDiskEvent())
+      continue;
+
+    if (event.event_type == last_event.event_type) {
+      events->erase(last_event_iterator);
+      events->push_front(event);
+      return;
+    }
+
+    if (event.event_type == DeviceEvent::kDeviceRemoved ||
+        event.event_type == DeviceEvent::kDiskRemoved) {
+      events->erase(last_event_iterator);
+      return;
+    }
+
+    if (event.event_type == DeviceEvent::kDiskChanged &&
+        last_event.event_type == DeviceEvent::kDiskAdded)
+      return;
+  }
+
+  events->push_front(event);
+}
+
+}  // namespace
+
+TEST(DeviceEventQueueBenchmark, LargeBurst) {
+  const int kNumDisks = 2000;
+
+  DeviceEventList events;
+  for (int i = 0; i < kNumDisks; ++i) {
+    events.push_back(DeviceEvent(DeviceEvent::kDiskAdded,
+                                 base::StringPrintf("/dev/sdb%d", i)));
+  }
+  for (int i = 0; i < kNumDisks; ++i) {
+    events.push_back(DeviceEvent(DeviceEvent::kDiskChanged,
+                                 base::StringPrintf("/dev/sdb%d", i)));
+  }
+
+  DeviceEventList unindexed_queue;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (const DeviceEvent& event : events)
+    AddToUnindexedQueue(&unindexed_queue, event);
+  const base::TimeDelta unindexed_time = base::TimeTicks::Now() - start;
+
+  DeviceEventQueue queue;
+  start = base::TimeTicks::Now();
+  for (const DeviceEvent& event : events)
+    queue.Add(event);
+  const base::TimeDelta indexed_time = base::TimeTicks::Now() - start;
+
+  EXPECT_EQ(unindexed_queue.size(), queue.events().size());
+  printf("%zu events: %" PRId64 " us scanning the queue, %" PRId64
+         " us with the index\n",
+         events.size(), unindexed_time.InMicroseconds(),
+         indexed_time.InMicroseconds());
+}
+
+}  // namespace cros_disks
@@ -5,13 +5,54 @@
 #include "cros-disks/device_event_queue.h"
 
 #include <algorithm>
+#include <random>
+#include <string>
 
+#include <base/strings/stringprintf.h>
 #include <gtest/gtest.h>
 
 #include "cros-disks/device_event.h"
 
 namespace cros_disks {
 
+namespace {
+
+// The implementation of DeviceEventQueue::Add that scanned the whole queue
+// for related events. Used as a reference for the indexed implementation.
+void AddToUnindexedQueue(DeviceEventList* events, const DeviceEvent& event) {
+  if (event.event_type == DeviceEvent::kIgnored ||
+      event.event_type == DeviceEvent::kDeviceScanned)
+    return;
+
+  for (DeviceEventList::iterator last_event_iterator = events->begin();
+       last_event_iterator != events->end(); ++last_event_iterator) {
+    const DeviceEvent& last_event = *last_event_iterator;
+    if (event.device_path != last_event.device_path ||
+        event.IsDiskEvent() != last_event.IsDiskEvent())
+      continue;
+
+    if (event.event_type == last_event.event_type) {
+      events->erase(last_event_iterator);
+      events->push_front(event);
+      return;
+    }
+
+    if (event.event_type == DeviceEvent::kDeviceRemoved ||
+        event.event_type == DeviceEvent::kDiskRemoved) {
+      events->erase(last_event_iterator);
+      return;
+    }
+
+    if (event.event_type == DeviceEvent::kDiskChanged &&
+        last_event.event_type == DeviceEvent::kDiskAdded)
+      return;
+  }
+
+  events->push_front(event);
+}
+
+}  // namespace
+
 class DeviceEventQueueTest : public ::testing::Test {
  protected:
   // Returns true if two device event objects have the same event type
@@ -229,4 +270,36 @@ TEST_F(DeviceEventQueueTest, Head) {
   EXPECT_EQ(nullptr, queue_.Head());
 }
 
+// Feeds the same random sequence of events to the queue and to the
+// unindexed implementation and checks that they always agree.
+TEST_F(DeviceEventQueueTest, MatchesUnindexedQueue) {
+  const DeviceEvent::EventType kTypes[] = {
+      DeviceEvent::kIgnored,       DeviceEvent::kDeviceAdded,
+      DeviceEvent::kDeviceScanned, DeviceEvent::kDeviceRemoved,
+      DeviceEvent::kDiskAdded,     DeviceEvent::kDiskChanged,
+      DeviceEvent::kDiskRemoved,
+  };
+  const int kNumTypes = sizeof(kTypes) / sizeof(kTypes[0]);
+
+  std::mt19937 rng(12345);
+  std::uniform_int_distribution<int> type_dist(0, kNumTypes - 1);
+  std::uniform_int_distribution<int> path_dist(0, 4);
+  std::uniform_int_distribution<int> op_dist(0, 9);
+
+  for (int i = 0; i < 20000; ++i) {
+    if (op_dist(rng) < 2) {
+      queue_.Remove();
+      if (!expected_events_.empty())
+        expected_events_.pop_back();
+    } else {
+      DeviceEvent event(kTypes[type_dist(rng)],
+                        base::StringPrintf("d%d", path_dist(rng)));
+      queue_.Add(event);
+      AddToUnindexedQueue(&expected_events_, event);
+    }
+    ASSERT_EQ(expected_events_.size(), queue_.events().size()) << i;
+    ASSERT_TRUE(VerifyDeviceEventQueue()) << i;
+  }
+}
+
 }  // namespace cros_disks
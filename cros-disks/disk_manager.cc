@@ -7,6 +7,7 @@
 #include <libudev.h>
 #include <string.h>
 #include <sys/mount.h>
+#include <sys/statvfs.h>
 
 #include <memory>
 #include <utility>
@@ -23,6 +24,7 @@
 #include "cros-disks/external_mounter.h"
 #include "cros-disks/filesystem.h"
 #include "cros-disks/metrics.h"
+#include "cros-disks/mount_info.h"
 #include "cros-disks/mount_options.h"
 #include "cros-disks/ntfs_mounter.h"
 #include "cros-disks/platform.h"
@@ -89,6 +91,25 @@ bool MatchDiskByPath(const string& path, bool* match, Disk* disk,
   return false;  // Match. Stop enumeration.
 }
 
+// Updates the parts of |disk| that can change without a udev event, i.e. where
+// it is mounted and how much space is left, from |mount_info|.
+void UpdateMountState(const MountInfo& mount_info, Disk* disk) {
+  vector<string> mount_paths;
+  if (!disk->device_file().empty())
+    mount_paths = mount_info.GetMountPaths(disk->device_file());
+
+  uint64_t remaining = 0;
+  if (!mount_paths.empty()) {
+    struct statvfs stat;
+    if (statvfs(mount_paths[0].c_str(), &stat) == 0)
+      remaining = stat.f_bfree * stat.f_frsize;
+  }
+
+  disk->set_is_mounted(!mount_paths.empty());
+  disk->set_mount_paths(mount_paths);
+  disk->set_bytes_remaining(remaining);
+}
+
 }  // namespace
 
 DiskManager::DiskManager(const string& mount_root, Platform* platform,
@@ -97,7 +118,8 @@ DiskManager::DiskManager(const string& mount_root, Platform* platform,
       device_ejector_(device_ejector),
       udev_(udev_new()),
       udev_monitor_fd_(0),
-      eject_device_on_unmount_(true) {
+      eject_device_on_unmount_(true),
+      block_devices_scanned_(false) {
   CHECK(device_ejector_) << "Invalid device ejector";
   CHECK(udev_) << "Failed to initialize udev";
   udev_monitor_ = udev_monitor_new_from_netlink(udev_, "udev");
@@ -121,14 +143,20 @@ DiskManager::~DiskManager() {
 bool DiskManager::Initialize() {
   RegisterDefaultFilesystems();
 
+  ScanBlockDevices();
+
+  return MountManager::Initialize();
+}
+
+void DiskManager::ScanBlockDevices() {
   // Since there are no udev add events for the devices that already exist
   // when the disk manager starts, emulate udev add events for these devices
-  // to correctly populate |disks_detected_|.
+  // to correctly populate |disks_detected_| and |block_devices_|. Any device
+  // that changes during the scan also has an event queued on |udev_monitor_|.
   EnumerateBlockDevices(base::Bind(&DiskManager::EmulateBlockDeviceEvent,
                                    base::Unretained(this),
                                    kUdevAddAction));
-
-  return MountManager::Initialize();
+  block_devices_scanned_ = true;
 }
 
 bool DiskManager::StopSession() {
@@ -140,12 +168,32 @@ bool DiskManager::EmulateBlockDeviceEvent(const char* action,
   DCHECK(dev);
 
   DeviceEventList events;
+  UpdateBlockDevice(dev, action);
   ProcessBlockDeviceEvents(dev, action, &events);
 
   return true;  // Continue the enumeration.
 }
 
 vector<Disk> DiskManager::EnumerateDisks() const {
+  if (!block_devices_scanned_)
+    return ScanDisks();
+
+  MountInfo mount_info;
+  mount_info.RetrieveFromCurrentProcess();
+
+  vector<Disk> disks;
+  for (const auto& entry : block_devices_) {
+    const BlockDevice& block_device = entry.second;
+    if (block_device.is_ignored)
+      continue;
+    disks.push_back(block_device.disk);
+    RefreshDisk(entry.first, &disks.back());
+    UpdateMountState(mount_info, &disks.back());
+  }
+  return disks;
+}
+
+vector<Disk> DiskManager::ScanDisks() const {
   vector<Disk> disks;
   EnumerateBlockDevices(
       base::Bind(&AppendDiskIfNotIgnored, base::Unretained(&disks)));
@@ -189,6 +237,44 @@ void DiskManager::EnumerateBlockDevices(
   udev_enumerate_unref(enumerate);
 }
 
+void DiskManager::UpdateBlockDevice(udev_device* dev, const char* action) {
+  const char* sys_path = udev_device_get_syspath(dev);
+  if (!sys_path)
+    return;
+
+  auto it = block_devices_.find(sys_path);
+  if (it != block_devices_.end()) {
+    block_device_paths_.erase(it->second.dev_path);
+    block_device_paths_.erase(it->second.disk.device_file());
+    block_devices_.erase(it);
+  }
+  if (strcmp(action, kUdevRemoveAction) == 0)
+    return;
+
+  UdevDevice device(dev);
+  BlockDevice& block_device = block_devices_[sys_path];
+  block_device.disk = device.ToDisk();
+  block_device.is_ignored = device.IsIgnored();
+  const char* dev_path = udev_device_get_devpath(dev);
+  if (dev_path) {
+    block_device.dev_path = dev_path;
+    block_device_paths_[dev_path] = sys_path;
+  }
+  if (!block_device.disk.device_file().empty())
+    block_device_paths_[block_device.disk.device_file()] = sys_path;
+}
+
+void DiskManager::RefreshDisk(const string& sys_path, Disk* disk) const {
+  udev_device* dev = udev_device_new_from_syspath(udev_, sys_path.c_str());
+  if (!dev)
+    return;
+
+  UdevDevice device(dev);
+  disk->set_is_hidden(device.IsHidden());
+  disk->set_is_media_available(device.IsMediaAvailable());
+  udev_device_unref(dev);
+}
+
 void DiskManager::ProcessBlockDeviceEvents(
     udev_device* dev, const char* action, DeviceEventList* events) {
   UdevDevice device(dev);
@@ -306,6 +392,7 @@ bool DiskManager::GetDeviceEvents(DeviceEventList* events) {
   // |udev_monitor_| only monitors block, mmc, and scsi device changes, so
   // subsystem is either "block", "mmc", or "scsi".
   if (strcmp(subsystem, kBlockSubsystem) == 0) {
+    UpdateBlockDevice(dev, action);
     ProcessBlockDeviceEvents(dev, action, events);
   } else {
     // strcmp(subsystem, kMmcSubsystem) == 0 ||
@@ -322,6 +409,32 @@ bool DiskManager::GetDiskByDevicePath(const string& device_path,
   if (device_path.empty())
     return false;
 
+  if (block_devices_scanned_) {
+    auto it = block_devices_.find(device_path);
+    if (it == block_devices_.end()) {
+      auto path_it = block_device_paths_.find(device_path);
+      if (path_it != block_device_paths_.end())
+        it = block_devices_.find(path_it->second);
+    }
+    if (it != block_devices_.end()) {
+      if (disk) {
+        MountInfo mount_info;
+        mount_info.RetrieveFromCurrentProcess();
+        *disk = it->second.disk;
+        RefreshDisk(it->first, disk);
+        UpdateMountState(mount_info, disk);
+      }
+      return true;
+    }
+  }
+
+  // Fall back to scanning in case the device has appeared but udev hasn't
+  // reported it yet.
+  return ScanDiskByDevicePath(device_path, disk);
+}
+
+bool DiskManager::ScanDiskByDevicePath(const string& device_path,
+                                       Disk* disk) const {
   bool disk_found = false;
   EnumerateBlockDevices(base::Bind(&MatchDiskByPath,
                                    device_path,
@@ -465,19 +578,37 @@ MountErrorType DiskManager::DoMount(const string& source_path,
                                     const vector<string>& options,
                                     const string& mount_path,
                                     MountOptions* applied_options) {
+  MountErrorType error_type;
+  unique_ptr<Mounter> mounter = PrepareMount(source_path, filesystem_type,
+                                             options, mount_path, &error_type);
+  if (!mounter)
+    return error_type;
+
+  error_type = FinishMount(*mounter, mounter->Mount());
+  *applied_options = mounter->mount_options();
+  return error_type;
+}
+
+unique_ptr<Mounter> DiskManager::PrepareMount(const string& source_path,
+                                              const string& filesystem_type,
+                                              const vector<string>& options,
+                                              const string& mount_path,
+                                              MountErrorType* error_type) {
   CHECK(!source_path.empty()) << "Invalid source path argument";
   CHECK(!mount_path.empty()) << "Invalid mount path argument";
 
   Disk disk;
   if (!GetDiskByDevicePath(source_path, &disk)) {
     LOG(ERROR) << "'" << source_path << "' is not a valid device.";
-    return MOUNT_ERROR_INVALID_DEVICE_PATH;
+    *error_type = MOUNT_ERROR_INVALID_DEVICE_PATH;
+    return nullptr;
   }
 
   const string& device_file = disk.device_file();
   if (device_file.empty()) {
     LOG(ERROR) << "'" << source_path << "' does not have a device file";
-    return MOUNT_ERROR_INVALID_DEVICE_PATH;
+    *error_type = MOUNT_ERROR_INVALID_DEVICE_PATH;
+    return nullptr;
   }
 
   string device_filesystem_type = filesystem_type.empty() ?
@@ -487,26 +618,35 @@ MountErrorType DiskManager::DoMount(const string& source_path,
   if (device_filesystem_type.empty()) {
     LOG(ERROR) << "Failed to determine the file system type of device '"
                << source_path << "'";
-    return MOUNT_ERROR_UNKNOWN_FILESYSTEM;
+    *error_type = MOUNT_ERROR_UNKNOWN_FILESYSTEM;
+    return nullptr;
   }
 
   const Filesystem* filesystem = GetFilesystem(device_filesystem_type);
   if (filesystem == nullptr) {
     LOG(ERROR) << "File system type '" << device_filesystem_type
                << "' on device '" << source_path << "' is not supported";
-    return MOUNT_ERROR_UNSUPPORTED_FILESYSTEM;
+    *error_type = MOUNT_ERROR_UNSUPPORTED_FILESYSTEM;
+    return nullptr;
   }
 
   unique_ptr<Mounter> mounter(
       CreateMounter(disk, *filesystem, mount_path, options));
   CHECK(mounter) << "Failed to create a mounter";
 
-  MountErrorType error_type = mounter->Mount();
-  if (error_type == MOUNT_ERROR_NONE) {
-    ScheduleEjectOnUnmount(mount_path, disk);
-  }
-  *applied_options = mounter->mount_options();
+  disks_being_mounted_[mount_path] = disk;
+  *error_type = MOUNT_ERROR_NONE;
+  return mounter;
+}
 
+MountErrorType DiskManager::FinishMount(const Mounter& mounter,
+                                        MountErrorType error_type) {
+  auto disk_iterator = disks_being_mounted_.find(mounter.target_path());
+  CHECK(disk_iterator != disks_being_mounted_.end())
+      << "Mount of '" << mounter.target_path() << "' was not prepared";
+  if (error_type == MOUNT_ERROR_NONE)
+    ScheduleEjectOnUnmount(mounter.target_path(), disk_iterator->second);
+  disks_being_mounted_.erase(disk_iterator);
   return error_type;
 }
 
@@ -608,4 +748,11 @@ bool DiskManager::UnmountAll() {
   return all_unmounted;
 }
 
+void DiskManager::UnmountCancelledMount(const string& source_path) {
+  // The mount was cancelled by UnmountAll(), so do not eject the device.
+  eject_device_on_unmount_ = false;
+  MountManager::UnmountCancelledMount(source_path);
+  eject_device_on_unmount_ = true;
+}
+
 }  // namespace cros_disks
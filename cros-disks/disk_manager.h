@@ -20,12 +20,12 @@
 #include "cros-disks/device_ejector.h"
 #include "cros-disks/device_event.h"
 #include "cros-disks/device_event_source_interface.h"
+#include "cros-disks/disk.h"
 #include "cros-disks/mount_manager.h"
 
 namespace cros_disks {
 
 class DeviceEjector;
-class Disk;
 class Filesystem;
 class Mounter;
 class Platform;
@@ -34,6 +34,10 @@ class Platform;
 // Said changes could be the result of a udev notification or a synchronous
 // call to enumerate the relevant storage devices attached to the system.
 //
+// Once initialized, the DiskManager keeps a model of the block devices on the
+// system that is updated from udev events, so that disks can be listed and
+// looked up without scanning udev.
+//
 // Sample Usage:
 //
 // Platform platform;
@@ -98,6 +102,23 @@ class DiskManager : public MountManager,
                          const std::string& mount_path,
                          MountOptions* applied_options) override;
 
+  // Looks up the disk at |source_path| and creates a mounter for it. The
+  // mounter only calls the const methods of Platform and can thus run on
+  // a worker thread.
+  std::unique_ptr<Mounter> PrepareMount(const std::string& source_path,
+                                        const std::string& filesystem_type,
+                                        const std::vector<std::string>& options,
+                                        const std::string& mount_path,
+                                        MountErrorType* error_type) override;
+
+  // Schedules the disk mounted by |mounter| to be ejected on unmount if the
+  // mount succeeded.
+  MountErrorType FinishMount(const Mounter& mounter,
+                             MountErrorType error_type) override;
+
+  // Unmounts |source_path| without ejecting it, like UnmountAll().
+  void UnmountCancelledMount(const std::string& source_path) override;
+
   // Unmounts |path| with |options|.
   MountErrorType DoUnmount(const std::string& path,
                            const std::vector<std::string>& options) override;
@@ -126,6 +147,27 @@ class DiskManager : public MountManager,
   // enumeration in EnumerateBlockDevices.
   bool EmulateBlockDeviceEvent(const char* action, udev_device* device);
 
+  // Adds the block devices that already exist to |block_devices_| by
+  // emulating udev add events for them.
+  void ScanBlockDevices();
+
+  // Updates |block_devices_| for the udev |action| on the block device |dev|.
+  void UpdateBlockDevice(udev_device* dev, const char* action);
+
+  // Updates the properties of |disk|, cached in |block_devices_| for the block
+  // device at |sys_path|, that can change without a udev event for the device
+  // itself: whether it is hidden, which depends on its partitions and parent
+  // devices, and whether media is available.
+  void RefreshDisk(const std::string& sys_path, Disk* disk) const;
+
+  // Lists the block devices by scanning udev rather than from
+  // |block_devices_|.
+  std::vector<Disk> ScanDisks() const;
+
+  // Looks up a block device by scanning udev rather than from
+  // |block_devices_|.
+  bool ScanDiskByDevicePath(const std::string& device_path, Disk* disk) const;
+
   // Enumerates the block devices on the system and invokes |callback| for each
   // device found during the enumeration. The ownership of |udev_device| is not
   // transferred to |callback|. The enumeration stops if |callback| returns
@@ -173,10 +215,34 @@ class DiskManager : public MountManager,
   // A set of device sysfs paths detected by the udev monitor.
   std::set<std::string> devices_detected_;
 
+  struct BlockDevice {
+    // The disk as of the last udev event for the device. The mount paths,
+    // remaining space and the properties updated by RefreshDisk() are
+    // refreshed whenever the disk is returned.
+    Disk disk;
+    // The udev device path, e.g. /devices/pci0000:00/.../block/sdb.
+    std::string dev_path;
+    bool is_ignored;
+  };
+
+  // Every block device on the system, indexed by sysfs path.
+  std::map<std::string, BlockDevice> block_devices_;
+
+  // Maps device files and udev device paths to sysfs paths in
+  // |block_devices_|.
+  std::map<std::string, std::string> block_device_paths_;
+
+  // True once the existing block devices have been added to |block_devices_|.
+  bool block_devices_scanned_;
+
   // A mapping from a mount path to the corresponding device file that should
   // be ejected on unmount.
   std::map<std::string, std::string> devices_to_eject_on_unmount_;
 
+  // Disks prepared by PrepareMount() and not finished yet, indexed by mount
+  // path.
+  std::map<std::string, Disk> disks_being_mounted_;
+
   // A mapping from a sysfs path of a disk, detected by the udev monitor,
   // to a set of sysfs paths of the immediate children of the disk.
   std::map<std::string, std::set<std::string>> disks_detected_;
@@ -197,6 +263,8 @@ class DiskManager : public MountManager,
   FRIEND_TEST(DiskManagerTest, EjectDeviceOfMountPathWhenEjectFailed);
   FRIEND_TEST(DiskManagerTest, EjectDeviceOfMountPathWhenExplicitlyDisabled);
   FRIEND_TEST(DiskManagerTest, EjectDeviceOfMountPathWhenMountPathExcluded);
+  FRIEND_TEST(DiskManagerTest, BlockDeviceModelMatchesScan);
+  FRIEND_TEST(DiskManagerTest, BlockDeviceModelUpdates);
 
   DISALLOW_COPY_AND_ASSIGN(DiskManager);
 };
@@ -4,8 +4,10 @@
 
 #include "cros-disks/disk_manager.h"
 
+#include <libudev.h>
 #include <sys/mount.h>
 
+#include <algorithm>
 #include <memory>
 
 #include <base/files/file_util.h>
@@ -34,6 +36,10 @@ namespace {
 
 const char kMountRootDirectory[] = "/media/removable";
 
+bool CompareNativePath(const cros_disks::Disk& a, const cros_disks::Disk& b) {
+  return a.native_path() < b.native_path();
+}
+
 }  // namespace
 
 namespace cros_disks {
@@ -159,6 +165,83 @@ TEST_F(DiskManagerTest, GetDiskByNonexistentDevicePath) {
   EXPECT_FALSE(manager_.GetDiskByDevicePath(device_path, &disk));
 }
 
+TEST_F(DiskManagerTest, BlockDeviceModelMatchesScan) {
+  manager_.ScanBlockDevices();
+
+  vector<Disk> disks = manager_.EnumerateDisks();
+  vector<Disk> scanned_disks = manager_.ScanDisks();
+  std::sort(disks.begin(), disks.end(), CompareNativePath);
+  std::sort(scanned_disks.begin(), scanned_disks.end(), CompareNativePath);
+  ASSERT_EQ(scanned_disks.size(), disks.size());
+  for (size_t i = 0; i < disks.size(); ++i) {
+    EXPECT_EQ(scanned_disks[i].native_path(), disks[i].native_path());
+    EXPECT_EQ(scanned_disks[i].device_file(), disks[i].device_file());
+    EXPECT_EQ(scanned_disks[i].filesystem_type(), disks[i].filesystem_type());
+    EXPECT_EQ(scanned_disks[i].label(), disks[i].label());
+    EXPECT_EQ(scanned_disks[i].uuid(), disks[i].uuid());
+    EXPECT_EQ(scanned_disks[i].device_capacity(), disks[i].device_capacity());
+    EXPECT_EQ(scanned_disks[i].is_mounted(), disks[i].is_mounted());
+    EXPECT_EQ(scanned_disks[i].mount_paths(), disks[i].mount_paths());
+    EXPECT_EQ(scanned_disks[i].is_hidden(), disks[i].is_hidden());
+    EXPECT_EQ(scanned_disks[i].is_media_available(),
+              disks[i].is_media_available());
+
+    Disk disk;
+    EXPECT_TRUE(manager_.GetDiskByDevicePath(disks[i].native_path(), &disk));
+    EXPECT_EQ(disks[i].device_file(), disk.device_file());
+    if (!disks[i].device_file().empty()) {
+      EXPECT_TRUE(manager_.GetDiskByDevicePath(disks[i].device_file(), &disk));
+      EXPECT_EQ(disks[i].native_path(), disk.native_path());
+    }
+  }
+}
+
+TEST_F(DiskManagerTest, BlockDeviceModelRefreshesDisk) {
+  manager_.ScanBlockDevices();
+  vector<Disk> disks = manager_.EnumerateDisks();
+  ASSERT_FALSE(disks.empty());
+  const Disk& disk = disks[0];
+
+  // Whether a disk is hidden or has media can change without a udev event for
+  // the disk, so a stale model must not be reported.
+  Disk& cached_disk = manager_.block_devices_[disk.native_path()].disk;
+  cached_disk.set_is_hidden(!disk.is_hidden());
+  cached_disk.set_is_media_available(!disk.is_media_available());
+
+  Disk found_disk;
+  EXPECT_TRUE(manager_.GetDiskByDevicePath(disk.native_path(), &found_disk));
+  EXPECT_EQ(disk.is_hidden(), found_disk.is_hidden());
+  EXPECT_EQ(disk.is_media_available(), found_disk.is_media_available());
+}
+
+TEST_F(DiskManagerTest, BlockDeviceModelUpdates) {
+  manager_.ScanBlockDevices();
+  vector<Disk> disks = manager_.EnumerateDisks();
+  ASSERT_FALSE(disks.empty());
+  const Disk& disk = disks[0];
+
+  udev_device* dev =
+      udev_device_new_from_syspath(manager_.udev_, disk.native_path().c_str());
+  ASSERT_NE(nullptr, dev);
+
+  manager_.UpdateBlockDevice(dev, "remove");
+  EXPECT_FALSE(ContainsKey(manager_.block_devices_, disk.native_path()));
+  EXPECT_FALSE(ContainsKey(manager_.block_device_paths_, disk.device_file()));
+  EXPECT_EQ(disks.size() - 1, manager_.EnumerateDisks().size());
+
+  // A device that the model doesn't know about yet is still found by scanning
+  // udev.
+  Disk found_disk;
+  EXPECT_TRUE(manager_.GetDiskByDevicePath(disk.native_path(), &found_disk));
+  EXPECT_EQ(disk.device_file(), found_disk.device_file());
+
+  manager_.UpdateBlockDevice(dev, "add");
+  EXPECT_TRUE(ContainsKey(manager_.block_devices_, disk.native_path()));
+  EXPECT_EQ(disks.size(), manager_.EnumerateDisks().size());
+
+  udev_device_unref(dev);
+}
+
 TEST_F(DiskManagerTest, GetFilesystem) {
   EXPECT_EQ(nullptr, manager_.GetFilesystem("nonexistent-fs"));
 
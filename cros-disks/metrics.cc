@@ -14,6 +14,11 @@ namespace {
 const char kArchiveTypeMetricName[] = "CrosDisks.ArchiveType";
 const char kDeviceMediaTypeMetricName[] = "CrosDisks.DeviceMediaType";
 const char kFilesystemTypeMetricName[] = "CrosDisks.FilesystemType";
+const char kMountTimeMetricPrefix[] = "CrosDisks.MountTime.";
+const char kMountTimeOtherFilesystem[] = "Other";
+const int kMountTimeMinMilliseconds = 1;
+const int kMountTimeMaxMilliseconds = 60 * 1000;
+const int kMountTimeNumBuckets = 50;
 
 }  // namespace
 
@@ -66,6 +71,13 @@ Metrics::FilesystemType Metrics::GetFilesystemType(
   return kFilesystemOther;
 }
 
+string Metrics::GetMountTimeMetricName(const string& filesystem_type) const {
+  FilesystemType type = GetFilesystemType(filesystem_type);
+  if (type == kFilesystemUnknown || type == kFilesystemOther)
+    return string(kMountTimeMetricPrefix) + kMountTimeOtherFilesystem;
+  return kMountTimeMetricPrefix + filesystem_type;
+}
+
 void Metrics::RecordArchiveType(const string& archive_type) {
   if (!metrics_library_.SendEnumToUMA(kArchiveTypeMetricName,
                                       GetArchiveType(archive_type),
@@ -87,4 +99,14 @@ void Metrics::RecordDeviceMediaType(DeviceMediaType device_media_type) {
     LOG(WARNING) << "Failed to send device media type sample to UMA";
 }
 
+void Metrics::RecordMountTime(const string& filesystem_type,
+                              base::TimeDelta mount_time) {
+  if (!metrics_library_.SendToUMA(GetMountTimeMetricName(filesystem_type),
+                                  mount_time.InMilliseconds(),
+                                  kMountTimeMinMilliseconds,
+                                  kMountTimeMaxMilliseconds,
+                                  kMountTimeNumBuckets))
+    LOG(WARNING) << "Failed to send mount time sample to UMA";
+}
+
 }  // namespace cros_disks
@@ -9,6 +9,7 @@
 #include <string>
 
 #include <base/macros.h>
+#include <base/time/time.h>
 #include <chromeos/dbus/service_constants.h>
 #include <gtest/gtest_prod.h>
 #include <metrics/metrics_library.h>
@@ -30,6 +31,11 @@ class Metrics {
   // Records the type of device media that cros-disks is trying to mount.
   void RecordDeviceMediaType(DeviceMediaType device_media_type);
 
+  // Records the time taken to mount a filesystem of |filesystem_type|,
+  // from the mount request until the filesystem is mounted.
+  void RecordMountTime(const std::string& filesystem_type,
+                       base::TimeDelta mount_time);
+
  private:
   enum ArchiveType {
     kArchiveUnknown = 0,
@@ -72,6 +78,11 @@ class Metrics {
   // type string.
   FilesystemType GetFilesystemType(const std::string& filesystem_type) const;
 
+  // Returns the name of the mount time histogram for the specified
+  // filesystem type string. Each known filesystem type has a histogram of
+  // its own.
+  std::string GetMountTimeMetricName(const std::string& filesystem_type) const;
+
   MetricsLibrary metrics_library_;
 
   // Mapping from an archive type to its corresponding metric value.
@@ -82,6 +93,7 @@ class Metrics {
 
   FRIEND_TEST(MetricsTest, GetArchiveType);
   FRIEND_TEST(MetricsTest, GetFilesystemType);
+  FRIEND_TEST(MetricsTest, GetMountTimeMetricName);
 
   DISALLOW_COPY_AND_ASSIGN(Metrics);
 };
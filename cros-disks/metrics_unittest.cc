@@ -36,4 +36,16 @@ TEST_F(MetricsTest, GetFilesystemType) {
   EXPECT_EQ(Metrics::kFilesystemOther, metrics_.GetFilesystemType("btrfs"));
 }
 
+TEST_F(MetricsTest, GetMountTimeMetricName) {
+  EXPECT_EQ("CrosDisks.MountTime.vfat",
+            metrics_.GetMountTimeMetricName("vfat"));
+  EXPECT_EQ("CrosDisks.MountTime.exfat",
+            metrics_.GetMountTimeMetricName("exfat"));
+  EXPECT_EQ("CrosDisks.MountTime.ntfs",
+            metrics_.GetMountTimeMetricName("ntfs"));
+  EXPECT_EQ("CrosDisks.MountTime.Other", metrics_.GetMountTimeMetricName(""));
+  EXPECT_EQ("CrosDisks.MountTime.Other",
+            metrics_.GetMountTimeMetricName("xfs"));
+}
+
 }  // namespace cros_disks
@@ -12,13 +12,17 @@
 #include <algorithm>
 #include <utility>
 
+#include <base/bind.h>
 #include <base/files/file_path.h>
 #include <base/logging.h>
 #include <base/stl_util.h>
 #include <base/strings/string_util.h>
 
+#include "cros-disks/metrics.h"
 #include "cros-disks/mount_entry.h"
 #include "cros-disks/mount_options.h"
+#include "cros-disks/mount_worker_pool.h"
+#include "cros-disks/mounter.h"
 #include "cros-disks/platform.h"
 
 using base::FilePath;
@@ -137,79 +141,95 @@ MountErrorType MountManager::Remount(const string& source_path,
   return error_type;
 }
 
-MountErrorType MountManager::MountNewSource(const string& source_path,
-                                            const string& filesystem_type,
-                                            const vector<string>& options,
-                                            string* mount_path) {
+bool MountManager::CheckExistingMount(const string& source_path,
+                                      string* mount_path,
+                                      MountErrorType* error_type) const {
   string actual_mount_path;
-  if (GetMountPathFromCache(source_path, &actual_mount_path)) {
-    LOG(WARNING) << "Path '" << source_path << "' is already mounted to '"
-                 << actual_mount_path << "'";
-    // TODO(benchan): Should probably compare filesystem type and mount options
-    //                with those used in previous mount.
-    if (mount_path->empty() || *mount_path == actual_mount_path) {
-      *mount_path = actual_mount_path;
-      return GetMountErrorOfReservedMountPath(actual_mount_path);
-    } else {
-      return MOUNT_ERROR_PATH_ALREADY_MOUNTED;
-    }
+  if (!GetMountPathFromCache(source_path, &actual_mount_path))
+    return false;
+
+  LOG(WARNING) << "Path '" << source_path << "' is already mounted to '"
+               << actual_mount_path << "'";
+  // TODO(benchan): Should probably compare filesystem type and mount options
+  //                with those used in previous mount.
+  if (mount_path->empty() || *mount_path == actual_mount_path) {
+    *mount_path = actual_mount_path;
+    *error_type = GetMountErrorOfReservedMountPath(actual_mount_path);
+  } else {
+    *error_type = MOUNT_ERROR_PATH_ALREADY_MOUNTED;
   }
+  return true;
+}
 
-  vector<string> updated_options = options;
+MountErrorType MountManager::CreateMountDirectory(
+    const string& source_path,
+    const vector<string>& options,
+    const string& mount_path,
+    string* actual_mount_path,
+    vector<string>* updated_options) {
+  *updated_options = options;
   string mount_label;
-  ExtractMountLabelFromOptions(&updated_options, &mount_label);
+  ExtractMountLabelFromOptions(updated_options, &mount_label);
 
   // Create a directory and set up its ownership/permissions for mounting
   // the source path. If an error occurs, ShouldReserveMountPathOnError()
   // is not called to reserve the mount path as a reserved mount path still
   // requires a proper mount directory.
-  if (mount_path->empty()) {
-    actual_mount_path = SuggestMountPath(source_path);
+  if (mount_path.empty()) {
+    *actual_mount_path = SuggestMountPath(source_path);
     if (!mount_label.empty()) {
       // Replace the basename(|actual_mount_path|) with |mount_label|.
-      actual_mount_path =
-          FilePath(actual_mount_path).DirName().Append(mount_label).value();
+      *actual_mount_path =
+          FilePath(*actual_mount_path).DirName().Append(mount_label).value();
     }
   } else {
-    actual_mount_path = *mount_path;
+    *actual_mount_path = mount_path;
   }
 
-  if (!IsValidMountPath(actual_mount_path)) {
-    LOG(ERROR) << "Mount path '" << actual_mount_path << "' is invalid";
+  if (!IsValidMountPath(*actual_mount_path)) {
+    LOG(ERROR) << "Mount path '" << *actual_mount_path << "' is invalid";
     return MOUNT_ERROR_INVALID_PATH;
   }
 
+  // Directories of mounts still in progress are empty but taken.
   bool mount_path_created;
-  if (mount_path->empty()) {
+  if (mount_path.empty()) {
+    set<string> unavailable_paths = GetReservedMountPaths();
+    unavailable_paths.insert(paths_being_mounted_.begin(),
+                             paths_being_mounted_.end());
     mount_path_created = platform_->CreateOrReuseEmptyDirectoryWithFallback(
-        &actual_mount_path, kMaxNumMountTrials, GetReservedMountPaths());
+        actual_mount_path, kMaxNumMountTrials, unavailable_paths);
   } else {
-    mount_path_created = !IsMountPathReserved(actual_mount_path) &&
-        platform_->CreateOrReuseEmptyDirectory(actual_mount_path);
+    mount_path_created = !IsMountPathReserved(*actual_mount_path) &&
+        !ContainsKey(paths_being_mounted_, *actual_mount_path) &&
+        platform_->CreateOrReuseEmptyDirectory(*actual_mount_path);
   }
   if (!mount_path_created) {
-    LOG(ERROR) << "Failed to create directory '" << actual_mount_path
+    LOG(ERROR) << "Failed to create directory '" << *actual_mount_path
                << "' to mount '" << source_path << "'";
     return MOUNT_ERROR_DIRECTORY_CREATION_FAILED;
   }
 
-  if (!platform_->SetOwnership(actual_mount_path, getuid(),
+  if (!platform_->SetOwnership(*actual_mount_path, getuid(),
                                platform_->mount_group_id()) ||
-      !platform_->SetPermissions(actual_mount_path,
+      !platform_->SetPermissions(*actual_mount_path,
                                  kMountDirectoryPermissions)) {
     LOG(ERROR) << "Failed to set ownership and permissions of directory '"
-               << actual_mount_path << "' to mount '" << source_path << "'";
-    platform_->RemoveEmptyDirectory(actual_mount_path);
+               << *actual_mount_path << "' to mount '" << source_path << "'";
+    platform_->RemoveEmptyDirectory(*actual_mount_path);
     return MOUNT_ERROR_DIRECTORY_CREATION_FAILED;
   }
+  return MOUNT_ERROR_NONE;
+}
 
-  // Perform the underlying mount operation. If an error occurs,
-  // ShouldReserveMountPathOnError() is called to check if the mount path
-  // should be reserved.
-  MountOptions applied_options;
-  MountErrorType error_type =
-      DoMount(source_path, filesystem_type, updated_options, actual_mount_path,
-              &applied_options);
+MountErrorType MountManager::FinishMountNewSource(
+    const string& source_path,
+    const string& actual_mount_path,
+    MountErrorType error_type,
+    bool is_read_only,
+    string* mount_path) {
+  // If an error occurs, ShouldReserveMountPathOnError() is called to check if
+  // the mount path should be reserved.
   if (error_type == MOUNT_ERROR_NONE) {
     LOG(INFO) << "Path '" << source_path << "' is mounted to '"
               << actual_mount_path << "'";
@@ -223,12 +243,163 @@ MountErrorType MountManager::MountNewSource(const string& source_path,
     return error_type;
   }
 
-  AddOrUpdateMountStateCache(source_path, actual_mount_path,
-                             applied_options.IsReadOnlyOptionSet());
+  AddOrUpdateMountStateCache(source_path, actual_mount_path, is_read_only);
   *mount_path = actual_mount_path;
   return error_type;
 }
 
+MountErrorType MountManager::MountNewSource(const string& source_path,
+                                            const string& filesystem_type,
+                                            const vector<string>& options,
+                                            string* mount_path) {
+  MountErrorType error_type;
+  if (CheckExistingMount(source_path, mount_path, &error_type))
+    return error_type;
+
+  string actual_mount_path;
+  vector<string> updated_options;
+  error_type = CreateMountDirectory(source_path, options, *mount_path,
+                                    &actual_mount_path, &updated_options);
+  if (error_type != MOUNT_ERROR_NONE)
+    return error_type;
+
+  // Perform the underlying mount operation.
+  MountOptions applied_options;
+  error_type = DoMount(source_path, filesystem_type, updated_options,
+                       actual_mount_path, &applied_options);
+  return FinishMountNewSource(source_path, actual_mount_path, error_type,
+                              applied_options.IsReadOnlyOptionSet(),
+                              mount_path);
+}
+
+void MountManager::MountAsync(const string& source_path,
+                              const string& filesystem_type,
+                              const vector<string>& options,
+                              const string& mount_path,
+                              const MountCallback& callback) {
+  if (ContainsKey(sources_being_mounted_, source_path)) {
+    LOG(INFO) << "Path '" << source_path << "' is being mounted, "
+              << "deferring another request to mount it";
+    waiting_mounts_[source_path].push_back(
+        {filesystem_type, options, mount_path, callback});
+    return;
+  }
+
+  string actual_mount_path = mount_path;
+  MountErrorType error_type;
+  bool is_new_source =
+      !source_path.empty() &&
+      find(options.begin(), options.end(), kMountOptionRemount) ==
+          options.end();
+  if (!worker_pool_ || !is_new_source) {
+    // Only the mount of a new source may be slow.
+    error_type =
+        Mount(source_path, filesystem_type, options, &actual_mount_path);
+    callback.Run(error_type, actual_mount_path);
+    return;
+  }
+  if (CheckExistingMount(source_path, &actual_mount_path, &error_type)) {
+    callback.Run(error_type, actual_mount_path);
+    return;
+  }
+
+  base::TimeTicks start_time = base::TimeTicks::Now();
+  vector<string> updated_options;
+  error_type = CreateMountDirectory(source_path, options, mount_path,
+                                    &actual_mount_path, &updated_options);
+  if (error_type != MOUNT_ERROR_NONE) {
+    callback.Run(error_type, mount_path);
+    return;
+  }
+
+  std::unique_ptr<Mounter> mounter =
+      PrepareMount(source_path, filesystem_type, updated_options,
+                   actual_mount_path, &error_type);
+  if (!mounter) {
+    // The derived class cannot mount off the main thread.
+    MountOptions applied_options;
+    if (error_type == MOUNT_ERROR_NONE) {
+      error_type = DoMount(source_path, filesystem_type, updated_options,
+                           actual_mount_path, &applied_options);
+    }
+    string result_mount_path = mount_path;
+    error_type = FinishMountNewSource(source_path, actual_mount_path,
+                                      error_type,
+                                      applied_options.IsReadOnlyOptionSet(),
+                                      &result_mount_path);
+    callback.Run(error_type, result_mount_path);
+    return;
+  }
+
+  sources_being_mounted_.insert(source_path);
+  paths_being_mounted_.insert(actual_mount_path);
+  Mounter* raw_mounter = mounter.get();
+  worker_pool_->Post(
+      base::Bind(&Mounter::Mount, base::Unretained(raw_mounter)),
+      base::Bind(&MountManager::OnMountFinished, base::Unretained(this),
+                 source_path, actual_mount_path, callback, start_time,
+                 base::Passed(&mounter)));
+}
+
+void MountManager::OnMountFinished(const string& source_path,
+                                   const string& actual_mount_path,
+                                   const MountCallback& callback,
+                                   base::TimeTicks start_time,
+                                   std::unique_ptr<Mounter> mounter,
+                                   MountErrorType error_type) {
+  sources_being_mounted_.erase(source_path);
+  paths_being_mounted_.erase(actual_mount_path);
+
+  error_type = FinishMount(*mounter, error_type);
+  if (cancelled_sources_.erase(source_path)) {
+    // UnmountAll() was called while the mount was running. Record a
+    // successful mount so that it is unmounted the usual way.
+    string mount_path;
+    error_type = FinishMountNewSource(
+        source_path, actual_mount_path, error_type,
+        mounter->mount_options().IsReadOnlyOptionSet(), &mount_path);
+    if (error_type == MOUNT_ERROR_NONE) {
+      LOG(INFO) << "Unmounting '" << source_path
+                << "', which finished mounting after all paths were unmounted";
+      UnmountCancelledMount(source_path);
+    }
+    callback.Run(MOUNT_ERROR_INTERNAL, "");
+
+    // Requests made after UnmountAll() waited for the cancelled mount. Replay
+    // them now that the source is unmounted.
+    ReplayWaitingMounts(source_path);
+    return;
+  }
+  if (error_type == MOUNT_ERROR_NONE) {
+    metrics_->RecordMountTime(mounter->filesystem_type(),
+                              base::TimeTicks::Now() - start_time);
+  }
+  string mount_path;
+  error_type = FinishMountNewSource(
+      source_path, actual_mount_path, error_type,
+      mounter->mount_options().IsReadOnlyOptionSet(), &mount_path);
+  callback.Run(error_type, mount_path);
+  ReplayWaitingMounts(source_path);
+}
+
+void MountManager::ReplayWaitingMounts(const string& source_path) {
+  // Replay the requests in order. The first of them may start another mount
+  // operation, which the others then wait for again.
+  auto waiting_it = waiting_mounts_.find(source_path);
+  if (waiting_it == waiting_mounts_.end())
+    return;
+  std::deque<MountRequest> waiting = std::move(waiting_it->second);
+  waiting_mounts_.erase(waiting_it);
+  for (const auto& request : waiting) {
+    MountAsync(source_path, request.filesystem_type, request.options,
+               request.mount_path, request.callback);
+  }
+}
+
+void MountManager::UnmountCancelledMount(const string& source_path) {
+  Unmount(source_path, vector<string>());
+}
+
 MountErrorType MountManager::Unmount(const string& path,
                                      const vector<string>& options) {
   if (path.empty()) {
@@ -277,6 +448,20 @@ bool MountManager::UnmountAll() {
       all_umounted = false;
     }
   }
+
+  // Mounts still running on the worker pool cannot be interrupted; they are
+  // unmounted by OnMountFinished(). Requests waiting for them are dropped.
+  for (const auto& source_path : sources_being_mounted_) {
+    LOG(INFO) << "Cancelling the mount of '" << source_path << "'";
+    cancelled_sources_.insert(source_path);
+    auto waiting_it = waiting_mounts_.find(source_path);
+    if (waiting_it == waiting_mounts_.end())
+      continue;
+    std::deque<MountRequest> waiting = std::move(waiting_it->second);
+    waiting_mounts_.erase(waiting_it);
+    for (const auto& request : waiting)
+      request.callback.Run(MOUNT_ERROR_INTERNAL, "");
+  }
   return all_umounted;
 }
 
@@ -433,6 +618,21 @@ bool MountManager::ExtractUnmountOptions(const vector<string>& options,
   return true;
 }
 
+std::unique_ptr<Mounter> MountManager::PrepareMount(
+    const string& source_path,
+    const string& filesystem_type,
+    const vector<string>& options,
+    const string& mount_path,
+    MountErrorType* error_type) {
+  *error_type = MOUNT_ERROR_NONE;
+  return nullptr;
+}
+
+MountErrorType MountManager::FinishMount(const Mounter& mounter,
+                                         MountErrorType error_type) {
+  return error_type;
+}
+
 bool MountManager::ShouldReserveMountPathOnError(
     MountErrorType error_type) const {
   return false;
@@ -10,12 +10,16 @@
 #ifndef CROS_DISKS_MOUNT_MANAGER_H_
 #define CROS_DISKS_MOUNT_MANAGER_H_
 
+#include <deque>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
+#include <base/callback.h>
 #include <base/macros.h>
+#include <base/time/time.h>
 #include <chromeos/dbus/service_constants.h>
 #include <gtest/gtest_prod.h>
 
@@ -25,6 +29,8 @@ namespace cros_disks {
 
 class Metrics;
 class MountEntry;
+class Mounter;
+class MountWorkerPool;
 class Platform;
 
 // A base class for managing mounted filesystems of certain kinds.
@@ -40,6 +46,10 @@ class MountManager {
     bool is_read_only;
   };
 
+  // Callback upon the completion of MountAsync() with the actual mount path.
+  using MountCallback = base::Callback<void(MountErrorType error_type,
+                                            const std::string& mount_path)>;
+
   // Constructor that takes a mount root directory, an object for providing
   // platform service, and an object for collecting UMA metrics. The mount
   // root directory |mount_root| must be a non-empty path string, but it is
@@ -109,13 +119,36 @@ class MountManager {
                        const std::vector<std::string>& options,
                        std::string* mount_path);
 
+  // Like Mount(), but reports the result by running |callback| on the main
+  // loop, which may happen before this method returns. When a new source is
+  // mounted and a worker pool is set, the part of the mount operation that
+  // waits for the kernel or a mount helper runs on the pool, so independent
+  // sources are mounted concurrently. A request for a source that is still
+  // being mounted waits until the earlier request completes. A source whose
+  // mount is still running when UnmountAll() is called is unmounted as soon
+  // as the mount completes, and the request fails with MOUNT_ERROR_INTERNAL.
+  void MountAsync(const std::string& source_path,
+                  const std::string& filesystem_type,
+                  const std::vector<std::string>& options,
+                  const std::string& mount_path,
+                  const MountCallback& callback);
+
+  // Sets the pool used by MountAsync(). The manager does not take ownership
+  // of |worker_pool|, which may be null to mount synchronously.
+  void set_worker_pool(MountWorkerPool* worker_pool) {
+    worker_pool_ = worker_pool;
+  }
+
   // Unmounts |path|, which can be a source path or a mount path,
   // with |options|. If the mount path is reserved during Mount(),
   // this method releases the reserved mount path.
   MountErrorType Unmount(const std::string& path,
                          const std::vector<std::string>& options);
 
-  // Unmounts all mounted paths.
+  // Unmounts all mounted paths. Mount operations still running on the worker
+  // pool are cancelled: their sources are unmounted once the mounts complete,
+  // and requests waiting for them fail right away. The return value only
+  // covers the paths that were already mounted.
   virtual bool UnmountAll();
 
   // Adds or updates a mapping |source_path| to its mount state in the cache.
@@ -185,6 +218,36 @@ class MountManager {
                                 const std::vector<std::string>& options,
                                 std::string* mount_path);
 
+  // Returns true if |source_path| is already mounted, in which case the
+  // request to mount it on |mount_path| is answered without mounting: on
+  // return, |error_type| holds the result of the request and |mount_path| is
+  // set to the existing mount path if the request is compatible with it.
+  bool CheckExistingMount(const std::string& source_path,
+                          std::string* mount_path,
+                          MountErrorType* error_type) const;
+
+  // Removes the mount label from |options| and creates the directory to
+  // mount |source_path| on. If |mount_path| is empty, a mount path is chosen
+  // from SuggestMountPath() and the mount label. On success, sets
+  // |actual_mount_path| to the created directory and |updated_options| to
+  // the remaining options.
+  MountErrorType CreateMountDirectory(
+      const std::string& source_path,
+      const std::vector<std::string>& options,
+      const std::string& mount_path,
+      std::string* actual_mount_path,
+      std::vector<std::string>* updated_options);
+
+  // Completes the mount of a new source on |actual_mount_path| that finished
+  // with |error_type|. If the mount succeeded or the mount path should be
+  // reserved, adds it to the cache and sets |mount_path| to
+  // |actual_mount_path|. Otherwise, removes the mount directory.
+  MountErrorType FinishMountNewSource(const std::string& source_path,
+                                      const std::string& actual_mount_path,
+                                      MountErrorType error_type,
+                                      bool is_read_only,
+                                      std::string* mount_path);
+
   // Remounts |source_path| on |mount_path| as |filesystem_type| with |options|.
   MountErrorType Remount(const std::string& source_path,
                          const std::string& filesystem_type,
@@ -201,6 +264,31 @@ class MountManager {
                                  const std::string& mount_path,
                                  MountOptions* applied_options) = 0;
 
+  // Prepares to mount |source_path| to |mount_path| as |filesystem_type| with
+  // |options| on the main thread, and returns a mounter whose Mount() can run
+  // on a worker thread. Returns nullptr and sets |error_type| if the source
+  // cannot be mounted. The default implementation returns nullptr and sets
+  // |error_type| to MOUNT_ERROR_NONE, which tells MountAsync() to call
+  // DoMount() on the main thread instead. A derived class whose mounts may
+  // block should override this method as well as FinishMount().
+  virtual std::unique_ptr<Mounter> PrepareMount(
+      const std::string& source_path,
+      const std::string& filesystem_type,
+      const std::vector<std::string>& options,
+      const std::string& mount_path,
+      MountErrorType* error_type);
+
+  // Called on the main thread after Mount() of a mounter returned by
+  // PrepareMount() has returned |error_type|. Returns the result of the
+  // mount operation. The default implementation returns |error_type|.
+  virtual MountErrorType FinishMount(const Mounter& mounter,
+                                     MountErrorType error_type);
+
+  // Called on the main thread to unmount |source_path|, whose mount completed
+  // after UnmountAll() cancelled it. The default implementation calls
+  // Unmount() without options.
+  virtual void UnmountCancelledMount(const std::string& source_path);
+
   // Implemented by a derived class to unmount |path| with |options|.
   virtual MountErrorType DoUnmount(const std::string& path,
                                    const std::vector<std::string>& options) = 0;
@@ -250,6 +338,28 @@ class MountManager {
   Metrics* metrics() const { return metrics_; }
 
  private:
+  // A call to MountAsync() deferred until an earlier mount of the same source
+  // completes.
+  struct MountRequest {
+    std::string filesystem_type;
+    std::vector<std::string> options;
+    std::string mount_path;
+    MountCallback callback;
+  };
+
+  // Called on the main loop when the mount of |source_path| started by
+  // MountAsync() at |start_time| has been run by the worker pool.
+  void OnMountFinished(const std::string& source_path,
+                       const std::string& actual_mount_path,
+                       const MountCallback& callback,
+                       base::TimeTicks start_time,
+                       std::unique_ptr<Mounter> mounter,
+                       MountErrorType error_type);
+
+  // Runs the MountAsync() calls that waited for the mount of |source_path|
+  // to complete.
+  void ReplayWaitingMounts(const std::string& source_path);
+
   // The root directory under which mount directories are created.
   std::string mount_root_;
 
@@ -267,6 +377,21 @@ class MountManager {
   // the path to reserved.
   ReservedMountPathMap reserved_mount_paths_;
 
+  // Pool on which MountAsync() runs mount operations, or null.
+  MountWorkerPool* worker_pool_ = nullptr;
+
+  // Source paths and mount paths of mount operations running on
+  // |worker_pool_|.
+  std::set<std::string> sources_being_mounted_;
+  std::set<std::string> paths_being_mounted_;
+
+  // Sources in |sources_being_mounted_| that UnmountAll() has cancelled.
+  std::set<std::string> cancelled_sources_;
+
+  // Requests to mount a source that was being mounted at the time of the
+  // request, keyed by source path in the order they were made.
+  std::map<std::string, std::deque<MountRequest>> waiting_mounts_;
+
   FRIEND_TEST(MountManagerTest, ExtractMountLabelFromOptions);
   FRIEND_TEST(MountManagerTest, ExtractMountLabelFromOptionsWithNoMountLabel);
   FRIEND_TEST(MountManagerTest, ExtractMountLabelFromOptionsWithTwoMountLabels);
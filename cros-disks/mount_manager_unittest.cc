@@ -10,16 +10,22 @@
 #include <sys/mount.h>
 #include <sys/unistd.h>
 
+#include <glib.h>
+
 #include <algorithm>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <base/bind.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include "cros-disks/metrics.h"
 #include "cros-disks/mount_entry.h"
 #include "cros-disks/mount_options.h"
+#include "cros-disks/mount_worker_pool.h"
+#include "cros-disks/mounter.h"
 #include "cros-disks/platform.h"
 
 using std::set;
@@ -59,6 +65,16 @@ class MockPlatform : public Platform {
   MOCK_CONST_METHOD2(SetPermissions, bool(const string& path, mode_t mode));
 };
 
+// A mounter that always succeeds without mounting anything.
+class FakeMounter : public Mounter {
+ public:
+  FakeMounter(const string& source_path, const string& target_path)
+      : Mounter(source_path, target_path, "", MountOptions()) {}
+
+ protected:
+  MountErrorType MountImpl() override { return MOUNT_ERROR_NONE; }
+};
+
 // A mock mount manager class for testing the mount manager base class.
 class MountManagerUnderTest : public MountManager {
  public:
@@ -66,6 +82,26 @@ class MountManagerUnderTest : public MountManager {
       : MountManager(kMountRootDirectory, platform, metrics) {
   }
 
+  // Returns a FakeMounter, to be run on the worker pool, if
+  // |prepare_mounts_| is set. Otherwise, lets MountAsync() call DoMount()
+  // on the main thread.
+  std::unique_ptr<Mounter> PrepareMount(const string& source_path,
+                                        const string& filesystem_type,
+                                        const vector<string>& options,
+                                        const string& mount_path,
+                                        MountErrorType* error_type) override {
+    if (!prepare_mounts_) {
+      return MountManager::PrepareMount(source_path, filesystem_type, options,
+                                        mount_path, error_type);
+    }
+    *error_type = MOUNT_ERROR_NONE;
+    return std::unique_ptr<Mounter>(new FakeMounter(source_path, mount_path));
+  }
+
+  void set_prepare_mounts(bool prepare_mounts) {
+    prepare_mounts_ = prepare_mounts;
+  }
+
   MOCK_CONST_METHOD1(CanMount, bool(const string& source_path));
   MOCK_CONST_METHOD0(GetMountSourceType, MountSourceType());
   MOCK_METHOD5(DoMount, MountErrorType(const string& source_path,
@@ -78,6 +114,9 @@ class MountManagerUnderTest : public MountManager {
   MOCK_CONST_METHOD1(ShouldReserveMountPathOnError,
                      bool(MountErrorType error_type));
   MOCK_CONST_METHOD1(SuggestMountPath, string(const string& source_path));
+
+ private:
+  bool prepare_mounts_ = false;
 };
 
 class MountManagerTest : public ::testing::Test {
@@ -117,6 +156,15 @@ MountErrorType DoMountSuccess(
   return MOUNT_ERROR_NONE;
 }
 
+// Callback for MountManager::MountAsync() that saves the result.
+void SaveMountResult(MountErrorType* saved_error_type,
+                     string* saved_mount_path,
+                     MountErrorType error_type,
+                     const string& mount_path) {
+  *saved_error_type = error_type;
+  *saved_mount_path = mount_path;
+}
+
 // Verifies that MountManager::Initialize() returns false when it fails to
 // create the mount root directory.
 TEST_F(MountManagerTest, InitializeFailedInCreateDirectory) {
@@ -531,6 +579,152 @@ TEST_F(MountManagerTest, MountSucceededWithEmptyMountPath) {
   EXPECT_FALSE(manager_.IsMountPathReserved(mount_path_));
 }
 
+// Verifies that MountManager::MountAsync() mounts a source path on the main
+// thread and reports the result before returning when the derived class does
+// not prepare mounts for the worker pool.
+TEST_F(MountManagerTest, MountAsyncWithoutPreparedMounter) {
+  source_path_ = kTestSourcePath;
+  string suggested_mount_path = kTestMountPath;
+  MountWorkerPool worker_pool(1);
+  manager_.set_worker_pool(&worker_pool);
+
+  EXPECT_CALL(platform_, CreateOrReuseEmptyDirectoryWithFallback(_, _, _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(platform_, SetOwnership(suggested_mount_path, _, _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(platform_, SetPermissions(suggested_mount_path, _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(platform_, RemoveEmptyDirectory(suggested_mount_path))
+      .WillOnce(Return(true));
+  EXPECT_CALL(manager_, DoMount(source_path_, filesystem_type_, options_,
+                                suggested_mount_path, _))
+      .WillOnce(Return(MOUNT_ERROR_NONE));
+  EXPECT_CALL(manager_, DoUnmount(suggested_mount_path, _))
+      .WillOnce(Return(MOUNT_ERROR_NONE));
+  EXPECT_CALL(manager_, SuggestMountPath(source_path_))
+      .WillOnce(Return(suggested_mount_path));
+
+  MountErrorType error_type = MOUNT_ERROR_UNKNOWN;
+  manager_.MountAsync(source_path_, filesystem_type_, options_, "",
+                      base::Bind(&SaveMountResult, &error_type, &mount_path_));
+  EXPECT_EQ(MOUNT_ERROR_NONE, error_type);
+  EXPECT_EQ(suggested_mount_path, mount_path_);
+  EXPECT_TRUE(manager_.IsMountPathInCache(mount_path_));
+  EXPECT_EQ(0, worker_pool.num_pending());
+
+  // Mounting the source again reports the existing mount path.
+  mount_path_.clear();
+  error_type = MOUNT_ERROR_UNKNOWN;
+  manager_.MountAsync(source_path_, filesystem_type_, options_, "",
+                      base::Bind(&SaveMountResult, &error_type, &mount_path_));
+  EXPECT_EQ(MOUNT_ERROR_NONE, error_type);
+  EXPECT_EQ(suggested_mount_path, mount_path_);
+
+  EXPECT_TRUE(manager_.UnmountAll());
+}
+
+// Verifies that MountManager::UnmountAll() cancels a mount running on the
+// worker pool: the source is unmounted once the mount completes, and both
+// the running request and a request waiting for it fail.
+TEST_F(MountManagerTest, UnmountAllCancelsMountInProgress) {
+  source_path_ = kTestSourcePath;
+  string suggested_mount_path = kTestMountPath;
+  MountWorkerPool worker_pool(1);
+  manager_.set_worker_pool(&worker_pool);
+  manager_.set_prepare_mounts(true);
+
+  EXPECT_CALL(platform_, CreateOrReuseEmptyDirectoryWithFallback(_, _, _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(platform_, SetOwnership(suggested_mount_path, _, _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(platform_, SetPermissions(suggested_mount_path, _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(platform_, RemoveEmptyDirectory(suggested_mount_path))
+      .WillOnce(Return(true));
+  EXPECT_CALL(manager_, DoMount(_, _, _, _, _)).Times(0);
+  EXPECT_CALL(manager_, DoUnmount(suggested_mount_path, _))
+      .WillOnce(Return(MOUNT_ERROR_NONE));
+  EXPECT_CALL(manager_, SuggestMountPath(source_path_))
+      .WillOnce(Return(suggested_mount_path));
+
+  // The reply of the worker pool only runs on the main loop, so the mount
+  // is still in progress when UnmountAll() is called.
+  MountErrorType error_type = MOUNT_ERROR_UNKNOWN;
+  manager_.MountAsync(source_path_, filesystem_type_, options_, "",
+                      base::Bind(&SaveMountResult, &error_type, &mount_path_));
+  MountErrorType waiting_error_type = MOUNT_ERROR_UNKNOWN;
+  string waiting_mount_path = "unset";
+  manager_.MountAsync(source_path_, filesystem_type_, options_, "",
+                      base::Bind(&SaveMountResult, &waiting_error_type,
+                                 &waiting_mount_path));
+  EXPECT_EQ(MOUNT_ERROR_UNKNOWN, error_type);
+  EXPECT_EQ(1, worker_pool.num_pending());
+
+  EXPECT_TRUE(manager_.UnmountAll());
+  EXPECT_EQ(MOUNT_ERROR_INTERNAL, waiting_error_type);
+  EXPECT_EQ("", waiting_mount_path);
+
+  while (worker_pool.num_pending() > 0)
+    g_main_context_iteration(nullptr, TRUE);
+  EXPECT_EQ(MOUNT_ERROR_INTERNAL, error_type);
+  EXPECT_EQ("", mount_path_);
+  EXPECT_FALSE(manager_.IsMountPathInCache(suggested_mount_path));
+  EXPECT_FALSE(manager_.GetMountPathFromCache(source_path_, &mount_path_));
+}
+
+// Verifies that a MountAsync() call made after MountManager::UnmountAll(),
+// while the cancelled mount of the same source is still running, mounts the
+// source once the cancelled mount is unmounted.
+TEST_F(MountManagerTest, MountAfterUnmountAllWaitsForCancelledMount) {
+  source_path_ = kTestSourcePath;
+  string suggested_mount_path = kTestMountPath;
+  MountWorkerPool worker_pool(1);
+  manager_.set_worker_pool(&worker_pool);
+  manager_.set_prepare_mounts(true);
+
+  EXPECT_CALL(platform_, CreateOrReuseEmptyDirectoryWithFallback(_, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(platform_, SetOwnership(suggested_mount_path, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(platform_, SetPermissions(suggested_mount_path, _))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(platform_, RemoveEmptyDirectory(suggested_mount_path))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(manager_, DoMount(_, _, _, _, _)).Times(0);
+  EXPECT_CALL(manager_, DoUnmount(suggested_mount_path, _))
+      .Times(2)
+      .WillRepeatedly(Return(MOUNT_ERROR_NONE));
+  EXPECT_CALL(manager_, SuggestMountPath(source_path_))
+      .Times(2)
+      .WillRepeatedly(Return(suggested_mount_path));
+
+  MountErrorType error_type = MOUNT_ERROR_UNKNOWN;
+  manager_.MountAsync(source_path_, filesystem_type_, options_, "",
+                      base::Bind(&SaveMountResult, &error_type, &mount_path_));
+  EXPECT_TRUE(manager_.UnmountAll());
+
+  MountErrorType new_error_type = MOUNT_ERROR_UNKNOWN;
+  string new_mount_path;
+  manager_.MountAsync(source_path_, filesystem_type_, options_, "",
+                      base::Bind(&SaveMountResult, &new_error_type,
+                                 &new_mount_path));
+  EXPECT_EQ(MOUNT_ERROR_UNKNOWN, new_error_type);
+
+  // The reply of the cancelled mount starts the new one on the worker pool.
+  while (worker_pool.num_pending() > 0)
+    g_main_context_iteration(nullptr, TRUE);
+  EXPECT_EQ(MOUNT_ERROR_INTERNAL, error_type);
+  EXPECT_EQ(MOUNT_ERROR_NONE, new_error_type);
+  EXPECT_EQ(suggested_mount_path, new_mount_path);
+  EXPECT_TRUE(manager_.IsMountPathInCache(suggested_mount_path));
+
+  EXPECT_TRUE(manager_.UnmountAll());
+}
+
 // Verifies that MountManager::Mount() returns no error when it successfully
 // mounts a source path with a given mount label in options.
 TEST_F(MountManagerTest, MountSucceededWithGivenMountLabel) {
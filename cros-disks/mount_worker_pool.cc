@@ -0,0 +1,122 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cros-disks/mount_worker_pool.h"
+
+#include <utility>
+
+#include <base/bind.h>
+#include <base/logging.h>
+#include <base/strings/stringprintf.h>
+
+namespace cros_disks {
+
+struct MountWorkerPool::Job {
+  Job(MountWorkerPool* job_pool, const Task& job_task, const Reply& job_reply)
+      : pool(job_pool),
+        task(job_task),
+        reply(job_reply),
+        done_source(g_idle_source_new()) {
+    g_source_set_callback(done_source, &MountWorkerPool::OnJobDone, this,
+                          nullptr);
+  }
+
+  ~Job() { g_source_unref(done_source); }
+
+  MountWorkerPool* const pool;
+  const Task task;
+  const Reply reply;
+
+  // Attached to the main context by the worker once |task| has finished. It
+  // is created on the main thread so that the worker never touches the job
+  // after handing it back.
+  GSource* const done_source;
+
+  size_t worker = 0;
+  MountErrorType result = MOUNT_ERROR_NONE;
+};
+
+MountWorkerPool::MountWorkerPool(size_t num_workers) {
+  for (size_t i = 0; i < num_workers; i++) {
+    std::unique_ptr<base::Thread> worker(
+        new base::Thread(base::StringPrintf("mount_worker%zu", i)));
+    if (!worker->Start()) {
+      LOG(ERROR) << "Failed to start mount worker thread " << i;
+      break;
+    }
+    idle_workers_.push_back(workers_.size());
+    workers_.emplace_back(std::move(worker));
+  }
+}
+
+MountWorkerPool::~MountWorkerPool() {
+  // Stopping a worker waits for the job it is running, after which the job
+  // only waits for its reply to be dispatched.
+  for (auto& worker : workers_)
+    worker->Stop();
+
+  for (const auto& job : started_jobs_) {
+    if (!g_source_is_destroyed(job->done_source))
+      g_source_destroy(job->done_source);
+  }
+  if (!queued_jobs_.empty() || !started_jobs_.empty()) {
+    LOG(WARNING) << "Dropped " << queued_jobs_.size() + started_jobs_.size()
+                 << " unfinished mount operations";
+  }
+}
+
+void MountWorkerPool::Post(const Task& task, const Reply& reply) {
+  if (workers_.empty()) {
+    reply.Run(task.Run());
+    return;
+  }
+
+  queued_jobs_.emplace_back(new Job(this, task, reply));
+  StartQueuedJobs();
+}
+
+void MountWorkerPool::StartQueuedJobs() {
+  while (!queued_jobs_.empty() && !idle_workers_.empty()) {
+    std::unique_ptr<Job> job = std::move(queued_jobs_.front());
+    queued_jobs_.pop_front();
+    job->worker = idle_workers_.back();
+    idle_workers_.pop_back();
+
+    Job* raw_job = job.get();
+    started_jobs_.push_back(std::move(job));
+    workers_[raw_job->worker]->task_runner()->PostTask(
+        FROM_HERE, base::Bind(&MountWorkerPool::RunJob, raw_job));
+  }
+}
+
+void MountWorkerPool::FinishJob(Job* job) {
+  std::unique_ptr<Job> finished_job;
+  for (auto it = started_jobs_.begin(); it != started_jobs_.end(); ++it) {
+    if (it->get() == job) {
+      finished_job = std::move(*it);
+      started_jobs_.erase(it);
+      break;
+    }
+  }
+  CHECK(finished_job) << "Unknown mount job";
+
+  idle_workers_.push_back(finished_job->worker);
+  StartQueuedJobs();
+  finished_job->reply.Run(finished_job->result);
+}
+
+// static
+void MountWorkerPool::RunJob(Job* job) {
+  job->result = job->task.Run();
+  g_source_attach(job->done_source, nullptr);
+}
+
+// static
+gboolean MountWorkerPool::OnJobDone(gpointer data) {
+  Job* job = static_cast<Job*>(data);
+  job->pool->FinishJob(job);
+  return FALSE;
+}
+
+}  // namespace cros_disks
@@ -0,0 +1,87 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CROS_DISKS_MOUNT_WORKER_POOL_H_
+#define CROS_DISKS_MOUNT_WORKER_POOL_H_
+
+#include <glib.h>
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include <base/callback.h>
+#include <base/macros.h>
+#include <base/threading/thread.h>
+#include <chromeos/dbus/service_constants.h>
+
+namespace cros_disks {
+
+// MountWorkerPool runs mount operations on a bounded pool of worker threads,
+// so that a slow mount neither blocks the main loop nor delays the mounts of
+// other sources. Operations start in the order they are posted, and their
+// results are reported back on the GLib main loop of the main thread.
+class MountWorkerPool {
+ public:
+  // An operation run on a worker thread. It must not touch state owned by
+  // the main thread.
+  using Task = base::Callback<MountErrorType()>;
+
+  // Run on the main loop with the result of a Task.
+  using Reply = base::Callback<void(MountErrorType error_type)>;
+
+  // Starts |num_workers| worker threads. With zero workers, or if no thread
+  // can be started, operations run synchronously in Post().
+  explicit MountWorkerPool(size_t num_workers);
+
+  // Waits for running operations to finish, and drops queued operations as
+  // well as replies that have not been delivered yet.
+  ~MountWorkerPool();
+
+  // Runs |task| on a worker thread as soon as one is free, and then |reply|
+  // with its result on the main loop. Without worker threads, both are run
+  // before Post() returns.
+  void Post(const Task& task, const Reply& reply);
+
+  size_t num_workers() const { return workers_.size(); }
+
+  // Returns the number of operations that have been posted but whose reply
+  // has not run yet.
+  size_t num_pending() const {
+    return queued_jobs_.size() + started_jobs_.size();
+  }
+
+ private:
+  struct Job;
+
+  // Hands queued jobs to idle workers.
+  void StartQueuedJobs();
+
+  // Called on the main loop once the task of |job| has finished.
+  void FinishJob(Job* job);
+
+  // Runs the task of |job| on a worker thread.
+  static void RunJob(Job* job);
+
+  // Called by GLib to dispatch the reply source of a job.
+  static gboolean OnJobDone(gpointer data);
+
+  std::vector<std::unique_ptr<base::Thread>> workers_;
+
+  // Indices into |workers_| of the workers that are not running a job.
+  std::vector<size_t> idle_workers_;
+
+  // Jobs waiting for a worker, in the order they were posted.
+  std::deque<std::unique_ptr<Job>> queued_jobs_;
+
+  // Jobs that are running on a worker or whose reply has not run yet.
+  std::list<std::unique_ptr<Job>> started_jobs_;
+
+  DISALLOW_COPY_AND_ASSIGN(MountWorkerPool);
+};
+
+}  // namespace cros_disks
+
+#endif  // CROS_DISKS_MOUNT_WORKER_POOL_H_
@@ -0,0 +1,70 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Runs kNumSources emulated mounts that each sleep kMountTimeMilliseconds, on
+// a one-worker pool and then on a pool with a worker per source, and prints
+// the time until the main loop has seen all of them complete. The serial time
+// is about kNumSources mount times, as when the partitions of a drive were
+// mounted one after another; the concurrent time should be close to one.
+
+#include "cros-disks/mount_worker_pool.h"
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <base/bind.h>
+#include <base/threading/platform_thread.h>
+#include <base/time/time.h>
+#include <gtest/gtest.h>
+
+namespace cros_disks {
+
+namespace {
+
+// Time taken by each emulated mount operation.
+const int kMountTimeMilliseconds = 100;
+
+// Number of sources mounted at once, e.g. the partitions of a drive.
+const size_t kNumSources = 4;
+
+// Emulates a mount operation that blocks for a while.
+MountErrorType Mount() {
+  base::PlatformThread::Sleep(
+      base::TimeDelta::FromMilliseconds(kMountTimeMilliseconds));
+  return MOUNT_ERROR_NONE;
+}
+
+void OnMountCompleted(size_t* num_completed, MountErrorType error_type) {
+  (*num_completed)++;
+}
+
+// Posts |kNumSources| mount operations to |pool| and runs the main loop until
+// they have all completed. Returns the time this took.
+base::TimeDelta MountAll(MountWorkerPool* pool) {
+  size_t num_completed = 0;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (size_t i = 0; i < kNumSources; i++)
+    pool->Post(base::Bind(&Mount), base::Bind(&OnMountCompleted,
+                                              &num_completed));
+  while (num_completed < kNumSources)
+    g_main_context_iteration(nullptr, TRUE);
+  return base::TimeTicks::Now() - start;
+}
+
+}  // namespace
+
+TEST(MountWorkerPoolBenchmark, MountLatency) {
+  MountWorkerPool serial_pool(1);
+  const base::TimeDelta serial_time = MountAll(&serial_pool);
+  MountWorkerPool pool(kNumSources);
+  const base::TimeDelta concurrent_time = MountAll(&pool);
+
+  printf("%zu mounts of %d ms each: %" PRId64 " ms serially, %" PRId64
+         " ms concurrently\n",
+         kNumSources, kMountTimeMilliseconds, serial_time.InMilliseconds(),
+         concurrent_time.InMilliseconds());
+}
+
+}  // namespace cros_disks
@@ -0,0 +1,141 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cros-disks/mount_worker_pool.h"
+
+#include <glib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <base/bind.h>
+#include <base/synchronization/lock.h>
+#include <base/threading/platform_thread.h>
+#include <base/time/time.h>
+#include <gtest/gtest.h>
+
+namespace cros_disks {
+
+namespace {
+
+// Time taken by each emulated mount operation.
+const int kMountTimeMilliseconds = 100;
+
+// Number of sources mounted at once, e.g. the partitions of a drive.
+const size_t kNumSources = 4;
+
+}  // namespace
+
+class MountWorkerPoolTest : public ::testing::Test {
+ public:
+  // Emulates a mount operation that blocks for a while, and records how
+  // many operations run at the same time.
+  MountErrorType Mount(MountErrorType result) {
+    {
+      base::AutoLock guard(lock_);
+      running_++;
+      max_running_ = std::max(max_running_, running_);
+    }
+    base::PlatformThread::Sleep(
+        base::TimeDelta::FromMilliseconds(kMountTimeMilliseconds));
+    {
+      base::AutoLock guard(lock_);
+      running_--;
+    }
+    return result;
+  }
+
+  void OnMountCompleted(size_t index, MountErrorType error_type) {
+    completed_.push_back(index);
+    results_.push_back(error_type);
+    if (main_loop_ && completed_.size() == expected_completions_)
+      g_main_loop_quit(main_loop_);
+  }
+
+ protected:
+  MountWorkerPoolTest() : main_loop_(nullptr) {}
+
+  static gboolean OnTimeout(gpointer data) {
+    GMainLoop* main_loop = static_cast<GMainLoop*>(data);
+    g_main_loop_quit(main_loop);
+    return TRUE;
+  }
+
+  // Posts |num_sources| mount operations to |pool| and runs the main loop
+  // until they have all completed.
+  void MountAll(MountWorkerPool* pool, size_t num_sources) {
+    expected_completions_ = num_sources;
+    main_loop_ = g_main_loop_new(g_main_context_default(), FALSE);
+    guint timeout_id = g_timeout_add_seconds(10, &OnTimeout, main_loop_);
+
+    for (size_t i = 0; i < num_sources; i++) {
+      pool->Post(base::Bind(&MountWorkerPoolTest::Mount,
+                            base::Unretained(this),
+                            i % 2 ? MOUNT_ERROR_UNKNOWN : MOUNT_ERROR_NONE),
+                 base::Bind(&MountWorkerPoolTest::OnMountCompleted,
+                            base::Unretained(this), i));
+    }
+    if (completed_.size() < num_sources)
+      g_main_loop_run(main_loop_);
+
+    g_source_remove(timeout_id);
+    g_main_loop_unref(main_loop_);
+    main_loop_ = nullptr;
+  }
+
+  GMainLoop* main_loop_;
+  size_t expected_completions_ = 0;
+  std::vector<size_t> completed_;
+  std::vector<MountErrorType> results_;
+
+  base::Lock lock_;
+  size_t running_ = 0;
+  size_t max_running_ = 0;
+};
+
+TEST_F(MountWorkerPoolTest, RunsSynchronouslyWithoutWorkers) {
+  MountWorkerPool pool(0);
+  EXPECT_EQ(0, pool.num_workers());
+  pool.Post(base::Bind(&MountWorkerPoolTest::Mount, base::Unretained(this),
+                       MOUNT_ERROR_NONE),
+            base::Bind(&MountWorkerPoolTest::OnMountCompleted,
+                       base::Unretained(this), 0));
+  ASSERT_EQ(1, completed_.size());
+  EXPECT_EQ(MOUNT_ERROR_NONE, results_[0]);
+  EXPECT_EQ(0, pool.num_pending());
+}
+
+TEST_F(MountWorkerPoolTest, BoundsConcurrentMounts) {
+  MountWorkerPool pool(2);
+  ASSERT_EQ(2, pool.num_workers());
+  MountAll(&pool, 2 * kNumSources);
+
+  ASSERT_EQ(2 * kNumSources, completed_.size());
+  EXPECT_EQ(2, max_running_);
+  EXPECT_EQ(0, pool.num_pending());
+  for (size_t i = 0; i < completed_.size(); i++) {
+    EXPECT_EQ(completed_[i] % 2 ? MOUNT_ERROR_UNKNOWN : MOUNT_ERROR_NONE,
+              results_[i]);
+  }
+}
+
+TEST_F(MountWorkerPoolTest, DropsPendingMountsOnDestruction) {
+  {
+    MountWorkerPool pool(1);
+    for (size_t i = 0; i < kNumSources; i++) {
+      pool.Post(base::Bind(&MountWorkerPoolTest::Mount, base::Unretained(this),
+                           MOUNT_ERROR_NONE),
+                base::Bind(&MountWorkerPoolTest::OnMountCompleted,
+                           base::Unretained(this), i));
+    }
+    EXPECT_EQ(kNumSources, pool.num_pending());
+  }
+  // Replies are never run once the pool is gone.
+  while (g_main_context_iteration(nullptr, FALSE)) {
+  }
+  EXPECT_TRUE(completed_.empty());
+  EXPECT_EQ(0, running_);
+}
+
+}  // namespace cros_disks
@@ -327,6 +327,7 @@
       'type': 'executable',
       'link_settings': {
         'libraries': [
+          '-lbootstat',
           '-lvboot_host',
         ],
       },
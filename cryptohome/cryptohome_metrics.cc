@@ -45,7 +45,10 @@ const TimerHistogramParams kTimerHistogramParams[cryptohome::kNumTimerTypes] = {
   // just check if PKCS#11 was previously initialized, returning immediately.
   // These will all fall into the first histogram bucket.
   {"Cryptohome.TimeToInitPkcs11", 1000, 100000, 50},
-  {"Cryptohome.TimeToMountEx", 0, 4000, 50}
+  {"Cryptohome.TimeToMountEx", 0, 4000, 50},
+  // Time spent populating a brand-new home (tracked directories and skeleton)
+  // once the vault has been created and mounted.
+  {"Cryptohome.TimeToSetupNewUser", 0, 4000, 50}
 };
 
 MetricsLibrary* g_metrics = NULL;
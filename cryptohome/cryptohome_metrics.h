@@ -39,6 +39,7 @@ enum TimerType {
   kTpmTakeOwnershipTimer,
   kPkcs11InitTimer,
   kMountExTimer,
+  kNewUserSetupTimer,
   kNumTimerTypes  // For the number of timer types.
 };
 
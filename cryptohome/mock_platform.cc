@@ -27,6 +27,8 @@ MockPlatform::MockPlatform()
       .WillByDefault(Return(base::Time::NowFromSystemTime()));
   ON_CALL(*this, Copy(_, _))
       .WillByDefault(CallCopy());
+  ON_CALL(*this, CopyFileWithOwnership(_, _, _, _))
+      .WillByDefault(CallCopyFileWithOwnership());
   ON_CALL(*this, StatVFS(_, _))
       .WillByDefault(CallStatVFS());
   ON_CALL(*this, ReportFilesystemDetails(_, _))
@@ -74,6 +74,9 @@ ACTION(CallCreateDirectory) {
 ACTION(CallReadFile) { return Platform().ReadFile(arg0, arg1); }
 ACTION(CallReadFileToString) { return Platform().ReadFileToString(arg0, arg1); }
 ACTION(CallCopy) { return Platform().Copy(arg0, arg1); }
+ACTION(CallCopyFileWithOwnership) {
+  return Platform().CopyFileWithOwnership(arg0, arg1, arg2, arg3);
+}
 ACTION(CallRename) { return Platform().Rename(arg0, arg1); }
 ACTION(CallComputeDirectorySize) {
   return Platform().ComputeDirectorySize(arg0);
@@ -158,6 +161,10 @@ class MockPlatform : public Platform {
   MOCK_METHOD1(TouchFileDurable, bool(const base::FilePath& path));
   MOCK_CONST_METHOD0(GetCurrentTime, base::Time());
   MOCK_METHOD2(Copy, bool(const base::FilePath&, const base::FilePath&));
+  MOCK_METHOD4(CopyFileWithOwnership, bool(const base::FilePath&,
+                                           const base::FilePath&,
+                                           uid_t,
+                                           gid_t));
   MOCK_METHOD2(Move, bool(const base::FilePath&, const base::FilePath&));
   MOCK_METHOD2(StatVFS, bool(const base::FilePath&, struct statvfs*));
   MOCK_METHOD2(ReportFilesystemDetails, bool(const base::FilePath&,
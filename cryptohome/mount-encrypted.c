@@ -129,6 +129,7 @@ static gchar *stateful_mount = NULL;
 static gchar *key_path = NULL;
 static gchar *needs_finalization_path = NULL;
 static gchar *block_path = NULL;
+static gchar *resize_state_path = NULL;
 static gchar *encrypted_mount = NULL;
 static gchar *dmcrypt_name = NULL;
 static gchar *dmcrypt_dev = NULL;
@@ -884,6 +885,22 @@ static void spawn_resizer(const char *device, uint64_t blocks,
 			  uint64_t blocks_max)
 {
 	pid_t pid;
+	uint64_t state_blocks, state_blocks_max, fs_blocks;
+
+	/* A recorded, finished resize to this size needs no more work. */
+	if (resize_state_read(resize_state_path, &state_blocks,
+			      &state_blocks_max) &&
+	    state_blocks_max == blocks_max && state_blocks > blocks)
+		blocks = state_blocks;
+
+	/* Without a record (e.g. after an update), ask the superblock. */
+	if (blocks < blocks_max && filesystem_blocks(device, &fs_blocks) &&
+	    fs_blocks > blocks) {
+		blocks = fs_blocks;
+		if (blocks >= blocks_max)
+			resize_state_write(resize_state_path, blocks,
+					   blocks_max);
+	}
 
 	/* Skip resize before forking, if it's not going to happen. */
 	if (blocks >= blocks_max) {
@@ -912,7 +929,7 @@ static void spawn_resizer(const char *device, uint64_t blocks,
 		goto out;
 	}
 
-	filesystem_resize(device, blocks, blocks_max);
+	filesystem_resize(device, blocks, blocks_max, resize_state_path);
 
 out:
 	INFO_DONE("Done.");
@@ -982,6 +999,7 @@ static int setup_encrypted(int mode)
 		/* Wipe out the old files, and ignore errors. */
 		unlink(key_path);
 		unlink(block_path);
+		unlink(resize_state_path);
 
 		/* Calculate the desired size of the new partition. */
 		if (statvfs(stateful_mount, &stateful_statbuf)) {
@@ -1129,8 +1147,9 @@ static int setup_encrypted(int mode)
 		goto dm_cleanup;
 	}
 
-	/* Always spawn filesystem resizer, in case growth was interrupted. */
-	/* TODO(keescook): if already full size, don't resize. */
+	/* Spawn the filesystem resizer if growth is pending or was
+	 * interrupted; it is skipped once the filesystem is full size.
+	 */
 	spawn_resizer(dmcrypt_dev, blocks_min, blocks_max);
 
 	/* If the legacy lockbox NVRAM area exists, we've rebuilt the
@@ -1376,6 +1395,7 @@ static int report_info(void)
 	printf("stateful_mount: %s\n", stateful_mount);
 	printf("key_path: %s\n", key_path);
 	printf("block_path: %s\n", block_path);
+	printf("resize_state_path: %s\n", resize_state_path);
 	printf("encrypted_mount: %s\n", encrypted_mount);
 	printf("dmcrypt_name: %s\n", dmcrypt_name);
 	printf("dmcrypt_dev: %s\n", dmcrypt_dev);
@@ -1470,6 +1490,9 @@ static void prepare_paths(void)
 	if (asprintf(&block_path, "%s%s", rootdir,
 		     STATEFUL_MNT "/encrypted.block") == -1)
 		goto fail;
+	if (asprintf(&resize_state_path, "%s%s", rootdir,
+		     STATEFUL_MNT "/encrypted.resize-state") == -1)
+		goto fail;
 	if (asprintf(&encrypted_mount, "%s%s", rootdir, ENCRYPTED_MNT) == -1)
 		goto fail;
 	if (asprintf(&dmcrypt_dev, "/dev/mapper/%s", dmcrypt_name) == -1)
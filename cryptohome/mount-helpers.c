@@ -20,14 +20,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
 
+#include <metrics/bootstat.h>
 #include <openssl/evp.h>
 
 #include "mount-encrypted.h"
@@ -42,6 +46,7 @@ static const gchar kDevTemplate[] = "/dev/%s";
 static const int kLoopMajor = 7;
 static const unsigned int kResizeStepSeconds = 2;
 static const uint64_t kResizeBlocks = 32768 * 10;
+static const int kResizeNice = 10;
 static const uint64_t kBlocksPerGroup = 32768;
 static const uint64_t kInodeRatioDefault = 16384;
 static const uint64_t kInodeRatioMinimum = 2048;
@@ -678,27 +683,144 @@ out:
 	return rc;
 }
 
-/* Spawns a filesystem resizing process. */
-int filesystem_resize(const char *device, uint64_t blocks, uint64_t blocks_max)
+/* Reads the number of blocks of the ext4 filesystem on device from its
+ * superblock, since statvfs does not report the correct value.
+ */
+int filesystem_blocks(const char *device, uint64_t *blocks)
+{
+	/* Offsets into the primary superblock, which starts at byte 1024. */
+	const off_t kSuperblockOffset = 1024;
+	const size_t kBlocksCountLo = 0x04;
+	const size_t kMagic = 0x38;
+	const size_t kFeatureIncompat = 0x60;
+	const size_t kBlocksCountHi = 0x150;
+	const uint16_t kExt4Magic = 0xEF53;
+	const uint32_t kFeatureIncompat64Bit = 0x80;
+	uint8_t sb[1024];
+	uint16_t magic;
+	uint32_t incompat, lo, hi = 0;
+	int fd, rc = 0;
+
+	if ((fd = open(device, O_RDONLY | O_NOFOLLOW | O_CLOEXEC)) < 0) {
+		PERROR("open(%s)", device);
+		return 0;
+	}
+	if (pread(fd, sb, sizeof(sb), kSuperblockOffset) != sizeof(sb)) {
+		PERROR("pread(%s)", device);
+		goto out;
+	}
+	/* ext4 stores the superblock little-endian, as do our targets. */
+	memcpy(&magic, sb + kMagic, sizeof(magic));
+	if (magic != kExt4Magic) {
+		ERROR("%s: bad superblock magic 0x%04x", device, magic);
+		goto out;
+	}
+	memcpy(&lo, sb + kBlocksCountLo, sizeof(lo));
+	memcpy(&incompat, sb + kFeatureIncompat, sizeof(incompat));
+	if (incompat & kFeatureIncompat64Bit)
+		memcpy(&hi, sb + kBlocksCountHi, sizeof(hi));
+	*blocks = ((uint64_t)hi << 32) | lo;
+	rc = 1;
+
+out:
+	close(fd);
+	return rc;
+}
+
+/* Reads the resize progress recorded in state_path. Returns 0 if there is
+ * no usable record.
+ */
+int resize_state_read(const char *state_path, uint64_t *blocks,
+		      uint64_t *blocks_max)
+{
+	gchar *contents = NULL;
+	int rc;
+
+	if (!g_file_get_contents(state_path, &contents, NULL, NULL))
+		return 0;
+	rc = (sscanf(contents, "%" SCNu64 " %" SCNu64, blocks, blocks_max) == 2);
+	g_free(contents);
+	return rc;
+}
+
+/* Records resize progress in state_path, replacing it atomically. */
+int resize_state_write(const char *state_path, uint64_t blocks,
+		       uint64_t blocks_max)
 {
-	/* Ignore resizing if we know the filesystem was built to max size. */
+	gchar *contents;
+	GError *err = NULL;
+	int rc = 1;
+
+	contents = g_strdup_printf("%" PRIu64 " %" PRIu64 "\n", blocks,
+				   blocks_max);
+	if (!g_file_set_contents(state_path, contents, -1, &err)) {
+		ERROR("%s: %s", state_path, err->message);
+		g_error_free(err);
+		rc = 0;
+	}
+	g_free(contents);
+	return rc;
+}
+
+/* Lowers the CPU and I/O priority of the calling process so that resizing
+ * does not compete with the rest of boot.
+ */
+static void resize_lower_priority(void)
+{
+	/* From linux/ioprio.h, which is not exported to userspace. */
+	const int kIoprioClassShift = 13;
+	const int kIoprioClassIdle = 3;
+	const int kIoprioWhoProcess = 1;
+
+	if (setpriority(PRIO_PROCESS, 0, kResizeNice))
+		PERROR("setpriority");
+	if (syscall(SYS_ioprio_set, kIoprioWhoProcess, 0,
+		    kIoprioClassIdle << kIoprioClassShift))
+		PERROR("ioprio_set");
+}
+
+static double elapsed_seconds(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) +
+	       (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Grows the filesystem on device from blocks to blocks_max in throttled
+ * steps, at idle I/O priority. If state_path is not NULL, progress is
+ * recorded there after each step so a reboot resumes where it left off
+ * and later boots can skip resizing entirely.
+ */
+int filesystem_resize(const char *device, uint64_t blocks, uint64_t blocks_max,
+		      const char *state_path)
+{
+	struct timespec start;
+	uint64_t current;
+
+	/* The superblock knows best how far a previous resize got. */
+	if (filesystem_blocks(device, &current) && current > blocks)
+		blocks = current;
+
+	/* Ignore resizing if the filesystem already has its max size. */
 	if (blocks >= blocks_max) {
 		INFO("Resizing aborted. blocks:%" PRIu64 " >= blocks_max:%" PRIu64,
 		     blocks, blocks_max);
+		if (state_path)
+			resize_state_write(state_path, blocks, blocks_max);
 		return 1;
 	}
 
-	/* TODO(keescook): Read superblock to find out the current size of
-	 * the filesystem (since statvfs does not report the correct value).
-	 * For now, instead of doing multi-step resizing, just resize to the
-	 * full size of the block device in one step.
-	 */
-	blocks = blocks_max;
-
-	INFO("Resizing started in %d second steps.", kResizeStepSeconds);
+	resize_lower_priority();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	bootstat_log("encstateful-resize-start");
+	INFO("Resizing from %" PRIu64 " to %" PRIu64 " blocks in %d second "
+	     "steps.", blocks, blocks_max, kResizeStepSeconds);
 
 	do {
 		gchar *blocks_str;
+		int failed;
 
 		sleep(kResizeStepSeconds);
 
@@ -720,15 +842,21 @@ int filesystem_resize(const char *device, uint64_t blocks, uint64_t blocks_max)
 			NULL
 		};
 
-		INFO("Resizing filesystem on %s to %" PRIu64 ".", device, blocks);
-		if (runcmd(resize, NULL)) {
+		INFO("Resizing filesystem on %s to %" PRIu64 " (%.1fs).",
+		     device, blocks, elapsed_seconds(&start));
+		failed = runcmd(resize, NULL);
+		g_free(blocks_str);
+		if (failed) {
 			ERROR("resize2fs failed");
+			bootstat_log("encstateful-resize-failed");
 			return 0;
 		}
-		g_free(blocks_str);
+		if (state_path)
+			resize_state_write(state_path, blocks, blocks_max);
 	} while (blocks < blocks_max);
 
-	INFO("Resizing finished.");
+	bootstat_log("encstateful-resize-done");
+	INFO("Resizing finished in %.1fs.", elapsed_seconds(&start));
 	return 1;
 }
 
@@ -33,7 +33,15 @@ int sparse_create(const char *path, uint64_t bytes);
 /* Filesystem creation. */
 int filesystem_build(const char *device, uint64_t block_bytes,
                      uint64_t blocks_min, uint64_t blocks_max);
-int filesystem_resize(const char *device, uint64_t blocks, uint64_t blocks_max);
+int filesystem_blocks(const char *device, uint64_t *blocks);
+int filesystem_resize(const char *device, uint64_t blocks, uint64_t blocks_max,
+                      const char *state_path);
+
+/* Filesystem resize progress tracking. */
+int resize_state_read(const char *state_path, uint64_t *blocks,
+                      uint64_t *blocks_max);
+int resize_state_write(const char *state_path, uint64_t blocks,
+                       uint64_t blocks_max);
 
 /* Encrypted keyfile handling. */
 char *keyfile_read(const char *keyfile, uint8_t *system_key);
@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <set>
@@ -124,6 +125,7 @@ Mount::Mount()
       default_access_group_(-1),
       shadow_root_(kDefaultShadowRoot),
       skel_source_(kDefaultSkeletonSource),
+      skeleton_manifest_loaded_(false),
       system_salt_(),
       default_platform_(new Platform()),
       platform_(default_platform_.get()),
@@ -626,13 +628,18 @@ bool Mount::MountCryptohomeInner(const Credentials& credentials,
     current_user_->set_key_data(serialized.key_data());
   }
 
+  if (created)
+    ReportTimerStart(kNewUserSetupTimer);
+
   // Move the tracked subdirectories from mount_point_/user to vault_path
   // as passthrough directories.
   CreateTrackedSubdirectories(credentials, created);
 
   FilePath user_home = GetMountedUserHomePath(obfuscated_username);
-  if (created)
+  if (created) {
     CopySkeleton(user_home);
+    ReportTimerStop(kNewUserSetupTimer);
+  }
 
   if (!SetupGroupAccess(FilePath(user_home))) {
     UnmountAll();
@@ -1664,8 +1671,73 @@ void Mount::MigrateToUserHome(const FilePath& vault_path) const {
   LOG(INFO) << "Migrated (or created) user directory: " << vault_path.value();
 }
 
+const std::vector<Mount::SkeletonEntry>& Mount::GetSkeletonManifest() const {
+  if (skeleton_manifest_loaded_)
+    return skeleton_manifest_;
+
+  std::vector<SkeletonEntry> directories;
+  std::vector<SkeletonEntry> files;
+  std::unique_ptr<FileEnumerator> enumerator(
+      platform_->GetFileEnumerator(skel_source_, true,
+                                   base::FileEnumerator::FILES |
+                                   base::FileEnumerator::DIRECTORIES |
+                                   base::FileEnumerator::SHOW_SYM_LINKS));
+  FilePath next_path;
+  while (!(next_path = enumerator->Next()).empty()) {
+    SkeletonEntry entry;
+    if (!skel_source_.AppendRelativePath(next_path, &entry.relative_path)) {
+      LOG(ERROR) << "Skipping skeleton entry outside of "
+                 << skel_source_.value() << ": " << next_path.value();
+      continue;
+    }
+    entry.is_directory = enumerator->GetInfo().IsDirectory();
+    entry.is_symlink = S_ISLNK(enumerator->GetInfo().stat().st_mode);
+    if (entry.is_directory)
+      directories.push_back(entry);
+    else
+      files.push_back(entry);
+  }
+  // Sorting puts every directory before its subdirectories.
+  std::sort(directories.begin(), directories.end(),
+            [](const SkeletonEntry& a, const SkeletonEntry& b) {
+              return a.relative_path < b.relative_path;
+            });
+  skeleton_manifest_.swap(directories);
+  skeleton_manifest_.insert(skeleton_manifest_.end(),
+                            files.begin(), files.end());
+  skeleton_manifest_loaded_ = true;
+  LOG(INFO) << "Loaded skeleton manifest with " << skeleton_manifest_.size()
+            << " entries from " << skel_source_.value();
+  return skeleton_manifest_;
+}
+
 void Mount::CopySkeleton(const FilePath& destination) const {
-  RecursiveCopy(destination, FilePath(skel_source_));
+  for (const auto& entry : GetSkeletonManifest()) {
+    const FilePath destination_path =
+        destination.Append(entry.relative_path);
+    bool copied;
+    if (entry.is_directory) {
+      copied = platform_->CreateDirectory(destination_path) &&
+               platform_->SetOwnership(destination_path, default_user_,
+                                       default_group_, true);
+    } else if (entry.is_symlink) {
+      FilePath target;
+      copied = platform_->ReadLink(skel_source_.Append(entry.relative_path),
+                                   &target) &&
+               platform_->CreateSymbolicLink(destination_path, target) &&
+               platform_->SetOwnership(destination_path, default_user_,
+                                       default_group_, false);
+    } else {
+      copied = platform_->CopyFileWithOwnership(
+          skel_source_.Append(entry.relative_path), destination_path,
+          default_user_, default_group_);
+    }
+    if (!copied) {
+      LOG(ERROR) << "Couldn't copy skeleton entry with owner ("
+                 << default_user_ << ":" << default_group_ << ") to "
+                 << destination_path.value();
+    }
+  }
 }
 
 bool Mount::CacheOldFiles(const std::vector<FilePath>& files) const {
@@ -1685,41 +1757,6 @@ bool Mount::CacheOldFiles(const std::vector<FilePath>& files) const {
   return true;
 }
 
-void Mount::RecursiveCopy(const FilePath& destination,
-                          const FilePath& source) const {
-  std::unique_ptr<FileEnumerator> file_enumerator(
-      platform_->GetFileEnumerator(source, false,
-                                   base::FileEnumerator::FILES));
-  FilePath next_path;
-  while (!(next_path = file_enumerator->Next()).empty()) {
-    FilePath file_name = next_path.BaseName();
-    FilePath destination_file = destination.Append(file_name);
-    if (!platform_->Copy(next_path, destination_file) ||
-        !platform_->SetOwnership(
-            destination_file, default_user_, default_group_, true)) {
-      LOG(ERROR) << "Couldn't change owner (" << default_user_ << ":"
-                 << default_group_ << ") of destination path: "
-                 << destination_file.value();
-    }
-  }
-  std::unique_ptr<FileEnumerator> dir_enumerator(
-      platform_->GetFileEnumerator(source, false,
-                                   base::FileEnumerator::DIRECTORIES));
-  while (!(next_path = dir_enumerator->Next()).empty()) {
-    FilePath dir_name = FilePath(next_path).BaseName();
-    FilePath destination_dir = destination.Append(dir_name);
-    LOG(INFO) << "RecursiveCopy: " << destination_dir.value();
-    if (!platform_->CreateDirectory(destination_dir) ||
-        !platform_->SetOwnership(
-            destination_dir, default_user_, default_group_, true)) {
-      LOG(ERROR) << "Couldn't change owner (" << default_user_ << ":"
-                 << default_group_ << ") of destination path: "
-                 << destination_dir.value();
-    }
-    RecursiveCopy(destination_dir, FilePath(next_path));
-  }
-}
-
 bool Mount::RevertCacheFiles(const std::vector<FilePath>& files) const {
   for (const auto& file : files) {
     FilePath file_bak = file.AddExtension("bak");
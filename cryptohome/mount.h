@@ -203,6 +203,7 @@ class Mount : public base::RefCountedThreadSafe<Mount> {
   // Used to override the default skeleton directory
   void set_skel_source(const base::FilePath& value) {
     skel_source_ = value;
+    skeleton_manifest_loaded_ = false;
   }
 
   // Used to override the default Crypto handler (does not take ownership)
@@ -635,16 +636,21 @@ class Mount : public base::RefCountedThreadSafe<Mount> {
   bool SetUpEphemeralCryptohome(const base::FilePath& source_path,
                                 const base::FilePath& home_dir);
 
-  // Recursively copies directory contents to the destination if the destination
-  // file does not exist.  Sets ownership to the default_user_
-  //
-  // Parameters
-  //   destination - Where to copy files to
-  //   source - Where to copy files from
-  void RecursiveCopy(const base::FilePath& destination,
-                     const base::FilePath& source) const;
+  // An entry of the skeleton directory, relative to skel_source_.
+  struct SkeletonEntry {
+    base::FilePath relative_path;
+    bool is_directory;
+    bool is_symlink;
+  };
 
-  // Copies the skeleton directory to the user's cryptohome.
+  // Returns the contents of the skeleton directory. The directory is only
+  // walked on the first call. Directories are listed before files, and each
+  // directory before its subdirectories.
+  const std::vector<SkeletonEntry>& GetSkeletonManifest() const;
+
+  // Copies the skeleton directory to the user's cryptohome, setting ownership
+  // to the default_user_. All directories are created first, then the files
+  // are copied into them. Symbolic links are recreated, not followed.
   void CopySkeleton(const base::FilePath& destination) const;
 
   // Returns the user's salt
@@ -763,6 +769,10 @@ class Mount : public base::RefCountedThreadSafe<Mount> {
   // Where the skeleton for the user's cryptohome is copied from
   base::FilePath skel_source_;
 
+  // Cached listing of skel_source_, see GetSkeletonManifest().
+  mutable std::vector<SkeletonEntry> skeleton_manifest_;
+  mutable bool skeleton_manifest_loaded_;
+
   // Stores the global system salt
   brillo::SecureBlob system_salt_;
 
@@ -839,6 +849,7 @@ class Mount : public base::RefCountedThreadSafe<Mount> {
   FRIEND_TEST(MountTest, TwoWayKeysetMigrationTest);
   FRIEND_TEST(MountTest, BothFlagsMigrationTest);
   FRIEND_TEST(MountTest, CreateTrackedSubdirectories);
+  FRIEND_TEST(MountTest, CopySkeletonReusesManifest);
 
   DISALLOW_COPY_AND_ASSIGN(Mount);
 };
@@ -1612,6 +1612,73 @@ TEST_P(MountTest, CreateTrackedSubdirectories) {
   EXPECT_TRUE(mount_->CreateTrackedSubdirectories(up, true /* is_new */));
 }
 
+TEST_P(MountTest, CopySkeletonReusesManifest) {
+  EXPECT_TRUE(DoMountInit());
+
+  struct stat dir_stat = {0};
+  dir_stat.st_mode = S_IFDIR | 0755;
+  struct stat file_stat = {0};
+  file_stat.st_mode = S_IFREG | 0644;
+  struct stat link_stat = {0};
+  link_stat.st_mode = S_IFLNK | 0777;
+  // Enumeration order is not guaranteed; the subdirectory comes first here.
+  NiceMock<MockFileEnumerator>* enumerator =
+      new NiceMock<MockFileEnumerator>();
+  enumerator->entries_.push_back(FileEnumerator::FileInfo(
+      kSkelDir.Append("a/b"), dir_stat));
+  enumerator->entries_.push_back(FileEnumerator::FileInfo(
+      kSkelDir.Append("a/b/file"), file_stat));
+  enumerator->entries_.push_back(FileEnumerator::FileInfo(
+      kSkelDir.Append("a"), dir_stat));
+  enumerator->entries_.push_back(FileEnumerator::FileInfo(
+      kSkelDir.Append("file"), file_stat));
+  enumerator->entries_.push_back(FileEnumerator::FileInfo(
+      kSkelDir.Append("link"), link_stat));
+  // The skeleton is only walked once.
+  EXPECT_CALL(platform_, GetFileEnumerator(kSkelDir, true, _))
+    .WillOnce(Return(enumerator));
+
+  const FilePath home1("home1");
+  const FilePath home2("home2");
+  for (const FilePath& home : {home1, home2}) {
+    InSequence s;
+    EXPECT_CALL(platform_, CreateDirectory(home.Append("a")))
+      .WillOnce(Return(true));
+    EXPECT_CALL(platform_,
+                SetOwnership(home.Append("a"), chronos_uid_, chronos_gid_,
+                             true))
+      .WillOnce(Return(true));
+    EXPECT_CALL(platform_, CreateDirectory(home.Append("a/b")))
+      .WillOnce(Return(true));
+    EXPECT_CALL(platform_,
+                SetOwnership(home.Append("a/b"), chronos_uid_, chronos_gid_,
+                             true))
+      .WillOnce(Return(true));
+    EXPECT_CALL(platform_,
+                CopyFileWithOwnership(kSkelDir.Append("a/b/file"),
+                                      home.Append("a/b/file"), chronos_uid_,
+                                      chronos_gid_))
+      .WillOnce(Return(true));
+    EXPECT_CALL(platform_,
+                CopyFileWithOwnership(kSkelDir.Append("file"),
+                                      home.Append("file"), chronos_uid_,
+                                      chronos_gid_))
+      .WillOnce(Return(true));
+    // Symbolic links are recreated rather than followed.
+    EXPECT_CALL(platform_, ReadLink(kSkelDir.Append("link"), _))
+      .WillOnce(DoAll(SetArgPointee<1>(FilePath("file")), Return(true)));
+    EXPECT_CALL(platform_,
+                CreateSymbolicLink(home.Append("link"), FilePath("file")))
+      .WillOnce(Return(true));
+    EXPECT_CALL(platform_,
+                SetOwnership(home.Append("link"), chronos_uid_, chronos_gid_,
+                             false))
+      .WillOnce(Return(true));
+  }
+  mount_->CopySkeleton(home1);
+  mount_->CopySkeleton(home2);
+}
+
 TEST_P(MountTest, MountCryptohomePreviousMigrationIncomplete) {
   // Checks that if both ecryptfs and dircrypto home directories
   // exist, fails with an error.
@@ -2466,8 +2533,7 @@ TEST_P(EphemeralExistingUserSystemTest, EnterpriseMountRemoveTest) {
     .WillRepeatedly(Return(true));
   EXPECT_CALL(platform_, SetGroupAccessible(_, _, _))
     .WillRepeatedly(Return(true));
-  EXPECT_CALL(platform_, GetFileEnumerator(kSkelDir, _, _))
-    .WillOnce(Return(new NiceMock<MockFileEnumerator>()))
+  EXPECT_CALL(platform_, GetFileEnumerator(kSkelDir, true, _))
     .WillOnce(Return(new NiceMock<MockFileEnumerator>()));
 
   EXPECT_CALL(platform_, Mount(_, _, _, _))
@@ -2571,8 +2637,7 @@ TEST_P(EphemeralExistingUserSystemTest, MountRemoveTest) {
     .WillRepeatedly(Return(true));
   EXPECT_CALL(platform_, SetGroupAccessible(_, _, _))
     .WillRepeatedly(Return(true));
-  EXPECT_CALL(platform_, GetFileEnumerator(kSkelDir, _, _))
-    .WillOnce(Return(new NiceMock<MockFileEnumerator>()))
+  EXPECT_CALL(platform_, GetFileEnumerator(kSkelDir, true, _))
     .WillOnce(Return(new NiceMock<MockFileEnumerator>()));
 
   EXPECT_CALL(platform_, Mount(_, _, _, _))
@@ -2743,8 +2808,7 @@ TEST_P(EphemeralExistingUserSystemTest, NonOwnerMountEnsureEphemeralTest) {
     .WillRepeatedly(Return(true));
   EXPECT_CALL(platform_, SetGroupAccessible(_, _, _))
     .WillRepeatedly(Return(true));
-  EXPECT_CALL(platform_, GetFileEnumerator(kSkelDir, _, _))
-    .WillOnce(Return(new NiceMock<MockFileEnumerator>()))
+  EXPECT_CALL(platform_, GetFileEnumerator(kSkelDir, true, _))
     .WillOnce(Return(new NiceMock<MockFileEnumerator>()));
   EXPECT_CALL(platform_,
       FileExists(
@@ -2834,8 +2898,7 @@ TEST_P(EphemeralExistingUserSystemTest, EnterpriseMountEnsureEphemeralTest) {
     .WillRepeatedly(Return(true));
   EXPECT_CALL(platform_, SetGroupAccessible(_, _, _))
     .WillRepeatedly(Return(true));
-  EXPECT_CALL(platform_, GetFileEnumerator(kSkelDir, _, _))
-    .WillOnce(Return(new NiceMock<MockFileEnumerator>()))
+  EXPECT_CALL(platform_, GetFileEnumerator(kSkelDir, true, _))
     .WillOnce(Return(new NiceMock<MockFileEnumerator>()));
   EXPECT_CALL(platform_,
       FileExists(
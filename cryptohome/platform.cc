@@ -860,6 +860,47 @@ bool Platform::Copy(const FilePath& from, const FilePath& to) {
   return base::CopyDirectory(from, to, true);
 }
 
+bool Platform::CopyFileWithOwnership(const FilePath& from,
+                                     const FilePath& to,
+                                     uid_t user_id,
+                                     gid_t group_id) {
+  base::File from_file(from, base::File::FLAG_OPEN | base::File::FLAG_READ);
+  if (!from_file.IsValid()) {
+    LOG(ERROR) << "Failed to open " << from.value() << ": "
+               << base::File::ErrorToString(from_file.error_details());
+    return false;
+  }
+  struct stat from_stat;
+  if (fstat(from_file.GetPlatformFile(), &from_stat)) {
+    PLOG(ERROR) << "fstat() of " << from.value() << " failed.";
+    return false;
+  }
+  if (!S_ISREG(from_stat.st_mode)) {
+    LOG(ERROR) << from.value() << " is not a regular file.";
+    return false;
+  }
+  base::File to_file(to, base::File::FLAG_CREATE_ALWAYS |
+                         base::File::FLAG_WRITE);
+  if (!to_file.IsValid()) {
+    LOG(ERROR) << "Failed to create " << to.value() << ": "
+               << base::File::ErrorToString(to_file.error_details());
+    return false;
+  }
+  // If something goes wrong we want to blow away the partial copy.
+  ScopedPath scoped_to(this, to);
+
+  if (!SendFile(to_file, from_file, 0, from_stat.st_size))
+    return false;
+  if (fchown(to_file.GetPlatformFile(), user_id, group_id) ||
+      fchmod(to_file.GetPlatformFile(), from_stat.st_mode & 07777)) {
+    PLOG(ERROR) << "Setting ownership of " << to.value() << " to ("
+                << user_id << "," << group_id << ") failed.";
+    return false;
+  }
+  scoped_to.release();
+  return true;
+}
+
 bool Platform::CopyPermissionsCallback(
     const FilePath& old_base,
     const FilePath& new_base,
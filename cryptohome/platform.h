@@ -521,6 +521,20 @@ class Platform {
   virtual bool CopyWithPermissions(const base::FilePath& from,
                                    const base::FilePath& to);
 
+  // Copies the regular file |from| to |to|, keeping its permissions, and gives
+  // the copy the requested ownership. The owner is set on the open file so no
+  // second path lookup is needed.
+  //
+  // Parameters
+  //   from - regular file to copy
+  //   to - path of the copy; replaced if it already exists
+  //   user_id - owner of the copy
+  //   group_id - group of the copy
+  virtual bool CopyFileWithOwnership(const base::FilePath& from,
+                                     const base::FilePath& to,
+                                     uid_t user_id,
+                                     gid_t group_id);
+
   // Moves a given path on the filesystem
   //
   // Parameters
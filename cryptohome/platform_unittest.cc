@@ -635,4 +635,31 @@ TEST_F(PlatformTest, SendFile) {
   EXPECT_FALSE(platform_.SendFile(to_file, from_file, offset, read_size + 1));
 }
 
+TEST_F(PlatformTest, CopyFileWithOwnership) {
+  const base::FilePath from(GetTempName());
+  const base::FilePath to(GetTempName());
+  const std::string contents = "0123456789";
+  ASSERT_TRUE(platform_.WriteStringToFile(from, contents));
+  ASSERT_TRUE(platform_.SetPermissions(from, 0640));
+
+  EXPECT_TRUE(platform_.CopyFileWithOwnership(from, to, getuid(), getgid()));
+  std::string to_contents;
+  ASSERT_TRUE(platform_.ReadFileToString(to, &to_contents));
+  EXPECT_EQ(contents, to_contents);
+  mode_t mode = 0;
+  ASSERT_TRUE(platform_.GetPermissions(to, &mode));
+  EXPECT_EQ(0640, mode & 07777);
+
+  // Directories and missing files cannot be copied.
+  base::FilePath temp_directory;
+  ASSERT_TRUE(base::GetTempDir(&temp_directory));
+  EXPECT_FALSE(platform_.CopyFileWithOwnership(temp_directory, GetTempName(),
+                                               getuid(), getgid()));
+  EXPECT_FALSE(platform_.CopyFileWithOwnership(GetTempName(), GetTempName(),
+                                               getuid(), getgid()));
+
+  platform_.DeleteFile(from, false /* recursive */);
+  platform_.DeleteFile(to, false /* recursive */);
+}
+
 }  // namespace cryptohome
@@ -6,9 +6,11 @@
 
 #include <fcntl.h>
 
+#include <map>
 #include <utility>
 
 #include <base/files/file_path.h>
+#include <base/files/file_util.h>
 #include <base/files/scoped_file.h>
 #include <base/posix/eintr_wrapper.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
@@ -25,6 +27,12 @@ namespace mist {
 namespace {
 
 const char kDefaultConfigFile[] = "/usr/share/mist/default.conf";
+const char kDefaultCompiledConfigFile[] = "/usr/share/mist/default.pbf";
+const char kCompiledConfigFileExtension[] = ".pbf";
+
+uint32_t GetUsbIdKey(uint16_t vendor_id, uint16_t product_id) {
+  return (static_cast<uint32_t>(vendor_id) << 16) | product_id;
+}
 
 }  // namespace
 
@@ -33,7 +41,8 @@ ConfigLoader::ConfigLoader() {}
 ConfigLoader::~ConfigLoader() {}
 
 bool ConfigLoader::LoadDefaultConfig() {
-  return LoadConfig(FilePath(kDefaultConfigFile));
+  return LoadPreferredConfig(FilePath(kDefaultCompiledConfigFile),
+                             FilePath(kDefaultConfigFile));
 }
 
 bool ConfigLoader::LoadConfig(const FilePath& file_path) {
@@ -48,29 +57,50 @@ bool ConfigLoader::LoadConfig(const FilePath& file_path) {
   google::protobuf::io::FileInputStream file_stream(fd);
 
   unique_ptr<Config> config(new Config());
-  if (!google::protobuf::TextFormat::Parse(&file_stream, config.get())) {
+  bool parsed = file_path.MatchesExtension(kCompiledConfigFileExtension)
+                    ? config->ParseFromZeroCopyStream(&file_stream)
+                    : google::protobuf::TextFormat::Parse(&file_stream,
+                                                          config.get());
+  if (!parsed) {
     LOG(ERROR) << "Could not parse config file '" << file_path.MaybeAsASCII()
                << "'";
     return false;
   }
 
+  // A USB modem listed more than once is matched by its first entry.
+  std::map<uint32_t, const UsbModemInfo*> usb_modem_info_index;
+  for (const UsbModemInfo& usb_modem_info : config->usb_modem_info()) {
+    const UsbId& usb_id = usb_modem_info.initial_usb_id();
+    usb_modem_info_index.emplace(
+        GetUsbIdKey(usb_id.vendor_id(), usb_id.product_id()), &usb_modem_info);
+  }
+
   config_ = std::move(config);
+  usb_modem_info_index_.swap(usb_modem_info_index);
   return true;
 }
 
-const UsbModemInfo* ConfigLoader::GetUsbModemInfo(
-    uint16_t vendor_id, uint16_t product_id) const {
-  if (!config_)
-    return nullptr;
-
-  for (int i = 0; i < config_->usb_modem_info_size(); ++i) {
-    const UsbModemInfo& usb_modem_info = config_->usb_modem_info(i);
-    const UsbId& usb_id = usb_modem_info.initial_usb_id();
-    if (usb_id.vendor_id() == vendor_id && usb_id.product_id() == product_id)
-      return &usb_modem_info;
+bool ConfigLoader::LoadPreferredConfig(const FilePath& compiled_config_file,
+                                       const FilePath& config_file) {
+  if (base::PathExists(compiled_config_file) &&
+      LoadConfig(compiled_config_file)) {
+    // Any file, even an empty one, may parse as a config in the binary
+    // format, so a compiled config without any modem is not trusted.
+    if (config_->usb_modem_info_size() > 0)
+      return true;
+    LOG(WARNING) << "Compiled config file '"
+                 << compiled_config_file.MaybeAsASCII()
+                 << "' has no USB modem info, loading '"
+                 << config_file.MaybeAsASCII() << "' instead";
   }
 
-  return nullptr;
+  return LoadConfig(config_file);
+}
+
+const UsbModemInfo* ConfigLoader::GetUsbModemInfo(
+    uint16_t vendor_id, uint16_t product_id) const {
+  auto it = usb_modem_info_index_.find(GetUsbIdKey(vendor_id, product_id));
+  return it != usb_modem_info_index_.end() ? it->second : nullptr;
 }
 
 }  // namespace mist
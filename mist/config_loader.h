@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 
+#include <map>
 #include <memory>
 
 #include <base/files/file_path.h>
@@ -20,17 +21,23 @@ class UsbModemInfo;
 
 // A configuration file loader, which loads information about USB modems
 // supported by mist from a configuration file based on the text format of
-// protocol buffers. The protocol buffers for the configuration file are defined
-// in proto/*.proto.
+// protocol buffers, or from a compiled configuration file based on the binary
+// format of protocol buffers. The protocol buffers for the configuration file
+// are defined in proto/*.proto. The compiled configuration file is generated
+// from the default configuration file at build time, and is preferred as it is
+// much cheaper to parse.
 class ConfigLoader {
  public:
   ConfigLoader();
   virtual ~ConfigLoader();
 
-  // Loads the default configuration. Returns true on success.
+  // Loads the default configuration, from the compiled configuration file if
+  // it is available. Returns true on success.
   virtual bool LoadDefaultConfig();
 
-  // Loads a configuration from |config_file|. Returns true on success.
+  // Loads a configuration from |config_file|, which is expected to be in the
+  // binary format if its extension is ".pbf", or in the text format otherwise.
+  // Returns true on success.
   virtual bool LoadConfig(const base::FilePath& config_file);
 
   // Returns the info of the USB modem with its vendor ID equal to |vendor_id|
@@ -43,13 +50,24 @@ class ConfigLoader {
 
  private:
   FRIEND_TEST(ConfigLoaderTest, GetUsbModemInfo);
+  FRIEND_TEST(ConfigLoaderTest, LoadCompiledConfigFile);
+  FRIEND_TEST(ConfigLoaderTest, LoadPreferredConfig);
   FRIEND_TEST(ConfigLoaderTest, LoadEmptyConfigFile);
   FRIEND_TEST(ConfigLoaderTest, LoadInvalidConfigFile);
   FRIEND_TEST(ConfigLoaderTest, LoadNonExistentConfigFile);
   FRIEND_TEST(ConfigLoaderTest, LoadValidConfigFile);
 
+  // Loads |compiled_config_file| if it exists and lists at least one USB
+  // modem, or |config_file| otherwise. Returns true on success.
+  bool LoadPreferredConfig(const base::FilePath& compiled_config_file,
+                           const base::FilePath& config_file);
+
   std::unique_ptr<Config> config_;
 
+  // Maps the vendor ID (upper 16 bits) and product ID (lower 16 bits) of the
+  // initial USB ID of each USB modem to its info in |config_|.
+  std::map<uint32_t, const UsbModemInfo*> usb_modem_info_index_;
+
   DISALLOW_COPY_AND_ASSIGN(ConfigLoader);
 };
 
@@ -9,6 +9,7 @@
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
 #include <base/files/scoped_temp_dir.h>
+#include <google/protobuf/text_format.h>
 #include <gtest/gtest.h>
 
 #include "mist/proto_bindings/config.pb.h"
@@ -105,6 +106,75 @@ TEST_F(ConfigLoaderTest, GetUsbModemInfo) {
   EXPECT_EQ(2500, usb_modem_info2->initial_delay_ms());
 }
 
+TEST_F(ConfigLoaderTest, LoadCompiledConfigFile) {
+  Config test_config;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(
+      kTestConfigFileContent, &test_config));
+  string compiled_config;
+  ASSERT_TRUE(test_config.SerializeToString(&compiled_config));
+
+  ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  FilePath config_file = temp_dir_.path().Append("config.pbf");
+  ASSERT_EQ(static_cast<int>(compiled_config.size()),
+            base::WriteFile(config_file, compiled_config.data(),
+                            compiled_config.size()));
+
+  EXPECT_TRUE(config_loader_.LoadConfig(config_file));
+  Config* config = config_loader_.config_.get();
+  EXPECT_NE(nullptr, config);
+  EXPECT_EQ(2, config->usb_modem_info_size());
+
+  const UsbModemInfo* usb_modem_info =
+      config_loader_.GetUsbModemInfo(0x1234, 0xabcd);
+  EXPECT_NE(nullptr, usb_modem_info);
+  EXPECT_EQ(3, usb_modem_info->usb_message_size());
+  EXPECT_EQ(2500, usb_modem_info->initial_delay_ms());
+  EXPECT_EQ(nullptr, config_loader_.GetUsbModemInfo(0x1234, 0x7890));
+
+  // A failed load keeps the previously loaded config.
+  const char kInvalidConfig[] = "<invalid config>";
+  ASSERT_EQ(static_cast<int>(arraysize(kInvalidConfig) - 1),
+            base::WriteFile(config_file, kInvalidConfig,
+                            arraysize(kInvalidConfig) - 1));
+  EXPECT_FALSE(config_loader_.LoadConfig(config_file));
+  EXPECT_EQ(config, config_loader_.config_.get());
+}
+
+TEST_F(ConfigLoaderTest, LoadPreferredConfig) {
+  ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  FilePath config_file;
+  ASSERT_TRUE(CreateConfigFileInDir(kTestConfigFileContent, temp_dir_.path(),
+                                    &config_file));
+  FilePath compiled_config_file = temp_dir_.path().Append("config.pbf");
+
+  // Without a compiled config, the text config is loaded.
+  EXPECT_TRUE(
+      config_loader_.LoadPreferredConfig(compiled_config_file, config_file));
+  EXPECT_EQ(2, config_loader_.config_->usb_modem_info_size());
+
+  // A compiled config is preferred when it lists USB modems.
+  Config compiled_config;
+  UsbId* usb_id =
+      compiled_config.add_usb_modem_info()->mutable_initial_usb_id();
+  usb_id->set_vendor_id(0x4321);
+  usb_id->set_product_id(0x8765);
+  string compiled_data;
+  ASSERT_TRUE(compiled_config.SerializeToString(&compiled_data));
+  ASSERT_EQ(static_cast<int>(compiled_data.size()),
+            base::WriteFile(compiled_config_file, compiled_data.data(),
+                            compiled_data.size()));
+  EXPECT_TRUE(
+      config_loader_.LoadPreferredConfig(compiled_config_file, config_file));
+  EXPECT_EQ(1, config_loader_.config_->usb_modem_info_size());
+
+  // An empty compiled config parses, but the text config is loaded instead.
+  ASSERT_EQ(0, base::WriteFile(compiled_config_file, "", 0));
+  EXPECT_TRUE(
+      config_loader_.LoadPreferredConfig(compiled_config_file, config_file));
+  EXPECT_EQ(2, config_loader_.config_->usb_modem_info_size());
+  EXPECT_NE(nullptr, config_loader_.GetUsbModemInfo(0x1234, 0xabcd));
+}
+
 TEST_F(ConfigLoaderTest, LoadEmptyConfigFile) {
   base::FilePath config_file;
   ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
@@ -41,6 +41,7 @@
         'udev_list_entry.cc',
         'udev_monitor.cc',
         'usb_bulk_transfer.cc',
+        'usb_bulk_transfer_queue.cc',
         'usb_config_descriptor.cc',
         'usb_constants.cc',
         'usb_device.cc',
@@ -58,10 +59,47 @@
         'usb_transfer.cc',
       ],
     },
+    {
+      # Compiles the default config from the text format of protocol buffers
+      # into the binary format, which ConfigLoader parses much faster.
+      'target_name': 'mist-config',
+      # The text config keeps the name default.conf it is installed under, so
+      # this does what common-mk/protoctxt.gypi does for .prototxt sources.
+      'type': 'none',
+      'variables': {
+        'protoc': '<!(which protoc)',
+      },
+      'actions': [
+        {
+          'action_name': 'mist-config-encode',
+          'inputs': [
+            '<(protoc)',
+            'default.conf',
+            'proto/config.proto',
+            'proto/usb_modem_info.proto',
+          ],
+          'outputs': [
+            '<(PRODUCT_DIR)/mist-config/default.pbf',
+          ],
+          'action': [
+            '<(protoc)',
+            '--proto_path', 'proto',
+            '--encode', 'mist.Config',
+            '--protobuf_in', 'default.conf',
+            '--protobuf_out', '<(PRODUCT_DIR)/mist-config/default.pbf',
+            'proto/config.proto',
+          ],
+          'message': 'Encoding text format protobuf file default.conf.',
+        },
+      ],
+    },
     {
       'target_name': 'mist',
       'type': 'executable',
-      'dependencies': ['libmist'],
+      'dependencies': [
+        'libmist',
+        'mist-config',
+      ],
       'sources': [
         'main.cc',
       ],
@@ -86,6 +124,7 @@
             'mist.cc',
             'mock_context.cc',
             'testrunner.cc',
+            'usb_bulk_transfer_queue_unittest.cc',
             'usb_config_descriptor_unittest.cc',
             'usb_constants_unittest.cc',
             'usb_device_descriptor_unittest.cc',
@@ -0,0 +1,222 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mist/usb_bulk_transfer_queue.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <base/bind.h>
+#include <base/logging.h>
+
+#include "mist/usb_bulk_transfer.h"
+
+using base::Bind;
+using std::unique_ptr;
+using std::vector;
+
+namespace mist {
+
+UsbBulkTransferQueue::UsbBulkTransferQueue(const UsbDevice* device,
+                                           uint8_t endpoint_address,
+                                           int max_transfer_length,
+                                           size_t max_transfers_in_flight,
+                                           uint32_t timeout)
+    : device_(device),
+      endpoint_address_(endpoint_address),
+      direction_(GetUsbDirectionOfEndpointAddress(endpoint_address)),
+      max_transfer_length_(max_transfer_length),
+      max_transfers_in_flight_(max_transfers_in_flight),
+      timeout_(timeout) {
+  CHECK_GT(max_transfer_length_, 0);
+  CHECK_GT(max_transfers_in_flight_, 0u);
+}
+
+UsbBulkTransferQueue::~UsbBulkTransferQueue() {
+  pending_requests_.clear();
+  for (auto& transfer_in_flight : transfers_in_flight_) {
+    UsbTransfer* transfer = transfer_in_flight.transfer.get();
+    if (transfer->state() == UsbTransfer::kInProgress)
+      CancelTransfer(transfer);
+
+    // As in UsbModemSwitchOperation, a transfer that is still in progress or
+    // being cancelled must survive until libusb invokes its callback, which
+    // cannot be withdrawn. The transfer is intentionally leaked; its callback
+    // holds a weak pointer to this object and does nothing.
+    if (transfer->state() != UsbTransfer::kIdle)
+      ignore_result(transfer_in_flight.transfer.release());
+  }
+}
+
+bool UsbBulkTransferQueue::Enqueue(
+    const vector<Segment>& segments,
+    const CompletionCallback& completion_callback) {
+  CHECK(!completion_callback.is_null());
+
+  int length = 0;
+  for (const auto& segment : segments) {
+    if (!segment.data || segment.length < 0 ||
+        segment.length > max_transfer_length_ - length) {
+      error_.set_type(UsbError::kErrorInvalidParameter);
+      return false;
+    }
+    length += segment.length;
+  }
+  if (length == 0) {
+    error_.set_type(UsbError::kErrorInvalidParameter);
+    return false;
+  }
+
+  pending_requests_.push_back({segments, length, completion_callback});
+  SubmitPendingRequests();
+  return true;
+}
+
+void UsbBulkTransferQueue::CancelAll() {
+  std::deque<Request> dropped_requests;
+  dropped_requests.swap(pending_requests_);
+
+  for (const auto& transfer_in_flight : transfers_in_flight_) {
+    UsbTransfer* transfer = transfer_in_flight.transfer.get();
+    if (!CancelTransfer(transfer)) {
+      LOG(WARNING) << "Could not cancel USB bulk transfer: "
+                   << transfer->error();
+    }
+  }
+
+  // The completion callbacks may destroy this object, so only local state is
+  // used from here on.
+  Result result = {kUsbTransferStatusCancelled, 0, base::TimeDelta()};
+  for (const auto& request : dropped_requests)
+    request.completion_callback.Run(result);
+}
+
+unique_ptr<UsbTransfer> UsbBulkTransferQueue::CreateTransfer() {
+  CHECK(device_);
+
+  unique_ptr<UsbBulkTransfer> transfer(new UsbBulkTransfer());
+  if (!transfer->Initialize(*device_,
+                            endpoint_address_,
+                            max_transfer_length_,
+                            timeout_)) {
+    LOG(ERROR) << "Could not create USB bulk transfer: " << transfer->error();
+    error_.set_type(transfer->error().type());
+    return nullptr;
+  }
+  return std::move(transfer);
+}
+
+bool UsbBulkTransferQueue::SubmitTransfer(
+    UsbTransfer* transfer,
+    const UsbTransfer::CompletionCallback& completion_callback) {
+  return transfer->Submit(completion_callback);
+}
+
+bool UsbBulkTransferQueue::CancelTransfer(UsbTransfer* transfer) {
+  return transfer->Cancel();
+}
+
+base::TimeTicks UsbBulkTransferQueue::Now() const {
+  return base::TimeTicks::Now();
+}
+
+void UsbBulkTransferQueue::SubmitPendingRequests() {
+  base::WeakPtr<UsbBulkTransferQueue> self = AsWeakPtr();
+  while (!pending_requests_.empty() &&
+         transfers_in_flight_.size() < max_transfers_in_flight_) {
+    Request request = std::move(pending_requests_.front());
+    pending_requests_.pop_front();
+
+    // Reuse the buffer of a completed transfer if there is one.
+    unique_ptr<UsbTransfer> transfer;
+    if (!idle_transfers_.empty()) {
+      transfer = std::move(idle_transfers_.back());
+      idle_transfers_.pop_back();
+    } else {
+      transfer = CreateTransfer();
+    }
+
+    base::TimeTicks submit_time = Now();
+    if (transfer && SubmitRequest(transfer.get(), request)) {
+      transfers_in_flight_.push_back(
+          {std::move(transfer), std::move(request), submit_time});
+      continue;
+    }
+
+    if (transfer)
+      idle_transfers_.push_back(std::move(transfer));
+    LOG(ERROR) << "Could not submit USB bulk transfer: " << error_;
+    request.completion_callback.Run(
+        {kUsbTransferStatusError, 0, base::TimeDelta()});
+    if (!self)
+      return;
+  }
+}
+
+bool UsbBulkTransferQueue::SubmitRequest(UsbTransfer* transfer,
+                                         const Request& request) {
+  if (!transfer->SetLength(request.length)) {
+    error_.set_type(transfer->error().type());
+    return false;
+  }
+
+  if (direction_ == kUsbDirectionOut) {
+    uint8_t* data = transfer->buffer();
+    for (const auto& segment : request.segments) {
+      memcpy(data, segment.data, segment.length);
+      data += segment.length;
+    }
+  }
+
+  if (!SubmitTransfer(
+          transfer,
+          Bind(&UsbBulkTransferQueue::OnTransferCompleted, AsWeakPtr()))) {
+    error_.set_type(transfer->error().type());
+    return false;
+  }
+  return true;
+}
+
+void UsbBulkTransferQueue::OnTransferCompleted(UsbTransfer* transfer) {
+  auto transfer_in_flight = std::find_if(
+      transfers_in_flight_.begin(),
+      transfers_in_flight_.end(),
+      [transfer](const TransferInFlight& candidate) {
+        return candidate.transfer.get() == transfer;
+      });
+  CHECK(transfer_in_flight != transfers_in_flight_.end());
+
+  Result result;
+  result.status = transfer->GetStatus();
+  result.actual_length = transfer->GetActualLength();
+  result.latency = Now() - transfer_in_flight->submit_time;
+  VLOG(1) << "USB bulk transfer completed in "
+          << result.latency.InMicroseconds() << " us: " << *transfer;
+
+  Request request = std::move(transfer_in_flight->request);
+  if (direction_ == kUsbDirectionIn) {
+    const uint8_t* data = transfer->buffer();
+    int remaining = result.actual_length;
+    for (const auto& segment : request.segments) {
+      if (remaining <= 0)
+        break;
+      int length = std::min(segment.length, remaining);
+      memcpy(segment.data, data, length);
+      data += length;
+      remaining -= length;
+    }
+  }
+
+  idle_transfers_.push_back(std::move(transfer_in_flight->transfer));
+  transfers_in_flight_.erase(transfer_in_flight);
+
+  base::WeakPtr<UsbBulkTransferQueue> self = AsWeakPtr();
+  request.completion_callback.Run(result);
+  if (self)
+    SubmitPendingRequests();
+}
+
+}  // namespace mist
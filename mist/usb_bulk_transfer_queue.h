@@ -0,0 +1,157 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MIST_USB_BULK_TRANSFER_QUEUE_H_
+#define MIST_USB_BULK_TRANSFER_QUEUE_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include <base/callback.h>
+#include <base/macros.h>
+#include <base/memory/weak_ptr.h>
+#include <base/time/time.h>
+
+#include "mist/usb_constants.h"
+#include "mist/usb_error.h"
+#include "mist/usb_transfer.h"
+
+namespace mist {
+
+class UsbDevice;
+
+// A queue of USB bulk transfers on one endpoint of a device, which keeps up to
+// a given number of transfers submitted at the same time. Unlike a single
+// UsbBulkTransfer, which has to complete before it is submitted again, the
+// queue lets the host controller start the next transfer as soon as the
+// previous one completes, without waiting for a round trip through the
+// completion callback.
+//
+// Each request is made of one or more memory segments: the data of a
+// host-to-device request is gathered from its segments into one transfer, and
+// the data received by a device-to-host request is scattered across its
+// segments. Requests are submitted, and complete, in the order they are
+// enqueued.
+class UsbBulkTransferQueue
+    : public base::SupportsWeakPtr<UsbBulkTransferQueue> {
+ public:
+  // A memory segment of a request.
+  struct Segment {
+    uint8_t* data;
+    int length;
+  };
+
+  // The outcome of a request.
+  struct Result {
+    UsbTransferStatus status;
+    // Number of bytes actually transferred.
+    int actual_length;
+    // Time from the submission of the transfer to its completion.
+    base::TimeDelta latency;
+  };
+
+  using CompletionCallback = base::Callback<void(const Result& result)>;
+
+  // Constructs a queue for the bulk endpoint at |endpoint_address| of
+  // |device|, which is not owned and must remain open while this object
+  // exists. Each request transfers at most |max_transfer_length| bytes, up to
+  // |max_transfers_in_flight| requests are submitted at a time, and each
+  // transfer times out after |timeout| milliseconds.
+  UsbBulkTransferQueue(const UsbDevice* device,
+                       uint8_t endpoint_address,
+                       int max_transfer_length,
+                       size_t max_transfers_in_flight,
+                       uint32_t timeout);
+
+  // Drops pending requests without invoking their completion callbacks, and
+  // cancels the transfers in flight.
+  virtual ~UsbBulkTransferQueue();
+
+  // Enqueues a request to transfer the data of |segments|, which must remain
+  // valid until |completion_callback| is invoked. Returns true on success. If
+  // the request is empty or longer than the maximum transfer length, sets
+  // |error_| to UsbError::kErrorInvalidParameter and returns false. If the
+  // transfer of the request cannot be submitted, |completion_callback| is
+  // invoked with kUsbTransferStatusError, possibly before this method returns.
+  bool Enqueue(const std::vector<Segment>& segments,
+               const CompletionCallback& completion_callback);
+
+  // Invokes the completion callbacks of the requests that are not submitted
+  // yet with kUsbTransferStatusCancelled, and cancels the transfers in flight.
+  // The completion callbacks of cancelled transfers are invoked once libusb
+  // reports their cancellation.
+  void CancelAll();
+
+  uint8_t endpoint_address() const { return endpoint_address_; }
+  size_t num_pending_requests() const { return pending_requests_.size(); }
+  size_t num_transfers_in_flight() const { return transfers_in_flight_.size(); }
+  const UsbError& error() const { return error_; }
+
+ protected:
+  // Creates a transfer, with a buffer of |max_transfer_length_| bytes, for the
+  // endpoint of this queue. Returns nullptr on failure.
+  virtual std::unique_ptr<UsbTransfer> CreateTransfer();
+
+  // Submits |transfer|, which invokes |completion_callback| upon completion.
+  // Returns true on success.
+  virtual bool SubmitTransfer(
+      UsbTransfer* transfer,
+      const UsbTransfer::CompletionCallback& completion_callback);
+
+  // Cancels |transfer|, which has been submitted. Returns true on success.
+  virtual bool CancelTransfer(UsbTransfer* transfer);
+
+  // Returns the current time, from which the latency of requests is measured.
+  virtual base::TimeTicks Now() const;
+
+  int max_transfer_length() const { return max_transfer_length_; }
+
+ private:
+  struct Request {
+    std::vector<Segment> segments;
+    int length;
+    CompletionCallback completion_callback;
+  };
+
+  struct TransferInFlight {
+    std::unique_ptr<UsbTransfer> transfer;
+    Request request;
+    base::TimeTicks submit_time;
+  };
+
+  // Submits pending requests until |max_transfers_in_flight_| transfers are
+  // in flight. Fails the requests that cannot be submitted.
+  void SubmitPendingRequests();
+
+  // Prepares |transfer| for |request|, and submits it. Returns true on
+  // success.
+  bool SubmitRequest(UsbTransfer* transfer, const Request& request);
+
+  // Called upon the completion of |transfer|.
+  void OnTransferCompleted(UsbTransfer* transfer);
+
+  const UsbDevice* const device_;
+  const uint8_t endpoint_address_;
+  const UsbDirection direction_;
+  const int max_transfer_length_;
+  const size_t max_transfers_in_flight_;
+  const uint32_t timeout_;
+
+  std::deque<Request> pending_requests_;
+  // Transfers in the order they were submitted.
+  std::list<TransferInFlight> transfers_in_flight_;
+  // Transfers kept for reuse by later requests.
+  std::vector<std::unique_ptr<UsbTransfer>> idle_transfers_;
+  UsbError error_;
+
+  DISALLOW_COPY_AND_ASSIGN(UsbBulkTransferQueue);
+};
+
+}  // namespace mist
+
+#endif  // MIST_USB_BULK_TRANSFER_QUEUE_H_
@@ -0,0 +1,302 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mist/usb_bulk_transfer_queue.h"
+
+#include <string.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/bind.h>
+#include <base/logging.h>
+#include <base/time/time.h>
+#include <gtest/gtest.h>
+#include <libusb.h>
+
+using base::Bind;
+using base::Unretained;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace mist {
+
+namespace {
+
+const uint8_t kOutEndpointAddress = 0x02;
+const uint8_t kInEndpointAddress = 0x81;
+const int kMaxTransferLength = 16;
+const size_t kMaxTransfersInFlight = 3;
+
+// A bulk transfer that is never handed to libusb. Its outcome is set by the
+// test instead.
+class FakeUsbTransfer : public UsbTransfer {
+ public:
+  FakeUsbTransfer(uint8_t endpoint_address, int length) {
+    CHECK(Allocate(0));
+    CHECK(AllocateBuffer(length));
+    transfer()->endpoint = endpoint_address;
+    transfer()->type = LIBUSB_TRANSFER_TYPE_BULK;
+    transfer()->length = length;
+  }
+
+  void SetResult(libusb_transfer_status status, int actual_length) {
+    transfer()->status = status;
+    transfer()->actual_length = actual_length;
+  }
+
+  void SetError(UsbError::Type type) { mutable_error()->set_type(type); }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FakeUsbTransfer);
+};
+
+// A queue whose transfers are submitted to the test rather than to libusb.
+class FakeUsbBulkTransferQueue : public UsbBulkTransferQueue {
+ public:
+  explicit FakeUsbBulkTransferQueue(uint8_t endpoint_address)
+      : UsbBulkTransferQueue(nullptr,
+                             endpoint_address,
+                             kMaxTransferLength,
+                             kMaxTransfersInFlight,
+                             0) {}
+  ~FakeUsbBulkTransferQueue() override = default;
+
+  // Completes the oldest submitted transfer as libusb would, with
+  // |actual_length| bytes of |data| received if it is not null.
+  void CompleteNextTransfer(libusb_transfer_status status,
+                            int actual_length,
+                            const char* data) {
+    ASSERT_FALSE(submitted_transfers_.empty());
+    SubmittedTransfer submitted = submitted_transfers_.front();
+    submitted_transfers_.pop_front();
+    if (data)
+      memcpy(submitted.transfer->buffer(), data, actual_length);
+    submitted.transfer->SetResult(status, actual_length);
+    submitted.completion_callback.Run(submitted.transfer);
+  }
+
+  // Returns the data of the |index|-th oldest submitted transfer.
+  string GetSubmittedData(size_t index) const {
+    UsbTransfer* transfer = submitted_transfers_.at(index).transfer;
+    return string(reinterpret_cast<const char*>(transfer->buffer()),
+                  transfer->GetLength());
+  }
+
+  size_t num_submitted_transfers() const { return submitted_transfers_.size(); }
+  int num_created_transfers() const { return num_created_transfers_; }
+  int num_cancelled_transfers() const { return num_cancelled_transfers_; }
+  void set_fail_submission(bool fail_submission) {
+    fail_submission_ = fail_submission;
+  }
+  void AdvanceTime(base::TimeDelta delta) { now_ += delta; }
+
+ protected:
+  unique_ptr<UsbTransfer> CreateTransfer() override {
+    num_created_transfers_++;
+    return unique_ptr<UsbTransfer>(
+        new FakeUsbTransfer(endpoint_address(), max_transfer_length()));
+  }
+
+  bool SubmitTransfer(
+      UsbTransfer* transfer,
+      const UsbTransfer::CompletionCallback& completion_callback) override {
+    FakeUsbTransfer* fake_transfer = static_cast<FakeUsbTransfer*>(transfer);
+    if (fail_submission_) {
+      fake_transfer->SetError(UsbError::kErrorNoDevice);
+      return false;
+    }
+    submitted_transfers_.push_back({fake_transfer, completion_callback});
+    return true;
+  }
+
+  bool CancelTransfer(UsbTransfer* transfer) override {
+    num_cancelled_transfers_++;
+    return true;
+  }
+
+  base::TimeTicks Now() const override { return now_; }
+
+ private:
+  struct SubmittedTransfer {
+    FakeUsbTransfer* transfer;
+    UsbTransfer::CompletionCallback completion_callback;
+  };
+
+  std::deque<SubmittedTransfer> submitted_transfers_;
+  int num_created_transfers_ = 0;
+  int num_cancelled_transfers_ = 0;
+  bool fail_submission_ = false;
+  base::TimeTicks now_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeUsbBulkTransferQueue);
+};
+
+}  // namespace
+
+class UsbBulkTransferQueueTest : public testing::Test {
+ protected:
+  struct CompletedRequest {
+    int id;
+    UsbBulkTransferQueue::Result result;
+  };
+
+  void OnRequestCompleted(int id, const UsbBulkTransferQueue::Result& result) {
+    completed_requests_.push_back({id, result});
+  }
+
+  UsbBulkTransferQueue::CompletionCallback MakeCallback(int id) {
+    return Bind(&UsbBulkTransferQueueTest::OnRequestCompleted,
+                Unretained(this),
+                id);
+  }
+
+  // Returns a request made of the single segment |data|.
+  vector<UsbBulkTransferQueue::Segment> MakeSegments(string* data) {
+    return {{reinterpret_cast<uint8_t*>(&(*data)[0]),
+             static_cast<int>(data->size())}};
+  }
+
+  vector<CompletedRequest> completed_requests_;
+};
+
+TEST_F(UsbBulkTransferQueueTest, KeepsTransfersInFlight) {
+  FakeUsbBulkTransferQueue queue(kOutEndpointAddress);
+  vector<string> messages;
+  for (int i = 0; i < 5; i++)
+    messages.push_back("message" + std::to_string(i));
+  for (int i = 0; i < 5; i++)
+    EXPECT_TRUE(queue.Enqueue(MakeSegments(&messages[i]), MakeCallback(i)));
+
+  EXPECT_EQ(kMaxTransfersInFlight, queue.num_transfers_in_flight());
+  EXPECT_EQ(2u, queue.num_pending_requests());
+  ASSERT_EQ(kMaxTransfersInFlight, queue.num_submitted_transfers());
+  EXPECT_EQ("message0", queue.GetSubmittedData(0));
+  EXPECT_EQ("message2", queue.GetSubmittedData(2));
+
+  // Each completion lets the next request in.
+  queue.CompleteNextTransfer(LIBUSB_TRANSFER_COMPLETED, 8, nullptr);
+  EXPECT_EQ(kMaxTransfersInFlight, queue.num_transfers_in_flight());
+  EXPECT_EQ(1u, queue.num_pending_requests());
+  EXPECT_EQ("message3", queue.GetSubmittedData(2));
+
+  for (int i = 1; i < 5; i++)
+    queue.CompleteNextTransfer(LIBUSB_TRANSFER_COMPLETED, 8, nullptr);
+  EXPECT_EQ(0u, queue.num_transfers_in_flight());
+  EXPECT_EQ(0u, queue.num_pending_requests());
+
+  // Requests complete in order, and transfers are reused.
+  ASSERT_EQ(5u, completed_requests_.size());
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(i, completed_requests_[i].id);
+    EXPECT_EQ(kUsbTransferStatusCompleted,
+              completed_requests_[i].result.status);
+    EXPECT_EQ(8, completed_requests_[i].result.actual_length);
+  }
+  EXPECT_EQ(static_cast<int>(kMaxTransfersInFlight),
+            queue.num_created_transfers());
+}
+
+TEST_F(UsbBulkTransferQueueTest, GathersOutputSegments) {
+  FakeUsbBulkTransferQueue queue(kOutEndpointAddress);
+  uint8_t header[] = {'a', 'b', 'c'};
+  uint8_t payload[] = {'d', 'e'};
+  EXPECT_TRUE(queue.Enqueue({{header, 3}, {payload, 0}, {payload, 2}},
+                            MakeCallback(0)));
+  ASSERT_EQ(1u, queue.num_submitted_transfers());
+  EXPECT_EQ("abcde", queue.GetSubmittedData(0));
+}
+
+TEST_F(UsbBulkTransferQueueTest, ScattersInputData) {
+  FakeUsbBulkTransferQueue queue(kInEndpointAddress);
+  char first[] = "...";
+  char second[] = "....";
+  EXPECT_TRUE(queue.Enqueue({{reinterpret_cast<uint8_t*>(first), 3},
+                             {reinterpret_cast<uint8_t*>(second), 4}},
+                            MakeCallback(0)));
+  queue.CompleteNextTransfer(LIBUSB_TRANSFER_COMPLETED, 5, "hello");
+
+  EXPECT_STREQ("hel", first);
+  EXPECT_STREQ("lo..", second);
+  ASSERT_EQ(1u, completed_requests_.size());
+  EXPECT_EQ(5, completed_requests_[0].result.actual_length);
+}
+
+TEST_F(UsbBulkTransferQueueTest, ReportsLatency) {
+  FakeUsbBulkTransferQueue queue(kOutEndpointAddress);
+  string message = "message";
+  EXPECT_TRUE(queue.Enqueue(MakeSegments(&message), MakeCallback(0)));
+  queue.AdvanceTime(base::TimeDelta::FromMilliseconds(20));
+  queue.CompleteNextTransfer(LIBUSB_TRANSFER_TIMED_OUT, 0, nullptr);
+
+  ASSERT_EQ(1u, completed_requests_.size());
+  EXPECT_EQ(kUsbTransferStatusTimedOut, completed_requests_[0].result.status);
+  EXPECT_EQ(20, completed_requests_[0].result.latency.InMilliseconds());
+}
+
+TEST_F(UsbBulkTransferQueueTest, RejectsInvalidRequests) {
+  FakeUsbBulkTransferQueue queue(kOutEndpointAddress);
+  uint8_t data[kMaxTransferLength + 1] = {};
+
+  EXPECT_FALSE(queue.Enqueue({}, MakeCallback(0)));
+  EXPECT_EQ(UsbError::kErrorInvalidParameter, queue.error().type());
+  EXPECT_FALSE(queue.Enqueue({{data, 0}}, MakeCallback(0)));
+  EXPECT_FALSE(queue.Enqueue({{nullptr, 1}}, MakeCallback(0)));
+  EXPECT_FALSE(queue.Enqueue({{data, -1}}, MakeCallback(0)));
+  EXPECT_FALSE(
+      queue.Enqueue({{data, kMaxTransferLength + 1}}, MakeCallback(0)));
+  EXPECT_FALSE(
+      queue.Enqueue({{data, kMaxTransferLength}, {data, 1}}, MakeCallback(0)));
+  EXPECT_EQ(0u, queue.num_pending_requests());
+
+  EXPECT_TRUE(queue.Enqueue({{data, kMaxTransferLength}}, MakeCallback(0)));
+  EXPECT_EQ(1u, queue.num_submitted_transfers());
+}
+
+TEST_F(UsbBulkTransferQueueTest, FailsRequestsThatCannotBeSubmitted) {
+  FakeUsbBulkTransferQueue queue(kOutEndpointAddress);
+  string message = "message";
+  queue.set_fail_submission(true);
+  EXPECT_TRUE(queue.Enqueue(MakeSegments(&message), MakeCallback(0)));
+
+  ASSERT_EQ(1u, completed_requests_.size());
+  EXPECT_EQ(kUsbTransferStatusError, completed_requests_[0].result.status);
+  EXPECT_EQ(UsbError::kErrorNoDevice, queue.error().type());
+  EXPECT_EQ(0u, queue.num_transfers_in_flight());
+
+  // The transfer is reused once submissions succeed again.
+  queue.set_fail_submission(false);
+  EXPECT_TRUE(queue.Enqueue(MakeSegments(&message), MakeCallback(1)));
+  EXPECT_EQ(1u, queue.num_transfers_in_flight());
+  EXPECT_EQ(1, queue.num_created_transfers());
+}
+
+TEST_F(UsbBulkTransferQueueTest, CancelAll) {
+  FakeUsbBulkTransferQueue queue(kOutEndpointAddress);
+  vector<string> messages(5, "message");
+  for (int i = 0; i < 5; i++)
+    EXPECT_TRUE(queue.Enqueue(MakeSegments(&messages[i]), MakeCallback(i)));
+
+  queue.CancelAll();
+  EXPECT_EQ(static_cast<int>(kMaxTransfersInFlight),
+            queue.num_cancelled_transfers());
+  EXPECT_EQ(0u, queue.num_pending_requests());
+  ASSERT_EQ(2u, completed_requests_.size());
+  EXPECT_EQ(3, completed_requests_[0].id);
+  EXPECT_EQ(kUsbTransferStatusCancelled, completed_requests_[0].result.status);
+  EXPECT_EQ(4, completed_requests_[1].id);
+
+  // Transfers in flight complete once libusb reports their cancellation.
+  for (size_t i = 0; i < kMaxTransfersInFlight; i++)
+    queue.CompleteNextTransfer(LIBUSB_TRANSFER_CANCELLED, 0, nullptr);
+  ASSERT_EQ(5u, completed_requests_.size());
+  EXPECT_EQ(0, completed_requests_[2].id);
+  EXPECT_EQ(kUsbTransferStatusCancelled, completed_requests_[2].result.status);
+  EXPECT_EQ(0u, queue.num_transfers_in_flight());
+}
+
+}  // namespace mist
@@ -120,6 +120,24 @@ bool UsbTransfer::IsCompletedWithExpectedLength(int expected_length) const {
          GetActualLength() == expected_length;
 }
 
+bool UsbTransfer::SetLength(int length) {
+  if (!VerifyAllocated())
+    return false;
+
+  if (state_ != kIdle) {
+    error_.set_type(UsbError::kErrorTransferAlreadySubmitted);
+    return false;
+  }
+
+  if (length < 0 || length > buffer_length_) {
+    error_.set_type(UsbError::kErrorInvalidParameter);
+    return false;
+  }
+
+  transfer_->length = length;
+  return true;
+}
+
 string UsbTransfer::ToString() const {
   if (!transfer_)
     return "Transfer (not allocated)";
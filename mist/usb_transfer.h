@@ -69,6 +69,16 @@ class UsbTransfer {
   // returns |expected_length|.
   bool IsCompletedWithExpectedLength(int expected_length) const;
 
+  // Sets the number of bytes to transfer, which may be less than the size of
+  // the transfer buffer, before this transfer is submitted. Returns true on
+  // success. If the underlying libusb_transfer struct is not allocated, sets
+  // |error_| to UsbError::kErrorTransferNotAllocated and returns false. If this
+  // transfer is in progress, sets |error_| to
+  // UsbError::kErrorTransferAlreadySubmitted and returns false. If |length| is
+  // negative or larger than buffer_length(), sets |error_| to
+  // UsbError::kErrorInvalidParameter and returns false.
+  bool SetLength(int length);
+
   // Returns a string describing the properties of this object for logging
   // purpose.
   std::string ToString() const;
@@ -115,6 +125,7 @@ class UsbTransfer {
   FRIEND_TEST(UsbTransferTest, AllocateBufferAfterSubmit);
   FRIEND_TEST(UsbTransferTest, FreeBeforeAllocate);
   FRIEND_TEST(UsbTransferTest, GetType);
+  FRIEND_TEST(UsbTransferTest, SetLength);
   FRIEND_TEST(UsbTransferTest, VerifyAllocated);
 
   libusb_transfer* transfer_;
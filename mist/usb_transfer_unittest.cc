@@ -201,6 +201,34 @@ TEST_F(UsbTransferTest, SubmitBeforeComplete) {
   EXPECT_EQ(UsbError::kErrorTransferAlreadySubmitted, transfer_.error().type());
 }
 
+TEST_F(UsbTransferTest, SetLengthBeforeAllocate) {
+  EXPECT_FALSE(transfer_.SetLength(0));
+  EXPECT_EQ(UsbError::kErrorTransferNotAllocated, transfer_.error().type());
+}
+
+TEST_F(UsbTransferTest, SetLength) {
+  InjectTestLibUsbTransfer();
+  EXPECT_TRUE(transfer_.AllocateBuffer(10));
+
+  EXPECT_TRUE(transfer_.SetLength(4));
+  EXPECT_EQ(4, transfer_.GetLength());
+  EXPECT_TRUE(transfer_.SetLength(10));
+  EXPECT_EQ(10, transfer_.GetLength());
+
+  EXPECT_FALSE(transfer_.SetLength(11));
+  EXPECT_EQ(UsbError::kErrorInvalidParameter, transfer_.error().type());
+  EXPECT_FALSE(transfer_.SetLength(-1));
+  EXPECT_EQ(UsbError::kErrorInvalidParameter, transfer_.error().type());
+  EXPECT_EQ(10, transfer_.GetLength());
+}
+
+TEST_F(UsbTransferTest, SetLengthAfterSubmit) {
+  InjectTestLibUsbTransfer();
+  PretendTransferInProgress();
+  EXPECT_FALSE(transfer_.SetLength(0));
+  EXPECT_EQ(UsbError::kErrorTransferAlreadySubmitted, transfer_.error().type());
+}
+
 TEST_F(UsbTransferTest, CancelBeforeSubmit) {
   EXPECT_FALSE(transfer_.Cancel());
   EXPECT_EQ(UsbTransfer::kIdle, transfer_.state());
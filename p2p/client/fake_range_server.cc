@@ -0,0 +1,185 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "p2p/client/fake_range_server.h"
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <base/logging.h>
+#include <base/strings/stringprintf.h>
+#include <base/threading/platform_thread.h>
+
+using base::TimeDelta;
+using base::TimeTicks;
+using std::string;
+
+namespace p2p {
+
+namespace client {
+
+FakeRangeServer::FakeRangeServer(const string& data, int64_t bytes_per_second,
+                                 uint64_t fail_after)
+    : data_(data),
+      bytes_per_second_(bytes_per_second),
+      fail_after_(fail_after),
+      available_size_(data.size()),
+      reported_size_(data.size()),
+      listen_fd_(-1),
+      port_(0),
+      bytes_sent_(0),
+      num_requests_(0),
+      must_stop_(false) {}
+
+FakeRangeServer::~FakeRangeServer() {
+  Stop();
+}
+
+void FakeRangeServer::SetGrowing(uint64_t available_size, TimeDelta delay) {
+  available_size_ = available_size;
+  growth_delay_ = delay;
+}
+
+bool FakeRangeServer::Start() {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+  if (listen_fd_ == -1)
+    return false;
+
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr),
+           sizeof(addr)) != 0 ||
+      getsockname(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr),
+                  &addr_len) != 0 ||
+      listen(listen_fd_, 4) != 0) {
+    PLOG(ERROR) << "Setting up the listening socket";
+    return false;
+  }
+  port_ = ntohs(addr.sin_port);
+
+  start_time_ = TimeTicks::Now();
+  thread_.reset(new base::DelegateSimpleThread(this, "fake-range-server"));
+  thread_->Start();
+  return true;
+}
+
+void FakeRangeServer::Stop() {
+  must_stop_ = true;
+  if (thread_) {
+    thread_->Join();
+    thread_.reset();
+  }
+  if (listen_fd_ != -1) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+  }
+}
+
+string FakeRangeServer::Url() const {
+  return base::StringPrintf("http://127.0.0.1:%d/file", port_);
+}
+
+void FakeRangeServer::Run() {
+  while (!must_stop_) {
+    struct pollfd pfd = {listen_fd_, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0)
+      continue;
+    int fd = accept4(listen_fd_, NULL, NULL, SOCK_CLOEXEC);
+    if (fd == -1)
+      continue;
+    if (bytes_sent_ < fail_after_)
+      ServeConnection(fd);
+    close(fd);
+  }
+}
+
+void FakeRangeServer::ServeConnection(int fd) {
+  string request;
+  char buf[1024];
+  while (request.find("\r\n\r\n") == string::npos) {
+    ssize_t num_recv = recv(fd, buf, sizeof(buf), 0);
+    if (num_recv <= 0)
+      return;
+    request.append(buf, num_recv);
+  }
+  num_requests_++;
+  if (response_delay_ > TimeDelta())
+    base::PlatformThread::Sleep(response_delay_);
+
+  uint64_t first, last;
+  size_t range_pos = request.find("Range: bytes=");
+  if (range_pos == string::npos ||
+      sscanf(request.c_str() + range_pos, "Range: bytes=%" SCNu64
+             "-%" SCNu64, &first, &last) != 2 ||
+      first > last || last >= data_.size()) {
+    SendAll(fd, "HTTP/1.1 400 Bad Request\r\n\r\n");
+    return;
+  }
+
+  // Formats the Content-Range like p2p-http-server does.
+  string headers = base::StringPrintf(
+      "HTTP/1.1 206 Partial Content\r\n"
+      "Content-Range: %" PRIu64 "-%" PRIu64 "/%" PRIu64 "\r\n"
+      "Content-Length: %" PRIu64 "\r\n"
+      "\r\n", first, last, reported_size_, last - first + 1);
+  if (!SendAll(fd, headers))
+    return;
+
+  const uint64_t kChunkSize = 4096;
+  TimeTicks send_start_time = TimeTicks::Now();
+  uint64_t sent = 0;
+  for (uint64_t offset = first; offset <= last && !must_stop_;
+       offset += kChunkSize) {
+    uint64_t length = std::min(kChunkSize, last + 1 - offset);
+    if (offset + length > available_size_) {
+      TimeDelta wait = start_time_ + growth_delay_ - TimeTicks::Now();
+      if (wait > TimeDelta())
+        base::PlatformThread::Sleep(wait);
+    }
+    if (bytes_sent_ + length > fail_after_)
+      length = fail_after_ - bytes_sent_;
+    if (!SendAll(fd, data_.substr(offset, length)))
+      return;
+    bytes_sent_ += length;
+    sent += length;
+    if (bytes_sent_ >= fail_after_)
+      return;
+
+    if (bytes_per_second_ > 0) {
+      TimeDelta target = TimeDelta::FromMicroseconds(
+          sent * base::Time::kMicrosecondsPerSecond / bytes_per_second_);
+      TimeDelta ahead = target - (TimeTicks::Now() - send_start_time);
+      if (ahead > TimeDelta())
+        base::PlatformThread::Sleep(ahead);
+    }
+  }
+}
+
+bool FakeRangeServer::SendAll(int fd, const string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t rc = send(fd, data.data() + sent, data.size() - sent,
+                      MSG_NOSIGNAL);
+    if (rc <= 0)
+      return false;
+    sent += rc;
+  }
+  return true;
+}
+
+}  // namespace client
+
+}  // namespace p2p
@@ -0,0 +1,91 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef P2P_CLIENT_FAKE_RANGE_SERVER_H__
+#define P2P_CLIENT_FAKE_RANGE_SERVER_H__
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include <base/macros.h>
+#include <base/threading/simple_thread.h>
+#include <base/time/time.h>
+
+namespace p2p {
+
+namespace client {
+
+// A minimal HTTP server on the loopback interface that serves the ranges of
+// an in-memory file, at most at a given speed, to one connection at a time
+// like p2p-http-server does for each download.
+class FakeRangeServer : public base::DelegateSimpleThread::Delegate {
+ public:
+  // Constructs a server for |data| sending at most |bytes_per_second| bytes
+  // per second, or as fast as possible if 0. After sending |fail_after| bytes
+  // of data, the server drops the connection and closes any new one.
+  FakeRangeServer(const std::string& data, int64_t bytes_per_second,
+                  uint64_t fail_after);
+  ~FakeRangeServer() override;
+
+  // Only sends the first |available_size| bytes of the file until |delay|
+  // after Start(), like p2p-http-server waits for a file it is still
+  // downloading to grow. The Content-Range still reports the whole file, as
+  // p2p-http-server reports the final size of the file. Must be called
+  // before Start().
+  void SetGrowing(uint64_t available_size, base::TimeDelta delay);
+
+  // Reports a file of |reported_size| bytes in the Content-Range instead of
+  // the size of the data. Must be called before Start().
+  void set_reported_size(uint64_t reported_size) {
+    reported_size_ = reported_size;
+  }
+
+  // Waits |response_delay| before responding to a request. Must be called
+  // before Start().
+  void set_response_delay(base::TimeDelta response_delay) {
+    response_delay_ = response_delay;
+  }
+
+  // Starts listening on a port chosen by the kernel.
+  bool Start();
+
+  void Stop();
+
+  std::string Url() const;
+
+  int num_requests() const { return num_requests_; }
+
+  // Overrides DelegateSimpleThread::Delegate.
+  void Run() override;
+
+ private:
+  void ServeConnection(int fd);
+
+  bool SendAll(int fd, const std::string& data);
+
+  const std::string data_;
+  const int64_t bytes_per_second_;
+  const uint64_t fail_after_;
+  uint64_t available_size_;
+  base::TimeDelta growth_delay_;
+  uint64_t reported_size_;
+  base::TimeDelta response_delay_;
+  int listen_fd_;
+  uint16_t port_;
+  base::TimeTicks start_time_;
+  uint64_t bytes_sent_;
+  volatile int num_requests_;
+  volatile bool must_stop_;
+  std::unique_ptr<base::DelegateSimpleThread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeRangeServer);
+};
+
+}  // namespace client
+
+}  // namespace p2p
+
+#endif  // P2P_CLIENT_FAKE_RANGE_SERVER_H__
@@ -2,15 +2,20 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include "p2p/client/peer_prober.h"
+#include "p2p/client/peer_scoreboard.h"
 #include "p2p/client/peer_selector.h"
+#include "p2p/client/range_downloader.h"
 #include "p2p/client/service_finder.h"
 #include "p2p/common/clock.h"
 #include "p2p/common/constants.h"
 #include "p2p/common/util.h"
 
+#include <fcntl.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <cassert>
 #include <cerrno>
@@ -18,6 +23,7 @@
 
 #include <base/bind.h>
 #include <base/command_line.h>
+#include <base/files/file_path.h>
 #include <base/logging.h>
 #include <base/rand_util.h>
 #include <base/strings/string_number_conversions.h>
@@ -31,11 +37,17 @@ using std::vector;
  * handler of SIGTERM. */
 static p2p::client::PeerSelector* volatile global_peer_selector = NULL;
 
+/* Global pointer to the RangeDownloader being used. Only used from the signal
+ * handler of SIGTERM. */
+static p2p::client::RangeDownloader* volatile global_range_downloader = NULL;
+
 static void sigterm_handler(int signum) {
   /* This function is non-reentrant since is only used to handle SIGTERM.
    * A second SIGTERM signal will wait until this call finishes. */
   if (global_peer_selector)
     global_peer_selector->Abort();
+  if (global_range_downloader)
+    global_range_downloader->Abort();
 }
 
 static void Usage(FILE* output) {
@@ -48,10 +60,15 @@ static void Usage(FILE* output) {
     " --list-all         Scan network and list available files\n"
     " --list-urls=ID     Like --list-all but only show peers for ID\n"
     " --get-url=ID       Scan for ID and pick a suitable peer\n"
+    " --download=ID      Scan for ID and download it in parallel from\n"
+    "                    several peers to the file given by --output\n"
     " --num-connections  Show total number of connections in the LAN\n"
     " -v=NUMBER          Verbosity level (default: 0)\n"
-    " --minimum-size=NUM When used with --get-url, scans for files\n"
-    "                    with at least NUM bytes (default: 1).\n"
+    " --minimum-size=NUM When used with --get-url or --download, scans\n"
+    "                    for files with at least NUM bytes (default: 1).\n"
+    " --output=FILE      When used with --download, the file to write\n"
+    " --num-peers=NUM    When used with --download, the maximum number\n"
+    "                    of peers to download from (default: 3).\n"
     "\n");
 }
 
@@ -78,6 +95,59 @@ static void ListUrls(p2p::client::ServiceFinder* finder,
   }
 }
 
+// Downloads the file |id| with at least |minimum_size| bytes from up to
+// |num_peers| peers into the file |output_path|. Returns the exit code.
+static int Download(p2p::client::PeerSelector* peer_selector,
+                    p2p::common::ClockInterface* clock,
+                    const string& id,
+                    uint64_t minimum_size,
+                    uint64_t num_peers,
+                    const string& output_path) {
+  // Register the SIGTERM signal handler in order to abort the
+  // GetUrlsAndWait() call, but reporting the metric.
+  global_peer_selector = peer_selector;
+  signal(SIGTERM, sigterm_handler);
+
+  size_t file_size = 0;
+  vector<string> urls =
+      peer_selector->GetUrlsAndWait(id, minimum_size, num_peers, &file_size);
+
+  global_peer_selector = NULL;
+
+  MetricsLibrary metrics_lib;
+  metrics_lib.Init();
+  peer_selector->ReportMetrics(&metrics_lib);
+
+  if (urls.empty())
+    return 1;
+
+  int output_fd = open(output_path.c_str(),
+                       O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+  if (output_fd == -1) {
+    PLOG(ERROR) << "Error opening " << output_path;
+    return 1;
+  }
+
+  p2p::client::RangeDownloader downloader(urls, file_size, output_fd, clock);
+  global_range_downloader = &downloader;
+  bool success = downloader.Run();
+  global_range_downloader = NULL;
+
+  // Score the peers by how they served their ranges.
+  for (auto const& stats : downloader.peer_stats()) {
+    if (stats.num_ranges > 0) {
+      peer_selector->ReportDownload(stats.url, stats.bytes_received,
+                                    stats.time_spent, !stats.failed);
+    }
+  }
+
+  if (close(output_fd) != 0) {
+    PLOG(ERROR) << "Error closing " << output_path;
+    success = false;
+  }
+  return success ? 0 : 1;
+}
+
 int main(int argc, char* argv[]) {
   std::unique_ptr<p2p::client::ServiceFinder> finder;
 
@@ -104,7 +174,18 @@ int main(int argc, char* argv[]) {
     return 1;
 
   p2p::common::Clock clock;
-  p2p::client::PeerSelector peer_selector(finder.get(), &clock);
+
+  // What was observed about the peers in previous runs. A scoreboard that
+  // can't be loaded is started over.
+  base::FilePath scoreboard_path(p2p::constants::kPeerScoreboardPath);
+  p2p::client::PeerScoreboard scoreboard(
+      p2p::constants::kMaxScoreboardPeers);
+  if (!scoreboard.Load(scoreboard_path))
+    LOG(WARNING) << "Starting with an empty peer scoreboard";
+  p2p::client::TcpPeerProber prober(&clock);
+
+  p2p::client::PeerSelector peer_selector(finder.get(), &clock, &scoreboard,
+                                          &prober);
   // The Metrics Library interface for reporting UMA stats.
 
   if (cl->HasSwitch("list-all")) {
@@ -140,10 +221,38 @@ int main(int argc, char* argv[]) {
     MetricsLibrary metrics_lib;
     metrics_lib.Init();
     peer_selector.ReportMetrics(&metrics_lib);
+    scoreboard.Save(scoreboard_path);
 
     if (url == "")
       return 1;
     printf("%s\n", url.c_str());
+  } else if (cl->HasSwitch("download")) {
+    string id = cl->GetSwitchValueNative("download");
+    string output_path = cl->GetSwitchValueNative("output");
+    if (output_path.empty()) {
+      LOG(ERROR) << "Missing --output argument";
+      return 1;
+    }
+    uint64_t minimum_size = 1;
+    if (cl->HasSwitch("minimum-size")) {
+      string minimum_size_str = cl->GetSwitchValueNative("minimum-size");
+      if (!base::StringToUint64(minimum_size_str, &minimum_size)) {
+        LOG(ERROR) << "Invalid --minimum-size argument";
+        return 1;
+      }
+    }
+    uint64_t num_peers = p2p::constants::kMaxSimultaneousDownloads;
+    if (cl->HasSwitch("num-peers")) {
+      string num_peers_str = cl->GetSwitchValueNative("num-peers");
+      if (!base::StringToUint64(num_peers_str, &num_peers) || num_peers == 0) {
+        LOG(ERROR) << "Invalid --num-peers argument";
+        return 1;
+      }
+    }
+    int exit_code = Download(&peer_selector, &clock, id, minimum_size,
+                             num_peers, output_path);
+    scoreboard.Save(scoreboard_path);
+    return exit_code;
   } else if (cl->HasSwitch("list-urls")) {
     string id = cl->GetSwitchValueNative("list-urls");
     finder->Lookup();
@@ -0,0 +1,127 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "p2p/client/peer_prober.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+
+using base::Time;
+using base::TimeDelta;
+using std::string;
+using std::vector;
+
+namespace p2p {
+
+namespace client {
+
+namespace {
+
+// Starts connecting a non-blocking socket to |peer|. Returns the socket, or
+// -1 on failure.
+int StartConnect(const Peer& peer) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = peer.is_ipv6 ? AF_INET6 : AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+
+  struct addrinfo* address = NULL;
+  string port = std::to_string(peer.port);
+  if (getaddrinfo(peer.address.c_str(), port.c_str(), &hints, &address) != 0)
+    return -1;
+
+  int sock = socket(address->ai_family,
+                    address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                    address->ai_protocol);
+  if (sock != -1 &&
+      connect(sock, address->ai_addr, address->ai_addrlen) != 0 &&
+      errno != EINPROGRESS) {
+    close(sock);
+    sock = -1;
+  }
+  freeaddrinfo(address);
+  return sock;
+}
+
+// Closes the socket |sock| with a reset rather than a FIN, so the connection
+// of a probe is dropped by the peer before it gets to its HTTP server.
+void ResetConnection(int sock) {
+  struct linger linger = {1, 0};
+  setsockopt(sock, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+  close(sock);
+}
+
+}  // namespace
+
+TcpPeerProber::TcpPeerProber(p2p::common::ClockInterface* clock)
+    : clock_(clock) {}
+
+void TcpPeerProber::MeasureRtts(const vector<const Peer*>& peers,
+                                TimeDelta timeout,
+                                vector<TimeDelta>* rtts) {
+  rtts->assign(peers.size(), timeout);
+  Time start_time = clock_->GetMonotonicTime();
+
+  // The probes still in progress and the index of their peer.
+  vector<struct pollfd> pfds;
+  vector<size_t> probe_peers;
+  for (size_t i = 0; i < peers.size(); i++) {
+    int sock = StartConnect(*peers[i]);
+    if (sock == -1) {
+      VLOG(1) << "Error connecting to " << peers[i]->address;
+      continue;
+    }
+    pfds.push_back({sock, POLLOUT, 0});
+    probe_peers.push_back(i);
+  }
+
+  while (!pfds.empty()) {
+    TimeDelta elapsed = clock_->GetMonotonicTime() - start_time;
+    if (elapsed >= timeout)
+      break;
+    int rc = HANDLE_EINTR(
+        poll(pfds.data(), pfds.size(), (timeout - elapsed).InMilliseconds()));
+    if (rc <= 0)
+      break;
+
+    for (size_t i = 0; i < pfds.size();) {
+      bool done = false;
+      if (pfds[i].revents & (POLLERR | POLLHUP)) {
+        // The connection was refused or reset.
+        done = true;
+      } else if (pfds[i].revents & POLLOUT) {
+        // Connected: the peer answered the SYN.
+        (*rtts)[probe_peers[i]] = clock_->GetMonotonicTime() - start_time;
+        done = true;
+      }
+
+      if (done) {
+        ResetConnection(pfds[i].fd);
+        pfds.erase(pfds.begin() + i);
+        probe_peers.erase(probe_peers.begin() + i);
+      } else {
+        pfds[i].revents = 0;
+        i++;
+      }
+    }
+  }
+
+  for (auto const& pfd : pfds)
+    ResetConnection(pfd.fd);
+}
+
+}  // namespace client
+
+}  // namespace p2p
@@ -0,0 +1,56 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef P2P_CLIENT_PEER_PROBER_H__
+#define P2P_CLIENT_PEER_PROBER_H__
+
+#include "p2p/client/peer.h"
+#include "p2p/common/clock_interface.h"
+
+#include <vector>
+
+#include <base/macros.h>
+#include <base/time/time.h>
+
+namespace p2p {
+
+namespace client {
+
+// Interface for measuring how fast peers respond.
+class PeerProber {
+ public:
+  virtual ~PeerProber() {}
+
+  // Measures the round-trip time to each peer in |peers|, in parallel, and
+  // stores it in |rtts| in the same order. A peer that doesn't
+  // respond within |timeout| gets |timeout|.
+  virtual void MeasureRtts(const std::vector<const Peer*>& peers,
+                           base::TimeDelta timeout,
+                           std::vector<base::TimeDelta>* rtts) = 0;
+};
+
+// A PeerProber that times the TCP handshake with the HTTP server of each peer
+// and resets the connection without sending a request. p2p-http-server only
+// accepts connections once they carry a request, so a probe is neither
+// counted as a connection nor reported in the server metrics.
+class TcpPeerProber : public PeerProber {
+ public:
+  explicit TcpPeerProber(p2p::common::ClockInterface* clock);
+
+  void MeasureRtts(const std::vector<const Peer*>& peers,
+                   base::TimeDelta timeout,
+                   std::vector<base::TimeDelta>* rtts) override;
+
+ private:
+  // An interface to the system clock functions, used for unit testing.
+  p2p::common::ClockInterface* clock_;
+
+  DISALLOW_COPY_AND_ASSIGN(TcpPeerProber);
+};
+
+}  // namespace client
+
+}  // namespace p2p
+
+#endif  // P2P_CLIENT_PEER_PROBER_H__
@@ -0,0 +1,202 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "p2p/client/peer_scoreboard.h"
+
+#include "p2p/common/constants.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <base/files/file_util.h>
+#include <base/logging.h>
+#include <base/strings/stringprintf.h>
+
+using std::string;
+using std::vector;
+
+namespace p2p {
+
+namespace client {
+
+namespace {
+
+// The first line of a saved scoreboard.
+const char kFileHeader[] = "p2p-peer-scoreboard 1";
+
+// The weight of a new sample in the moving averages.
+const double kSmoothingFactor = 0.3;
+
+// The round-trip time at which the score of a peer is halved. Wired peers
+// in a LAN answer within a few milliseconds, while a congested wireless
+// link takes tens to hundreds of milliseconds.
+const double kRttHalvingMs = 50.0;
+
+// Returns |average| updated with the new |sample|, or |sample| if it is the
+// first one.
+double UpdateAverage(double average, int num_samples, double sample) {
+  if (num_samples == 0)
+    return sample;
+  return average + kSmoothingFactor * (sample - average);
+}
+
+}  // namespace
+
+PeerScoreboard::PeerScoreboard(size_t max_peers)
+    : max_peers_(max_peers),
+      update_counter_(0) {
+}
+
+bool PeerScoreboard::Load(const base::FilePath& path) {
+  records_.clear();
+  update_counter_ = 0;
+  if (!base::PathExists(path))
+    return true;
+
+  string contents;
+  if (!base::ReadFileToString(path, &contents)) {
+    LOG(ERROR) << "Error reading " << path.value();
+    return false;
+  }
+
+  vector<string> lines;
+  size_t pos = 0;
+  while (pos < contents.size()) {
+    size_t end = contents.find('\n', pos);
+    if (end == string::npos)
+      end = contents.size();
+    lines.push_back(contents.substr(pos, end - pos));
+    pos = end + 1;
+  }
+  if (lines.empty() || lines[0] != kFileHeader) {
+    LOG(ERROR) << "Unknown format of " << path.value();
+    return false;
+  }
+
+  for (size_t i = 1; i < lines.size(); i++) {
+    char key[128];
+    PeerRecord record;
+    if (sscanf(lines[i].c_str(), "%127s %lf %d %lf %d %" SCNu64,
+               key, &record.throughput, &record.num_downloads,
+               &record.rtt_ms, &record.num_rtts, &record.last_update) != 6 ||
+        record.throughput < 0 || record.num_downloads < 0 ||
+        record.rtt_ms < 0 || record.num_rtts < 0) {
+      LOG(ERROR) << "Malformed line " << i + 1 << " in " << path.value();
+      records_.clear();
+      update_counter_ = 0;
+      return false;
+    }
+    records_[key] = record;
+    update_counter_ = std::max(update_counter_, record.last_update + 1);
+  }
+  RemoveExcessRecords();
+  return true;
+}
+
+bool PeerScoreboard::Save(const base::FilePath& path) const {
+  string contents = string(kFileHeader) + "\n";
+  for (auto const& key_record : records_) {
+    const PeerRecord& record = key_record.second;
+    contents += base::StringPrintf(
+        "%s %.1f %d %.3f %d %" PRIu64 "\n", key_record.first.c_str(),
+        record.throughput, record.num_downloads, record.rtt_ms,
+        record.num_rtts, record.last_update);
+  }
+
+  // Write to a temporary file first so that a partially written scoreboard
+  // is never loaded.
+  base::FilePath temp_path = path.AddExtension(".tmp");
+  if (!base::CreateDirectory(path.DirName()) ||
+      base::WriteFile(temp_path, contents.data(), contents.size()) !=
+          static_cast<int>(contents.size()) ||
+      !base::ReplaceFile(temp_path, path, NULL)) {
+    LOG(ERROR) << "Error saving the peer scoreboard to " << path.value();
+    base::DeleteFile(temp_path, false);
+    return false;
+  }
+  return true;
+}
+
+void PeerScoreboard::RecordDownload(const Peer& peer, uint64_t num_bytes,
+                                    base::TimeDelta duration) {
+  int64_t duration_ms = std::max(duration.InMilliseconds(),
+                                 static_cast<int64_t>(1));
+  PeerRecord* record = UpdateRecord(peer);
+  record->throughput =
+      UpdateAverage(record->throughput, record->num_downloads,
+                    num_bytes * 1000.0 / duration_ms);
+  record->num_downloads++;
+  RemoveExcessRecords();
+}
+
+void PeerScoreboard::RecordFailure(const Peer& peer) {
+  PeerRecord* record = UpdateRecord(peer);
+  record->throughput =
+      UpdateAverage(record->throughput, record->num_downloads, 0.0);
+  record->num_downloads++;
+  RemoveExcessRecords();
+}
+
+void PeerScoreboard::RecordRtt(const Peer& peer, base::TimeDelta rtt) {
+  PeerRecord* record = UpdateRecord(peer);
+  record->rtt_ms = UpdateAverage(record->rtt_ms, record->num_rtts,
+                                 rtt.InMicroseconds() / 1000.0);
+  record->num_rtts++;
+  RemoveExcessRecords();
+}
+
+double PeerScoreboard::Score(const Peer& peer) const {
+  const PeerRecord* record = GetRecord(peer);
+
+  // A peer not downloaded from yet is expected to serve at the full speed of
+  // a download, so new peers get tried.
+  double throughput = constants::kMaxSpeedPerDownload;
+  if (record && record->num_downloads > 0)
+    throughput = record->throughput;
+
+  // The uplink of the peer is shared among its connections.
+  double score = throughput / (1 + std::max(peer.num_connections, 0));
+
+  if (record && record->num_rtts > 0)
+    score /= 1 + record->rtt_ms / kRttHalvingMs;
+  return score;
+}
+
+const PeerScoreboard::PeerRecord* PeerScoreboard::GetRecord(
+    const Peer& peer) const {
+  auto it = records_.find(GetKey(peer));
+  return it == records_.end() ? NULL : &it->second;
+}
+
+PeerScoreboard::PeerRecord* PeerScoreboard::UpdateRecord(const Peer& peer) {
+  PeerRecord* record = &records_[GetKey(peer)];
+  record->last_update = update_counter_++;
+  return record;
+}
+
+void PeerScoreboard::RemoveExcessRecords() {
+  while (records_.size() > max_peers_) {
+    auto oldest = std::min_element(
+        records_.begin(), records_.end(),
+        [](const std::pair<const string, PeerRecord>& a,
+           const std::pair<const string, PeerRecord>& b) {
+          return a.second.last_update < b.second.last_update;
+        });
+    records_.erase(oldest);
+  }
+}
+
+string PeerScoreboard::GetKey(const Peer& peer) {
+  if (peer.is_ipv6)
+    return base::StringPrintf("[%s]:%d", peer.address.c_str(), peer.port);
+  return base::StringPrintf("%s:%d", peer.address.c_str(), peer.port);
+}
+
+}  // namespace client
+
+}  // namespace p2p
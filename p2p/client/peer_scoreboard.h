@@ -0,0 +1,110 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef P2P_CLIENT_PEER_SCOREBOARD_H__
+#define P2P_CLIENT_PEER_SCOREBOARD_H__
+
+#include "p2p/client/peer.h"
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include <base/files/file_path.h>
+#include <base/macros.h>
+#include <base/time/time.h>
+
+namespace p2p {
+
+namespace client {
+
+// PeerScoreboard keeps what was observed about each peer in the LAN: the
+// throughput of the downloads made from it and the round-trip time of the
+// probes sent to it. It combines them with the load a peer advertises into a
+// score used to choose among peers. The scoreboard can be saved to a file and
+// loaded back, so it survives across runs of p2p-client.
+class PeerScoreboard {
+ public:
+  // Observations about a peer. Each of them is an exponentially weighted
+  // moving average of the samples recorded, so recent samples matter most.
+  struct PeerRecord {
+    // The throughput of a download from the peer, in bytes per second.
+    double throughput = 0;
+
+    // The number of downloads recorded, including failed ones.
+    int num_downloads = 0;
+
+    // The round-trip time to the peer, in milliseconds.
+    double rtt_ms = 0;
+
+    // The number of round-trip times recorded.
+    int num_rtts = 0;
+
+    // A counter of the last time the record was updated, used to forget the
+    // peers not seen for the longest time.
+    uint64_t last_update = 0;
+  };
+
+  // Constructs an empty scoreboard remembering at most |max_peers| peers.
+  explicit PeerScoreboard(size_t max_peers);
+
+  // Replaces the records by those saved in |path| by Save(). A file that
+  // doesn't exist results in an empty scoreboard. Returns false and leaves
+  // the scoreboard empty if the file can't be read or is malformed.
+  bool Load(const base::FilePath& path);
+
+  // Saves the records to |path|, atomically replacing any previous file.
+  // Returns false on failure.
+  bool Save(const base::FilePath& path) const;
+
+  // Records a download of |num_bytes| bytes from |peer| that took |duration|.
+  void RecordDownload(const Peer& peer, uint64_t num_bytes,
+                      base::TimeDelta duration);
+
+  // Records a download from |peer| that failed, as a download with no
+  // throughput.
+  void RecordFailure(const Peer& peer);
+
+  // Records a round-trip time of |rtt| to |peer|.
+  void RecordRtt(const Peer& peer, base::TimeDelta rtt);
+
+  // Returns the expected throughput, in bytes per second, of a new download
+  // from |peer|. This is the throughput observed from the peer, or the speed
+  // of a download if there is none, shared with the connections the peer
+  // advertises and reduced as its round-trip time grows.
+  double Score(const Peer& peer) const;
+
+  // Returns the record of |peer|, or NULL if there is none.
+  const PeerRecord* GetRecord(const Peer& peer) const;
+
+  size_t num_peers() const { return records_.size(); }
+
+ private:
+  // Returns the record of |peer|, creating it if needed.
+  PeerRecord* UpdateRecord(const Peer& peer);
+
+  // Forgets the peers updated the longest time ago until there are no more
+  // than |max_peers_|.
+  void RemoveExcessRecords();
+
+  // Returns the key of |peer| in |records_|.
+  static std::string GetKey(const Peer& peer);
+
+  const size_t max_peers_;
+
+  // The records, by peer address and port.
+  std::map<std::string, PeerRecord> records_;
+
+  // The value of PeerRecord::last_update of the next record updated.
+  uint64_t update_counter_;
+
+  DISALLOW_COPY_AND_ASSIGN(PeerScoreboard);
+};
+
+}  // namespace client
+
+}  // namespace p2p
+
+#endif  // P2P_CLIENT_PEER_SCOREBOARD_H__
@@ -0,0 +1,168 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "p2p/client/peer_scoreboard.h"
+
+#include "p2p/common/constants.h"
+#include "p2p/common/testutil.h"
+
+#include <string>
+
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/time/time.h>
+#include <gtest/gtest.h>
+
+using base::FilePath;
+using base::TimeDelta;
+using p2p::testutil::SetupTestDir;
+using p2p::testutil::TeardownTestDir;
+using std::string;
+
+namespace p2p {
+
+namespace client {
+
+static Peer MakePeer(const string& address, int num_connections) {
+  Peer peer;
+  peer.address = address;
+  peer.is_ipv6 = false;
+  peer.port = constants::kHttpServerDefaultPort;
+  peer.num_connections = num_connections;
+  return peer;
+}
+
+TEST(PeerScoreboard, UnknownPeerGetsTheSpeedOfADownload) {
+  PeerScoreboard scoreboard(10);
+  EXPECT_DOUBLE_EQ(constants::kMaxSpeedPerDownload,
+                   scoreboard.Score(MakePeer("10.0.0.1", 0)));
+  // The peer shares its uplink with its connections.
+  EXPECT_DOUBLE_EQ(constants::kMaxSpeedPerDownload / 2.0,
+                   scoreboard.Score(MakePeer("10.0.0.1", 1)));
+  EXPECT_EQ(nullptr, scoreboard.GetRecord(MakePeer("10.0.0.1", 0)));
+}
+
+TEST(PeerScoreboard, RecordDownloadAveragesThroughput) {
+  PeerScoreboard scoreboard(10);
+  Peer peer = MakePeer("10.0.0.1", 0);
+
+  scoreboard.RecordDownload(peer, 100000, TimeDelta::FromSeconds(1));
+  EXPECT_DOUBLE_EQ(100000, scoreboard.Score(peer));
+
+  // Later downloads move the average towards their throughput.
+  scoreboard.RecordDownload(peer, 200000, TimeDelta::FromSeconds(1));
+  double score = scoreboard.Score(peer);
+  EXPECT_GT(score, 100000);
+  EXPECT_LT(score, 200000);
+  EXPECT_EQ(2, scoreboard.GetRecord(peer)->num_downloads);
+
+  // Another port is another peer.
+  Peer other_peer = peer;
+  other_peer.port++;
+  EXPECT_EQ(nullptr, scoreboard.GetRecord(other_peer));
+}
+
+TEST(PeerScoreboard, RecordFailureLowersScore) {
+  PeerScoreboard scoreboard(10);
+  Peer peer = MakePeer("10.0.0.1", 0);
+  scoreboard.RecordFailure(peer);
+  EXPECT_DOUBLE_EQ(0, scoreboard.Score(peer));
+
+  scoreboard.RecordDownload(peer, 100000, TimeDelta::FromSeconds(1));
+  EXPECT_GT(scoreboard.Score(peer), 0);
+  EXPECT_LT(scoreboard.Score(peer), 100000);
+}
+
+TEST(PeerScoreboard, RecordRttLowersScore) {
+  PeerScoreboard scoreboard(10);
+  Peer near_peer = MakePeer("10.0.0.1", 0);
+  Peer far_peer = MakePeer("10.0.0.2", 0);
+  scoreboard.RecordRtt(near_peer, TimeDelta::FromMilliseconds(1));
+  scoreboard.RecordRtt(far_peer, TimeDelta::FromMilliseconds(200));
+
+  EXPECT_GT(scoreboard.Score(near_peer), scoreboard.Score(far_peer));
+  EXPECT_LT(scoreboard.Score(near_peer), constants::kMaxSpeedPerDownload);
+  EXPECT_DOUBLE_EQ(200, scoreboard.GetRecord(far_peer)->rtt_ms);
+}
+
+TEST(PeerScoreboard, ForgetsPeersNotSeenForLongest) {
+  PeerScoreboard scoreboard(2);
+  Peer peer1 = MakePeer("10.0.0.1", 0);
+  Peer peer2 = MakePeer("10.0.0.2", 0);
+  Peer peer3 = MakePeer("10.0.0.3", 0);
+  scoreboard.RecordFailure(peer1);
+  scoreboard.RecordFailure(peer2);
+  scoreboard.RecordRtt(peer1, TimeDelta::FromMilliseconds(1));
+  scoreboard.RecordFailure(peer3);
+
+  EXPECT_EQ(2u, scoreboard.num_peers());
+  EXPECT_NE(nullptr, scoreboard.GetRecord(peer1));
+  EXPECT_EQ(nullptr, scoreboard.GetRecord(peer2));
+  EXPECT_NE(nullptr, scoreboard.GetRecord(peer3));
+}
+
+TEST(PeerScoreboard, SaveAndLoad) {
+  FilePath testdir = SetupTestDir("peer-scoreboard");
+  FilePath path = testdir.Append("state").Append("scoreboard");
+
+  Peer peer1 = MakePeer("10.0.0.1", 0);
+  Peer peer2 = MakePeer("10.0.0.2", 1);
+  Peer peer3 = MakePeer("10.0.0.3", 0);
+  PeerScoreboard scoreboard(2);
+  scoreboard.RecordDownload(peer1, 50000, TimeDelta::FromSeconds(1));
+  scoreboard.RecordRtt(peer1, TimeDelta::FromMilliseconds(30));
+  scoreboard.RecordRtt(peer2, TimeDelta::FromMilliseconds(3));
+  EXPECT_TRUE(scoreboard.Save(path));
+
+  PeerScoreboard loaded(2);
+  EXPECT_TRUE(loaded.Load(path));
+  EXPECT_EQ(2u, loaded.num_peers());
+  EXPECT_DOUBLE_EQ(scoreboard.Score(peer1), loaded.Score(peer1));
+  EXPECT_DOUBLE_EQ(scoreboard.Score(peer2), loaded.Score(peer2));
+
+  // The order in which the peers were updated is kept.
+  loaded.RecordFailure(peer3);
+  EXPECT_EQ(nullptr, loaded.GetRecord(peer1));
+  EXPECT_NE(nullptr, loaded.GetRecord(peer2));
+
+  TeardownTestDir(testdir);
+}
+
+TEST(PeerScoreboard, LoadMissingFile) {
+  FilePath testdir = SetupTestDir("peer-scoreboard-missing");
+  PeerScoreboard scoreboard(10);
+  scoreboard.RecordFailure(MakePeer("10.0.0.1", 0));
+
+  EXPECT_TRUE(scoreboard.Load(testdir.Append("scoreboard")));
+  EXPECT_EQ(0u, scoreboard.num_peers());
+
+  TeardownTestDir(testdir);
+}
+
+TEST(PeerScoreboard, LoadMalformedFile) {
+  FilePath testdir = SetupTestDir("peer-scoreboard-malformed");
+  FilePath path = testdir.Append("scoreboard");
+  PeerScoreboard scoreboard(10);
+
+  const string kNotAScoreboard = "some other file\n";
+  ASSERT_EQ(static_cast<int>(kNotAScoreboard.size()),
+            base::WriteFile(path, kNotAScoreboard.data(),
+                            kNotAScoreboard.size()));
+  EXPECT_FALSE(scoreboard.Load(path));
+
+  const string kBadRecord =
+      "p2p-peer-scoreboard 1\n"
+      "10.0.0.1:16725 1000.0 1 5.000 1 0\n"
+      "10.0.0.2:16725 -5.0 1 5.000 1 1\n";
+  ASSERT_EQ(static_cast<int>(kBadRecord.size()),
+            base::WriteFile(path, kBadRecord.data(), kBadRecord.size()));
+  EXPECT_FALSE(scoreboard.Load(path));
+  EXPECT_EQ(0u, scoreboard.num_peers());
+
+  TeardownTestDir(testdir);
+}
+
+}  // namespace client
+
+}  // namespace p2p
@@ -10,6 +10,7 @@
 
 #include <algorithm>
 #include <map>
+#include <random>
 #include <vector>
 
 #include <base/bind.h>
@@ -25,10 +26,36 @@ namespace p2p {
 
 namespace client {
 
+namespace {
+
+// The maximum number of peers whose round-trip time is measured before
+// picking one.
+const size_t kMaxProbedPeers = 8;
+
+// The time to wait for the peers to respond to a probe.
+const int kProbeTimeoutMs = 500;
+
+// The minimum weight of a peer when picking one at random, as a fraction of
+// the largest weight, so peers with a bad score are tried again once in a
+// while and can recover.
+const double kMinWeightFraction = 0.02;
+
+}  // namespace
+
 PeerSelector::PeerSelector(ServiceFinder* finder,
                            p2p::common::ClockInterface* clock)
+    : PeerSelector(finder, clock, NULL, NULL) {
+}
+
+PeerSelector::PeerSelector(ServiceFinder* finder,
+                           p2p::common::ClockInterface* clock,
+                           PeerScoreboard* scoreboard,
+                           PeerProber* prober)
     : finder_(finder),
     clock_(clock),
+    scoreboard_(scoreboard),
+    prober_(prober),
+    rng_(static_cast<uint32_t>(base::RandUint64())),
     lookup_result_(kNumLookupResults),
     candidate_files_count_(-1),
     victim_connections_(-1),
@@ -91,24 +118,163 @@ string PeerSelector::PickUrlForId(const string& id, size_t minimum_size) {
   if (!big_enough_files)
     return "";
 
-  // If we have any files left, pick randomly from the top 33%
-  int victim_number = 0;
-  int num_possible_victims = peers.size()/3 - 1;
-  if (num_possible_victims > 1)
-    victim_number = base::RandInt(0, num_possible_victims - 1);
-  const Peer* victim = peers[victim_number];
+  const Peer* victim;
+  if (scoreboard_) {
+    ProbePeers(peers);
+
+    // Weight each peer by its score and how much of the largest copy of the
+    // file it has, since a download stalls at the end of a partial copy.
+    size_t largest_size = peers[0]->files.find(id)->second;
+    vector<double> weights;
+    double max_weight = 0;
+    for (auto const& peer : peers) {
+      double completeness =
+          static_cast<double>(peer->files.find(id)->second) / largest_size;
+      weights.push_back(scoreboard_->Score(*peer) * completeness);
+      max_weight = std::max(max_weight, weights.back());
+    }
+    double total_weight = 0;
+    for (auto& weight : weights) {
+      weight = std::max(weight, max_weight * kMinWeightFraction);
+      total_weight += weight;
+    }
+
+    size_t victim_number = 0;
+    double choice =
+        std::uniform_real_distribution<double>(0, total_weight)(rng_);
+    while (victim_number + 1 < peers.size() &&
+           choice >= weights[victim_number]) {
+      choice -= weights[victim_number];
+      victim_number++;
+    }
+    victim = peers[victim_number];
+  } else {
+    // If we have any files left, pick randomly from the top 33%
+    int victim_number = 0;
+    int num_possible_victims = peers.size()/3 - 1;
+    if (num_possible_victims > 1)
+      victim_number = std::uniform_int_distribution<int>(
+          0, num_possible_victims - 1)(rng_);
+    victim = peers[victim_number];
+  }
   // Record the number of current connection the victim has.
   victim_connections_ = victim->num_connections;
 
-  string address = victim->address;
-  if (victim->is_ipv6)
+  picked_peers_.clear();
+  return MakeUrl(victim, id);
+}
+
+void PeerSelector::ProbePeers(const vector<const Peer*>& peers) {
+  if (!prober_)
+    return;
+
+  vector<const Peer*> probed_peers = peers;
+  std::stable_sort(probed_peers.begin(), probed_peers.end(),
+                   [this](const Peer* a, const Peer* b) {
+                     return scoreboard_->Score(*a) > scoreboard_->Score(*b);
+                   });
+  if (probed_peers.size() > kMaxProbedPeers)
+    probed_peers.resize(kMaxProbedPeers);
+
+  vector<base::TimeDelta> rtts;
+  prober_->MeasureRtts(probed_peers,
+                       base::TimeDelta::FromMilliseconds(kProbeTimeoutMs),
+                       &rtts);
+  for (size_t i = 0; i < probed_peers.size(); i++) {
+    VLOG(1) << "Round-trip time to " << probed_peers[i]->address << ": "
+            << rtts[i].InMilliseconds() << " ms";
+    scoreboard_->RecordRtt(*probed_peers[i], rtts[i]);
+  }
+}
+
+string PeerSelector::MakeUrl(const Peer* peer, const string& id) {
+  string address = peer->address;
+  if (peer->is_ipv6)
     address = "[" + address + "]";
-  return string("http://") + address + ":" + std::to_string(victim->port) +
-      "/" + id;
+  string url = string("http://") + address + ":" +
+      std::to_string(peer->port) + "/" + id;
+  picked_peers_[url] = *peer;
+  return url;
+}
+
+vector<string> PeerSelector::PickUrlsForId(const string& id,
+                                           size_t minimum_size,
+                                           size_t max_peers,
+                                           size_t* file_size) {
+  vector<const Peer*> peers = finder_->GetPeersForFile(id);
+
+  // Set an invalid victim_connections_ value in order to catch logic errors
+  // during test.
+  victim_connections_ = -1;
+
+  // Compute the candidate_files_count_ for metrics purposes, and the size of
+  // the largest copy of the file.
+  candidate_files_count_ = 0;
+  size_t largest_size = 0;
+  for (auto const& peer : peers) {
+    map<string, size_t>::const_iterator file_size_it = peer->files.find(id);
+    if (file_size_it != peer->files.end() && file_size_it->second > 0) {
+      candidate_files_count_++;
+      largest_size = std::max(largest_size, file_size_it->second);
+    }
+  }
+
+  if (!candidate_files_count_ || largest_size < minimum_size)
+    return vector<string>();
+
+  // Only peers with the largest copy can serve any range of it.
+  vector<const Peer*> victims;
+  for (auto const& peer : peers) {
+    map<string, size_t>::const_iterator file_size_it = peer->files.find(id);
+    if (file_size_it != peer->files.end() &&
+        file_size_it->second == largest_size)
+      victims.push_back(peer);
+  }
+
+  if (scoreboard_) {
+    ProbePeers(victims);
+    std::stable_sort(victims.begin(), victims.end(),
+                     [this](const Peer* a, const Peer* b) {
+                       return scoreboard_->Score(*a) > scoreboard_->Score(*b);
+                     });
+  } else {
+    // Spread the load by preferring the peers with fewer connections.
+    std::stable_sort(victims.begin(), victims.end(),
+                     [](const Peer* a, const Peer* b) {
+                       return a->num_connections < b->num_connections;
+                     });
+  }
+  if (victims.size() > max_peers)
+    victims.resize(max_peers);
+  victim_connections_ = victims[0]->num_connections;
+
+  picked_peers_.clear();
+  vector<string> urls;
+  for (auto const& victim : victims)
+    urls.push_back(MakeUrl(victim, id));
+  *file_size = largest_size;
+  return urls;
 }
 
 string PeerSelector::GetUrlAndWait(const string& id, size_t minimum_size) {
-  LOG(INFO) << "Requesting URL in the LAN for ID " << id
+  vector<string> urls = LookupUrlsAndWait(id, minimum_size, 1, NULL);
+  return urls.empty() ? "" : urls[0];
+}
+
+vector<string> PeerSelector::GetUrlsAndWait(const string& id,
+                                            size_t minimum_size,
+                                            size_t max_peers,
+                                            size_t* file_size) {
+  CHECK(file_size != NULL);
+  return LookupUrlsAndWait(id, minimum_size, max_peers, file_size);
+}
+
+vector<string> PeerSelector::LookupUrlsAndWait(const string& id,
+                                               size_t minimum_size,
+                                               size_t max_peers,
+                                               size_t* file_size) {
+  LOG(INFO) << "Requesting " << (file_size ? "URLs" : "URL")
+            << " in the LAN for ID " << id
             << " (minimum_size=" << minimum_size << ")";
 
   // Set the current state to an invalid condition in order to detect logic
@@ -117,7 +283,7 @@ string PeerSelector::GetUrlAndWait(const string& id, size_t minimum_size) {
 
   base::Time init_time = clock_->GetMonotonicTime();
 
-  string url;
+  vector<string> urls;
   int num_retries = 0;
 
   do {
@@ -130,21 +296,34 @@ string PeerSelector::GetUrlAndWait(const string& id, size_t minimum_size) {
     if (must_exit_now_)
       break;
 
-    url = PickUrlForId(id, minimum_size);
+    if (file_size) {
+      urls = PickUrlsForId(id, minimum_size, max_peers, file_size);
+    } else {
+      string url = PickUrlForId(id, minimum_size);
+      urls.clear();
+      if (url.size() > 0)
+        urls.push_back(url);
+    }
 
     // If we didn't find a peer, fail.
-    if (url.size() == 0) {
+    if (urls.empty()) {
       LOG(INFO) << "Returning error - no peer for the given ID.";
       lookup_result_ = num_retries ? kVanished : kNotFound;
       break;
     }
 
-    // Only return the peer if the number of connections in the LAN
-    // is below the threshold.
+    // Only return the peers if the number of connections in the LAN
+    // is below the threshold, and don't take it over the threshold.
     int num_total_conn = finder_->NumTotalConnections();
     if (num_total_conn < constants::kMaxSimultaneousDownloads) {
-      LOG(INFO) << "Returning URL " << url << " after " << num_retries
-                << " retries.";
+      size_t num_free_conn =
+          constants::kMaxSimultaneousDownloads - num_total_conn;
+      if (urls.size() > num_free_conn)
+        urls.resize(num_free_conn);
+      for (auto const& url : urls) {
+        LOG(INFO) << "Returning URL " << url << " after " << num_retries
+                  << " retries.";
+      }
       lookup_result_ = kFound;
       break;
     }
@@ -160,7 +339,7 @@ string PeerSelector::GetUrlAndWait(const string& id, size_t minimum_size) {
     clock_->Sleep(base::TimeDelta::FromSeconds(
         constants::kMaxSimultaneousDownloadsPollTimeSeconds));
 
-    // Now that we've slept for a while, the URL may not be valid
+    // Now that we've slept for a while, the URLs may not be valid
     // anymore, so we do the lookup again.
     num_retries++;
   } while (!must_exit_now_);
@@ -168,11 +347,29 @@ string PeerSelector::GetUrlAndWait(const string& id, size_t minimum_size) {
   if (must_exit_now_) {
     LOG(INFO) << "Abort was requested.";
     lookup_result_ = kCanceled;
-    url = "";
+    urls.clear();
   }
 
   url_waiting_time_sec_ = (clock_->GetMonotonicTime() - init_time).InSeconds();
-  return url;
+  return urls;
+}
+
+void PeerSelector::ReportDownload(const string& url,
+                                  uint64_t num_bytes,
+                                  base::TimeDelta duration,
+                                  bool success) {
+  if (!scoreboard_)
+    return;
+
+  map<string, Peer>::const_iterator peer_it = picked_peers_.find(url);
+  if (peer_it == picked_peers_.end()) {
+    LOG(WARNING) << "Ignoring download from unknown URL " << url;
+    return;
+  }
+  if (success)
+    scoreboard_->RecordDownload(peer_it->second, num_bytes, duration);
+  else
+    scoreboard_->RecordFailure(peer_it->second);
 }
 
 void PeerSelector::Abort() {
@@ -208,7 +405,7 @@ bool PeerSelector::ReportMetrics(MetricsLibraryInterface* metrics_lib) {
 
   if (lookup_result_ == kNumLookupResults) {
     LOG(ERROR) << "Invalid LookupResult from the previous GetUrlAndWait() "
-               << "call. Was it ever called?";
+               << "or GetUrlsAndWait() call. Was it ever called?";
     return false;
   }
 
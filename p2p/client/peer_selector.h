@@ -5,13 +5,19 @@
 #ifndef P2P_CLIENT_PEER_SELECTOR_H__
 #define P2P_CLIENT_PEER_SELECTOR_H__
 
+#include "p2p/client/peer_prober.h"
+#include "p2p/client/peer_scoreboard.h"
 #include "p2p/client/service_finder.h"
 #include "p2p/common/clock.h"
 
 #include <stdint.h>
 
+#include <map>
+#include <random>
 #include <string>
+#include <vector>
 
+#include <base/time/time.h>
 #include <gtest/gtest_prod.h>  // for FRIEND_TEST
 #include <metrics/metrics_library.h>
 
@@ -25,6 +31,14 @@ class PeerSelector {
   // Constructs the PeerSelector with the provided interfaces.
   PeerSelector(ServiceFinder* finder, p2p::common::ClockInterface* clock);
 
+  // Constructs a PeerSelector that chooses among the peers according to their
+  // score in |scoreboard|, after measuring their round-trip time with
+  // |prober| unless it is NULL. Neither of them is owned.
+  PeerSelector(ServiceFinder* finder,
+               p2p::common::ClockInterface* clock,
+               PeerScoreboard* scoreboard,
+               PeerProber* prober);
+
   // Finds an URL for the file |id| with at least |minimum_size| bytes and
   // waits until the number of connections in the LAN has dropped below the
   // required threshold. If there are no peers sharing this file with at least
@@ -32,7 +46,30 @@ class PeerSelector {
   // the LAN. On success, returns the URL found.
   std::string GetUrlAndWait(const std::string& id, size_t minimum_size);
 
-  // Reports the following metrics based on the last call to GetUrlAndWait():
+  // Like GetUrlAndWait(), but finds the URLs of up to |max_peers| peers
+  // sharing the largest available copy of the file |id|, for downloading
+  // disjoint ranges of it in parallel. The number of URLs returned is also
+  // limited so that the connections to them don't exceed the threshold of
+  // connections in the LAN. On success, stores the size of the file shared by
+  // those peers in |file_size|.
+  std::vector<std::string> GetUrlsAndWait(const std::string& id,
+                                          size_t minimum_size,
+                                          size_t max_peers,
+                                          size_t* file_size);
+
+  // Records in the scoreboard a download of |num_bytes| bytes that took
+  // |duration| from |url|, which was returned by the last call to
+  // GetUrlAndWait() or GetUrlsAndWait(). If |success| is false, the download
+  // failed. Does nothing if there is no scoreboard. Only p2p-client --download
+  // observes downloads: with --get-url, the caller downloads the file, so the
+  // peers it picks are only scored by round-trip time and load.
+  void ReportDownload(const std::string& url,
+                      uint64_t num_bytes,
+                      base::TimeDelta duration,
+                      bool success);
+
+  // Reports the following metrics based on the last call to GetUrlAndWait()
+  // or GetUrlsAndWait():
   //  * P2P.Client.LookupResult
   //  * P2P.Client.NumPeers
   //  * P2P.Client.Found.WaitingTimeSeconds
@@ -44,9 +81,9 @@ class PeerSelector {
   // returns true.
   bool ReportMetrics(MetricsLibraryInterface* metrics_lib);
 
-  // Abort() cancels any ongoing and future call to GetUrlAndWait() making it
-  // return an empty string as soon as possible. This function is
-  // Async-Signal-Safe and can be called several times.
+  // Abort() cancels any ongoing and future call to GetUrlAndWait() or
+  // GetUrlsAndWait() making it return no URL as soon as possible. This
+  // function is Async-Signal-Safe and can be called several times.
   void Abort();
 
  private:
@@ -55,23 +92,73 @@ class PeerSelector {
   FRIEND_TEST(PeerSelectorTest, PickUrlForIdWithZeroBytes);
   FRIEND_TEST(PeerSelectorTest, PickUrlForIdWithMinimumSize);
   FRIEND_TEST(PeerSelectorTest, PickUrlFromTheFirstThird);
+  FRIEND_TEST(PeerSelectorTest, PickUrlsForIdOnlyUsesLargestFiles);
+  FRIEND_TEST(PeerSelectorTest, PickUrlsForIdPrefersIdlePeers);
+  FRIEND_TEST(PeerSelectorScoringTest, PickUrlForIdAvoidsSlowPeers);
+  FRIEND_TEST(PeerSelectorScoringTest, PickUrlForIdTriesUnknownPeers);
+  FRIEND_TEST(PeerSelectorScoringTest, PickUrlsForIdSortsByScore);
+  FRIEND_TEST(PeerSelectorScoringTest, ProbesOnlyTheBestPeers);
+  FRIEND_TEST(PeerSelectorScoringTest, SimulateManyPeers);
   FRIEND_TEST(PeerSelectorTest, GetUrlAndWaitWhenThePeerGoesAway);
   FRIEND_TEST(PeerSelectorTest, GetUrlDoesntWaitForSmallFiles);
   FRIEND_TEST(PeerSelectorTest, ReportMetricsOnFilteredNetwork);
   FRIEND_TEST(PeerSelectorTest, ReportMetricsWhenFound);
   FRIEND_TEST(PeerSelectorTest, ReportMetricsWhenCanceled);
 
-  // file |id| with at least |minimum_size| bytes. If no peer is found meeting
+  // PickUrlForId() picks a random peer from the top third of peers sharing the
+  // file |id| with at least |minimum_size| bytes. With a scoreboard, the peer
+  // is instead picked among all of those peers at random, weighted by its
+  // score and by how much of the file it has. If no peer is found meeting
   // those conditions, an empty string is returned. Otherwise, the URL of the
   // provided file is returned.
   std::string PickUrlForId(const std::string& id, size_t minimum_size);
 
+  // PickUrlsForId() returns the URLs of up to |max_peers| peers sharing the
+  // largest copy of the file |id|, provided it has at least |minimum_size|
+  // bytes, with the peers serving the fewest connections, or with the best
+  // score if there is a scoreboard, first. The size of that copy is stored in
+  // |file_size|. If no peer is found meeting those conditions, an empty vector
+  // is returned.
+  std::vector<std::string> PickUrlsForId(const std::string& id,
+                                         size_t minimum_size,
+                                         size_t max_peers,
+                                         size_t* file_size);
+
+  // Measures the round-trip time of the peers in |peers| with the best
+  // scores, and records it in the scoreboard. Does nothing without a prober.
+  void ProbePeers(const std::vector<const Peer*>& peers);
+
+  // Returns the URL of the file |id| on |peer|, remembering the peer for
+  // ReportDownload().
+  std::string MakeUrl(const Peer* peer, const std::string& id);
+
+  // Implements GetUrlAndWait(), when |max_peers| is 1 and |file_size| is
+  // NULL, and GetUrlsAndWait().
+  std::vector<std::string> LookupUrlsAndWait(const std::string& id,
+                                             size_t minimum_size,
+                                             size_t max_peers,
+                                             size_t* file_size);
+
   // The underlying service finder class used.
   ServiceFinder* finder_;
 
   // An interface to the system clock functions, used for unit testing.
   p2p::common::ClockInterface* clock_;
 
+  // The scoreboard used to choose among peers, or NULL to not use one.
+  PeerScoreboard* scoreboard_;
+
+  // The prober measuring the round-trip time of peers, or NULL.
+  PeerProber* prober_;
+
+  // The random number generator used to pick peers, seeded at random. Tests
+  // seed it to pick the same peers on every run.
+  std::mt19937 rng_;
+
+  // The peers picked by the last call to PickUrlForId() or PickUrlsForId(),
+  // by URL.
+  std::map<std::string, Peer> picked_peers_;
+
   enum LookupResult {
     kFound,  // The resource was found.
     kNotFound,  // The resource was not found.
@@ -84,13 +171,14 @@ class PeerSelector {
   };
   static std::string ToString(LookupResult lookup_result);
 
-  // The result of the last GetUrlAndWait() call.
+  // The result of the last GetUrlAndWait() or GetUrlsAndWait() call.
   LookupResult lookup_result_;
 
   // Candidate files counter used for report metrics.
   int candidate_files_count_;
 
-  // The number of connections of the peer picked by PickUrlForId().
+  // The number of connections of the peer picked by PickUrlForId(), or of the
+  // first peer picked by PickUrlsForId().
   int victim_connections_;
 
   // The total number of peers in the network implementing P2P at the last
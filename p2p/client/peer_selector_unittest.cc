@@ -6,10 +6,19 @@
 #include "p2p/client/peer_selector.h"
 
 #include "p2p/client/fake_service_finder.h"
+#include "p2p/client/peer_prober.h"
+#include "p2p/client/peer_scoreboard.h"
+#include "p2p/common/constants.h"
 #include "p2p/common/fake_clock.h"
 #include "p2p/common/testutil.h"
 
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
 #include <string>
+#include <vector>
 
 #include <base/bind.h>
 #include <gmock/gmock.h>
@@ -80,6 +89,68 @@ TEST_F(PeerSelectorTest, PickUrlFromTheFirstThird) {
       "http://[2001:db8:85a3:0:0:8a2e:370:7334]:1111/some-file");
 }
 
+TEST_F(PeerSelectorTest, PickUrlsForIdOnlyUsesLargestFiles) {
+  int peer1 = sf_.NewPeer("10.0.0.1", false, 1111);
+  int peer2 = sf_.NewPeer("10.0.0.2", false, 2222);
+  int peer3 = sf_.NewPeer("2001:db8::3", true, 3333);
+  ASSERT_TRUE(sf_.PeerShareFile(peer1, "some-file", 500));
+  ASSERT_TRUE(sf_.PeerShareFile(peer2, "some-file", 1000));
+  ASSERT_TRUE(sf_.PeerShareFile(peer3, "some-file", 1000));
+
+  // Only the peers with the whole 1000 bytes can serve any range.
+  size_t file_size = 0;
+  std::vector<std::string> urls = ps_.PickUrlsForId("some-file", 1, 5,
+                                                    &file_size);
+  ASSERT_EQ(urls.size(), 2u);
+  EXPECT_EQ(urls[0], "http://10.0.0.2:2222/some-file");
+  EXPECT_EQ(urls[1], "http://[2001:db8::3]:3333/some-file");
+  EXPECT_EQ(file_size, 1000u);
+
+  // The largest file is too small.
+  EXPECT_TRUE(ps_.PickUrlsForId("some-file", 1001, 5, &file_size).empty());
+}
+
+TEST_F(PeerSelectorTest, PickUrlsForIdPrefersIdlePeers) {
+  int peer1 = sf_.NewPeer("10.0.0.1", false, 1111);
+  int peer2 = sf_.NewPeer("10.0.0.2", false, 2222);
+  int peer3 = sf_.NewPeer("10.0.0.3", false, 3333);
+  ASSERT_TRUE(sf_.PeerShareFile(peer1, "some-file", 1000));
+  ASSERT_TRUE(sf_.PeerShareFile(peer2, "some-file", 1000));
+  ASSERT_TRUE(sf_.PeerShareFile(peer3, "some-file", 1000));
+  ASSERT_TRUE(sf_.SetPeerConnections(peer1, 2));
+  ASSERT_TRUE(sf_.SetPeerConnections(peer3, 1));
+
+  size_t file_size = 0;
+  std::vector<std::string> urls = ps_.PickUrlsForId("some-file", 1, 2,
+                                                    &file_size);
+  ASSERT_EQ(urls.size(), 2u);
+  EXPECT_EQ(urls[0], "http://10.0.0.2:2222/some-file");
+  EXPECT_EQ(urls[1], "http://10.0.0.3:3333/some-file");
+  EXPECT_EQ(ps_.victim_connections_, 0);
+}
+
+TEST_F(PeerSelectorTest, GetUrlsAndWaitStaysBelowConnectionThreshold) {
+  int peer1 = sf_.NewPeer("10.0.0.1", false, 1111);
+  int peer2 = sf_.NewPeer("10.0.0.2", false, 2222);
+  int peer3 = sf_.NewPeer("10.0.0.3", false, 3333);
+  int peer4 = sf_.NewPeer("10.0.0.4", false, 4444);
+  ASSERT_TRUE(sf_.PeerShareFile(peer1, "some-file", 1000));
+  ASSERT_TRUE(sf_.PeerShareFile(peer2, "some-file", 1000));
+  ASSERT_TRUE(sf_.PeerShareFile(peer3, "some-file", 1000));
+  ASSERT_TRUE(sf_.PeerShareFile(peer4, "other-file", 1000));
+  // There is already a download in the LAN.
+  ASSERT_TRUE(sf_.SetPeerConnections(peer4, 1));
+
+  size_t file_size = 0;
+  std::vector<std::string> urls = ps_.GetUrlsAndWait("some-file", 1, 10,
+                                                     &file_size);
+  EXPECT_EQ(urls.size(),
+            static_cast<size_t>(constants::kMaxSimultaneousDownloads - 1));
+  EXPECT_EQ(file_size, 1000u);
+  EXPECT_EQ(sf_.GetNumLookupCalls(), 1);
+  EXPECT_EQ(clock_.GetSleptTime(), base::TimeDelta::FromSeconds(0));
+}
+
 TEST_F(PeerSelectorTest, GetUrlAndWaitWithNoPeers) {
   EXPECT_EQ(ps_.GetUrlAndWait("some-file", 1), "");
 
@@ -266,6 +337,214 @@ TEST_F(PeerSelectorTest, ReportMetricsWhenCanceled) {
   EXPECT_TRUE(ps_.ReportMetrics(&mock_metrics_lib_));
 }
 
+// A PeerProber returning a given round-trip time for each peer address.
+class FakePeerProber : public PeerProber {
+ public:
+  FakePeerProber() : num_probed_peers_(0) {}
+
+  void MeasureRtts(const std::vector<const Peer*>& peers,
+                   base::TimeDelta timeout,
+                   std::vector<base::TimeDelta>* rtts) override {
+    rtts->clear();
+    for (auto const& peer : peers) {
+      std::map<std::string, base::TimeDelta>::const_iterator rtt_it =
+          rtts_.find(peer->address);
+      rtts->push_back(rtt_it == rtts_.end() ? timeout :
+                      std::min(rtt_it->second, timeout));
+    }
+    num_probed_peers_ += peers.size();
+  }
+
+  void SetRtt(const std::string& address, base::TimeDelta rtt) {
+    rtts_[address] = rtt;
+  }
+
+  // The number of peers probed since the object creation.
+  size_t num_probed_peers() const { return num_probed_peers_; }
+
+ private:
+  std::map<std::string, base::TimeDelta> rtts_;
+  size_t num_probed_peers_;
+};
+
+class PeerSelectorScoringTest : public ::testing::Test {
+ public:
+  PeerSelectorScoringTest()
+      : scoreboard_(constants::kMaxScoreboardPeers),
+        ps_(&sf_, &clock_, &scoreboard_, &prober_) {}
+
+ protected:
+  p2p::common::FakeClock clock_;
+  FakeServiceFinder sf_;
+  FakePeerProber prober_;
+  PeerScoreboard scoreboard_;
+  PeerSelector ps_;  // The PeerSelector under test.
+};
+
+TEST_F(PeerSelectorScoringTest, PickUrlForIdAvoidsSlowPeers) {
+  int fast_peer = sf_.NewPeer("10.0.0.1", false, 1111);
+  int slow_peer = sf_.NewPeer("10.0.0.2", false, 2222);
+  ASSERT_TRUE(sf_.PeerShareFile(fast_peer, "some-file", 1000));
+  ASSERT_TRUE(sf_.PeerShareFile(slow_peer, "some-file", 1000));
+
+  // Download once from each peer.
+  std::string slow_url = "http://10.0.0.2:2222/some-file";
+  std::string fast_url = "http://10.0.0.1:1111/some-file";
+  while (ps_.PickUrlForId("some-file", 1) != slow_url) {}
+  ps_.ReportDownload(slow_url, 5000, base::TimeDelta::FromSeconds(1), true);
+  while (ps_.PickUrlForId("some-file", 1) != fast_url) {}
+  ps_.ReportDownload(fast_url, 100000, base::TimeDelta::FromSeconds(1),
+                     true);
+
+  // The slow peer is only tried once in a while.
+  std::map<std::string, int> picks;
+  for (int i = 0; i < 1000; i++)
+    picks[ps_.PickUrlForId("some-file", 1)]++;
+  EXPECT_GT(picks[fast_url], 900);
+  EXPECT_GT(picks[slow_url], 0);
+}
+
+TEST_F(PeerSelectorScoringTest, PickUrlForIdTriesUnknownPeers) {
+  int known_peer = sf_.NewPeer("10.0.0.1", false, 1111);
+  int new_peer = sf_.NewPeer("10.0.0.2", false, 2222);
+  ASSERT_TRUE(sf_.PeerShareFile(known_peer, "some-file", 1000));
+  ASSERT_TRUE(sf_.PeerShareFile(new_peer, "some-file", 1000));
+
+  std::string known_url = "http://10.0.0.1:1111/some-file";
+  while (ps_.PickUrlForId("some-file", 1) != known_url) {}
+  ps_.ReportDownload(known_url, 0, base::TimeDelta::FromSeconds(1), false);
+
+  std::map<std::string, int> picks;
+  for (int i = 0; i < 100; i++)
+    picks[ps_.PickUrlForId("some-file", 1)]++;
+  EXPECT_GT(picks["http://10.0.0.2:2222/some-file"], 90);
+}
+
+TEST_F(PeerSelectorScoringTest, PickUrlsForIdSortsByScore) {
+  int peer1 = sf_.NewPeer("10.0.0.1", false, 1111);
+  int peer2 = sf_.NewPeer("10.0.0.2", false, 2222);
+  int peer3 = sf_.NewPeer("10.0.0.3", false, 3333);
+  ASSERT_TRUE(sf_.PeerShareFile(peer1, "some-file", 1000));
+  ASSERT_TRUE(sf_.PeerShareFile(peer2, "some-file", 1000));
+  ASSERT_TRUE(sf_.PeerShareFile(peer3, "some-file", 1000));
+  prober_.SetRtt("10.0.0.1", base::TimeDelta::FromMilliseconds(100));
+  prober_.SetRtt("10.0.0.2", base::TimeDelta::FromMilliseconds(2));
+  prober_.SetRtt("10.0.0.3", base::TimeDelta::FromMilliseconds(10));
+  // Without the connections it serves, peer3 would come first.
+  ASSERT_TRUE(sf_.SetPeerConnections(peer3, 1));
+
+  size_t file_size = 0;
+  std::vector<std::string> urls = ps_.PickUrlsForId("some-file", 1, 3,
+                                                    &file_size);
+  ASSERT_EQ(urls.size(), 3u);
+  EXPECT_EQ(urls[0], "http://10.0.0.2:2222/some-file");
+  EXPECT_EQ(urls[1], "http://10.0.0.3:3333/some-file");
+  EXPECT_EQ(urls[2], "http://10.0.0.1:1111/some-file");
+}
+
+TEST_F(PeerSelectorScoringTest, ProbesOnlyTheBestPeers) {
+  for (int i = 0; i < 20; i++) {
+    int peer = sf_.NewPeer("10.0.0." + std::to_string(i + 1), false, 1111);
+    ASSERT_TRUE(sf_.PeerShareFile(peer, "some-file", 1000));
+  }
+  EXPECT_NE(ps_.PickUrlForId("some-file", 1), "");
+  EXPECT_EQ(prober_.num_probed_peers(), 8u);
+}
+
+TEST_F(PeerSelectorScoringTest, ReportDownloadIgnoresUnknownUrls) {
+  ps_.ReportDownload("http://10.0.0.1:1111/some-file", 1000,
+                     base::TimeDelta::FromSeconds(1), true);
+  EXPECT_EQ(scoreboard_.num_peers(), 0u);
+}
+
+// Simulates a LAN with many peers: a third of them are wired, a third are on
+// a good wireless link and a third are on a congested wireless link that is
+// slow and has a long round-trip time. Every peer also serves a varying
+// number of other downloads. Compares the average speed of the downloads
+// from the peers picked with and without a scoreboard.
+// Simulates picking a peer for --get-url among many peers on wired, good and
+// congested wireless links, with and without a scoreboard. With --get-url the
+// caller downloads the file, so the scoreboard only learns the round-trip
+// time and the load of the peers, not their throughput. The picks are seeded
+// and each download advances the fake clock, so every run picks the same
+// peers.
+TEST_F(PeerSelectorScoringTest, SimulateManyPeers) {
+  const int kNumPeers = 60;
+  const int kNumDownloads = 1000;
+  const size_t kFileSize = 10 * 1000 * 1000;
+
+  struct SimulatedPeer {
+    int id;
+    double uplink;  // In bytes per second.
+    bool congested;
+  };
+  std::map<std::string, SimulatedPeer> peers;
+  for (int i = 0; i < kNumPeers; i++) {
+    std::string address = "10.0." + std::to_string(i / 200) + "." +
+        std::to_string(i % 200 + 1);
+    SimulatedPeer peer;
+    peer.id = sf_.NewPeer(address, false, constants::kHttpServerDefaultPort);
+    ASSERT_TRUE(sf_.PeerShareFile(peer.id, "some-file", kFileSize));
+    int64_t rtt_ms;
+    switch (i % 3) {
+      case 0:
+        peer.uplink = 10e6;
+        rtt_ms = 1;
+        break;
+      case 1:
+        peer.uplink = 150e3;
+        rtt_ms = 15;
+        break;
+      default:
+        peer.uplink = 40e3;
+        rtt_ms = 150;
+        break;
+    }
+    peer.congested = i % 3 == 2;
+    prober_.SetRtt(address, base::TimeDelta::FromMilliseconds(rtt_ms));
+    peers["http://" + address + ":" +
+          std::to_string(constants::kHttpServerDefaultPort) + "/some-file"] =
+        peer;
+  }
+
+  PeerSelector unscored_ps(&sf_, &clock_);
+  unscored_ps.rng_.seed(1);
+  ps_.rng_.seed(1);
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> connections(0, 2);
+  double total_speed[2] = {0, 0};
+  int congested_picks[2] = {0, 0};
+  for (int i = 0; i < kNumDownloads; i++) {
+    for (auto const& peer : peers)
+      ASSERT_TRUE(sf_.SetPeerConnections(peer.second.id, connections(rng)));
+
+    for (int scored = 0; scored < 2; scored++) {
+      PeerSelector* ps = scored ? &ps_ : &unscored_ps;
+      std::string url = ps->PickUrlForId("some-file", 1);
+      ASSERT_EQ(peers.count(url), 1u);
+
+      // The download gets its share of the uplink of the peer, up to the
+      // speed limit of a download.
+      double speed = std::min(
+          peers[url].uplink / (1 + ps->victim_connections_),
+          static_cast<double>(constants::kMaxSpeedPerDownload));
+      total_speed[scored] += speed;
+      if (peers[url].congested)
+        congested_picks[scored]++;
+      clock_.Sleep(base::TimeDelta::FromMilliseconds(kFileSize * 1000 / speed));
+    }
+  }
+
+  printf("Average download speed from %d peers: %.0f bytes/s without "
+         "scoreboard, %.0f bytes/s with scoreboard\n",
+         kNumPeers, total_speed[0] / kNumDownloads,
+         total_speed[1] / kNumDownloads);
+  printf("Downloads from congested peers: %d without scoreboard, %d with "
+         "scoreboard\n", congested_picks[0], congested_picks[1]);
+  EXPECT_LT(congested_picks[1], congested_picks[0]);
+  EXPECT_GT(total_speed[1], total_speed[0]);
+}
+
 }  // namespace client
 
 }  // namespace p2p
@@ -0,0 +1,550 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "p2p/client/range_downloader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/threading/simple_thread.h>
+
+using base::TimeDelta;
+using std::string;
+using std::vector;
+
+namespace p2p {
+
+namespace client {
+
+namespace {
+
+// The default size of the smallest range taken over from another peer. At
+// the speed a peer serves a single download, this is about half a second.
+const uint64_t kDefaultMinStealSize = 64 * 1024;
+
+// The default time without receiving data after which a peer is considered
+// to have failed.
+const int kDefaultIdleTimeoutSeconds = 30;
+
+// The interval at which a blocked peer thread checks for Abort().
+const int kPollIntervalMs = 1000;
+
+// The maximum size of the headers of a response.
+const size_t kMaxHeaderSize = 16 * 1024;
+
+const size_t kReceiveBufferSize = 64 * 1024;
+
+// Splits the URL |url| of the form "http://host:port/path", where the host
+// may be an IPv6 address in brackets, into its parts.
+bool ParseUrl(const string& url, string* host, string* port, string* path) {
+  const string kScheme = "http://";
+  if (url.compare(0, kScheme.size(), kScheme) != 0)
+    return false;
+
+  size_t path_pos = url.find('/', kScheme.size());
+  if (path_pos == string::npos)
+    return false;
+  string authority = url.substr(kScheme.size(), path_pos - kScheme.size());
+  *path = url.substr(path_pos);
+
+  size_t port_pos = authority.rfind(':');
+  size_t bracket_pos = authority.rfind(']');
+  if (port_pos == string::npos ||
+      (bracket_pos != string::npos && port_pos < bracket_pos))
+    return false;
+  *host = authority.substr(0, port_pos);
+  *port = authority.substr(port_pos + 1);
+  if (host->size() > 2 && (*host)[0] == '[' && (*host)[host->size() - 1] == ']')
+    *host = host->substr(1, host->size() - 2);
+  return !host->empty() && !port->empty();
+}
+
+// Connects to |host| on |port|. Returns the connected socket, or -1 on
+// failure.
+int ConnectToHost(const string& host, const string& port, TimeDelta timeout) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICSERV;
+
+  struct addrinfo* addresses = NULL;
+  int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+  if (rc != 0) {
+    LOG(ERROR) << "Error resolving " << host << ": " << gai_strerror(rc);
+    return -1;
+  }
+
+  // The send timeout also bounds the time connect() blocks.
+  struct timeval tv;
+  tv.tv_sec = timeout.InSeconds();
+  tv.tv_usec = 0;
+
+  int sock = -1;
+  for (struct addrinfo* ai = addresses; ai != NULL; ai = ai->ai_next) {
+    sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                  ai->ai_protocol);
+    if (sock == -1)
+      continue;
+    if (setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) == 0 &&
+        HANDLE_EINTR(connect(sock, ai->ai_addr, ai->ai_addrlen)) == 0)
+      break;
+    PLOG(ERROR) << "Error connecting to " << host << ":" << port;
+    close(sock);
+    sock = -1;
+  }
+  freeaddrinfo(addresses);
+  return sock;
+}
+
+bool SendAll(int sock, const string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t rc = HANDLE_EINTR(
+        send(sock, data.data() + sent, data.size() - sent, MSG_NOSIGNAL));
+    if (rc < 0) {
+      PLOG(ERROR) << "Error sending request";
+      return false;
+    }
+    sent += rc;
+  }
+  return true;
+}
+
+// Parses the status line and headers of a response to a request for the
+// range starting at |range_begin|, in |headers|. Returns true if it is a
+// response with the requested range, storing the size of the whole file in
+// |file_size|.
+bool ParseRangeResponse(const string& headers, uint64_t range_begin,
+                        uint64_t* file_size) {
+  int status_code = 0;
+  if (sscanf(headers.c_str(), "HTTP/%*d.%*d %d", &status_code) != 1 ||
+      status_code != 206) {
+    LOG(ERROR) << "Unexpected response: "
+               << headers.substr(0, headers.find("\r\n"));
+    return false;
+  }
+
+  const string kContentRange = "content-range:";
+  size_t pos = 0;
+  while ((pos = headers.find("\r\n", pos)) != string::npos) {
+    pos += 2;
+    if (strncasecmp(headers.c_str() + pos, kContentRange.c_str(),
+                    kContentRange.size()) != 0)
+      continue;
+
+    // RFC 2616 specifies "bytes first-last/length", while p2p-http-server
+    // omits the "bytes " unit.
+    const char* value = headers.c_str() + pos + kContentRange.size();
+    value += strspn(value, " ");
+    if (strncasecmp(value, "bytes ", 6) == 0)
+      value += 6;
+    uint64_t first;
+    if (sscanf(value, "%" SCNu64 "-%*" SCNu64 "/%" SCNu64, &first,
+               file_size) != 2 ||
+        first != range_begin) {
+      LOG(ERROR) << "Unexpected Content-Range in response";
+      return false;
+    }
+    return true;
+  }
+  LOG(ERROR) << "No Content-Range in response";
+  return false;
+}
+
+}  // namespace
+
+class RangeDownloader::PeerDelegate
+    : public base::DelegateSimpleThread::Delegate {
+ public:
+  PeerDelegate(RangeDownloader* downloader, size_t peer)
+      : downloader_(downloader), peer_(peer) {}
+
+  void Run() override { downloader_->RunPeer(peer_); }
+
+ private:
+  RangeDownloader* downloader_;
+  size_t peer_;
+
+  DISALLOW_COPY_AND_ASSIGN(PeerDelegate);
+};
+
+RangeDownloader::RangeDownloader(const vector<string>& urls,
+                                 uint64_t advertised_size,
+                                 int output_fd,
+                                 p2p::common::ClockInterface* clock)
+    : urls_(urls),
+      advertised_size_(advertised_size),
+      output_fd_(output_fd),
+      clock_(clock),
+      min_steal_size_(kDefaultMinStealSize),
+      idle_timeout_(TimeDelta::FromSeconds(kDefaultIdleTimeoutSeconds)),
+      range_released_(&lock_),
+      file_size_(0),
+      file_size_known_(false),
+      bytes_written_(0),
+      write_failed_(false),
+      must_exit_now_(false) {
+}
+
+bool RangeDownloader::Run() {
+  if (urls_.empty()) {
+    LOG(ERROR) << "No peer to download from";
+    return false;
+  }
+
+  // There is no range to request for an empty file, so no peer reports
+  // its size.
+  if (advertised_size_ == 0 && !AllocateOutputFile(0))
+    return false;
+
+  base::Time start_time = clock_->GetMonotonicTime();
+  size_t num_peers = urls_.size();
+  {
+    base::AutoLock auto_lock(lock_);
+    file_size_ = 0;
+    file_size_known_ = advertised_size_ == 0;
+    released_ranges_.clear();
+    active_ranges_.clear();
+    for (size_t i = 0; i < num_peers; i++) {
+      active_ranges_.push_back({advertised_size_ * i / num_peers,
+                                advertised_size_ * (i + 1) / num_peers});
+    }
+    bytes_written_ = 0;
+    write_failed_ = false;
+  }
+  peer_stats_.assign(num_peers, PeerStats());
+
+  vector<std::unique_ptr<PeerDelegate>> delegates;
+  vector<std::unique_ptr<base::DelegateSimpleThread>> threads;
+  for (size_t i = 0; i < num_peers; i++) {
+    peer_stats_[i].url = urls_[i];
+    delegates.emplace_back(new PeerDelegate(this, i));
+    threads.emplace_back(new base::DelegateSimpleThread(
+        delegates.back().get(), "range-downloader"));
+    threads.back()->Start();
+  }
+  for (auto const& thread : threads)
+    thread->Join();
+
+  elapsed_time_ = clock_->GetMonotonicTime() - start_time;
+  for (auto const& stats : peer_stats_) {
+    LOG(INFO) << "Received " << stats.bytes_received << " bytes in "
+              << stats.num_ranges << " range(s), " << stats.num_stolen_ranges
+              << " taken over, from " << stats.url << " in "
+              << stats.time_spent.InMilliseconds() << " ms"
+              << (stats.failed ? " before failing" : "");
+  }
+
+  base::AutoLock auto_lock(lock_);
+  if (must_exit_now_ || write_failed_ || !file_size_known_ ||
+      bytes_written_ != file_size_) {
+    LOG(ERROR) << "Downloaded " << bytes_written_ << " of "
+               << std::max(file_size_, advertised_size_) << " bytes";
+    return false;
+  }
+  int64_t elapsed_ms = std::max(elapsed_time_.InMilliseconds(),
+                                static_cast<int64_t>(1));
+  LOG(INFO) << "Downloaded " << file_size_ << " bytes from " << num_peers
+            << " peer(s) in " << elapsed_ms << " ms ("
+            << file_size_ * 1000 / elapsed_ms << " bytes/s)";
+  return true;
+}
+
+void RangeDownloader::Abort() {
+  must_exit_now_ = true;
+}
+
+void RangeDownloader::RunPeer(size_t peer) {
+  bool has_range;
+  {
+    base::AutoLock auto_lock(lock_);
+    has_range = active_ranges_[peer].size() > 0;
+  }
+
+  while (has_range || TakeRange(peer)) {
+    has_range = false;
+    peer_stats_[peer].num_ranges++;
+    base::Time start_time = clock_->GetMonotonicTime();
+    bool success = DownloadRange(peer);
+    peer_stats_[peer].time_spent += clock_->GetMonotonicTime() - start_time;
+    ReleaseRange(peer);
+    if (!success) {
+      peer_stats_[peer].failed = !must_exit_now_;
+      break;
+    }
+  }
+}
+
+bool RangeDownloader::TakeRange(size_t peer) {
+  base::AutoLock auto_lock(lock_);
+  while (!must_exit_now_ && !write_failed_) {
+    if (!released_ranges_.empty()) {
+      active_ranges_[peer] = released_ranges_.front();
+      released_ranges_.pop_front();
+      return true;
+    }
+
+    // All the peers started with a range of the same size, so the peer with
+    // the most left to download is the slowest one.
+    size_t victim = 0;
+    uint64_t largest_size = 0;
+    for (size_t i = 0; i < active_ranges_.size(); i++) {
+      if (active_ranges_[i].size() > largest_size) {
+        victim = i;
+        largest_size = active_ranges_[i].size();
+      }
+    }
+    if (largest_size == 0)
+      return false;
+
+    if (largest_size >= 2 * min_steal_size_) {
+      Range* victim_range = &active_ranges_[victim];
+      uint64_t middle = victim_range->begin + largest_size / 2;
+      active_ranges_[peer] = {middle, victim_range->end};
+      victim_range->end = middle;
+      peer_stats_[peer].num_stolen_ranges++;
+      VLOG(1) << "Taking over bytes " << middle << "-"
+              << active_ranges_[peer].end << " from " << urls_[victim];
+      return true;
+    }
+
+    // The ranges left are too small to split, but the peers downloading them
+    // could still fail.
+    range_released_.TimedWait(TimeDelta::FromMilliseconds(kPollIntervalMs));
+  }
+  return false;
+}
+
+size_t RangeDownloader::ClaimData(size_t peer, size_t length,
+                                  uint64_t* offset, bool* range_complete) {
+  base::AutoLock auto_lock(lock_);
+  Range* range = &active_ranges_[peer];
+  size_t claimed = std::min(static_cast<uint64_t>(length), range->size());
+  *offset = range->begin;
+  range->begin += claimed;
+  *range_complete = range->size() == 0;
+  return claimed;
+}
+
+bool RangeDownloader::SetFileSize(size_t peer, uint64_t file_size) {
+  base::AutoLock auto_lock(lock_);
+  if (file_size_known_) {
+    if (file_size == file_size_)
+      return true;
+    LOG(ERROR) << urls_[peer] << " reports a file of " << file_size
+               << " bytes, other peers of " << file_size_ << " bytes";
+    return false;
+  }
+
+  // The file only grows while the peers download it.
+  if (file_size < advertised_size_) {
+    LOG(ERROR) << urls_[peer] << " reports a file of " << file_size
+               << " bytes, smaller than the " << advertised_size_
+               << " bytes advertised";
+    return false;
+  }
+  if (!AllocateOutputFile(file_size)) {
+    write_failed_ = true;
+    must_exit_now_ = true;
+    return false;
+  }
+  file_size_ = file_size;
+  file_size_known_ = true;
+  if (file_size_ > advertised_size_) {
+    VLOG(1) << "The file grew from " << advertised_size_ << " to "
+            << file_size_ << " bytes";
+    released_ranges_.push_back({advertised_size_, file_size_});
+    range_released_.Broadcast();
+  }
+  return true;
+}
+
+bool RangeDownloader::AllocateOutputFile(uint64_t file_size) {
+  // Allocate the whole file up front, so a full disk fails the download
+  // before the ranges are transferred and they are written without
+  // fragmenting the file.
+  if (HANDLE_EINTR(ftruncate(output_fd_, file_size)) != 0) {
+    PLOG(ERROR) << "Error resizing the output file to " << file_size
+                << " bytes";
+    return false;
+  }
+  if (file_size > 0) {
+    int rc = posix_fallocate(output_fd_, 0, file_size);
+    if (rc == ENOSPC) {
+      LOG(ERROR) << "Not enough space for " << file_size << " bytes";
+      return false;
+    }
+    if (rc != 0)
+      VLOG(1) << "Not preallocating the output file: " << strerror(rc);
+  }
+  return true;
+}
+
+void RangeDownloader::ReleaseRange(size_t peer) {
+  base::AutoLock auto_lock(lock_);
+  if (active_ranges_[peer].size() > 0)
+    released_ranges_.push_back(active_ranges_[peer]);
+  active_ranges_[peer] = {0, 0};
+  range_released_.Broadcast();
+}
+
+bool RangeDownloader::DownloadRange(size_t peer) {
+  Range range;
+  {
+    base::AutoLock auto_lock(lock_);
+    range = active_ranges_[peer];
+  }
+
+  string host, port, path;
+  if (!ParseUrl(urls_[peer], &host, &port, &path)) {
+    LOG(ERROR) << "Invalid URL " << urls_[peer];
+    return false;
+  }
+
+  VLOG(1) << "Requesting bytes " << range.begin << "-" << range.end
+          << " from " << urls_[peer];
+  int sock = ConnectToHost(host, port, idle_timeout_);
+  if (sock == -1)
+    return false;
+
+  // The peer may only send part of the range if another peer takes over the
+  // rest, so the connection is not reused.
+  string host_header = host.find(':') == string::npos ? host :
+      "[" + host + "]";
+  string request = "GET " + path + " HTTP/1.1\r\n"
+      "Host: " + host_header + ":" + port + "\r\n"
+      "Range: bytes=" + std::to_string(range.begin) + "-" +
+      std::to_string(range.end - 1) + "\r\n"
+      "Connection: close\r\n"
+      "\r\n";
+
+  bool success = false;
+  string headers;
+  size_t headers_end = string::npos;
+  if (SendAll(sock, request)) {
+    char buf[4096];
+    while (headers_end == string::npos && headers.size() < kMaxHeaderSize &&
+           WaitForData(sock)) {
+      ssize_t num_recv = HANDLE_EINTR(recv(sock, buf, sizeof(buf), 0));
+      if (num_recv <= 0)
+        break;
+      headers.append(buf, num_recv);
+      headers_end = headers.find("\r\n\r\n");
+    }
+  }
+  uint64_t file_size = 0;
+  if (headers_end != string::npos &&
+      ParseRangeResponse(headers.substr(0, headers_end + 2), range.begin,
+                         &file_size) &&
+      SetFileSize(peer, file_size)) {
+    success = ReceiveRange(peer, sock, headers.data() + headers_end + 4,
+                           headers.size() - headers_end - 4);
+  }
+  close(sock);
+
+  if (!success && !must_exit_now_)
+    LOG(ERROR) << "Error downloading a range from " << urls_[peer];
+  return success;
+}
+
+bool RangeDownloader::ReceiveRange(size_t peer, int sock, const char* data,
+                                   size_t data_length) {
+  std::unique_ptr<char[]> buf(new char[kReceiveBufferSize]);
+  while (true) {
+    size_t consumed = 0;
+    bool range_complete = false;
+    while (!range_complete && consumed < data_length) {
+      uint64_t offset;
+      size_t length = ClaimData(peer, data_length - consumed, &offset,
+                                &range_complete);
+      if (length > 0 && !WriteData(data + consumed, length, offset))
+        return false;
+      peer_stats_[peer].bytes_received += length;
+      consumed += length;
+    }
+    if (!range_complete) {
+      // Check whether the range was shortened to what was already received.
+      uint64_t offset;
+      ClaimData(peer, 0, &offset, &range_complete);
+    }
+    if (range_complete)
+      return true;
+
+    if (!WaitForData(sock))
+      return false;
+    ssize_t num_recv =
+        HANDLE_EINTR(recv(sock, buf.get(), kReceiveBufferSize, 0));
+    if (num_recv < 0) {
+      PLOG(ERROR) << "Error receiving from " << urls_[peer];
+      return false;
+    }
+    if (num_recv == 0) {
+      LOG(ERROR) << "Connection to " << urls_[peer] << " closed early";
+      return false;
+    }
+    data = buf.get();
+    data_length = num_recv;
+  }
+}
+
+bool RangeDownloader::WaitForData(int sock) {
+  struct pollfd pfd = {sock, POLLIN, 0};
+  int64_t waited_ms = 0;
+  while (!must_exit_now_) {
+    int rc = poll(&pfd, 1, kPollIntervalMs);
+    if (rc > 0)
+      return true;
+    if (rc < 0 && errno != EINTR) {
+      PLOG(ERROR) << "Error polling socket";
+      return false;
+    }
+    waited_ms += kPollIntervalMs;
+    if (waited_ms >= idle_timeout_.InMilliseconds()) {
+      LOG(ERROR) << "Timeout waiting for data";
+      return false;
+    }
+  }
+  return false;
+}
+
+bool RangeDownloader::WriteData(const char* data, size_t length,
+                                uint64_t offset) {
+  size_t written = 0;
+  while (written < length) {
+    ssize_t rc = HANDLE_EINTR(pwrite(output_fd_, data + written,
+                                     length - written, offset + written));
+    if (rc < 0) {
+      PLOG(ERROR) << "Error writing to the output file";
+      base::AutoLock auto_lock(lock_);
+      write_failed_ = true;
+      must_exit_now_ = true;
+      return false;
+    }
+    written += rc;
+  }
+
+  base::AutoLock auto_lock(lock_);
+  bytes_written_ += length;
+  return true;
+}
+
+}  // namespace client
+
+}  // namespace p2p
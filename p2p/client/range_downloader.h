@@ -0,0 +1,216 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef P2P_CLIENT_RANGE_DOWNLOADER_H__
+#define P2P_CLIENT_RANGE_DOWNLOADER_H__
+
+#include "p2p/common/clock_interface.h"
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/synchronization/condition_variable.h>
+#include <base/synchronization/lock.h>
+#include <base/time/time.h>
+
+namespace p2p {
+
+namespace client {
+
+// RangeDownloader downloads a file from several peers in parallel, fetching
+// disjoint byte ranges of it from each peer with HTTP Range requests.
+//
+// The file is initially split evenly among the peers. A peer that completes
+// its range takes over the second half of what is left of the largest range
+// still in progress, which belongs to the slowest peer. The unfinished range
+// of a peer that fails is handed over to the remaining peers. The data is
+// written at its offset in an output file preallocated to the size of the
+// file, so the ranges can complete in any order.
+//
+// The peers may still be downloading the file themselves, so the size they
+// advertise can be smaller than the file. The size of the file is the length
+// in the Content-Range of the first response, which every peer must agree
+// on; the part of the file past the advertised size is handed over like the
+// range of a failed peer.
+class RangeDownloader {
+ public:
+  // Statistics about the download from one peer.
+  struct PeerStats {
+    std::string url;
+
+    // The number of bytes of the file received from the peer.
+    uint64_t bytes_received = 0;
+
+    // The number of ranges requested from the peer.
+    int num_ranges = 0;
+
+    // The number of those ranges taken over from other peers.
+    int num_stolen_ranges = 0;
+
+    // Whether the peer failed to serve a range.
+    bool failed = false;
+
+    // The time spent downloading ranges from the peer, not counting the time
+    // waiting for a range to download.
+    base::TimeDelta time_spent;
+  };
+
+  // Constructs a RangeDownloader for the file served at each URL in |urls|,
+  // which the peers advertised with a size of |advertised_size| bytes, that
+  // is written to the file descriptor |output_fd|. The file descriptor must
+  // be open for writing and is not owned.
+  RangeDownloader(const std::vector<std::string>& urls,
+                  uint64_t advertised_size,
+                  int output_fd,
+                  p2p::common::ClockInterface* clock);
+
+  // Downloads the file into the output file, blocking until every byte was
+  // written, every peer failed or Abort() was called. Returns true if the
+  // whole file was downloaded.
+  bool Run();
+
+  // Abort() makes any ongoing and future call to Run() return false as soon
+  // as possible. This function is Async-Signal-Safe and can be called several
+  // times.
+  void Abort();
+
+  // Returns the statistics of each peer, in the order of the URLs. Only valid
+  // after Run() returns.
+  const std::vector<PeerStats>& peer_stats() const { return peer_stats_; }
+
+  // Returns the time spent by the last call to Run().
+  base::TimeDelta elapsed_time() const { return elapsed_time_; }
+
+  // Returns the size of the file reported by the peers, or 0 if none of
+  // them responded. Only valid after Run() returns.
+  uint64_t file_size() const { return file_size_; }
+
+  // Sets the size of the smallest range that can be taken over by another
+  // peer. Ranges with less than twice this size left are not split.
+  void set_min_steal_size(uint64_t min_steal_size) {
+    min_steal_size_ = min_steal_size;
+  }
+
+  // Sets the time without receiving data after which a peer is considered
+  // to have failed.
+  void set_idle_timeout(base::TimeDelta idle_timeout) {
+    idle_timeout_ = idle_timeout;
+  }
+
+ private:
+  // Runs RunPeer() for one peer on a base::DelegateSimpleThread.
+  class PeerDelegate;
+
+  // A range [begin, end) of the file. For the range being downloaded from a
+  // peer, |begin| is the offset where the next byte received goes.
+  struct Range {
+    uint64_t begin;
+    uint64_t end;
+
+    uint64_t size() const { return end - begin; }
+  };
+
+  // Downloads ranges from the peer |peer| until there is nothing left to
+  // take or the peer fails. Runs on its own thread.
+  void RunPeer(size_t peer);
+
+  // Assigns the next range to download to |peer|: a range released by a
+  // failed peer or else the second half of the largest range in progress.
+  // Blocks while there is none but other peers could still fail. Returns
+  // false if there is nothing left to download.
+  bool TakeRange(size_t peer);
+
+  // Reserves the next |length| bytes of the range of |peer|, or less if the
+  // range was shortened by another peer taking it over, for the data just
+  // received. Stores the offset where the data goes in |offset| and whether
+  // the range is complete after that in |range_complete|. Returns the number
+  // of bytes reserved.
+  size_t ClaimData(size_t peer, size_t length, uint64_t* offset,
+                   bool* range_complete);
+
+  // Checks the size of the file |file_size| reported by |peer| against the
+  // one reported by the other peers. The first size reported must be at
+  // least the advertised size; it sets the size of the output file and the
+  // part past the advertised size is released to the peers. Returns false if
+  // the size is rejected or the output file can't be resized.
+  bool SetFileSize(size_t peer, uint64_t file_size);
+
+  // Resizes the output file to |file_size| bytes and preallocates it.
+  bool AllocateOutputFile(uint64_t file_size);
+
+  // Marks the range of |peer| as done, releasing its unfinished part, if
+  // any, to the other peers.
+  void ReleaseRange(size_t peer);
+
+  // Requests the range assigned to |peer| from it and writes the data
+  // received. Returns false if the peer fails to serve the range.
+  bool DownloadRange(size_t peer);
+
+  // Receives the body of the response to the range request of |peer| on the
+  // socket |sock|. |data| holds the first |data_length| bytes of the body,
+  // received along with the headers.
+  bool ReceiveRange(size_t peer, int sock, const char* data,
+                    size_t data_length);
+
+  // Waits until there is data to receive on the socket |sock|. Returns false
+  // on timeout or if the download was aborted.
+  bool WaitForData(int sock);
+
+  // Writes the |length| bytes of |data| to the output file at |offset|.
+  // Aborts the download on failure.
+  bool WriteData(const char* data, size_t length, uint64_t offset);
+
+  const std::vector<std::string> urls_;
+  const uint64_t advertised_size_;
+  const int output_fd_;
+
+  // An interface to the system clock functions, used for unit testing.
+  p2p::common::ClockInterface* clock_;
+
+  uint64_t min_steal_size_;
+  base::TimeDelta idle_timeout_;
+
+  // Protects the members below, up to |write_failed_|.
+  base::Lock lock_;
+
+  // Signaled when a range is released.
+  base::ConditionVariable range_released_;
+
+  // Ranges left by failed peers, not assigned to any peer.
+  std::deque<Range> released_ranges_;
+
+  // The range being downloaded from each peer. An empty range means the peer
+  // is not downloading.
+  std::vector<Range> active_ranges_;
+
+  // The size of the file, once |file_size_known_|.
+  uint64_t file_size_;
+  bool file_size_known_;
+
+  // The number of bytes written to the output file.
+  uint64_t bytes_written_;
+
+  // Whether writing to the output file failed.
+  bool write_failed_;
+
+  // Each entry is only modified by the thread of its peer.
+  std::vector<PeerStats> peer_stats_;
+
+  base::TimeDelta elapsed_time_;
+
+  // A flag used to signal the download was canceled.
+  volatile bool must_exit_now_;
+
+  DISALLOW_COPY_AND_ASSIGN(RangeDownloader);
+};
+
+}  // namespace client
+
+}  // namespace p2p
+
+#endif  // P2P_CLIENT_RANGE_DOWNLOADER_H__
@@ -0,0 +1,85 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Downloads a file of twice kMaxSpeedPerDownload bytes with RangeDownloader
+// from one to four FakeRangeServers on loopback. Each server is throttled to
+// kMaxSpeedPerDownload like p2p-http-server, so a single peer takes about two
+// seconds. The printed rate should grow roughly in step with the number of
+// peers; a rate that stays flat means the ranges are not fetched in parallel.
+
+#include "p2p/client/fake_range_server.h"
+#include "p2p/client/range_downloader.h"
+#include "p2p/common/clock.h"
+#include "p2p/common/constants.h"
+#include "p2p/common/testutil.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/rand_util.h>
+#include <gtest/gtest.h>
+
+using base::FilePath;
+using p2p::testutil::SetupTestDir;
+using p2p::testutil::TeardownTestDir;
+using std::string;
+using std::vector;
+
+namespace p2p {
+
+namespace client {
+
+TEST(RangeDownloaderBenchmark, Loopback) {
+  const int kMaxPeers = 4;
+  const string data =
+      base::RandBytesAsString(2 * constants::kMaxSpeedPerDownload);
+  vector<std::unique_ptr<FakeRangeServer>> servers;
+  vector<string> all_urls;
+  for (int i = 0; i < kMaxPeers; i++) {
+    servers.emplace_back(new FakeRangeServer(
+        data, constants::kMaxSpeedPerDownload, UINT64_MAX));
+    ASSERT_TRUE(servers.back()->Start());
+    all_urls.push_back(servers.back()->Url());
+  }
+
+  FilePath testdir_path = SetupTestDir("range-downloader-benchmark");
+  FilePath output_path = testdir_path.Append("output");
+  int output_fd = open(output_path.value().c_str(),
+                       O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+  ASSERT_NE(output_fd, -1);
+  p2p::common::Clock clock;
+
+  for (int num_peers = 1; num_peers <= kMaxPeers; num_peers++) {
+    ASSERT_EQ(0, ftruncate(output_fd, 0));
+    vector<string> urls(all_urls.begin(), all_urls.begin() + num_peers);
+    RangeDownloader downloader(urls, data.size(), output_fd, &clock);
+    ASSERT_TRUE(downloader.Run());
+    string output;
+    EXPECT_TRUE(base::ReadFileToString(output_path, &output));
+    EXPECT_TRUE(output == data);
+
+    int64_t elapsed_ms = std::max(downloader.elapsed_time().InMilliseconds(),
+                                  static_cast<int64_t>(1));
+    printf("%d peer(s): %zu bytes in %" PRId64 " ms, %" PRId64 " bytes/s\n",
+           num_peers, data.size(), elapsed_ms,
+           static_cast<int64_t>(data.size() * 1000 / elapsed_ms));
+  }
+
+  EXPECT_EQ(0, close(output_fd));
+  servers.clear();
+  TeardownTestDir(testdir_path);
+}
+
+}  // namespace client
+
+}  // namespace p2p
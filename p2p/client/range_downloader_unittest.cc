@@ -0,0 +1,251 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "p2p/client/range_downloader.h"
+
+#include "p2p/client/fake_range_server.h"
+#include "p2p/common/clock.h"
+#include "p2p/common/testutil.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/rand_util.h>
+#include <base/time/time.h>
+#include <gtest/gtest.h>
+
+using base::FilePath;
+using base::TimeDelta;
+using p2p::testutil::SetupTestDir;
+using p2p::testutil::TeardownTestDir;
+using std::string;
+using std::vector;
+
+namespace p2p {
+
+namespace client {
+
+class RangeDownloaderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    testdir_path_ = SetupTestDir("range-downloader");
+    output_path_ = testdir_path_.Append("output");
+    output_fd_ = open(output_path_.value().c_str(),
+                      O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    ASSERT_NE(output_fd_, -1);
+  }
+
+  void TearDown() override {
+    servers_.clear();
+    if (output_fd_ != -1)
+      EXPECT_EQ(0, close(output_fd_));
+    TeardownTestDir(testdir_path_);
+  }
+
+  // Creates a server for |data_|, to be started with StartServer().
+  FakeRangeServer* NewServer(int64_t bytes_per_second, uint64_t fail_after) {
+    servers_.emplace_back(
+        new FakeRangeServer(data_, bytes_per_second, fail_after));
+    return servers_.back().get();
+  }
+
+  // Starts |server| and returns its URL.
+  string StartServer(FakeRangeServer* server) {
+    EXPECT_TRUE(server->Start());
+    return server->Url();
+  }
+
+  // Starts a server for |data_| and returns its URL.
+  string AddServer(int64_t bytes_per_second, uint64_t fail_after) {
+    return StartServer(NewServer(bytes_per_second, fail_after));
+  }
+
+  string AddServer(int64_t bytes_per_second) {
+    return AddServer(bytes_per_second, UINT64_MAX);
+  }
+
+  string ReadOutput() {
+    string output;
+    EXPECT_TRUE(base::ReadFileToString(output_path_, &output));
+    return output;
+  }
+
+  // The file served by the servers.
+  string data_ = base::RandBytesAsString(512 * 1024);
+
+  FilePath testdir_path_;
+  FilePath output_path_;
+  int output_fd_;
+  p2p::common::Clock clock_;
+  vector<std::unique_ptr<FakeRangeServer>> servers_;
+};
+
+TEST_F(RangeDownloaderTest, DownloadFromOnePeer) {
+  vector<string> urls = {AddServer(0)};
+  RangeDownloader downloader(urls, data_.size(), output_fd_, &clock_);
+  EXPECT_TRUE(downloader.Run());
+  EXPECT_TRUE(ReadOutput() == data_);
+
+  ASSERT_EQ(1u, downloader.peer_stats().size());
+  EXPECT_EQ(data_.size(), downloader.peer_stats()[0].bytes_received);
+  EXPECT_EQ(1, downloader.peer_stats()[0].num_ranges);
+  EXPECT_FALSE(downloader.peer_stats()[0].failed);
+  EXPECT_EQ(data_.size(), downloader.file_size());
+}
+
+TEST_F(RangeDownloaderTest, EmptyFile) {
+  data_.clear();
+  vector<string> urls = {AddServer(0)};
+  RangeDownloader downloader(urls, 0, output_fd_, &clock_);
+  EXPECT_TRUE(downloader.Run());
+  EXPECT_EQ("", ReadOutput());
+  EXPECT_EQ(0, servers_[0]->num_requests());
+}
+
+TEST_F(RangeDownloaderTest, SplitsTheFileAmongPeers) {
+  // Keep every peer busy with its initial range for a while.
+  vector<string> urls;
+  for (int i = 0; i < 3; i++)
+    urls.push_back(AddServer(1024 * 1024));
+  RangeDownloader downloader(urls, data_.size(), output_fd_, &clock_);
+  EXPECT_TRUE(downloader.Run());
+  EXPECT_TRUE(ReadOutput() == data_);
+
+  uint64_t total_received = 0;
+  for (auto const& stats : downloader.peer_stats()) {
+    EXPECT_GT(stats.bytes_received, 0u);
+    EXPECT_FALSE(stats.failed);
+    total_received += stats.bytes_received;
+  }
+  EXPECT_EQ(data_.size(), total_received);
+}
+
+TEST_F(RangeDownloaderTest, TakesOverTheRangeOfASlowPeer) {
+  vector<string> urls = {AddServer(0), AddServer(64 * 1024)};
+  RangeDownloader downloader(urls, data_.size(), output_fd_, &clock_);
+  downloader.set_min_steal_size(16 * 1024);
+  EXPECT_TRUE(downloader.Run());
+  EXPECT_TRUE(ReadOutput() == data_);
+
+  const RangeDownloader::PeerStats& fast = downloader.peer_stats()[0];
+  const RangeDownloader::PeerStats& slow = downloader.peer_stats()[1];
+  EXPECT_GT(fast.num_stolen_ranges, 0);
+  EXPECT_GT(fast.bytes_received, slow.bytes_received);
+  EXPECT_EQ(data_.size(), fast.bytes_received + slow.bytes_received);
+  // Without taking over its range, the slow peer alone would need four
+  // seconds to send its half of the file.
+  EXPECT_LT(downloader.elapsed_time().InSeconds(), 4);
+}
+
+TEST_F(RangeDownloaderTest, TimeSpentExcludesWaitingForARange) {
+  // The fast peer can't take over the range of the slow one, so it waits for
+  // the slow peer to complete its range for about a second.
+  vector<string> urls = {AddServer(0), AddServer(256 * 1024)};
+  RangeDownloader downloader(urls, data_.size(), output_fd_, &clock_);
+  downloader.set_min_steal_size(data_.size());
+  EXPECT_TRUE(downloader.Run());
+  EXPECT_TRUE(ReadOutput() == data_);
+
+  const RangeDownloader::PeerStats& fast = downloader.peer_stats()[0];
+  const RangeDownloader::PeerStats& slow = downloader.peer_stats()[1];
+  EXPECT_EQ(1, fast.num_ranges);
+  EXPECT_LT(fast.time_spent.InMilliseconds() * 4,
+            slow.time_spent.InMilliseconds());
+}
+
+TEST_F(RangeDownloaderTest, RecoversFromAFailingPeer) {
+  vector<string> urls = {AddServer(256 * 1024),
+                         AddServer(256 * 1024, 32 * 1024)};
+  RangeDownloader downloader(urls, data_.size(), output_fd_, &clock_);
+  EXPECT_TRUE(downloader.Run());
+  EXPECT_TRUE(ReadOutput() == data_);
+
+  EXPECT_FALSE(downloader.peer_stats()[0].failed);
+  EXPECT_TRUE(downloader.peer_stats()[1].failed);
+  EXPECT_EQ(32u * 1024, downloader.peer_stats()[1].bytes_received);
+}
+
+TEST_F(RangeDownloaderTest, DownloadsAFileStillGrowing) {
+  // The peers advertised half of the file, which they are still downloading,
+  // and only send the rest a while after.
+  const uint64_t advertised_size = data_.size() / 2;
+  vector<string> urls;
+  for (int i = 0; i < 2; i++) {
+    FakeRangeServer* server = NewServer(0, UINT64_MAX);
+    server->SetGrowing(advertised_size, TimeDelta::FromMilliseconds(200));
+    urls.push_back(StartServer(server));
+  }
+  RangeDownloader downloader(urls, advertised_size, output_fd_, &clock_);
+  EXPECT_TRUE(downloader.Run());
+  EXPECT_EQ(data_.size(), downloader.file_size());
+  EXPECT_TRUE(ReadOutput() == data_);
+
+  uint64_t total_received = 0;
+  for (auto const& stats : downloader.peer_stats()) {
+    EXPECT_FALSE(stats.failed);
+    total_received += stats.bytes_received;
+  }
+  EXPECT_EQ(data_.size(), total_received);
+}
+
+TEST_F(RangeDownloaderTest, RejectsAPeerReportingAnotherSize) {
+  // The second peer responds after the first one set the size of the file.
+  FakeRangeServer* other_size_server = NewServer(0, UINT64_MAX);
+  other_size_server->set_reported_size(data_.size() + 1);
+  other_size_server->set_response_delay(TimeDelta::FromMilliseconds(200));
+  vector<string> urls = {AddServer(0), StartServer(other_size_server)};
+  RangeDownloader downloader(urls, data_.size(), output_fd_, &clock_);
+  EXPECT_TRUE(downloader.Run());
+  EXPECT_EQ(data_.size(), downloader.file_size());
+  EXPECT_TRUE(ReadOutput() == data_);
+
+  EXPECT_FALSE(downloader.peer_stats()[0].failed);
+  EXPECT_EQ(data_.size(), downloader.peer_stats()[0].bytes_received);
+  EXPECT_TRUE(downloader.peer_stats()[1].failed);
+  EXPECT_EQ(0u, downloader.peer_stats()[1].bytes_received);
+}
+
+TEST_F(RangeDownloaderTest, RejectsASizeSmallerThanAdvertised) {
+  FakeRangeServer* server = NewServer(0, UINT64_MAX);
+  server->set_reported_size(data_.size() - 1);
+  vector<string> urls = {StartServer(server)};
+  RangeDownloader downloader(urls, data_.size(), output_fd_, &clock_);
+  EXPECT_FALSE(downloader.Run());
+  EXPECT_TRUE(downloader.peer_stats()[0].failed);
+}
+
+TEST_F(RangeDownloaderTest, FailsWhenEveryPeerFails) {
+  vector<string> urls = {AddServer(0, 1024), AddServer(0, 1024)};
+  RangeDownloader downloader(urls, data_.size(), output_fd_, &clock_);
+  EXPECT_FALSE(downloader.Run());
+  EXPECT_TRUE(downloader.peer_stats()[0].failed);
+  EXPECT_TRUE(downloader.peer_stats()[1].failed);
+}
+
+TEST_F(RangeDownloaderTest, FailsOnUnreachablePeer) {
+  // Get a port nobody listens on.
+  string url = AddServer(0);
+  servers_.clear();
+  RangeDownloader downloader({url}, data_.size(), output_fd_, &clock_);
+  EXPECT_FALSE(downloader.Run());
+  EXPECT_TRUE(downloader.peer_stats()[0].failed);
+}
+
+TEST_F(RangeDownloaderTest, Abort) {
+  vector<string> urls = {AddServer(0)};
+  RangeDownloader downloader(urls, data_.size(), output_fd_, &clock_);
+  downloader.Abort();
+  EXPECT_FALSE(downloader.Run());
+  EXPECT_FALSE(downloader.peer_stats()[0].failed);
+}
+
+}  // namespace client
+
+}  // namespace p2p
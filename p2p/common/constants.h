@@ -35,6 +35,12 @@ constexpr uint16_t kHttpServerDefaultPort = 16725;
 // The path of the directory for peer to peer content.
 constexpr char kP2PDir[] = "/var/cache/p2p";
 
+// The path of the file where p2p-client keeps what it observed about peers.
+constexpr char kPeerScoreboardPath[] = "/var/lib/p2p/peer-scoreboard";
+
+// The maximum number of peers remembered in the peer scoreboard.
+constexpr int kMaxScoreboardPeers = 256;
+
 // Universal constants used for unit conversion.
 constexpr int64_t kBytesPerKB = 1000;
 constexpr int64_t kBytesPerMB = 1000000;
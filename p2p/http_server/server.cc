@@ -14,6 +14,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -43,6 +44,14 @@ namespace p2p {
 
 namespace http_server {
 
+namespace {
+
+// The time a connection is held back waiting for the request of the client
+// before it is accepted anyway.
+const int kDeferAcceptSeconds = 10;
+
+}  // namespace
+
 Server::Server(const FilePath& directory, uint16_t port, int message_fd,
     ConnectionDelegateFactory delegate_factory)
     : thread_pool_("p2p-http-server", 10),
@@ -137,6 +146,16 @@ bool Server::Start() {
     return false;
   }
 
+  // Only accept connections once the client sent its request. p2p-client
+  // measures the round-trip time to the peers by connecting and resetting
+  // the connection right away, and these probes shouldn't be counted as
+  // connections nor reported in the metrics.
+  int defer_accept_seconds = kDeferAcceptSeconds;
+  if (setsockopt(listen_fd_, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+                 &defer_accept_seconds, sizeof defer_accept_seconds) == -1) {
+    PLOG(WARNING) << "Error deferring accept, probes will count as clients";
+  }
+
   if (bind(listen_fd_,
            reinterpret_cast<const struct ::sockaddr*>(&sock_addr),
            sizeof sock_addr) ==
@@ -77,7 +77,10 @@
         },
       },
       'sources': [
+        'client/peer_prober.cc',
+        'client/peer_scoreboard.cc',
         'client/peer_selector.cc',
+        'client/range_downloader.cc',
         'client/service_finder.cc',
       ],
     },
@@ -235,8 +238,27 @@
             'libp2p-client',
           ],
           'sources': [
+            'client/fake_range_server.cc',
             'client/fake_service_finder.cc',
+            'client/peer_scoreboard_unittest.cc',
             'client/peer_selector_unittest.cc',
+            'client/range_downloader_unittest.cc',
+            'client/testrunner.cc',
+          ],
+        },
+        # Takes several seconds against throttled local peers, so it is kept
+        # out of the unit tests.
+        {
+          'target_name': 'p2p-client-benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'libp2p-util',
+            'libp2p-testutil',
+            'libp2p-client',
+          ],
+          'sources': [
+            'client/fake_range_server.cc',
+            'client/range_downloader_benchmark.cc',
             'client/testrunner.cc',
           ],
         },
@@ -15,6 +15,7 @@
 #include "base/logging.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_split.h"
+#include "permission_broker/udev_device_cache.h"
 #include "permission_broker/udev_scopers.h"
 
 namespace permission_broker {
@@ -99,15 +100,27 @@ Rule::Result DenyClaimedHidrawDeviceRule::ProcessHidrawDevice(
   // Because udev lacks the ability to filter an enumeration by arbitrary
   // ancestor properties (e.g. "enumerate all nodes with a usb_interface
   // ancestor") we have to scan the entire set of devices to find potential
-  // matches.
+  // matches, unless the device cache can list the descendants directly.
   struct udev* udev = udev_device_get_udev(device);
-  ScopedUdevEnumeratePtr enumerate(udev_enumerate_new(udev));
-  udev_enumerate_scan_devices(enumerate.get());
-  struct udev_list_entry* entry;
-  udev_list_entry_foreach(entry,
-                          udev_enumerate_get_list_entry(enumerate.get())) {
-    const char* syspath = udev_list_entry_get_name(entry);
-    ScopedUdevDevicePtr child(udev_device_new_from_syspath(udev, syspath));
+  std::vector<std::string> candidates;
+  if (device_cache()) {
+    candidates = device_cache()->GetDescendants(usb_interface_path);
+  } else {
+    ScopedUdevEnumeratePtr enumerate(udev_enumerate_new(udev));
+    udev_enumerate_scan_devices(enumerate.get());
+    struct udev_list_entry* entry;
+    udev_list_entry_foreach(entry,
+                            udev_enumerate_get_list_entry(enumerate.get())) {
+      candidates.push_back(udev_list_entry_get_name(entry));
+    }
+  }
+
+  for (const std::string& syspath : candidates) {
+    ScopedUdevDevicePtr child(
+        udev_device_new_from_syspath(udev, syspath.c_str()));
+    if (!child) {
+      continue;
+    }
     struct udev_device* child_usb_interface =
         udev_device_get_parent_with_subsystem_devtype(
             child.get(), "usb", "usb_interface");
@@ -6,9 +6,13 @@
 
 #include <libudev.h>
 
+#include <string>
+#include <vector>
+
 #include "base/logging.h"
 #include "base/memory/ptr_util.h"
 #include "base/strings/string_number_conversions.h"
+#include "permission_broker/udev_device_cache.h"
 #include "permission_broker/udev_scopers.h"
 
 using policy::DevicePolicy;
@@ -92,17 +96,28 @@ Rule::Result DenyClaimedUsbDeviceRule::ProcessUsbDevice(udev_device* device) {
   }
 
   udev* udev = udev_device_get_udev(device);
-  ScopedUdevEnumeratePtr enumerate(udev_enumerate_new(udev));
-  udev_enumerate_scan_devices(enumerate.get());
+  std::vector<std::string> candidates;
+  if (device_cache()) {
+    candidates = device_cache()->GetChildren(device_syspath);
+  } else {
+    ScopedUdevEnumeratePtr enumerate(udev_enumerate_new(udev));
+    udev_enumerate_scan_devices(enumerate.get());
+    struct udev_list_entry *entry = nullptr;
+    udev_list_entry_foreach(entry,
+                            udev_enumerate_get_list_entry(enumerate.get())) {
+      candidates.push_back(udev_list_entry_get_name(entry));
+    }
+  }
 
   bool found_claimed_interface = false;
   bool found_unclaimed_interface = false;
   bool found_adb_interface = false;
-  struct udev_list_entry *entry = nullptr;
-  udev_list_entry_foreach(entry,
-                          udev_enumerate_get_list_entry(enumerate.get())) {
-    const char *entry_path = udev_list_entry_get_name(entry);
-    ScopedUdevDevicePtr child(udev_device_new_from_syspath(udev, entry_path));
+  for (const std::string& entry_path : candidates) {
+    ScopedUdevDevicePtr child(
+        udev_device_new_from_syspath(udev, entry_path.c_str()));
+    if (!child) {
+      continue;
+    }
 
     // Find out if this entry's direct parent is the device in question.
     struct udev_device* parent = udev_device_get_parent(child.get());
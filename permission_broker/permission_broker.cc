@@ -15,6 +15,7 @@
 #include <utility>
 #include <vector>
 
+#include <base/bind.h>
 #include <base/logging.h>
 #include <base/memory/ptr_util.h>
 #include <base/posix/eintr_wrapper.h>
@@ -57,6 +58,19 @@ const uint16_t kLinuxFoundationUsbVendorId = 0x1d6b;
 const char kErrorDomainPermissionBroker[] = "permission_broker";
 const char kPermissionDeniedError[] = "permission_denied";
 const char kOpenFailedError[] = "open_failed";
+
+// Time from a path request until the rules are run on the path, which is
+// mostly time spent waiting for udev.
+const char kRequestQueueTimeMetric[] = "PermissionBroker.RequestQueueTime";
+const int kRequestQueueTimeMetricMin = 1;
+const int kRequestQueueTimeMetricMax = 60 * 1000;
+const int kRequestQueueTimeMetricBuckets = 50;
+
+bool IsAllowed(permission_broker::Rule::Result result) {
+  return result == permission_broker::Rule::ALLOW ||
+         result == permission_broker::Rule::ALLOW_WITH_LOCKDOWN ||
+         result == permission_broker::Rule::ALLOW_WITH_DETACH;
+}
 }
 
 namespace permission_broker {
@@ -104,6 +118,7 @@ PermissionBroker::PermissionBroker(
       port_tracker_(firewalld) {
   CHECK(brillo::userdb::GetGroupInfo(access_group_name, &access_group_))
       << "You must specify a group name via the --access_group flag.";
+  metrics_library_.Init();
   rule_engine_.AddRule(new AllowUsbDeviceRule());
   rule_engine_.AddRule(new AllowTtyDeviceRule());
   rule_engine_.AddRule(new DenyClaimedUsbDeviceRule());
@@ -137,26 +152,90 @@ void PermissionBroker::RegisterAsync(
   dbus_object_.RegisterAsync(cb);
 }
 
-bool PermissionBroker::CheckPathAccess(const std::string& in_path) {
-  Rule::Result result = rule_engine_.ProcessPath(in_path);
-  return result == Rule::ALLOW || result == Rule::ALLOW_WITH_LOCKDOWN
-      || result == Rule::ALLOW_WITH_DETACH;
+void PermissionBroker::CheckPathAccess(DBusMethodResponsePtr<bool> response,
+                                       const std::string& in_path) {
+  ProcessPath(in_path,
+              base::Bind(&PermissionBroker::OnCheckPathAccess,
+                         base::Unretained(this),
+                         base::Passed(&response)));
 }
 
-bool PermissionBroker::RequestPathAccess(const std::string& in_path,
+void PermissionBroker::RequestPathAccess(DBusMethodResponsePtr<bool> response,
+                                         const std::string& in_path,
                                          int32_t in_interface_id) {
-  if (rule_engine_.ProcessPath(in_path) == Rule::ALLOW) {
-    return GrantAccess(in_path);
+  ProcessPath(in_path,
+              base::Bind(&PermissionBroker::OnRequestPathAccess,
+                         base::Unretained(this),
+                         base::Passed(&response),
+                         in_path));
+}
+
+void PermissionBroker::OpenPath(
+    DBusMethodResponsePtr<dbus::FileDescriptor> response,
+    const std::string& in_path) {
+  ProcessPath(in_path,
+              base::Bind(&PermissionBroker::OnOpenPath,
+                         base::Unretained(this),
+                         base::Passed(&response),
+                         in_path));
+}
+
+void PermissionBroker::ProcessPath(
+    const std::string& path,
+    const RuleEngine::ProcessPathCallback& callback) {
+  // |rule_engine_| drops pending callbacks when it is destroyed along with
+  // |this|, so Unretained is safe.
+  rule_engine_.ProcessPathAsync(
+      path,
+      base::Bind(&PermissionBroker::OnPathProcessed,
+                 base::Unretained(this),
+                 base::TimeTicks::Now(),
+                 callback));
+}
+
+void PermissionBroker::OnPathProcessed(
+    base::TimeTicks start_time,
+    const RuleEngine::ProcessPathCallback& callback,
+    Rule::Result result) {
+  metrics_library_.SendToUMA(
+      kRequestQueueTimeMetric,
+      (base::TimeTicks::Now() - start_time).InMilliseconds(),
+      kRequestQueueTimeMetricMin,
+      kRequestQueueTimeMetricMax,
+      kRequestQueueTimeMetricBuckets);
+  callback.Run(result);
+}
+
+void PermissionBroker::OnCheckPathAccess(DBusMethodResponsePtr<bool> response,
+                                         Rule::Result result) {
+  response->Return(IsAllowed(result));
+}
+
+void PermissionBroker::OnRequestPathAccess(
+    DBusMethodResponsePtr<bool> response,
+    const std::string& path,
+    Rule::Result result) {
+  response->Return(result == Rule::ALLOW && GrantAccess(path));
+}
+
+void PermissionBroker::OnOpenPath(
+    DBusMethodResponsePtr<dbus::FileDescriptor> response,
+    const std::string& path,
+    Rule::Result result) {
+  brillo::ErrorPtr error;
+  dbus::FileDescriptor fd;
+  if (!OpenAllowedPath(&error, path, result, &fd)) {
+    response->ReplyWithError(error.get());
+    return;
   }
-  return false;
+  response->Return(fd);
 }
 
-bool PermissionBroker::OpenPath(brillo::ErrorPtr* error,
-                                const std::string& in_path,
-                                dbus::FileDescriptor* out_fd) {
-  Rule::Result rule_result = rule_engine_.ProcessPath(in_path);
-  if (rule_result != Rule::ALLOW && rule_result != Rule::ALLOW_WITH_LOCKDOWN
-      && rule_result != Rule::ALLOW_WITH_DETACH) {
+bool PermissionBroker::OpenAllowedPath(brillo::ErrorPtr* error,
+                                       const std::string& in_path,
+                                       Rule::Result rule_result,
+                                       dbus::FileDescriptor* out_fd) {
+  if (!IsAllowed(rule_result)) {
     brillo::Error::AddToPrintf(
         error, FROM_HERE, kErrorDomainPermissionBroker, kPermissionDeniedError,
         "Permission to open '%s' denied", in_path.c_str());
@@ -8,6 +8,7 @@
         'dbus-1',
         'libbrillo-<(libbase_ver)',
         'libchrome-<(libbase_ver)',
+        'libmetrics-<(libbase_ver)',
         'libudev',
         'libfirewalld-client',
       ],
@@ -53,6 +54,7 @@
         'rule.cc',
         'rule_engine.cc',
         'tty_subsystem_udev_rule.cc',
+        'udev_device_cache.cc',
         'udev_scopers.cc',
         'usb_driver_tracker.cc',
         'usb_subsystem_udev_rule.cc',
@@ -98,6 +100,17 @@
             'rule_engine_unittest.cc',
             'rule_test.cc',
             'run_all_tests.cc',
+            'udev_device_cache_unittest.cc',
+          ],
+        },
+        # Compares cached and scanning device lookups; built but never run by
+        # the tests.
+        {
+          'target_name': 'udev_device_cache_benchmark',
+          'type': 'executable',
+          'dependencies': ['libpermission_broker'],
+          'sources': [
+            'udev_device_cache_benchmark.cc',
           ],
         },
       ],
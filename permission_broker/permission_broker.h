@@ -14,7 +14,9 @@
 #include <base/macros.h>
 #include <base/message_loop/message_loop.h>
 #include <base/sequenced_task_runner.h>
+#include <base/time/time.h>
 #include <brillo/dbus/exported_object_manager.h>
+#include <metrics/metrics_library.h>
 
 #include "container_utils/device_jail/device_jail_server.h"
 #include "firewalld/dbus-proxies.h"
@@ -43,13 +45,18 @@ class PermissionBroker : public org::chromium::PermissionBrokerAdaptor,
       const brillo::dbus_utils::AsyncEventSequencer::CompletionAction& cb);
 
  private:
+  template<typename... Types>
+  using DBusMethodResponsePtr =
+      std::unique_ptr<brillo::dbus_utils::DBusMethodResponse<Types...>>;
+
   // D-Bus methods.
-  bool CheckPathAccess(const std::string& in_path) override;
-  bool RequestPathAccess(const std::string& in_path,
+  void CheckPathAccess(DBusMethodResponsePtr<bool> response,
+                       const std::string& in_path) override;
+  void RequestPathAccess(DBusMethodResponsePtr<bool> response,
+                         const std::string& in_path,
                          int32_t in_interface_id) override;
-  bool OpenPath(brillo::ErrorPtr* error,
-                const std::string& in_path,
-                dbus::FileDescriptor* out_fd) override;
+  void OpenPath(DBusMethodResponsePtr<dbus::FileDescriptor> response,
+                const std::string& in_path) override;
   bool RequestTcpPortAccess(uint16_t in_port,
                             const std::string& in_interface,
                             const dbus::FileDescriptor& dbus_fd) override;
@@ -65,6 +72,30 @@ class PermissionBroker : public org::chromium::PermissionBrokerAdaptor,
                        const dbus::FileDescriptor& dbus_fd) override;
   bool RemoveVpnSetup() override;
 
+  // Runs the rule engine on |path| without blocking on unrelated udev events,
+  // then runs |callback| with the verdict.
+  void ProcessPath(const std::string& path,
+                   const RuleEngine::ProcessPathCallback& callback);
+  void OnPathProcessed(base::TimeTicks start_time,
+                       const RuleEngine::ProcessPathCallback& callback,
+                       Rule::Result result);
+
+  // Continuations of the D-Bus methods once the verdict for the path is known.
+  void OnCheckPathAccess(DBusMethodResponsePtr<bool> response,
+                         Rule::Result result);
+  void OnRequestPathAccess(DBusMethodResponsePtr<bool> response,
+                           const std::string& path,
+                           Rule::Result result);
+  void OnOpenPath(DBusMethodResponsePtr<dbus::FileDescriptor> response,
+                  const std::string& path,
+                  Rule::Result result);
+
+  // Opens |path| as allowed by |rule_result|.
+  bool OpenAllowedPath(brillo::ErrorPtr* error,
+                       const std::string& path,
+                       Rule::Result rule_result,
+                       dbus::FileDescriptor* out_fd);
+
   // Grants access to |path|, which is accomplished by changing the owning group
   // on the path to the one specified numerically by the 'access_group' flag.
   virtual bool GrantAccess(const std::string& path);
@@ -75,6 +106,7 @@ class PermissionBroker : public org::chromium::PermissionBrokerAdaptor,
   gid_t access_group_;
   PortTracker port_tracker_;
   UsbDriverTracker usb_driver_tracker_;
+  MetricsLibrary metrics_library_;
 
   DISALLOW_COPY_AND_ASSIGN(PermissionBroker);
 };
@@ -13,6 +13,8 @@ struct udev_device;
 
 namespace permission_broker {
 
+class UdevDeviceCache;
+
 // A Rule represents a single unit of policy used to decide to which paths
 // access is granted. Each time a Rule processes a path it can return one of
 // these values: |ALLOW|, |ALLOW_WITH_DETACH|, |ALLOW_WITH_LOCKDOWN|, |DENY|, or
@@ -35,11 +37,18 @@ class Rule {
 
   virtual Result ProcessDevice(udev_device* device) = 0;
 
+  // Sets the cache that rules can use to find related devices instead of
+  // scanning every udev device. |cache| is not owned and may be null.
+  void set_device_cache(const UdevDeviceCache* cache) { device_cache_ = cache; }
+
  protected:
   explicit Rule(const std::string& name);
 
+  const UdevDeviceCache* device_cache() const { return device_cache_; }
+
  private:
   const std::string name_;
+  const UdevDeviceCache* device_cache_ = nullptr;
 
   DISALLOW_COPY_AND_ASSIGN(Rule);
 };
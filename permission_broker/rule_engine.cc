@@ -7,10 +7,16 @@
 #include <libudev.h>
 #include <poll.h>
 #include <sys/inotify.h>
+#include <sys/stat.h>
 
+#include <utility>
+
+#include "base/bind.h"
 #include "base/logging.h"
 #include "permission_broker/rule.h"
 
+using brillo::MessageLoop;
+
 namespace permission_broker {
 
 RuleEngine::RuleEngine()
@@ -24,19 +30,150 @@ RuleEngine::RuleEngine(
 
   poll_interval_msecs_ = poll_interval_msecs;
   udev_run_path_ = udev_run_path;
+
+  device_cache_.reset(new UdevDeviceCache());
+  if (!device_cache_->Start(udev_.get())) {
+    LOG(WARNING) << "Falling back to scanning udev for each request";
+    device_cache_.reset();
+    return;
+  }
+  device_cache_->set_event_callback(base::Bind(
+      &RuleEngine::ProcessDeferredRequests, base::Unretained(this)));
 }
 
 RuleEngine::~RuleEngine() {
+  if (queue_check_task_ != MessageLoop::kTaskIdNull)
+    MessageLoop::current()->CancelTask(queue_check_task_);
 }
 
 void RuleEngine::AddRule(Rule* rule) {
   CHECK(rule) << "Cannot add NULL as a rule.";
+  rule->set_device_cache(device_cache_.get());
   rules_.push_back(std::unique_ptr<Rule>(rule));
+  verdicts_.clear();
 }
 
 Rule::Result RuleEngine::ProcessPath(const std::string& path) {
   WaitForEmptyUdevQueue();
+  return ProcessSettledPath(path);
+}
 
+void RuleEngine::ProcessPathAsync(const std::string& path,
+                                  const ProcessPathCallback& callback) {
+  deferred_requests_.push_back({path, callback});
+  ProcessDeferredRequests();
+}
+
+bool RuleEngine::IsPathSettled(const std::string& path) {
+  if (!device_cache_ || !device_cache_->tracking_kernel_events() ||
+      !kernel_events_tracked_) {
+    return false;
+  }
+
+  // A device that udev hasn't announced yet is still being added.
+  std::string syspath;
+  if (!device_cache_->FindSyspath(path, &syspath))
+    return false;
+
+  // Rules look at the siblings and interfaces of USB devices, so events
+  // anywhere under the USB device matter.
+  ScopedUdevDevicePtr device(
+      udev_device_new_from_syspath(udev_.get(), syspath.c_str()));
+  if (!device)
+    return false;
+  udev_device* usb_device = udev_device_get_parent_with_subsystem_devtype(
+      device.get(), "usb", "usb_device");
+  if (usb_device)
+    syspath = udev_device_get_syspath(usb_device);
+  return !device_cache_->HasUnprocessedEvents(syspath);
+}
+
+void RuleEngine::ProcessDeferredRequests() {
+  if (deferred_requests_.empty())
+    return;
+
+  if (device_cache_)
+    device_cache_->ProcessPendingEvents();
+  const bool queue_empty = IsUdevQueueEmpty();
+  if (queue_empty && device_cache_) {
+    device_cache_->ClearUnprocessedEvents();
+    kernel_events_tracked_ = true;
+  }
+
+  // Callbacks may add requests, so take the ready ones out first.
+  std::deque<DeferredRequest> ready;
+  std::deque<DeferredRequest> waiting;
+  for (DeferredRequest& request : deferred_requests_) {
+    if (queue_empty || IsPathSettled(request.path))
+      ready.push_back(std::move(request));
+    else
+      waiting.push_back(std::move(request));
+  }
+  deferred_requests_.swap(waiting);
+
+  for (const DeferredRequest& request : ready)
+    request.callback.Run(ProcessSettledPath(request.path));
+
+  if (deferred_requests_.empty() ||
+      queue_check_task_ != MessageLoop::kTaskIdNull) {
+    return;
+  }
+  queue_check_task_ = MessageLoop::current()->PostDelayedTask(
+      FROM_HERE,
+      base::Bind(&RuleEngine::OnQueueCheck, base::Unretained(this)),
+      base::TimeDelta::FromMilliseconds(poll_interval_msecs_));
+}
+
+void RuleEngine::OnQueueCheck() {
+  queue_check_task_ = MessageLoop::kTaskIdNull;
+  ProcessDeferredRequests();
+}
+
+Rule::Result RuleEngine::ProcessSettledPath(const std::string& path) {
+  if (!device_cache_)
+    return ProcessDevice(path);
+
+  // Catch up with the events udev has just finished processing.
+  device_cache_->ProcessPendingEvents();
+  if (verdicts_generation_ != device_cache_->generation()) {
+    verdicts_.clear();
+    verdicts_generation_ = device_cache_->generation();
+  }
+
+  // Some rules look at the owner of the node, which can change without a udev
+  // event.
+  struct stat node_stat;
+  if (stat(path.c_str(), &node_stat) != 0)
+    return ProcessDevice(path);
+
+  auto it = verdicts_.find(path);
+  if (it != verdicts_.end()) {
+    const struct stat& cached_stat = it->second.node_stat;
+    if (cached_stat.st_ino == node_stat.st_ino &&
+        cached_stat.st_rdev == node_stat.st_rdev &&
+        cached_stat.st_mode == node_stat.st_mode &&
+        cached_stat.st_uid == node_stat.st_uid &&
+        cached_stat.st_gid == node_stat.st_gid) {
+      LOG(INFO) << "Cached verdict for " << path << ": "
+                << Rule::ResultToString(it->second.result);
+      return it->second.result;
+    }
+    verdicts_.erase(it);
+  }
+
+  Rule::Result result = ProcessDevice(path);
+  // Rules may cause udev events, e.g. by opening the device; don't remember
+  // a verdict that they have already invalidated.
+  device_cache_->ProcessPendingEvents();
+  if (verdicts_generation_ == device_cache_->generation()) {
+    Verdict& verdict = verdicts_[path];
+    verdict.result = result;
+    verdict.node_stat = node_stat;
+  }
+  return result;
+}
+
+Rule::Result RuleEngine::ProcessDevice(const std::string& path) {
   LOG(INFO) << "ProcessPath(" << path << ")";
   Rule::Result result = Rule::IGNORE;
 
@@ -68,6 +205,13 @@ Rule::Result RuleEngine::ProcessPath(const std::string& path) {
   return result;
 }
 
+bool RuleEngine::IsUdevQueueEmpty() {
+  struct udev_queue* queue = udev_queue_new(udev_.get());
+  const bool empty = udev_queue_get_queue_is_empty(queue);
+  udev_queue_unref(queue);
+  return empty;
+}
+
 void RuleEngine::WaitForEmptyUdevQueue() {
   struct udev_queue* queue = udev_queue_new(udev_.get());
   if (udev_queue_get_queue_is_empty(queue)) {
@@ -97,6 +241,15 @@ void RuleEngine::WaitForEmptyUdevQueue() {
 }
 
 ScopedUdevDevicePtr RuleEngine::FindUdevDevice(const std::string& path) {
+  // Fall back to a full scan on a cache miss, in case the cache lost events.
+  std::string syspath;
+  if (device_cache_ && device_cache_->FindSyspath(path, &syspath)) {
+    ScopedUdevDevicePtr device(
+        udev_device_new_from_syspath(udev_.get(), syspath.c_str()));
+    if (device)
+      return device;
+  }
+
   ScopedUdevEnumeratePtr enumerate(udev_enumerate_new(udev_.get()));
   udev_enumerate_scan_devices(enumerate.get());
 
@@ -5,14 +5,21 @@
 #ifndef PERMISSION_BROKER_RULE_ENGINE_H_
 #define PERMISSION_BROKER_RULE_ENGINE_H_
 
+#include <sys/stat.h>
+
+#include <deque>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <base/callback.h>
 #include <base/macros.h>
+#include <brillo/message_loops/message_loop.h>
 
 #include "permission_broker/rule.h"
+#include "permission_broker/udev_device_cache.h"
 #include "permission_broker/udev_scopers.h"
 
 struct udev;
@@ -23,6 +30,8 @@ class UdevRule;
 
 class RuleEngine {
  public:
+  using ProcessPathCallback = base::Callback<void(Rule::Result)>;
+
   RuleEngine(const std::string& udev_run_path, int poll_interval_msecs);
   virtual ~RuleEngine();
 
@@ -34,9 +43,19 @@ class RuleEngine {
   // denies access to the path or until there are no more rules left. If, after
   // executing all of the stored rules, no rule has explicitly allowed access to
   // the path then access is denied. If _any_ rule denies access to |path| then
-  // processing the rules is aborted early and access is denied.
+  // processing the rules is aborted early and access is denied. Verdicts are
+  // remembered until the next udev event or until the ownership or mode of
+  // the device node changes.
   Rule::Result ProcessPath(const std::string& path);
 
+  // Like ProcessPath(), but rather than blocking until the whole udev queue is
+  // empty, defers the request only until udev has processed the events for
+  // the device at |path| and the USB device it belongs to. Other requests are
+  // handled in the meantime. |callback| is run with the verdict, possibly
+  // before this returns.
+  void ProcessPathAsync(const std::string& path,
+                        const ProcessPathCallback& callback);
+
  protected:
   // This constructor is for use by test code only.
   RuleEngine();
@@ -49,13 +68,63 @@ class RuleEngine {
   // dependency and overhead.
   virtual void WaitForEmptyUdevQueue();
 
+  // Returns true if udev has no queued events.
+  virtual bool IsUdevQueueEmpty();
+
+  // Returns true if udev has finished processing every event that could
+  // affect the verdict for |path|, even if other events are still queued.
+  bool IsPathSettled(const std::string& path);
+
+  // Answers every deferred request that can be answered now and schedules
+  // another check if requests are left.
+  void ProcessDeferredRequests();
+  void OnQueueCheck();
+
+  // Looks up or reaches the verdict for |path| once udev is settled.
+  Rule::Result ProcessSettledPath(const std::string& path);
+
+  // Runs the rule chain on the device with node |path|.
+  Rule::Result ProcessDevice(const std::string& path);
+
   // Finds the udev_device where udev_device_get_devnode returns |path|.
   ScopedUdevDevicePtr FindUdevDevice(const std::string& path);
 
   ScopedUdevPtr udev_;
   std::vector<std::unique_ptr<Rule>> rules_;
 
-  int poll_interval_msecs_;
+  // Null if the cache could not be started, in which case devices are found
+  // by scanning udev and verdicts are not remembered.
+  std::unique_ptr<UdevDeviceCache> device_cache_;
+
+  struct Verdict {
+    Rule::Result result;
+    // The state of the device node when the verdict was reached.
+    struct stat node_stat;
+  };
+
+  // Verdicts keyed by path, valid while the cache is at
+  // |verdicts_generation_|.
+  std::map<std::string, Verdict> verdicts_;
+  uint64_t verdicts_generation_ = 0;
+
+  struct DeferredRequest {
+    std::string path;
+    ProcessPathCallback callback;
+  };
+
+  // Requests from ProcessPathAsync() waiting for udev, in arrival order.
+  std::deque<DeferredRequest> deferred_requests_;
+
+  // Polls the udev queue while requests are deferred.
+  brillo::MessageLoop::TaskId queue_check_task_ =
+      brillo::MessageLoop::kTaskIdNull;
+
+  // True once the udev queue has been seen empty since |device_cache_| started
+  // following kernel uevents. Events queued before then aren't known to the
+  // cache, so until then requests wait for the whole queue.
+  bool kernel_events_tracked_ = false;
+
+  int poll_interval_msecs_ = 0;
   std::string udev_run_path_;
 
   DISALLOW_COPY_AND_ASSIGN(RuleEngine);
@@ -4,6 +4,8 @@
 
 #include "permission_broker/rule_engine.h"
 
+#include <base/bind.h>
+#include <brillo/message_loops/fake_message_loop.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -17,6 +19,14 @@ using ::testing::Return;
 
 namespace permission_broker {
 
+namespace {
+
+void SaveResult(Rule::Result* out, Rule::Result result) {
+  *out = result;
+}
+
+}  // namespace
+
 class MockRule : public Rule {
  public:
   MockRule() : Rule("MockRule") {}
@@ -34,6 +44,7 @@ class MockRuleEngine : public RuleEngine {
   ~MockRuleEngine() override = default;
 
   MOCK_METHOD0(WaitForEmptyUdevQueue, void(void));
+  MOCK_METHOD0(IsUdevQueueEmpty, bool(void));
 
  private:
   DISALLOW_COPY_AND_ASSIGN(MockRuleEngine);
@@ -41,13 +52,28 @@ class MockRuleEngine : public RuleEngine {
 
 class RuleEngineTest : public testing::Test {
  public:
-  RuleEngineTest() = default;
+  RuleEngineTest() { fake_loop_.SetAsCurrent(); }
   ~RuleEngineTest() override = default;
 
   Rule::Result ProcessPath(const string& path) {
     return engine_.ProcessPath(path);
   }
 
+  // Starts an asynchronous request whose verdict is stored in |result|.
+  void ProcessPathAsync(const string& path, Rule::Result* result) {
+    engine_.ProcessPathAsync(path, base::Bind(&SaveResult, result));
+  }
+
+  // Gives |engine_| a device cache that only knows about /dev/null. Must be
+  // called before rules are added.
+  UdevDeviceCache* UseDeviceCache() {
+    engine_.device_cache_.reset(new UdevDeviceCache());
+    engine_.device_cache_->AddDevice(
+        "/sys/devices/virtual/mem/null", "/sys/devices/virtual/mem",
+        "/dev/null");
+    return engine_.device_cache_.get();
+  }
+
  protected:
   Rule *CreateMockRule(const Rule::Result result) const {
     MockRule *rule = new MockRule();
@@ -55,6 +81,8 @@ class RuleEngineTest : public testing::Test {
     return rule;
   }
 
+  // Declared before |engine_| so that it outlives the engine's tasks.
+  brillo::FakeMessageLoop fake_loop_{nullptr};
   MockRuleEngine engine_;
 
  private:
@@ -103,4 +131,110 @@ TEST_F(RuleEngineTest, DetachPrecedence) {
   EXPECT_EQ(Rule::ALLOW_WITH_DETACH, ProcessPath("/dev/null"));
 }
 
+TEST_F(RuleEngineTest, CachedVerdict) {
+  UdevDeviceCache* cache = UseDeviceCache();
+  MockRule* rule = new MockRule();
+  EXPECT_CALL(*rule, ProcessDevice(_))
+      .Times(2)
+      .WillRepeatedly(Return(Rule::ALLOW));
+  engine_.AddRule(rule);
+
+  EXPECT_EQ(Rule::ALLOW, ProcessPath("/dev/null"));
+  EXPECT_EQ(Rule::ALLOW, ProcessPath("/dev/null"));
+
+  // A change to the device tree invalidates the verdict.
+  cache->AddDevice("/sys/devices/virtual/mem/zero", "/sys/devices/virtual/mem",
+                   "/dev/zero");
+  EXPECT_EQ(Rule::ALLOW, ProcessPath("/dev/null"));
+}
+
+TEST_F(RuleEngineTest, AsyncWithEmptyQueue) {
+  engine_.AddRule(CreateMockRule(Rule::ALLOW));
+  EXPECT_CALL(engine_, IsUdevQueueEmpty()).WillOnce(Return(true));
+
+  Rule::Result result = Rule::IGNORE;
+  ProcessPathAsync("/dev/null", &result);
+  EXPECT_EQ(Rule::ALLOW, result);
+}
+
+TEST_F(RuleEngineTest, AsyncDeferredUntilQueueEmpty) {
+  engine_.AddRule(CreateMockRule(Rule::DENY));
+  EXPECT_CALL(engine_, IsUdevQueueEmpty())
+      .WillOnce(Return(false))
+      .WillOnce(Return(false))
+      .WillOnce(Return(true));
+
+  // Without kernel uevents to go on, the request waits for the whole queue.
+  Rule::Result result = Rule::IGNORE;
+  ProcessPathAsync("/dev/null", &result);
+  EXPECT_EQ(Rule::IGNORE, result);
+  fake_loop_.RunOnce(true);
+  EXPECT_EQ(Rule::IGNORE, result);
+  fake_loop_.RunOnce(true);
+  EXPECT_EQ(Rule::DENY, result);
+  EXPECT_FALSE(fake_loop_.PendingTasks());
+}
+
+TEST_F(RuleEngineTest, AsyncDeferredUntilDeviceSettled) {
+  UdevDeviceCache* cache = UseDeviceCache();
+  cache->set_tracking_kernel_events_for_testing(true);
+  cache->AddDevice("/sys/devices/virtual/mem/zero", "/sys/devices/virtual/mem",
+                   "/dev/zero");
+  MockRule* rule = new MockRule();
+  EXPECT_CALL(*rule, ProcessDevice(_)).WillRepeatedly(Return(Rule::ALLOW));
+  engine_.AddRule(rule);
+  // The queue is seen empty once, so the cache has followed every event since,
+  // and is busy from then on.
+  EXPECT_CALL(engine_, IsUdevQueueEmpty())
+      .WillOnce(Return(true))
+      .WillRepeatedly(Return(false));
+  Rule::Result result = Rule::IGNORE;
+  ProcessPathAsync("/dev/null", &result);
+  EXPECT_EQ(Rule::ALLOW, result);
+
+  // An event for the device defers its request, but not one for another
+  // device.
+  cache->AddUnprocessedEvent(10, "/sys/devices/virtual/mem/null");
+  Rule::Result null_result = Rule::IGNORE;
+  Rule::Result zero_result = Rule::IGNORE;
+  ProcessPathAsync("/dev/null", &null_result);
+  ProcessPathAsync("/dev/zero", &zero_result);
+  EXPECT_EQ(Rule::IGNORE, null_result);
+  EXPECT_EQ(Rule::ALLOW, zero_result);
+  fake_loop_.RunOnce(true);
+  EXPECT_EQ(Rule::IGNORE, null_result);
+
+  // Once udev has processed the event, the request is answered on the next
+  // check even though the queue is still busy.
+  cache->RemoveUnprocessedEvent(10);
+  fake_loop_.RunOnce(true);
+  EXPECT_EQ(Rule::ALLOW, null_result);
+  EXPECT_FALSE(fake_loop_.PendingTasks());
+}
+
+// A device that udev hasn't announced yet is not settled.
+TEST_F(RuleEngineTest, AsyncDeferredUntilDeviceAdded) {
+  UdevDeviceCache* cache = UseDeviceCache();
+  cache->set_tracking_kernel_events_for_testing(true);
+  MockRule* rule = new MockRule();
+  EXPECT_CALL(*rule, ProcessDevice(_)).WillRepeatedly(Return(Rule::ALLOW));
+  engine_.AddRule(rule);
+  EXPECT_CALL(engine_, IsUdevQueueEmpty())
+      .WillOnce(Return(true))
+      .WillRepeatedly(Return(false));
+  Rule::Result result = Rule::IGNORE;
+  ProcessPathAsync("/dev/null", &result);
+  EXPECT_EQ(Rule::ALLOW, result);
+
+  result = Rule::IGNORE;
+  ProcessPathAsync("/dev/zero", &result);
+  fake_loop_.RunOnce(true);
+  EXPECT_EQ(Rule::IGNORE, result);
+
+  cache->AddDevice("/sys/devices/virtual/mem/zero", "/sys/devices/virtual/mem",
+                   "/dev/zero");
+  fake_loop_.RunOnce(true);
+  EXPECT_EQ(Rule::ALLOW, result);
+}
+
 }  // namespace permission_broker
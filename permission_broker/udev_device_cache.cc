@@ -0,0 +1,270 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "permission_broker/udev_device_cache.h"
+
+#include <libudev.h>
+#include <string.h>
+
+#include <base/bind.h>
+#include <base/logging.h>
+
+using brillo::MessageLoop;
+
+namespace permission_broker {
+
+namespace {
+
+// Large enough to absorb the events of a device storm between two passes
+// through the message loop.
+const int kMonitorReceiveBufferSize = 8 * 1024 * 1024;
+
+std::string GetParentSyspath(udev_device* device) {
+  udev_device* parent = udev_device_get_parent(device);
+  const char* syspath = parent ? udev_device_get_syspath(parent) : nullptr;
+  return syspath ? syspath : "";
+}
+
+// Returns true if |a| and |b| are the same device or one is an ancestor of the
+// other.
+bool IsSameBranch(const std::string& a, const std::string& b) {
+  const std::string& shorter = a.size() < b.size() ? a : b;
+  const std::string& longer = a.size() < b.size() ? b : a;
+  return longer.compare(0, shorter.size(), shorter) == 0 &&
+         (longer.size() == shorter.size() || longer[shorter.size()] == '/');
+}
+
+}  // namespace
+
+UdevDeviceCache::UdevDeviceCache() {}
+
+UdevDeviceCache::~UdevDeviceCache() {
+  if (watch_task_ != MessageLoop::kTaskIdNull)
+    MessageLoop::current()->CancelTask(watch_task_);
+  if (kernel_watch_task_ != MessageLoop::kTaskIdNull)
+    MessageLoop::current()->CancelTask(kernel_watch_task_);
+}
+
+bool UdevDeviceCache::Start(udev* udev) {
+  // Start listening before scanning so that no change is missed in between.
+  monitor_.reset(udev_monitor_new_from_netlink(udev, "udev"));
+  if (!monitor_) {
+    LOG(ERROR) << "Could not create udev monitor";
+    return false;
+  }
+  udev_monitor_set_receive_buffer_size(monitor_.get(),
+                                       kMonitorReceiveBufferSize);
+  if (udev_monitor_enable_receiving(monitor_.get()) < 0) {
+    LOG(ERROR) << "Could not enable udev monitor";
+    monitor_.reset();
+    return false;
+  }
+
+  ScopedUdevEnumeratePtr enumerate(udev_enumerate_new(udev));
+  udev_enumerate_scan_devices(enumerate.get());
+  struct udev_list_entry* entry = nullptr;
+  udev_list_entry_foreach(entry,
+                          udev_enumerate_get_list_entry(enumerate.get())) {
+    ScopedUdevDevicePtr device(
+        udev_device_new_from_syspath(udev, udev_list_entry_get_name(entry)));
+    if (!device)
+      continue;
+    const char* devnode = udev_device_get_devnode(device.get());
+    AddDevice(udev_device_get_syspath(device.get()),
+              GetParentSyspath(device.get()),
+              devnode ? devnode : "");
+  }
+  ProcessPendingEvents();
+
+  watch_task_ = MessageLoop::current()->WatchFileDescriptor(
+      FROM_HERE,
+      udev_monitor_get_fd(monitor_.get()),
+      MessageLoop::WatchMode::kWatchRead,
+      true,
+      base::Bind(&UdevDeviceCache::OnUdevEvent, base::Unretained(this)));
+  if (watch_task_ == MessageLoop::kTaskIdNull) {
+    LOG(ERROR) << "Unable to watch udev monitor";
+    monitor_.reset();
+    return false;
+  }
+
+  // Kernel uevents are only needed to tell whether a device is settled, so
+  // failing to follow them is not fatal.
+  kernel_monitor_.reset(udev_monitor_new_from_netlink(udev, "kernel"));
+  if (kernel_monitor_) {
+    udev_monitor_set_receive_buffer_size(kernel_monitor_.get(),
+                                         kMonitorReceiveBufferSize);
+    if (udev_monitor_enable_receiving(kernel_monitor_.get()) == 0) {
+      kernel_watch_task_ = MessageLoop::current()->WatchFileDescriptor(
+          FROM_HERE,
+          udev_monitor_get_fd(kernel_monitor_.get()),
+          MessageLoop::WatchMode::kWatchRead,
+          true,
+          base::Bind(&UdevDeviceCache::OnUdevEvent, base::Unretained(this)));
+    }
+    if (kernel_watch_task_ == MessageLoop::kTaskIdNull) {
+      LOG(WARNING) << "Unable to follow kernel uevents";
+      kernel_monitor_.reset();
+    }
+  }
+  tracking_kernel_events_ = kernel_monitor_ != nullptr;
+
+  LOG(INFO) << "Cached " << devices_.size() << " udev devices";
+  return true;
+}
+
+void UdevDeviceCache::ProcessPendingEvents() {
+  if (!monitor_)
+    return;
+  // The monitor sockets are non-blocking, so these stop once they are empty.
+  // The kernel sends each uevent to its listeners before udev starts
+  // processing it, so every uevent that udev reports here is already queued
+  // on the kernel monitor and is matched up by sequence number below.
+  // Reading the kernel monitor first would not do: a uevent sent in between
+  // could be processed and reported by udev before it was recorded.
+  while (true) {
+    ScopedUdevDevicePtr device(udev_monitor_receive_device(monitor_.get()));
+    if (!device)
+      break;
+    HandleDevice(device.get());
+  }
+  while (kernel_monitor_) {
+    ScopedUdevDevicePtr device(
+        udev_monitor_receive_device(kernel_monitor_.get()));
+    if (!device)
+      break;
+    const char* syspath = udev_device_get_syspath(device.get());
+    if (syspath)
+      AddUnprocessedEvent(udev_device_get_seqnum(device.get()), syspath);
+  }
+}
+
+void UdevDeviceCache::AddDevice(const std::string& syspath,
+                                const std::string& parent_syspath,
+                                const std::string& devnode) {
+  auto it = devices_.find(syspath);
+  if (it != devices_.end()) {
+    Device& device = it->second;
+    if (device.parent_syspath == parent_syspath && device.devnode == devnode)
+      return;
+    RemoveDevice(syspath);
+  }
+
+  Device& device = devices_[syspath];
+  device.parent_syspath = parent_syspath;
+  device.devnode = devnode;
+  if (!devnode.empty())
+    devnodes_[devnode] = syspath;
+  if (!parent_syspath.empty())
+    children_[parent_syspath].insert(syspath);
+  generation_++;
+}
+
+void UdevDeviceCache::RemoveDevice(const std::string& syspath) {
+  auto it = devices_.find(syspath);
+  if (it == devices_.end())
+    return;
+
+  const Device& device = it->second;
+  auto devnode_it = devnodes_.find(device.devnode);
+  if (devnode_it != devnodes_.end() && devnode_it->second == syspath)
+    devnodes_.erase(devnode_it);
+  auto children_it = children_.find(device.parent_syspath);
+  if (children_it != children_.end()) {
+    children_it->second.erase(syspath);
+    if (children_it->second.empty())
+      children_.erase(children_it);
+  }
+  devices_.erase(it);
+  generation_++;
+}
+
+bool UdevDeviceCache::FindSyspath(const std::string& devnode,
+                                  std::string* syspath) const {
+  auto it = devnodes_.find(devnode);
+  if (it == devnodes_.end())
+    return false;
+  *syspath = it->second;
+  return true;
+}
+
+std::vector<std::string> UdevDeviceCache::GetChildren(
+    const std::string& syspath) const {
+  auto it = children_.find(syspath);
+  if (it == children_.end())
+    return std::vector<std::string>();
+  return std::vector<std::string>(it->second.begin(), it->second.end());
+}
+
+std::vector<std::string> UdevDeviceCache::GetDescendants(
+    const std::string& syspath) const {
+  std::vector<std::string> descendants = GetChildren(syspath);
+  for (size_t i = 0; i < descendants.size(); ++i) {
+    auto it = children_.find(descendants[i]);
+    if (it != children_.end())
+      descendants.insert(descendants.end(), it->second.begin(),
+                         it->second.end());
+  }
+  return descendants;
+}
+
+bool UdevDeviceCache::HasUnprocessedEvents(const std::string& syspath) const {
+  for (const auto& event : unprocessed_events_) {
+    if (IsSameBranch(event.second, syspath))
+      return true;
+  }
+  return false;
+}
+
+void UdevDeviceCache::ClearUnprocessedEvents() {
+  unprocessed_events_.clear();
+}
+
+void UdevDeviceCache::AddUnprocessedEvent(uint64_t seqnum,
+                                          const std::string& syspath) {
+  const bool processed = processed_early_events_.count(seqnum) > 0;
+  processed_early_events_.erase(processed_early_events_.begin(),
+                                processed_early_events_.upper_bound(seqnum));
+  if (!processed)
+    unprocessed_events_[seqnum] = syspath;
+}
+
+void UdevDeviceCache::RemoveUnprocessedEvent(uint64_t seqnum) {
+  if (unprocessed_events_.erase(seqnum) == 0)
+    processed_early_events_.insert(seqnum);
+}
+
+void UdevDeviceCache::HandleDevice(udev_device* device) {
+  if (tracking_kernel_events_)
+    RemoveUnprocessedEvent(udev_device_get_seqnum(device));
+
+  const char* syspath = udev_device_get_syspath(device);
+  const char* action = udev_device_get_action(device);
+  if (!syspath || !action)
+    return;
+
+  if (strcmp(action, "remove") == 0) {
+    RemoveDevice(syspath);
+    return;
+  }
+  if (strcmp(action, "move") == 0) {
+    const char* old_devpath =
+        udev_device_get_property_value(device, "DEVPATH_OLD");
+    if (old_devpath)
+      RemoveDevice(std::string("/sys") + old_devpath);
+  }
+  const char* devnode = udev_device_get_devnode(device);
+  AddDevice(syspath, GetParentSyspath(device), devnode ? devnode : "");
+  // Events such as "change" or "bind" can alter the properties that rules
+  // look at without changing the tree itself.
+  generation_++;
+}
+
+void UdevDeviceCache::OnUdevEvent() {
+  ProcessPendingEvents();
+  if (!event_callback_.is_null())
+    event_callback_.Run();
+}
+
+}  // namespace permission_broker
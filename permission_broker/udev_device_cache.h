@@ -0,0 +1,138 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef PERMISSION_BROKER_UDEV_DEVICE_CACHE_H_
+#define PERMISSION_BROKER_UDEV_DEVICE_CACHE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <base/callback.h>
+#include <base/macros.h>
+#include <brillo/message_loops/message_loop.h>
+
+#include "permission_broker/udev_scopers.h"
+
+namespace permission_broker {
+
+// UdevDeviceCache indexes the udev device tree by device node and by parent so
+// that rules can look devices up without enumerating every device on the
+// system. Once started, a udev monitor keeps the index current.
+//
+// The cache also follows kernel uevents until udev has finished processing
+// them, so that callers can tell whether a particular device is settled
+// without waiting for the whole udev queue to drain.
+class UdevDeviceCache {
+ public:
+  UdevDeviceCache();
+  ~UdevDeviceCache();
+
+  // Populates the cache from a scan of all devices known to |udev| and starts
+  // monitoring it for changes. Must be called on a thread with a
+  // brillo::MessageLoop.
+  bool Start(udev* udev);
+
+  // Applies any udev events that have been received but not processed yet.
+  // Called before the cache is used so that it reflects every event that udev
+  // has finished processing.
+  void ProcessPendingEvents();
+
+  // Sets a callback that is run after events from the monitors are processed.
+  void set_event_callback(const base::Closure& callback) {
+    event_callback_ = callback;
+  }
+
+  // Returns true if kernel uevents are being followed, i.e. if
+  // HasUnprocessedEvents() can be relied on.
+  bool tracking_kernel_events() const { return tracking_kernel_events_; }
+  void set_tracking_kernel_events_for_testing(bool tracking) {
+    tracking_kernel_events_ = tracking;
+  }
+
+  // Records that the kernel sent uevent |seqnum| for |syspath| and that udev
+  // has finished processing it, respectively. Normally called for the events
+  // reported by the monitors. The two sockets are read separately, so udev's
+  // report may be seen first; it is then remembered until the kernel's
+  // uevent with the same |seqnum| arrives, which isn't recorded.
+  void AddUnprocessedEvent(uint64_t seqnum, const std::string& syspath);
+  void RemoveUnprocessedEvent(uint64_t seqnum);
+
+  // Returns true if udev has not finished processing a kernel uevent for
+  // |syspath|, one of its ancestors or one of its descendants.
+  bool HasUnprocessedEvents(const std::string& syspath) const;
+
+  // Forgets all unprocessed kernel uevents. Called once the udev queue is known
+  // to be empty, in case udev never reported some of them.
+  void ClearUnprocessedEvents();
+
+  // Adds or updates the device at |syspath|. |devnode| may be empty.
+  void AddDevice(const std::string& syspath,
+                 const std::string& parent_syspath,
+                 const std::string& devnode);
+
+  // Removes the device at |syspath|.
+  void RemoveDevice(const std::string& syspath);
+
+  // Looks up the syspath of the device with node |devnode|.
+  bool FindSyspath(const std::string& devnode, std::string* syspath) const;
+
+  // Returns the syspaths of the direct children of |syspath|.
+  std::vector<std::string> GetChildren(const std::string& syspath) const;
+
+  // Returns the syspaths of all descendants of |syspath|.
+  std::vector<std::string> GetDescendants(const std::string& syspath) const;
+
+  size_t size() const { return devices_.size(); }
+
+  // Incremented every time the cache changes or a udev event is received.
+  uint64_t generation() const { return generation_; }
+
+ private:
+  struct Device {
+    std::string parent_syspath;
+    std::string devnode;
+  };
+
+  // Updates the cache with the device reported by |monitor_|.
+  void HandleDevice(udev_device* device);
+
+  // Called when |monitor_| or |kernel_monitor_| has events to read.
+  void OnUdevEvent();
+
+  // Keyed by syspath.
+  std::map<std::string, Device> devices_;
+  // Maps device nodes to syspaths.
+  std::map<std::string, std::string> devnodes_;
+  // Maps syspaths to the syspaths of their children.
+  std::map<std::string, std::set<std::string>> children_;
+
+  uint64_t generation_ = 0;
+
+  // Syspaths of kernel uevents that udev hasn't reported yet, keyed by
+  // sequence number.
+  std::map<uint64_t, std::string> unprocessed_events_;
+  // Sequence numbers that udev reported before the kernel's uevent was read.
+  // The kernel delivers uevents in sequence number order, so entries below
+  // the last uevent read will never be matched and are dropped.
+  std::set<uint64_t> processed_early_events_;
+  bool tracking_kernel_events_ = false;
+
+  base::Closure event_callback_;
+
+  ScopedUdevMonitorPtr monitor_;
+  brillo::MessageLoop::TaskId watch_task_ = brillo::MessageLoop::kTaskIdNull;
+  ScopedUdevMonitorPtr kernel_monitor_;
+  brillo::MessageLoop::TaskId kernel_watch_task_ =
+      brillo::MessageLoop::kTaskIdNull;
+
+  DISALLOW_COPY_AND_ASSIGN(UdevDeviceCache);
+};
+
+}  // namespace permission_broker
+
+#endif  // PERMISSION_BROKER_UDEV_DEVICE_CACHE_H_
@@ -0,0 +1,118 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Builds a fake sysfs tree of 16 USB hubs with 64 two-interface devices each,
+// then, for every hidraw node, finds its syspath and the other devices on the
+// same USB interface: once by walking the whole device list, as each
+// OpenPath request used to, and once through UdevDeviceCache. Both must find
+// the same devices; the cached lookups should take a small fraction of the
+// time of the scan.
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <base/logging.h>
+#include <base/strings/stringprintf.h>
+#include <base/time/time.h>
+
+#include "permission_broker/udev_device_cache.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const char kRoot[] = "/sys/devices/pci0000:00/0000:00:14.0";
+
+struct FakeDevice {
+  string syspath;
+  string parent_syspath;
+  string devnode;
+};
+
+// Builds a tree of |num_hubs| USB hubs with |devices_per_hub| devices each,
+// where every device has two interfaces and every interface has a hidraw
+// node and an input device.
+vector<FakeDevice> BuildFakeTree(int num_hubs, int devices_per_hub) {
+  vector<FakeDevice> tree;
+  int node = 0;
+  for (int hub = 0; hub < num_hubs; ++hub) {
+    const string hub_path = base::StringPrintf("%s/usb%d", kRoot, hub);
+    tree.push_back({hub_path, kRoot, ""});
+    for (int dev = 0; dev < devices_per_hub; ++dev) {
+      const string dev_path =
+          base::StringPrintf("%s/%d-%d", hub_path.c_str(), hub, dev);
+      tree.push_back({dev_path, hub_path,
+                      base::StringPrintf("/dev/bus/usb/%03d/%03d", hub, dev)});
+      for (int intf = 0; intf < 2; ++intf) {
+        const string intf_path = base::StringPrintf(
+            "%s/%d-%d:1.%d", dev_path.c_str(), hub, dev, intf);
+        tree.push_back({intf_path, dev_path, ""});
+        tree.push_back({intf_path + "/hidraw", intf_path,
+                        base::StringPrintf("/dev/hidraw%d", node)});
+        tree.push_back({intf_path + "/input", intf_path,
+                        base::StringPrintf("/dev/input/event%d", node)});
+        ++node;
+      }
+    }
+  }
+  return tree;
+}
+
+}  // namespace
+
+int main() {
+  const vector<FakeDevice> tree = BuildFakeTree(16, 64);
+  permission_broker::UdevDeviceCache cache;
+  for (const FakeDevice& device : tree)
+    cache.AddDevice(device.syspath, device.parent_syspath, device.devnode);
+  CHECK_EQ(tree.size(), cache.size());
+
+  vector<string> devnodes;
+  for (const FakeDevice& device : tree) {
+    if (device.devnode.find("/dev/hidraw") == 0)
+      devnodes.push_back(device.devnode);
+  }
+
+  // Find each hidraw node and the devices that share its USB interface.
+  base::TimeTicks start = base::TimeTicks::Now();
+  size_t scan_matches = 0;
+  for (const string& devnode : devnodes) {
+    string syspath;
+    for (const FakeDevice& device : tree) {
+      if (device.devnode == devnode) {
+        syspath = device.syspath;
+        break;
+      }
+    }
+    const string intf_path = syspath.substr(0, syspath.rfind('/'));
+    for (const FakeDevice& device : tree) {
+      if (device.syspath.compare(0, intf_path.size() + 1, intf_path + "/") ==
+          0) {
+        ++scan_matches;
+      }
+    }
+  }
+  const base::TimeDelta scan_time = base::TimeTicks::Now() - start;
+
+  start = base::TimeTicks::Now();
+  size_t cache_matches = 0;
+  for (const string& devnode : devnodes) {
+    string syspath;
+    CHECK(cache.FindSyspath(devnode, &syspath));
+    const string intf_path = syspath.substr(0, syspath.rfind('/'));
+    cache_matches += cache.GetDescendants(intf_path).size();
+  }
+  const base::TimeDelta cache_time = base::TimeTicks::Now() - start;
+  CHECK_EQ(scan_matches, cache_matches);
+
+  printf("%zu lookups in a tree of %zu devices: %" PRId64 " us scanning, "
+         "%" PRId64 " us with the cache\n",
+         devnodes.size(), tree.size(), scan_time.InMicroseconds(),
+         cache_time.InMicroseconds());
+  return 0;
+}
@@ -0,0 +1,132 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "permission_broker/udev_device_cache.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using std::string;
+using std::vector;
+
+namespace permission_broker {
+
+class UdevDeviceCacheTest : public testing::Test {
+ public:
+  UdevDeviceCacheTest() = default;
+  ~UdevDeviceCacheTest() override = default;
+
+ protected:
+  UdevDeviceCache cache_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(UdevDeviceCacheTest);
+};
+
+TEST_F(UdevDeviceCacheTest, FindSyspath) {
+  cache_.AddDevice("/sys/devices/a", "", "/dev/a");
+  cache_.AddDevice("/sys/devices/b", "", "");
+
+  string syspath;
+  EXPECT_TRUE(cache_.FindSyspath("/dev/a", &syspath));
+  EXPECT_EQ("/sys/devices/a", syspath);
+  EXPECT_FALSE(cache_.FindSyspath("/dev/b", &syspath));
+  EXPECT_FALSE(cache_.FindSyspath("", &syspath));
+
+  // The node moves to another device.
+  cache_.AddDevice("/sys/devices/b", "", "/dev/a");
+  EXPECT_TRUE(cache_.FindSyspath("/dev/a", &syspath));
+  EXPECT_EQ("/sys/devices/b", syspath);
+  cache_.RemoveDevice("/sys/devices/a");
+  EXPECT_TRUE(cache_.FindSyspath("/dev/a", &syspath));
+  cache_.RemoveDevice("/sys/devices/b");
+  EXPECT_FALSE(cache_.FindSyspath("/dev/a", &syspath));
+  EXPECT_EQ(0, cache_.size());
+}
+
+TEST_F(UdevDeviceCacheTest, ChildrenAndDescendants) {
+  cache_.AddDevice("/sys/devices/usb", "", "");
+  cache_.AddDevice("/sys/devices/usb/1-1", "/sys/devices/usb", "/dev/usb1");
+  cache_.AddDevice("/sys/devices/usb/1-1/1-1:1.0", "/sys/devices/usb/1-1", "");
+  cache_.AddDevice("/sys/devices/usb/1-1/1-1:1.0/hidraw",
+                   "/sys/devices/usb/1-1/1-1:1.0", "/dev/hidraw0");
+  cache_.AddDevice("/sys/devices/usb/1-2", "/sys/devices/usb", "/dev/usb2");
+
+  vector<string> children = cache_.GetChildren("/sys/devices/usb");
+  std::sort(children.begin(), children.end());
+  ASSERT_EQ(2, children.size());
+  EXPECT_EQ("/sys/devices/usb/1-1", children[0]);
+  EXPECT_EQ("/sys/devices/usb/1-2", children[1]);
+
+  vector<string> descendants = cache_.GetDescendants("/sys/devices/usb/1-1");
+  std::sort(descendants.begin(), descendants.end());
+  ASSERT_EQ(2, descendants.size());
+  EXPECT_EQ("/sys/devices/usb/1-1/1-1:1.0", descendants[0]);
+  EXPECT_EQ("/sys/devices/usb/1-1/1-1:1.0/hidraw", descendants[1]);
+
+  cache_.RemoveDevice("/sys/devices/usb/1-1/1-1:1.0/hidraw");
+  EXPECT_TRUE(cache_.GetChildren("/sys/devices/usb/1-1/1-1:1.0").empty());
+  EXPECT_EQ(1, cache_.GetDescendants("/sys/devices/usb/1-1").size());
+  EXPECT_TRUE(cache_.GetChildren("/sys/devices/nonexistent").empty());
+}
+
+TEST_F(UdevDeviceCacheTest, Generation) {
+  const uint64_t initial = cache_.generation();
+  cache_.AddDevice("/sys/devices/a", "", "/dev/a");
+  const uint64_t added = cache_.generation();
+  EXPECT_NE(initial, added);
+
+  // Adding the same device again changes nothing.
+  cache_.AddDevice("/sys/devices/a", "", "/dev/a");
+  EXPECT_EQ(added, cache_.generation());
+
+  cache_.RemoveDevice("/sys/devices/nonexistent");
+  EXPECT_EQ(added, cache_.generation());
+  cache_.RemoveDevice("/sys/devices/a");
+  EXPECT_NE(added, cache_.generation());
+}
+
+TEST_F(UdevDeviceCacheTest, UnprocessedEvents) {
+  const string device = "/sys/devices/usb/1-1";
+  EXPECT_FALSE(cache_.HasUnprocessedEvents(device));
+
+  cache_.AddUnprocessedEvent(1, "/sys/devices/usb/1-1/1-1:1.0");
+  cache_.AddUnprocessedEvent(2, "/sys/devices/usb/1-10");
+  EXPECT_TRUE(cache_.HasUnprocessedEvents(device));
+  EXPECT_TRUE(cache_.HasUnprocessedEvents("/sys/devices/usb"));
+  EXPECT_FALSE(cache_.HasUnprocessedEvents("/sys/devices/usb/1-2"));
+
+  cache_.RemoveUnprocessedEvent(1);
+  EXPECT_FALSE(cache_.HasUnprocessedEvents(device));
+
+  // An event for an ancestor affects the device as well.
+  cache_.AddUnprocessedEvent(3, "/sys/devices/usb");
+  EXPECT_TRUE(cache_.HasUnprocessedEvents(device));
+  cache_.ClearUnprocessedEvents();
+  EXPECT_FALSE(cache_.HasUnprocessedEvents(device));
+  EXPECT_FALSE(cache_.HasUnprocessedEvents("/sys/devices/usb/1-10"));
+}
+
+// udev's report of an event may be read before the kernel's uevent.
+TEST_F(UdevDeviceCacheTest, EventProcessedBeforeUevent) {
+  const string device = "/sys/devices/usb/1-1";
+  cache_.RemoveUnprocessedEvent(5);
+  cache_.AddUnprocessedEvent(5, device);
+  EXPECT_FALSE(cache_.HasUnprocessedEvents(device));
+
+  // A report whose uevent was never read is dropped once a later uevent
+  // arrives, so it can't hide anything afterwards.
+  cache_.RemoveUnprocessedEvent(6);
+  cache_.AddUnprocessedEvent(7, device);
+  EXPECT_TRUE(cache_.HasUnprocessedEvents(device));
+  cache_.RemoveUnprocessedEvent(7);
+  EXPECT_FALSE(cache_.HasUnprocessedEvents(device));
+  cache_.AddUnprocessedEvent(6, device);
+  EXPECT_TRUE(cache_.HasUnprocessedEvents(device));
+}
+
+}  // namespace permission_broker
@@ -18,4 +18,8 @@ void UdevDeviceDeleter::operator()(udev_device* device) const {
   udev_device_unref(device);
 }
 
+void UdevMonitorDeleter::operator()(udev_monitor* monitor) const {
+  udev_monitor_unref(monitor);
+}
+
 }  // namespace permission_broker
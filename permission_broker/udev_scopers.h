@@ -23,10 +23,15 @@ struct UdevDeviceDeleter {
   void operator()(udev_device* device) const;
 };
 
+struct UdevMonitorDeleter {
+  void operator()(udev_monitor* monitor) const;
+};
+
 typedef std::unique_ptr<udev, UdevDeleter> ScopedUdevPtr;
 typedef std::unique_ptr<udev_enumerate, UdevEnumerateDeleter>
     ScopedUdevEnumeratePtr;
 typedef std::unique_ptr<udev_device, UdevDeviceDeleter> ScopedUdevDevicePtr;
+typedef std::unique_ptr<udev_monitor, UdevMonitorDeleter> ScopedUdevMonitorPtr;
 
 }  // namespace permission_broker
 
@@ -119,5 +119,12 @@ const char kDarkResumeWakeDurationMsName[] = "Power.DarkResumeWakeDurationMs";
 const int kDarkResumeWakeDurationMsMin = 0;
 const int kDarkResumeWakeDurationMsMax = 10 * 60 * 1000;
 
+const char kSuspendPrepareDurationName[] = "Power.SuspendPrepareDuration";
+const char kSuspendDelaysDurationName[] = "Power.SuspendDelaysDuration";
+const char kSuspendScriptDurationName[] = "Power.SuspendScriptDuration";
+const char kResumeFinishDurationName[] = "Power.ResumeFinishDuration";
+const int kSuspendPhaseDurationMsMin = 1;
+const int kSuspendPhaseDurationMsMax = 60 * 1000;
+
 }  // namespace metrics
 }  // namespace power_manager
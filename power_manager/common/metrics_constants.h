@@ -111,6 +111,13 @@ extern const char kDarkResumeWakeDurationMsName[];
 extern const int kDarkResumeWakeDurationMsMin;
 extern const int kDarkResumeWakeDurationMsMax;
 
+extern const char kSuspendPrepareDurationName[];
+extern const char kSuspendDelaysDurationName[];
+extern const char kSuspendScriptDurationName[];
+extern const char kResumeFinishDurationName[];
+extern const int kSuspendPhaseDurationMsMin;
+extern const int kSuspendPhaseDurationMsMax;
+
 // Values for kBatteryInfoSampleName.
 enum class BatteryInfoSampleResult {
   READ,
@@ -234,6 +234,22 @@ extern const char kBusServicePath[];
 extern const char kBusInterface[];
 extern const char kBusNameOwnerChangedSignal[];
 
+// powerd D-Bus method that returns a string describing recent suspend requests.
+// Not yet part of system_api.
+extern const char kGetSuspendTracesMethod[];
+
+// powerd D-Bus signal emitted shortly before an idle-triggered suspend request
+// to give slow suspend delays a head start. Arguments are the int64 internal
+// TimeDelta value until the request is expected and an array of the int32 IDs
+// of the delays being notified. Not yet part of system_api.
+extern const char kSuspendImminentSoonSignal[];
+
+// powerd D-Bus signal emitted if the request announced by the last
+// kSuspendImminentSoonSignal won't happen after all, e.g. because the user
+// became active. The argument is an array of the int32 IDs of the delays that
+// were notified. Not yet part of system_api.
+extern const char kSuspendImminentSoonCanceledSignal[];
+
 // Small value used when comparing floating-point percentages.
 extern const double kEpsilon;
 
@@ -48,11 +48,6 @@
     {
       'target_name': 'libsystem',
       'type': 'static_library',
-      'link_settings': {
-        'libraries': [
-          '-lrt',
-        ],
-      },
       'sources': [
         'powerd/system/acpi_wakeup_helper.cc',
         'powerd/system/ambient_light_sensor.cc',
@@ -126,6 +121,7 @@
         'powerd/policy/keyboard_backlight_controller.cc',
         'powerd/policy/state_controller.cc',
         'powerd/policy/suspend_delay_controller.cc',
+        'powerd/policy/suspend_tracer.cc',
         'powerd/policy/suspender.cc',
       ],
     },
@@ -376,6 +372,7 @@
             'powerd/policy/keyboard_backlight_controller_unittest.cc',
             'powerd/policy/state_controller_unittest.cc',
             'powerd/policy/suspend_delay_controller_unittest.cc',
+            'powerd/policy/suspend_tracer_unittest.cc',
             'powerd/policy/suspender_unittest.cc',
           ],
         },
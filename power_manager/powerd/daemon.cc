@@ -235,6 +235,18 @@ class Daemon::StateControllerDelegate
     daemon_->dbus_wrapper_->EmitBareSignal(kIdleActionDeferredSignal);
   }
 
+  base::TimeDelta GetSuspendNotice() override {
+    return daemon_->suspender_->GetEarlyNotificationLeadTime();
+  }
+
+  void NotifySuspendSoon(base::TimeDelta time_until_suspend) override {
+    daemon_->suspender_->NotifySuspendSoon(time_until_suspend);
+  }
+
+  void CancelSuspendSoon() override {
+    daemon_->suspender_->CancelSuspendSoon();
+  }
+
   void ReportUserActivityMetrics() override {
     daemon_->metrics_collector_->GenerateUserActivityMetrics();
   }
@@ -755,6 +767,10 @@ void Daemon::GenerateDarkResumeMetrics(
                                                 suspend_duration);
 }
 
+void Daemon::GenerateSuspendTraceMetrics(const policy::SuspendTrace& trace) {
+  metrics_collector_->GenerateSuspendTraceMetrics(trace);
+}
+
 void Daemon::ShutDownForFailedSuspend() {
   ShutDown(ShutdownMode::POWER_OFF, ShutdownReason::SUSPEND_FAILED);
 }
@@ -936,6 +952,7 @@ void Daemon::InitDBus() {
        &Suspender::HandleDarkSuspendReadiness},
       {kRecordDarkResumeWakeReasonMethod,
        &Suspender::RecordDarkResumeWakeReason},
+      {kGetSuspendTracesMethod, &Suspender::GetSuspendTraces},
   };
   for (const auto& it : kSuspenderMethods) {
     dbus_wrapper_->ExportMethod(
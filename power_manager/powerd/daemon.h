@@ -136,6 +136,7 @@ class Daemon : public policy::BacklightControllerObserver,
       const std::vector<policy::Suspender::DarkResumeInfo>&
           dark_resume_wake_durations,
       base::TimeDelta suspend_duration) override;
+  void GenerateSuspendTraceMetrics(const policy::SuspendTrace& trace) override;
   void ShutDownForFailedSuspend() override;
   void ShutDownForDarkResume() override;
 
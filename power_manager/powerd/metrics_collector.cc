@@ -8,6 +8,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <utility>
 
 #include <base/logging.h>
 
@@ -297,6 +298,27 @@ void MetricsCollector::GenerateDarkResumeMetrics(
   }
 }
 
+void MetricsCollector::GenerateSuspendTraceMetrics(
+    const policy::SuspendTrace& trace) {
+  // Canceled requests are cut short at arbitrary points.
+  if (!trace.success)
+    return;
+
+  const std::vector<std::pair<const char*, base::TimeDelta>> kPhases = {
+      {kSuspendPrepareDurationName, trace.prepare_duration},
+      {kSuspendDelaysDurationName, trace.delays_duration},
+      {kSuspendScriptDurationName, trace.suspend_script_duration},
+      {kResumeFinishDurationName, trace.finish_duration},
+  };
+  for (const auto& phase : kPhases) {
+    SendMetric(phase.first,
+               phase.second.InMilliseconds(),
+               kSuspendPhaseDurationMsMin,
+               kSuspendPhaseDurationMsMax,
+               kDefaultBuckets);
+  }
+}
+
 void MetricsCollector::GenerateUserActivityMetrics() {
   if (last_idle_event_timestamp_.is_null())
     return;
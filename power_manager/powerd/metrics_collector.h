@@ -85,6 +85,10 @@ class MetricsCollector {
       const std::vector<policy::Suspender::DarkResumeInfo>& wake_durations,
       base::TimeDelta suspend_duration);
 
+  // Called after a suspend request has completed. Generates UMA metrics
+  // describing the time spent in each phase of a successful request.
+  void GenerateSuspendTraceMetrics(const policy::SuspendTrace& trace);
+
   // Generates UMA metrics on when leaving the idle state.
   void GenerateUserActivityMetrics();
 
@@ -550,6 +550,43 @@ TEST_F(MetricsCollectorTest, GatherDarkResumeMetrics) {
   collector_.GenerateDarkResumeMetrics(wake_durations, suspend_duration);
 }
 
+TEST_F(MetricsCollectorTest, SuspendTraceMetrics) {
+  Init();
+
+  policy::SuspendTrace trace;
+  trace.success = true;
+  trace.prepare_duration = base::TimeDelta::FromMilliseconds(12);
+  trace.delays_duration = base::TimeDelta::FromMilliseconds(340);
+  trace.suspend_script_duration = base::TimeDelta::FromMilliseconds(1500);
+  trace.finish_duration = base::TimeDelta::FromMilliseconds(25);
+  ExpectMetric(kSuspendPrepareDurationName,
+               trace.prepare_duration.InMilliseconds(),
+               kSuspendPhaseDurationMsMin,
+               kSuspendPhaseDurationMsMax,
+               kDefaultBuckets);
+  ExpectMetric(kSuspendDelaysDurationName,
+               trace.delays_duration.InMilliseconds(),
+               kSuspendPhaseDurationMsMin,
+               kSuspendPhaseDurationMsMax,
+               kDefaultBuckets);
+  ExpectMetric(kSuspendScriptDurationName,
+               trace.suspend_script_duration.InMilliseconds(),
+               kSuspendPhaseDurationMsMin,
+               kSuspendPhaseDurationMsMax,
+               kDefaultBuckets);
+  ExpectMetric(kResumeFinishDurationName,
+               trace.finish_duration.InMilliseconds(),
+               kSuspendPhaseDurationMsMin,
+               kSuspendPhaseDurationMsMax,
+               kDefaultBuckets);
+  collector_.GenerateSuspendTraceMetrics(trace);
+  Mock::VerifyAndClearExpectations(metrics_lib_);
+
+  // Nothing should be reported for canceled requests.
+  trace.success = false;
+  collector_.GenerateSuspendTraceMetrics(trace);
+}
+
 TEST_F(MetricsCollectorTest, BatteryDischargeRateWhileSuspended) {
   const double kEnergyBeforeSuspend = 60;
   const double kEnergyAfterResume = 50;
@@ -204,6 +204,22 @@ void AmbientLightHandler::OnAmbientLightUpdated(
   }
 }
 
+bool AmbientLightHandler::GetStableLuxRange(int* min_lux, int* max_lux) const {
+  // The next reading is acted on no matter what it is.
+  if (steps_.empty() || hysteresis_state_ == HysteresisState::IMMEDIATE)
+    return false;
+
+  // Readings between the current step's thresholds keep the current step.
+  const BrightnessStep& step = steps_[step_index_];
+  *min_lux = step.decrease_lux_threshold == -1
+                 ? -1
+                 : step.decrease_lux_threshold + 1;
+  *max_lux = step.increase_lux_threshold == -1
+                 ? -1
+                 : step.increase_lux_threshold - 1;
+  return true;
+}
+
 double AmbientLightHandler::GetTargetPercent() const {
   CHECK_LT(step_index_, steps_.size());
   return power_source_ == PowerSource::AC
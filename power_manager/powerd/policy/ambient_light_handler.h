@@ -89,6 +89,7 @@ class AmbientLightHandler : public system::AmbientLightObserver {
   // system::AmbientLightObserver implementation:
   void OnAmbientLightUpdated(
       system::AmbientLightSensorInterface* sensor) override;
+  bool GetStableLuxRange(int* min_lux, int* max_lux) const override;
 
  private:
   // Contains information from prefs about a brightness step.
@@ -177,5 +177,38 @@ TEST_F(AmbientLightHandlerTest, DeferInitialChange) {
             delegate_.cause());
 }
 
+TEST_F(AmbientLightHandlerTest, StableLuxRange) {
+  steps_pref_ = "20.0 -1 40\n50.0 20 80\n100.0 60 -1";
+  initial_lux_ = 50;
+  initial_brightness_percent_ = 60.0;
+  Init();
+
+  // Every reading matters until the first one has been acted on.
+  int min_lux = 0, max_lux = 0;
+  EXPECT_FALSE(handler_.GetStableLuxRange(&min_lux, &max_lux));
+
+  // After that, readings strictly between the current step's thresholds are
+  // ignored.
+  UpdateSensor(50);
+  ASSERT_TRUE(handler_.GetStableLuxRange(&min_lux, &max_lux));
+  EXPECT_EQ(21, min_lux);
+  EXPECT_EQ(79, max_lux);
+
+  // The top and bottom steps are unbounded on one side.
+  UpdateSensor(100);
+  UpdateSensor(100);
+  ASSERT_DOUBLE_EQ(100.0, delegate_.percent());
+  ASSERT_TRUE(handler_.GetStableLuxRange(&min_lux, &max_lux));
+  EXPECT_EQ(61, min_lux);
+  EXPECT_EQ(-1, max_lux);
+
+  UpdateSensor(0);
+  UpdateSensor(0);
+  ASSERT_DOUBLE_EQ(20.0, delegate_.percent());
+  ASSERT_TRUE(handler_.GetStableLuxRange(&min_lux, &max_lux));
+  EXPECT_EQ(-1, min_lux);
+  EXPECT_EQ(39, max_lux);
+}
+
 }  // namespace policy
 }  // namespace power_manager
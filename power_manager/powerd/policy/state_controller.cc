@@ -879,6 +879,26 @@ void StateController::UpdateState() {
   }
   resend_idle_warning_ = false;
 
+  // Give suspend delays that are slow to report readiness a head start.
+  suspend_notice_ = idle_action_ == Action::SUSPEND
+                        ? std::min(delegate_->GetSuspendNotice(), delays_.idle)
+                        : base::TimeDelta();
+  if (suspend_notice_ <= base::TimeDelta() ||
+      idle_duration < delays_.idle - suspend_notice_) {
+    // Let the notified delays stand down if the system didn't suspend.
+    if (sent_suspend_notice_ && !idle_action_performed_) {
+      LOG(INFO) << "Canceling suspend announcement";
+      delegate_->CancelSuspendSoon();
+    }
+    sent_suspend_notice_ = false;
+  } else if (!sent_suspend_notice_ && idle_duration < delays_.idle) {
+    const base::TimeDelta time_until_suspend = delays_.idle - idle_duration;
+    LOG(INFO) << "Announcing suspend in "
+              << util::TimeDeltaToString(time_until_suspend);
+    delegate_->NotifySuspendSoon(time_until_suspend);
+    sent_suspend_notice_ = true;
+  }
+
   bool docked = in_docked_mode();
   if (docked != turned_panel_off_for_docked_mode_) {
     LOG(INFO) << "Turning panel " << (docked ? "off" : "on") << " after "
@@ -983,6 +1003,12 @@ void StateController::ScheduleActionTimeout(base::TimeTicks now) {
                         GetLastActivityTimeForIdle(now),
                         delays_.idle,
                         &timeout_delay);
+    if (suspend_notice_ > base::TimeDelta()) {
+      UpdateActionTimeout(now,
+                          GetLastActivityTimeForIdle(now),
+                          delays_.idle - suspend_notice_,
+                          &timeout_delay);
+    }
   }
 
   if (timeout_delay > base::TimeDelta()) {
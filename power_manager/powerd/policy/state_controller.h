@@ -88,6 +88,19 @@ class StateController : public PrefsObserver {
     // state before the idle action was performed.
     virtual void EmitIdleActionDeferred() = 0;
 
+    // Returns how long before the system suspends for inactivity
+    // NotifySuspendSoon() should be called, or zero if no advance notice is
+    // needed.
+    virtual base::TimeDelta GetSuspendNotice() = 0;
+
+    // Announces that the system will suspend for inactivity after
+    // |time_until_suspend|.
+    virtual void NotifySuspendSoon(base::TimeDelta time_until_suspend) = 0;
+
+    // Called after NotifySuspendSoon() if the system didn't suspend for
+    // inactivity after all, e.g. because the user became active.
+    virtual void CancelSuspendSoon() = 0;
+
     // Reports metrics in response to user activity.
     virtual void ReportUserActivityMetrics() = 0;
   };
@@ -323,6 +336,7 @@ class StateController : public PrefsObserver {
   bool screen_turned_off_ = false;
   bool requested_screen_lock_ = false;
   bool sent_idle_warning_ = false;
+  bool sent_suspend_notice_ = false;
   bool idle_action_performed_ = false;
   bool lid_closed_action_performed_ = false;
   bool turned_panel_off_for_docked_mode_ = false;
@@ -334,6 +348,10 @@ class StateController : public PrefsObserver {
   // changed.
   bool resend_idle_warning_ = false;
 
+  // Advance notice requested by |delegate_| before suspending for inactivity,
+  // updated by UpdateState().
+  base::TimeDelta suspend_notice_;
+
   // Time at which the screen was turned off, or null if
   // |screen_turned_off_| is false.  Used for updating
   // |saw_user_activity_soon_after_screen_dim_or_off_|.
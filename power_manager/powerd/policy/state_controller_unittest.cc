@@ -36,6 +36,8 @@ const char kShutDown[] = "shut_down";
 const char kDocked[] = "docked";
 const char kUndocked[] = "undocked";
 const char kIdleDeferred[] = "idle_deferred";
+const char kSuspendSoon[] = "suspend_soon";
+const char kCancelSuspendSoon[] = "cancel_suspend_soon";
 const char kReportUserActivityMetrics[] = "metrics";
 
 // String returned by TestDelegate::GetActions() if no actions were
@@ -71,6 +73,7 @@ class TestDelegate : public StateController::Delegate, public ActionRecorder {
     headphone_jack_plugged_ = plugged;
   }
   void set_lid_state(LidState state) { lid_state_ = state; }
+  void set_suspend_notice(base::TimeDelta notice) { suspend_notice_ = notice; }
 
   // StateController::Delegate overrides:
   bool IsUsbInputDeviceConnected() override {
@@ -95,6 +98,11 @@ class TestDelegate : public StateController::Delegate, public ActionRecorder {
     AppendAction(GetIdleImminentAction(time_until_idle_action));
   }
   void EmitIdleActionDeferred() override { AppendAction(kIdleDeferred); }
+  base::TimeDelta GetSuspendNotice() override { return suspend_notice_; }
+  void NotifySuspendSoon(base::TimeDelta time_until_suspend) override {
+    AppendAction(kSuspendSoon);
+  }
+  void CancelSuspendSoon() override { AppendAction(kCancelSuspendSoon); }
   void ReportUserActivityMetrics() override {
     if (record_metrics_actions_)
       AppendAction(kReportUserActivityMetrics);
@@ -120,6 +128,9 @@ class TestDelegate : public StateController::Delegate, public ActionRecorder {
   // Lid state to be returned by QueryLidState().
   LidState lid_state_;
 
+  // Value returned by GetSuspendNotice().
+  base::TimeDelta suspend_notice_;
+
   DISALLOW_COPY_AND_ASSIGN(TestDelegate);
 };
 
@@ -997,7 +1008,52 @@ TEST_F(StateControllerTest, AvoidSuspendDuringSystemUpdate) {
             delegate_.GetActions());
 }
 
-// Tests that idle warnings are emitted as requested.
+// Tests that slow suspend delays are notified before suspending for
+// inactivity.
+TEST_F(StateControllerTest, SuspendNotice) {
+  const base::TimeDelta kNotice = base::TimeDelta::FromSeconds(5);
+  delegate_.set_suspend_notice(kNotice);
+  Init();
+
+  const base::TimeDelta kIdleDelay = base::TimeDelta::FromSeconds(60);
+  PowerManagementPolicy policy;
+  policy.mutable_ac_delays()->set_screen_dim_ms(0);
+  policy.mutable_ac_delays()->set_screen_off_ms(0);
+  policy.mutable_ac_delays()->set_screen_lock_ms(0);
+  policy.mutable_ac_delays()->set_idle_ms(kIdleDelay.InMilliseconds());
+  policy.set_ac_idle_action(PowerManagementPolicy_Action_SUSPEND);
+  controller_.HandlePolicyChange(policy);
+
+  // The notice should be sent once, |kNotice| before suspending.
+  ASSERT_TRUE(StepTimeAndTriggerTimeout(kIdleDelay - kNotice));
+  EXPECT_EQ(kSuspendSoon, delegate_.GetActions());
+  ASSERT_TRUE(StepTimeAndTriggerTimeout(kIdleDelay));
+  EXPECT_EQ(kSuspend, delegate_.GetActions());
+
+  // It should be sent again after user activity.
+  controller_.HandleUserActivity();
+  ResetLastStepDelay();
+  ASSERT_TRUE(StepTimeAndTriggerTimeout(kIdleDelay - kNotice));
+  EXPECT_EQ(kSuspendSoon, delegate_.GetActions());
+
+  // If the user becomes active before the system suspends, the notice should
+  // be canceled.
+  controller_.HandleUserActivity();
+  EXPECT_EQ(kCancelSuspendSoon, delegate_.GetActions());
+  ResetLastStepDelay();
+  ASSERT_TRUE(StepTimeAndTriggerTimeout(kIdleDelay - kNotice));
+  EXPECT_EQ(kSuspendSoon, delegate_.GetActions());
+
+  // No notice is needed if the idle action isn't suspending.
+  controller_.HandleUserActivity();
+  EXPECT_EQ(kCancelSuspendSoon, delegate_.GetActions());
+  policy.set_ac_idle_action(PowerManagementPolicy_Action_STOP_SESSION);
+  controller_.HandlePolicyChange(policy);
+  ResetLastStepDelay();
+  ASSERT_TRUE(StepTimeAndTriggerTimeout(kIdleDelay));
+  EXPECT_EQ(kStopSession, delegate_.GetActions());
+}
+
 TEST_F(StateControllerTest, IdleWarnings) {
   Init();
 
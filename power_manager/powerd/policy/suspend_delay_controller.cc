@@ -14,6 +14,7 @@
 #include <base/strings/string_number_conversions.h>
 #include <chromeos/dbus/service_constants.h>
 
+#include "power_manager/common/clock.h"
 #include "power_manager/common/util.h"
 #include "power_manager/powerd/policy/suspend_delay_observer.h"
 #include "power_manager/proto_bindings/suspend.pb.h"
@@ -27,13 +28,24 @@ namespace {
 // ready, in milliseconds.
 const int kMaxDelayTimeoutMs = 20000;
 
+// Number of readiness latencies remembered for each delay description.
+const size_t kLatencyHistorySize = 5;
+
+// Delays whose recent latencies exceed this are notified early about
+// anticipated suspend requests, in milliseconds.
+const int kSlowDelayThresholdMs = 1000;
+
 }  // namespace
 
 SuspendDelayController::SuspendDelayController(int initial_delay_id,
-                                               const std::string& description)
+                                               const std::string& description,
+                                               Clock* clock)
     : description_(description),
       next_delay_id_(initial_delay_id),
-      current_suspend_id_(0) {}
+      current_suspend_id_(0),
+      clock_(clock) {
+  DCHECK(clock_);
+}
 
 SuspendDelayController::~SuspendDelayController() {}
 
@@ -104,6 +116,7 @@ void SuspendDelayController::HandleSuspendReadiness(
                  << ", which we weren't waiting for";
     return;
   }
+  AddDelayTrace(delay_id, false);
   RemoveDelayFromWaitList(delay_id);
 }
 
@@ -129,6 +142,9 @@ void SuspendDelayController::HandleDBusClientDisconnected(
 
 void SuspendDelayController::PrepareForSuspend(int suspend_id) {
   current_suspend_id_ = suspend_id;
+  suspend_start_time_ = clock_->GetCurrentTime();
+  delay_traces_.clear();
+  early_notified_delay_ids_.clear();
 
   size_t old_count = delay_ids_being_waited_on_.size();
   delay_ids_being_waited_on_.clear();
@@ -141,22 +157,60 @@ void SuspendDelayController::PrepareForSuspend(int suspend_id) {
             << current_suspend_id_ << " with "
             << delay_ids_being_waited_on_.size() << " pending delay(s) and "
             << old_count << " outstanding delay(s) from previous request";
-  if (delay_ids_being_waited_on_.empty()) {
+  if (delay_ids_being_waited_on_.empty())
     PostNotifyObserversTask(current_suspend_id_);
-  } else {
-    base::TimeDelta max_timeout;
-    for (DelayInfoMap::const_iterator it = registered_delays_.begin();
-         it != registered_delays_.end();
-         ++it) {
-      max_timeout = std::max(max_timeout, it->second.timeout);
-    }
-    max_timeout = std::min(
-        max_timeout, base::TimeDelta::FromMilliseconds(kMaxDelayTimeoutMs));
-    delay_expiration_timer_.Start(FROM_HERE,
-                                  max_timeout,
-                                  this,
-                                  &SuspendDelayController::OnDelayExpiration);
+  else
+    ScheduleDelayExpiration();
+}
+
+base::TimeDelta SuspendDelayController::GetExpectedLatency(
+    const std::string& description) const {
+  base::TimeDelta latency;
+  auto it = latency_histories_.find(description);
+  if (it != latency_histories_.end()) {
+    for (const auto& sample : it->second)
+      latency = std::max(latency, sample);
+  }
+  return latency;
+}
+
+base::TimeDelta SuspendDelayController::GetEarlyNotificationLeadTime() const {
+  const base::TimeDelta threshold =
+      base::TimeDelta::FromMilliseconds(kSlowDelayThresholdMs);
+  base::TimeDelta lead_time;
+  for (const auto& it : registered_delays_) {
+    const base::TimeDelta latency = GetExpectedLatency(it.second.description);
+    if (latency >= threshold)
+      lead_time = std::max(lead_time, latency);
   }
+  return std::min(lead_time,
+                  base::TimeDelta::FromMilliseconds(kMaxDelayTimeoutMs));
+}
+
+std::vector<int> SuspendDelayController::PrepareForSuspendSoon() {
+  const base::TimeDelta threshold =
+      base::TimeDelta::FromMilliseconds(kSlowDelayThresholdMs);
+  early_notified_delay_ids_.clear();
+  for (const auto& it : registered_delays_) {
+    if (GetExpectedLatency(it.second.description) >= threshold)
+      early_notified_delay_ids_.insert(it.first);
+  }
+  if (!early_notified_delay_ids_.empty()) {
+    LOG(INFO) << "Notifying " << early_notified_delay_ids_.size()
+              << " slow " << GetLogDescription() << " delay(s) early";
+  }
+  return std::vector<int>(early_notified_delay_ids_.begin(),
+                          early_notified_delay_ids_.end());
+}
+
+std::vector<int> SuspendDelayController::CancelSuspendSoon() {
+  std::vector<int> delay_ids;
+  for (int delay_id : early_notified_delay_ids_) {
+    if (registered_delays_.count(delay_id))
+      delay_ids.push_back(delay_id);
+  }
+  early_notified_delay_ids_.clear();
+  return delay_ids;
 }
 
 void SuspendDelayController::FinishSuspend(int suspend_id) {
@@ -165,6 +219,7 @@ void SuspendDelayController::FinishSuspend(int suspend_id) {
 
   delay_expiration_timer_.Stop();
   delay_ids_being_waited_on_.clear();
+  early_notified_delay_ids_.clear();
 }
 
 std::string SuspendDelayController::GetLogDescription() const {
@@ -177,6 +232,50 @@ std::string SuspendDelayController::GetDelayDescription(int delay_id) const {
   return it != registered_delays_.end() ? it->second.description : "unknown";
 }
 
+void SuspendDelayController::AddDelayTrace(int delay_id, bool timed_out) {
+  SuspendTrace::DelayTrace trace;
+  DelayInfoMap::const_iterator it = registered_delays_.find(delay_id);
+  if (it != registered_delays_.end()) {
+    trace.description = it->second.description;
+    trace.dbus_client = it->second.dbus_client;
+  }
+  trace.latency = clock_->GetCurrentTime() - suspend_start_time_;
+  trace.timed_out = timed_out;
+  delay_traces_.push_back(trace);
+
+  // Early-notified delays are also measured from the announcement: they can't
+  // report readiness before it, so measuring from the notification would only
+  // ever grow their lead time. Once the head start lets them report promptly,
+  // their lead time shrinks as the slow samples age out of the history.
+  std::deque<base::TimeDelta>& history =
+      latency_histories_[trace.description];
+  history.push_back(trace.latency);
+  while (history.size() > kLatencyHistorySize)
+    history.pop_front();
+}
+
+base::TimeTicks SuspendDelayController::GetDelayDeadline(int delay_id) const {
+  base::TimeDelta timeout =
+      base::TimeDelta::FromMilliseconds(kMaxDelayTimeoutMs);
+  DelayInfoMap::const_iterator it = registered_delays_.find(delay_id);
+  if (it != registered_delays_.end())
+    timeout = std::min(timeout, it->second.timeout);
+  return suspend_start_time_ + timeout;
+}
+
+void SuspendDelayController::ScheduleDelayExpiration() {
+  DCHECK(!delay_ids_being_waited_on_.empty());
+  base::TimeTicks deadline =
+      GetDelayDeadline(*delay_ids_being_waited_on_.begin());
+  for (int delay_id : delay_ids_being_waited_on_)
+    deadline = std::min(deadline, GetDelayDeadline(delay_id));
+  delay_expiration_timer_.Start(
+      FROM_HERE,
+      std::max(base::TimeDelta(), deadline - clock_->GetCurrentTime()),
+      this,
+      &SuspendDelayController::OnDelayExpiration);
+}
+
 void SuspendDelayController::UnregisterDelayInternal(int delay_id) {
   if (!registered_delays_.count(delay_id)) {
     LOG(WARNING) << "Ignoring request to remove unknown " << GetLogDescription()
@@ -199,24 +298,37 @@ void SuspendDelayController::RemoveDelayFromWaitList(int delay_id) {
 }
 
 void SuspendDelayController::OnDelayExpiration() {
+  const base::TimeTicks now = clock_->GetCurrentTime();
+  std::vector<int> expired_delay_ids;
+  for (int delay_id : delay_ids_being_waited_on_) {
+    if (GetDelayDeadline(delay_id) <= now)
+      expired_delay_ids.push_back(delay_id);
+  }
+  if (expired_delay_ids.empty()) {
+    // The delay that the timer was started for already reported readiness.
+    ScheduleDelayExpiration();
+    return;
+  }
+
   std::string tardy_delays;
-  for (std::set<int>::const_iterator it = delay_ids_being_waited_on_.begin();
-       it != delay_ids_being_waited_on_.end();
-       ++it) {
-    const DelayInfo& delay = registered_delays_[*it];
+  for (int delay_id : expired_delay_ids) {
+    const DelayInfo& delay = registered_delays_[delay_id];
     if (!tardy_delays.empty())
       tardy_delays += ", ";
-    tardy_delays += base::IntToString(*it) + " (" + delay.dbus_client + ": " +
-                    delay.description + ")";
+    tardy_delays += base::IntToString(delay_id) + " (" + delay.dbus_client +
+                    ": " + delay.description + ")";
+    AddDelayTrace(delay_id, true);
+    delay_ids_being_waited_on_.erase(delay_id);
   }
   LOG(WARNING) << "Timed out while waiting for " << GetLogDescription()
                << " request " << current_suspend_id_
-               << " readiness confirmation for "
-               << delay_ids_being_waited_on_.size()
+               << " readiness confirmation for " << expired_delay_ids.size()
                << " delay(s): " << tardy_delays;
 
-  delay_ids_being_waited_on_.clear();
-  PostNotifyObserversTask(current_suspend_id_);
+  if (delay_ids_being_waited_on_.empty())
+    PostNotifyObserversTask(current_suspend_id_);
+  else
+    ScheduleDelayExpiration();
 }
 
 void SuspendDelayController::PostNotifyObserversTask(int suspend_id) {
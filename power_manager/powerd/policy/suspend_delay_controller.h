@@ -5,17 +5,22 @@
 #ifndef POWER_MANAGER_POWERD_POLICY_SUSPEND_DELAY_CONTROLLER_H_
 #define POWER_MANAGER_POWERD_POLICY_SUSPEND_DELAY_CONTROLLER_H_
 
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <base/macros.h>
 #include <base/observer_list.h>
 #include <base/time/time.h>
 #include <base/timer/timer.h>
 
+#include "power_manager/powerd/policy/suspend_tracer.h"
+
 namespace power_manager {
 
+class Clock;
 class RegisterSuspendDelayReply;
 class RegisterSuspendDelayRequest;
 class SuspendReadinessInfo;
@@ -27,13 +32,27 @@ class SuspendDelayObserver;
 
 // Handles D-Bus requests to delay suspending until other processes have had
 // time to do last-minute cleanup.
+//
+// Each delay is waited on until its own timeout expires, and the readiness
+// latencies of recent requests are remembered per delay description so that
+// delays that are usually slow can be notified before a request is announced.
 class SuspendDelayController {
  public:
-  SuspendDelayController(int initial_delay_id, const std::string& description);
+  // |clock| is used to measure delay latencies and must outlive this object.
+  SuspendDelayController(int initial_delay_id,
+                         const std::string& description,
+                         Clock* clock);
   ~SuspendDelayController();
 
   bool ready_for_suspend() const { return delay_ids_being_waited_on_.empty(); }
 
+  // Returns the time that each delay took to become ready for the current (or
+  // most-recent) suspend request, in the order that they became ready. Delays
+  // that were still pending when the request timed out are listed last.
+  const std::vector<SuspendTrace::DelayTrace>& delay_traces() const {
+    return delay_traces_;
+  }
+
   // Adds or removes an observer that will be notified when it's safe to
   // suspend.
   void AddObserver(SuspendDelayObserver* observer);
@@ -61,6 +80,25 @@ class SuspendDelayController {
   // |delays_being_waited_on_| and notifies clients that suspend is imminent.
   void PrepareForSuspend(int suspend_id);
 
+  // Returns the longest readiness latency recently observed for delays with
+  // |description|, or zero if there's no history.
+  base::TimeDelta GetExpectedLatency(const std::string& description) const;
+
+  // Returns how long before a suspend request delays with a history of slow
+  // readiness reports should be notified that the request is coming, or zero
+  // if no registered delays are slow.
+  base::TimeDelta GetEarlyNotificationLeadTime() const;
+
+  // Called shortly before an anticipated suspend request. Returns the IDs of
+  // registered delays that have historically been slow to report readiness;
+  // the caller is responsible for notifying them.
+  std::vector<int> PrepareForSuspendSoon();
+
+  // Called if the request anticipated by PrepareForSuspendSoon() won't happen.
+  // Returns the IDs of the still-registered delays that were notified, if the
+  // request hasn't started since; the caller is responsible for telling them.
+  std::vector<int> CancelSuspendSoon();
+
   // Stops |suspend_id| if it is in-progress, i.e. it matches
   // |current_suspend_id_|. This really just entails stopping
   // |delay_expiration_timer_| to avoid spamming the logs after a suspend
@@ -89,6 +127,18 @@ class SuspendDelayController {
   // Returns the human-readable description of |delay_id|.
   std::string GetDelayDescription(int delay_id) const;
 
+  // Appends an entry describing |delay_id| to |delay_traces_| and records its
+  // latency in |latency_histories_|.
+  void AddDelayTrace(int delay_id, bool timed_out);
+
+  // Returns the time at which the controller stops waiting for |delay_id| to
+  // become ready for the current request.
+  base::TimeTicks GetDelayDeadline(int delay_id) const;
+
+  // Starts |delay_expiration_timer_| to fire at the earliest deadline in
+  // |delay_ids_being_waited_on_|.
+  void ScheduleDelayExpiration();
+
   // Removes |delay_id| from |registered_delays_| and calls
   // RemoveDelayFromWaitList().
   void UnregisterDelayInternal(int delay_id);
@@ -99,9 +149,9 @@ class SuspendDelayController {
   void RemoveDelayFromWaitList(int delay_id);
 
   // Called by |delay_expiration_timer_| after a PrepareForSuspend() call if
-  // HandleSuspendReadiness() isn't invoked for all registered delays before the
-  // maximum delay timeout has elapsed.  Notifies observers that it's safe to
-  // suspend.
+  // HandleSuspendReadiness() isn't invoked for a registered delay before its
+  // timeout has elapsed. Stops waiting for expired delays and notifies
+  // observers that it's safe to suspend if no delays remain.
   void OnDelayExpiration();
 
   // Posts a NotifyObservers() call to the message loop.
@@ -130,6 +180,23 @@ class SuspendDelayController {
   // suspend.
   std::set<int> delay_ids_being_waited_on_;
 
+  Clock* clock_;  // weak
+
+  // Time at which the current suspend request was announced.
+  base::TimeTicks suspend_start_time_;
+
+  // Latencies of delays for the current suspend request.
+  std::vector<SuspendTrace::DelayTrace> delay_traces_;
+
+  // Most-recent readiness latencies, oldest first, keyed by delay description.
+  // Descriptions are used rather than delay IDs or D-Bus names so that history
+  // survives clients restarting.
+  std::map<std::string, std::deque<base::TimeDelta>> latency_histories_;
+
+  // Delays returned by the last PrepareForSuspendSoon() call. Cleared when the
+  // anticipated request starts.
+  std::set<int> early_notified_delay_ids_;
+
   // Used to invoke NotifyObservers().
   base::OneShotTimer notify_observers_timer_;
 
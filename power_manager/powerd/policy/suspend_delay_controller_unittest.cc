@@ -4,11 +4,18 @@
 
 #include "power_manager/powerd/policy/suspend_delay_controller.h"
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include <base/compiler_specific.h>
+#include <base/logging.h>
+#include <base/strings/stringprintf.h>
 #include <base/time/time.h>
 #include <chromeos/dbus/service_constants.h>
 #include <gtest/gtest.h>
 
+#include "power_manager/common/clock.h"
 #include "power_manager/common/test_main_loop_runner.h"
 #include "power_manager/powerd/policy/suspend_delay_observer.h"
 #include "power_manager/proto_bindings/suspend.pb.h"
@@ -50,7 +57,7 @@ class TestObserver : public SuspendDelayObserver {
 
 class SuspendDelayControllerTest : public ::testing::Test {
  public:
-  SuspendDelayControllerTest() : controller_(1, "") {
+  SuspendDelayControllerTest() : controller_(1, "", &clock_) {
     controller_.AddObserver(&observer_);
   }
 
@@ -87,6 +94,55 @@ class SuspendDelayControllerTest : public ::testing::Test {
     controller_.HandleSuspendReadiness(info, client);
   }
 
+  // Simulates a suspend request in which the client that registered
+  // |delay_ids[i]| needs |work[i]| to prepare for suspend, starting when it's
+  // notified. If |notify_early| is true, slow clients are notified
+  // GetEarlyNotificationLeadTime() before the request is announced. Returns
+  // the time between the announcement and the controller becoming ready.
+  base::TimeDelta SimulateRequest(int suspend_id,
+                                  const std::vector<int>& delay_ids,
+                                  const std::vector<base::TimeDelta>& work,
+                                  bool notify_early) {
+    Clock* clock = &clock_;
+    base::TimeTicks now = base::TimeTicks::FromInternalValue(
+        static_cast<int64_t>(suspend_id) *
+        base::TimeDelta::FromMinutes(1).ToInternalValue());
+    clock->set_current_time_for_testing(now);
+
+    std::vector<int> early_ids;
+    base::TimeDelta lead_time;
+    if (notify_early) {
+      lead_time = controller_.GetEarlyNotificationLeadTime();
+      early_ids = controller_.PrepareForSuspendSoon();
+      now += lead_time;
+      clock->set_current_time_for_testing(now);
+    }
+    const base::TimeTicks early_time = now - lead_time;
+    const base::TimeTicks announce_time = now;
+    controller_.PrepareForSuspend(suspend_id);
+
+    std::vector<std::pair<base::TimeTicks, int>> ready_times;
+    for (size_t i = 0; i < delay_ids.size(); ++i) {
+      const bool early = std::find(early_ids.begin(),
+                                   early_ids.end(),
+                                   delay_ids[i]) != early_ids.end();
+      const base::TimeTicks start = early ? early_time : announce_time;
+      ready_times.push_back(
+          std::make_pair(std::max(start + work[i], announce_time),
+                         delay_ids[i]));
+    }
+    std::sort(ready_times.begin(), ready_times.end());
+    for (const auto& ready : ready_times) {
+      clock->set_current_time_for_testing(ready.first);
+      HandleSuspendReadiness(ready.second,
+                             suspend_id,
+                             base::StringPrintf("client%d", ready.second));
+    }
+    EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+    return ready_times.back().first - announce_time;
+  }
+
+  Clock clock_;
   TestObserver observer_;
   SuspendDelayController controller_;
 
@@ -315,5 +371,245 @@ TEST_F(SuspendDelayControllerTest, MultipleDelays) {
   EXPECT_TRUE(controller_.ready_for_suspend());
 }
 
+TEST_F(SuspendDelayControllerTest, DelayTraces) {
+  const std::string kClient1 = "client1";
+  int delay_id1 =
+      RegisterSuspendDelay(base::TimeDelta::FromSeconds(8), kClient1);
+  const std::string kClient2 = "client2";
+  int delay_id2 =
+      RegisterSuspendDelay(base::TimeDelta::FromSeconds(8), kClient2);
+
+  Clock* clock = &clock_;
+  const base::TimeTicks kStartTime = base::TimeTicks::FromInternalValue(1000);
+  clock->set_current_time_for_testing(kStartTime);
+  const int kSuspendId = 5;
+  controller_.PrepareForSuspend(kSuspendId);
+  EXPECT_TRUE(controller_.delay_traces().empty());
+
+  // Delays should be listed in the order in which they became ready.
+  const base::TimeDelta kLatency2 = base::TimeDelta::FromMilliseconds(30);
+  clock->set_current_time_for_testing(kStartTime + kLatency2);
+  HandleSuspendReadiness(delay_id2, kSuspendId, kClient2);
+  const base::TimeDelta kLatency1 = base::TimeDelta::FromMilliseconds(200);
+  clock->set_current_time_for_testing(kStartTime + kLatency1);
+  HandleSuspendReadiness(delay_id1, kSuspendId, kClient1);
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+
+  ASSERT_EQ(2u, controller_.delay_traces().size());
+  const SuspendTrace::DelayTrace& trace2 = controller_.delay_traces()[0];
+  EXPECT_EQ(kClient2, trace2.dbus_client);
+  EXPECT_EQ(kClient2 + "-desc", trace2.description);
+  EXPECT_EQ(kLatency2.ToInternalValue(), trace2.latency.ToInternalValue());
+  EXPECT_FALSE(trace2.timed_out);
+  const SuspendTrace::DelayTrace& trace1 = controller_.delay_traces()[1];
+  EXPECT_EQ(kClient1, trace1.dbus_client);
+  EXPECT_EQ(kLatency1.ToInternalValue(), trace1.latency.ToInternalValue());
+  EXPECT_FALSE(trace1.timed_out);
+
+  // The next request should start with an empty list.
+  controller_.PrepareForSuspend(kSuspendId + 1);
+  EXPECT_TRUE(controller_.delay_traces().empty());
+}
+
+TEST_F(SuspendDelayControllerTest, DelayTracesAfterTimeout) {
+  const std::string kClient = "client";
+  RegisterSuspendDelay(base::TimeDelta::FromMilliseconds(8), kClient);
+  controller_.PrepareForSuspend(5);
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+
+  ASSERT_EQ(1u, controller_.delay_traces().size());
+  EXPECT_EQ(kClient, controller_.delay_traces()[0].dbus_client);
+  EXPECT_TRUE(controller_.delay_traces()[0].timed_out);
+}
+
+TEST_F(SuspendDelayControllerTest, PerDelayTimeouts) {
+  // An unresponsive delay with a short timeout shouldn't hold up the request
+  // until a longer timeout expires.
+  const std::string kShortClient = "short";
+  RegisterSuspendDelay(base::TimeDelta::FromMilliseconds(10), kShortClient);
+  const std::string kLongClient = "long";
+  int long_id =
+      RegisterSuspendDelay(base::TimeDelta::FromSeconds(8), kLongClient);
+
+  const int kSuspendId = 5;
+  controller_.PrepareForSuspend(kSuspendId);
+  HandleSuspendReadiness(long_id, kSuspendId, kLongClient);
+  EXPECT_FALSE(controller_.ready_for_suspend());
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  EXPECT_TRUE(controller_.ready_for_suspend());
+
+  ASSERT_EQ(2u, controller_.delay_traces().size());
+  EXPECT_EQ(kLongClient, controller_.delay_traces()[0].dbus_client);
+  EXPECT_FALSE(controller_.delay_traces()[0].timed_out);
+  EXPECT_EQ(kShortClient, controller_.delay_traces()[1].dbus_client);
+  EXPECT_TRUE(controller_.delay_traces()[1].timed_out);
+}
+
+TEST_F(SuspendDelayControllerTest, EarlyNotification) {
+  const std::string kFastClient = "fast";
+  int fast_id =
+      RegisterSuspendDelay(base::TimeDelta::FromSeconds(8), kFastClient);
+  const std::string kSlowClient = "slow";
+  int slow_id =
+      RegisterSuspendDelay(base::TimeDelta::FromSeconds(8), kSlowClient);
+
+  // Nobody needs early notification without any history.
+  EXPECT_EQ(base::TimeDelta(), controller_.GetEarlyNotificationLeadTime());
+  EXPECT_TRUE(controller_.PrepareForSuspendSoon().empty());
+
+  Clock* clock = &clock_;
+  const base::TimeTicks kStartTime = base::TimeTicks::FromInternalValue(1000);
+  clock->set_current_time_for_testing(kStartTime);
+  controller_.PrepareForSuspend(1);
+  const base::TimeDelta kFastLatency = base::TimeDelta::FromMilliseconds(100);
+  clock->set_current_time_for_testing(kStartTime + kFastLatency);
+  HandleSuspendReadiness(fast_id, 1, kFastClient);
+  const base::TimeDelta kSlowLatency = base::TimeDelta::FromSeconds(3);
+  clock->set_current_time_for_testing(kStartTime + kSlowLatency);
+  HandleSuspendReadiness(slow_id, 1, kSlowClient);
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+
+  EXPECT_EQ(kFastLatency.ToInternalValue(),
+            controller_.GetExpectedLatency(kFastClient + "-desc")
+                .ToInternalValue());
+  EXPECT_EQ(kSlowLatency.ToInternalValue(),
+            controller_.GetExpectedLatency(kSlowClient + "-desc")
+                .ToInternalValue());
+  EXPECT_EQ(kSlowLatency.ToInternalValue(),
+            controller_.GetEarlyNotificationLeadTime().ToInternalValue());
+
+  // Only the slow delay should be notified early. Its latency is still measured
+  // from the announcement.
+  const base::TimeTicks kNoticeTime =
+      kStartTime + base::TimeDelta::FromMinutes(1);
+  clock->set_current_time_for_testing(kNoticeTime);
+  EXPECT_EQ(std::vector<int>(1, slow_id), controller_.PrepareForSuspendSoon());
+  clock->set_current_time_for_testing(kNoticeTime + kSlowLatency);
+  controller_.PrepareForSuspend(2);
+  HandleSuspendReadiness(fast_id, 2, kFastClient);
+  const base::TimeDelta kExtraLatency = base::TimeDelta::FromMilliseconds(200);
+  clock->set_current_time_for_testing(kNoticeTime + kSlowLatency +
+                                      kExtraLatency);
+  HandleSuspendReadiness(slow_id, 2, kSlowClient);
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+
+  ASSERT_EQ(2u, controller_.delay_traces().size());
+  EXPECT_EQ(kExtraLatency.ToInternalValue(),
+            controller_.delay_traces()[1].latency.ToInternalValue());
+  EXPECT_EQ(kSlowLatency.ToInternalValue(),
+            controller_.GetEarlyNotificationLeadTime().ToInternalValue());
+
+  // Unregistered delays shouldn't affect the lead time.
+  UnregisterSuspendDelay(slow_id, kSlowClient);
+  EXPECT_EQ(base::TimeDelta(), controller_.GetEarlyNotificationLeadTime());
+}
+
+// Tests that the lead time shrinks once early notification lets a slow delay
+// report readiness promptly.
+TEST_F(SuspendDelayControllerTest, LeadTimeShrinksWithEarlyNotification) {
+  const std::string kClient = "client";
+  const int delay_id =
+      RegisterSuspendDelay(base::TimeDelta::FromSeconds(8), kClient);
+  const base::TimeDelta kWork = base::TimeDelta::FromSeconds(3);
+  const base::TimeDelta kFastLatency = base::TimeDelta::FromMilliseconds(50);
+
+  // Without notice, the client needs |kWork| after the announcement.
+  base::TimeTicks now = base::TimeTicks::FromInternalValue(1000);
+  clock_.set_current_time_for_testing(now);
+  controller_.PrepareForSuspend(1);
+  clock_.set_current_time_for_testing(now + kWork);
+  HandleSuspendReadiness(delay_id, 1, kClient);
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  EXPECT_EQ(kWork.ToInternalValue(),
+            controller_.GetEarlyNotificationLeadTime().ToInternalValue());
+
+  // With notice, it's ready shortly after each announcement. The lead time
+  // should stay put until the slow sample ages out of the history and then
+  // drop back to zero.
+  for (int suspend_id = 2; suspend_id <= 6; ++suspend_id) {
+    now += base::TimeDelta::FromMinutes(1);
+    clock_.set_current_time_for_testing(now);
+    const base::TimeDelta lead_time =
+        controller_.GetEarlyNotificationLeadTime();
+    ASSERT_EQ(kWork.ToInternalValue(), lead_time.ToInternalValue())
+        << "request " << suspend_id;
+    EXPECT_EQ(std::vector<int>(1, delay_id),
+              controller_.PrepareForSuspendSoon());
+    now += lead_time;
+    clock_.set_current_time_for_testing(now);
+    controller_.PrepareForSuspend(suspend_id);
+    clock_.set_current_time_for_testing(now + kFastLatency);
+    HandleSuspendReadiness(delay_id, suspend_id, kClient);
+    EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+  }
+  EXPECT_EQ(kFastLatency.ToInternalValue(),
+            controller_.GetExpectedLatency(kClient + "-desc")
+                .ToInternalValue());
+  EXPECT_EQ(base::TimeDelta(), controller_.GetEarlyNotificationLeadTime());
+  EXPECT_TRUE(controller_.PrepareForSuspendSoon().empty());
+}
+
+// Tests that early-notified delays are reported when the anticipated request is
+// canceled, but not once it has started.
+TEST_F(SuspendDelayControllerTest, CancelEarlyNotification) {
+  const std::string kClient = "client";
+  const int delay_id =
+      RegisterSuspendDelay(base::TimeDelta::FromSeconds(8), kClient);
+  const base::TimeTicks kStartTime = base::TimeTicks::FromInternalValue(1000);
+  clock_.set_current_time_for_testing(kStartTime);
+  controller_.PrepareForSuspend(1);
+  clock_.set_current_time_for_testing(kStartTime +
+                                      base::TimeDelta::FromSeconds(2));
+  HandleSuspendReadiness(delay_id, 1, kClient);
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+
+  // Nothing has been notified yet.
+  EXPECT_TRUE(controller_.CancelSuspendSoon().empty());
+
+  EXPECT_EQ(std::vector<int>(1, delay_id), controller_.PrepareForSuspendSoon());
+  EXPECT_EQ(std::vector<int>(1, delay_id), controller_.CancelSuspendSoon());
+  EXPECT_TRUE(controller_.CancelSuspendSoon().empty());
+
+  // Once the request starts, there's nothing left to cancel.
+  EXPECT_EQ(std::vector<int>(1, delay_id), controller_.PrepareForSuspendSoon());
+  controller_.PrepareForSuspend(2);
+  EXPECT_TRUE(controller_.CancelSuspendSoon().empty());
+}
+
+// Simulates many clients with varying amounts of work to check how quickly
+// suspend requests can start with and without early notification.
+TEST_F(SuspendDelayControllerTest, ManyClientsSimulation) {
+  const int kNumClients = 100;
+  std::vector<int> delay_ids;
+  std::vector<base::TimeDelta> work;
+  base::TimeDelta max_fast_work;
+  for (int i = 0; i < kNumClients; ++i) {
+    const int delay_id = RegisterSuspendDelay(
+        base::TimeDelta::FromSeconds(8),
+        base::StringPrintf("client%d", i + 1));
+    ASSERT_EQ(i + 1, delay_id);
+    delay_ids.push_back(delay_id);
+    work.push_back(base::TimeDelta::FromMilliseconds((i % 10) * 300));
+    if (work.back() < base::TimeDelta::FromSeconds(1))
+      max_fast_work = std::max(max_fast_work, work.back());
+  }
+
+  const base::TimeDelta cold_duration =
+      SimulateRequest(1, delay_ids, work, false);
+  const base::TimeDelta warm_duration =
+      SimulateRequest(2, delay_ids, work, true);
+  LOG(INFO) << "Readiness with " << kNumClients << " clients took "
+            << cold_duration.InMilliseconds() << " ms without and "
+            << warm_duration.InMilliseconds() << " ms with early notification";
+
+  EXPECT_EQ(std::max_element(work.begin(), work.end())->ToInternalValue(),
+            cold_duration.ToInternalValue());
+  EXPECT_EQ(max_fast_work.ToInternalValue(), warm_duration.ToInternalValue());
+
+  // Slow clients should keep getting notified early.
+  EXPECT_EQ(warm_duration.ToInternalValue(),
+            SimulateRequest(3, delay_ids, work, true).ToInternalValue());
+}
+
 }  // namespace policy
 }  // namespace power_manager
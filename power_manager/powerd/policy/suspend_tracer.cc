@@ -0,0 +1,141 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "power_manager/powerd/policy/suspend_tracer.h"
+
+#include <inttypes.h>
+
+#include <algorithm>
+
+#include <base/logging.h>
+#include <base/strings/stringprintf.h>
+
+#include "power_manager/common/clock.h"
+
+namespace power_manager {
+namespace policy {
+
+std::string SuspendTrace::ToString() const {
+  std::string delay_string;
+  for (const auto& delay : delays) {
+    if (!delay_string.empty())
+      delay_string += ", ";
+    delay_string += base::StringPrintf(
+        "%s (%s): %" PRId64 " ms%s",
+        delay.description.c_str(),
+        delay.dbus_client.c_str(),
+        delay.latency.InMilliseconds(),
+        delay.timed_out ? " timed out" : "");
+  }
+  return base::StringPrintf(
+      "suspend %d at %" PRId64 " %s after %d attempt(s) and %d dark resume(s): "
+      "prepare %" PRId64 " ms, delays %" PRId64 " ms [%s], suspend script %"
+      PRId64 " ms, asleep %" PRId64 " ms, between attempts %" PRId64 " ms, "
+      "finish %" PRId64 " ms",
+      suspend_id,
+      static_cast<int64_t>(start_time.ToTimeT()),
+      success ? "succeeded" : "failed",
+      num_attempts,
+      num_dark_resumes,
+      prepare_duration.InMilliseconds(),
+      delays_duration.InMilliseconds(),
+      delay_string.c_str(),
+      suspend_script_duration.InMilliseconds(),
+      asleep_duration.InMilliseconds(),
+      between_attempts_duration.InMilliseconds(),
+      finish_duration.InMilliseconds());
+}
+
+const size_t SuspendTracer::kMaxTraces = 10;
+
+SuspendTracer::SuspendTracer(Clock* clock)
+    : clock_(clock), in_request_(false) {
+  DCHECK(clock_);
+}
+
+SuspendTracer::~SuspendTracer() {}
+
+void SuspendTracer::StartRequest(int suspend_id) {
+  current_ = SuspendTrace();
+  current_.suspend_id = suspend_id;
+  current_.start_time = clock_->GetCurrentWallTime();
+  in_request_ = true;
+  phase_start_time_ = clock_->GetCurrentTime();
+}
+
+void SuspendTracer::HandleRequestAnnounced() {
+  if (!in_request_)
+    return;
+  current_.prepare_duration = GetElapsed(phase_start_time_);
+  phase_start_time_ = clock_->GetCurrentTime();
+}
+
+void SuspendTracer::HandleDelaysReady(
+    const std::vector<SuspendTrace::DelayTrace>& delays) {
+  if (!in_request_)
+    return;
+  current_.delays_duration = GetElapsed(phase_start_time_);
+  current_.delays = delays;
+}
+
+void SuspendTracer::StartAttempt() {
+  if (!in_request_)
+    return;
+  if (current_.num_attempts == 0)
+    current_.delays_duration = GetElapsed(phase_start_time_);
+  else
+    current_.between_attempts_duration += GetElapsed(phase_start_time_);
+  current_.num_attempts++;
+  phase_start_time_ = clock_->GetCurrentTime();
+  attempt_start_wall_time_ = clock_->GetCurrentWallTime();
+}
+
+void SuspendTracer::FinishAttempt(bool entered_dark_resume) {
+  if (!in_request_)
+    return;
+  const base::TimeDelta script_duration = GetElapsed(phase_start_time_);
+  const base::TimeDelta wall_duration =
+      clock_->GetCurrentWallTime() - attempt_start_wall_time_;
+  current_.suspend_script_duration += script_duration;
+  current_.asleep_duration +=
+      std::max(base::TimeDelta(), wall_duration - script_duration);
+  if (entered_dark_resume)
+    current_.num_dark_resumes++;
+  phase_start_time_ = clock_->GetCurrentTime();
+}
+
+void SuspendTracer::StartFinishingRequest() {
+  if (!in_request_ || current_.num_attempts > 0)
+    return;
+  // The request was canceled before any attempt was made.
+  current_.delays_duration = GetElapsed(phase_start_time_);
+  phase_start_time_ = clock_->GetCurrentTime();
+}
+
+const SuspendTrace& SuspendTracer::FinishRequest(bool success) {
+  DCHECK(in_request_);
+  current_.finish_duration = GetElapsed(phase_start_time_);
+  current_.success = success;
+  in_request_ = false;
+
+  LOG(INFO) << "Suspend trace: " << current_.ToString();
+  traces_.push_back(current_);
+  while (traces_.size() > kMaxTraces)
+    traces_.pop_front();
+  return traces_.back();
+}
+
+std::string SuspendTracer::GetTracesString() const {
+  std::string result;
+  for (const auto& trace : traces_)
+    result += trace.ToString() + "\n";
+  return result;
+}
+
+base::TimeDelta SuspendTracer::GetElapsed(base::TimeTicks start) const {
+  return std::max(base::TimeDelta(), clock_->GetCurrentTime() - start);
+}
+
+}  // namespace policy
+}  // namespace power_manager
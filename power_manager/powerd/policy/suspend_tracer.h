@@ -0,0 +1,147 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef POWER_MANAGER_POWERD_POLICY_SUSPEND_TRACER_H_
+#define POWER_MANAGER_POWERD_POLICY_SUSPEND_TRACER_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/time/time.h>
+
+namespace power_manager {
+
+class Clock;
+
+namespace policy {
+
+// Timeline of a single suspend request, from the announcement of the request
+// to clients until the announcement of its completion.
+struct SuspendTrace {
+  // Time spent waiting for one registered suspend delay to report readiness.
+  struct DelayTrace {
+    // Client-supplied description of the delay and the D-Bus connection that
+    // registered it.
+    std::string description;
+    std::string dbus_client;
+
+    // Time between the announcement of the request and the client's readiness
+    // report, or the time that powerd gave up waiting if |timed_out| is true.
+    base::TimeDelta latency;
+    bool timed_out = false;
+  };
+
+  // Returns a single line describing the trace.
+  std::string ToString() const;
+
+  int suspend_id = 0;
+
+  // Wall time at which the request started.
+  base::Time start_time;
+
+  // True if the system suspended and resumed successfully, false if the
+  // request was canceled or abandoned.
+  bool success = false;
+
+  // Number of suspend attempts and of dark resumes during the request.
+  int num_attempts = 0;
+  int num_dark_resumes = 0;
+
+  // Time spent preparing the system for suspend and announcing the request.
+  base::TimeDelta prepare_duration;
+
+  // Time from the announcement of the request until the first suspend attempt
+  // (or until the request was canceled, if no attempt was made), and a
+  // breakdown of the time each delay took to become ready.
+  base::TimeDelta delays_duration;
+  std::vector<DelayTrace> delays;
+
+  // Time spent in the powerd_suspend script, summed over all attempts. This
+  // includes the kernel's work to suspend and resume devices but not the time
+  // that the system was asleep.
+  base::TimeDelta suspend_script_duration;
+
+  // Time that the system was asleep, summed over all attempts. Computed as
+  // the difference between wall time and monotonic time across attempts.
+  base::TimeDelta asleep_duration;
+
+  // Time spent awake between attempts, e.g. in dark resume or while waiting to
+  // retry a failed attempt.
+  base::TimeDelta between_attempts_duration;
+
+  // Time from the end of the final attempt until the completion of the request
+  // was announced to clients, including the time spent handling the resume
+  // before Suspender started finishing the request.
+  base::TimeDelta finish_duration;
+};
+
+// Records a SuspendTrace for each suspend request and keeps the most recent
+// ones. Suspender calls the methods below as a request moves through its
+// phases.
+class SuspendTracer {
+ public:
+  // Maximum number of completed traces that are retained.
+  static const size_t kMaxTraces;
+
+  // |clock| is used to timestamp phases and must outlive this object.
+  explicit SuspendTracer(Clock* clock);
+  ~SuspendTracer();
+
+  const std::deque<SuspendTrace>& traces() const { return traces_; }
+  bool in_request() const { return in_request_; }
+
+  // Starts tracing a new request. Any unfinished request is discarded.
+  void StartRequest(int suspend_id);
+
+  // Called after the request has been announced to clients.
+  void HandleRequestAnnounced();
+
+  // Called when all suspend delays are ready, with the per-delay breakdown.
+  // The delays phase lasts until the first call to StartAttempt().
+  void HandleDelaysReady(const std::vector<SuspendTrace::DelayTrace>& delays);
+
+  // Called immediately before and after running powerd_suspend.
+  void StartAttempt();
+  void FinishAttempt(bool entered_dark_resume);
+
+  // Called when Suspender starts finishing the request. If an attempt was made,
+  // the finishing phase already started when the last attempt finished.
+  void StartFinishingRequest();
+
+  // Completes the current trace, stores it and returns it. Must only be called
+  // while in_request() is true.
+  const SuspendTrace& FinishRequest(bool success);
+
+  // Returns all retained traces, oldest first, one per line.
+  std::string GetTracesString() const;
+
+ private:
+  // Returns the monotonic time elapsed since |start|.
+  base::TimeDelta GetElapsed(base::TimeTicks start) const;
+
+  Clock* clock_;  // weak
+
+  // Completed traces, oldest first.
+  std::deque<SuspendTrace> traces_;
+
+  // Trace of the request that is currently in progress.
+  SuspendTrace current_;
+  bool in_request_;
+
+  // Monotonic time at which the current phase started. Each phase starts when
+  // the previous one ends so that the phases cover the whole request.
+  base::TimeTicks phase_start_time_;
+
+  // Wall time at which the current suspend attempt started.
+  base::Time attempt_start_wall_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(SuspendTracer);
+};
+
+}  // namespace policy
+}  // namespace power_manager
+
+#endif  // POWER_MANAGER_POWERD_POLICY_SUSPEND_TRACER_H_
@@ -0,0 +1,155 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "power_manager/powerd/policy/suspend_tracer.h"
+
+#include <base/macros.h>
+#include <base/strings/string_util.h>
+#include <gtest/gtest.h>
+
+#include "power_manager/common/clock.h"
+
+namespace power_manager {
+namespace policy {
+
+class SuspendTracerTest : public testing::Test {
+ public:
+  SuspendTracerTest()
+      : now_(base::TimeTicks::FromInternalValue(1000)),
+        wall_now_(base::Time::FromInternalValue(5000)),
+        tracer_(&clock_) {
+    UpdateClock();
+  }
+
+ protected:
+  // Advances the monotonic time by |monotonic| and the wall time by |wall|.
+  void AdvanceTime(base::TimeDelta monotonic, base::TimeDelta wall) {
+    now_ += monotonic;
+    wall_now_ += wall;
+    UpdateClock();
+  }
+
+  // Advances both clocks by |delta|.
+  void AdvanceTime(base::TimeDelta delta) { AdvanceTime(delta, delta); }
+
+  base::TimeTicks now_;
+  base::Time wall_now_;
+  Clock clock_;
+  SuspendTracer tracer_;
+
+ private:
+  void UpdateClock() {
+    clock_.set_current_time_for_testing(now_);
+    clock_.set_current_wall_time_for_testing(wall_now_);
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(SuspendTracerTest);
+};
+
+TEST_F(SuspendTracerTest, TracePhases) {
+  const base::Time kStartTime = wall_now_;
+  tracer_.StartRequest(7);
+  EXPECT_TRUE(tracer_.in_request());
+  AdvanceTime(base::TimeDelta::FromMilliseconds(15));
+  tracer_.HandleRequestAnnounced();
+
+  AdvanceTime(base::TimeDelta::FromMilliseconds(250));
+  SuspendTrace::DelayTrace delay;
+  delay.description = "chrome";
+  delay.dbus_client = ":1.5";
+  delay.latency = base::TimeDelta::FromMilliseconds(250);
+  tracer_.HandleDelaysReady({delay});
+  AdvanceTime(base::TimeDelta::FromMilliseconds(5));
+
+  // The first attempt wakes into dark resume after sleeping for a minute. The
+  // second one resumes fully after sleeping for two minutes.
+  tracer_.StartAttempt();
+  AdvanceTime(base::TimeDelta::FromMilliseconds(400),
+              base::TimeDelta::FromMilliseconds(400) +
+                  base::TimeDelta::FromMinutes(1));
+  tracer_.FinishAttempt(true);
+  AdvanceTime(base::TimeDelta::FromSeconds(5));
+  tracer_.StartAttempt();
+  AdvanceTime(base::TimeDelta::FromMilliseconds(600),
+              base::TimeDelta::FromMilliseconds(600) +
+                  base::TimeDelta::FromMinutes(2));
+  tracer_.FinishAttempt(false);
+
+  // Time spent handling the resume before Suspender starts finishing the
+  // request is included in the finishing phase.
+  AdvanceTime(base::TimeDelta::FromMilliseconds(20));
+  tracer_.StartFinishingRequest();
+  AdvanceTime(base::TimeDelta::FromMilliseconds(30));
+  const SuspendTrace& trace = tracer_.FinishRequest(true);
+  EXPECT_FALSE(tracer_.in_request());
+
+  EXPECT_EQ(7, trace.suspend_id);
+  EXPECT_EQ(kStartTime.ToInternalValue(), trace.start_time.ToInternalValue());
+  EXPECT_TRUE(trace.success);
+  EXPECT_EQ(2, trace.num_attempts);
+  EXPECT_EQ(1, trace.num_dark_resumes);
+  EXPECT_EQ(15, trace.prepare_duration.InMilliseconds());
+  EXPECT_EQ(255, trace.delays_duration.InMilliseconds());
+  ASSERT_EQ(1u, trace.delays.size());
+  EXPECT_EQ(":1.5", trace.delays[0].dbus_client);
+  EXPECT_EQ(1000, trace.suspend_script_duration.InMilliseconds());
+  EXPECT_EQ(3, trace.asleep_duration.InMinutes());
+  EXPECT_EQ(5, trace.between_attempts_duration.InSeconds());
+  EXPECT_EQ(50, trace.finish_duration.InMilliseconds());
+
+  const std::string description = tracer_.GetTracesString();
+  EXPECT_TRUE(base::StartsWith(
+      description, "suspend 7 at ", base::CompareCase::SENSITIVE))
+      << description;
+  EXPECT_NE(std::string::npos, description.find("chrome (:1.5): 250 ms"))
+      << description;
+  EXPECT_NE(std::string::npos, description.find("suspend script 1000 ms"))
+      << description;
+}
+
+TEST_F(SuspendTracerTest, CanceledBeforeAttempt) {
+  // If the request is canceled while waiting for delays, the wait should be
+  // reported as the delays phase rather than as part of finishing.
+  tracer_.StartRequest(2);
+  AdvanceTime(base::TimeDelta::FromMilliseconds(10));
+  tracer_.HandleRequestAnnounced();
+  AdvanceTime(base::TimeDelta::FromMilliseconds(700));
+  tracer_.StartFinishingRequest();
+  AdvanceTime(base::TimeDelta::FromMilliseconds(40));
+  const SuspendTrace& trace = tracer_.FinishRequest(false);
+  EXPECT_EQ(0, trace.num_attempts);
+  EXPECT_EQ(10, trace.prepare_duration.InMilliseconds());
+  EXPECT_EQ(700, trace.delays_duration.InMilliseconds());
+  EXPECT_EQ(40, trace.finish_duration.InMilliseconds());
+}
+
+TEST_F(SuspendTracerTest, AsleepTimeIsNeverNegative) {
+  // If the wall clock is set backward during the attempt, no time should be
+  // reported as asleep.
+  tracer_.StartRequest(1);
+  tracer_.StartAttempt();
+  AdvanceTime(base::TimeDelta::FromMilliseconds(100),
+              base::TimeDelta::FromMilliseconds(-5000));
+  tracer_.FinishAttempt(false);
+  tracer_.StartFinishingRequest();
+  const SuspendTrace& trace = tracer_.FinishRequest(true);
+  EXPECT_EQ(100, trace.suspend_script_duration.InMilliseconds());
+  EXPECT_EQ(0, trace.asleep_duration.ToInternalValue());
+}
+
+TEST_F(SuspendTracerTest, KeepsRecentTraces) {
+  const int kNumRequests = SuspendTracer::kMaxTraces + 3;
+  for (int i = 0; i < kNumRequests; ++i) {
+    tracer_.StartRequest(i);
+    tracer_.StartFinishingRequest();
+    tracer_.FinishRequest(false);
+  }
+  ASSERT_EQ(SuspendTracer::kMaxTraces, tracer_.traces().size());
+  EXPECT_EQ(kNumRequests - static_cast<int>(SuspendTracer::kMaxTraces),
+            tracer_.traces().front().suspend_id);
+  EXPECT_EQ(kNumRequests - 1, tracer_.traces().back().suspend_id);
+}
+
+}  // namespace policy
+}  // namespace power_manager
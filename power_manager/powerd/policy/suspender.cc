@@ -36,6 +36,10 @@ void Suspender::TestApi::SetCurrentWallTime(base::Time wall_time) {
   suspender_->clock_->set_current_wall_time_for_testing(wall_time);
 }
 
+void Suspender::TestApi::SetCurrentTime(base::TimeTicks now) {
+  suspender_->clock_->set_current_time_for_testing(now);
+}
+
 bool Suspender::TestApi::TriggerResuspendTimeout() {
   if (!suspender_->resuspend_timer_.IsRunning())
     return false;
@@ -54,6 +58,7 @@ Suspender::Suspender()
       dbus_wrapper_(NULL),
       dark_resume_(NULL),
       clock_(new Clock),
+      tracer_(clock_.get()),
       state_(State::IDLE),
       handling_event_(false),
       processing_queued_events_(false),
@@ -80,13 +85,14 @@ void Suspender::Init(Delegate* delegate,
 
   const int initial_id = delegate_->GetInitialSuspendId();
   suspend_request_id_ = initial_id - 1;
-  suspend_delay_controller_.reset(new SuspendDelayController(initial_id, ""));
+  suspend_delay_controller_.reset(
+      new SuspendDelayController(initial_id, "", clock_.get()));
   suspend_delay_controller_->AddObserver(this);
 
   const int initial_dark_id = delegate_->GetInitialDarkSuspendId();
   dark_suspend_id_ = initial_dark_id - 1;
   dark_suspend_delay_controller_.reset(
-      new SuspendDelayController(initial_dark_id, "dark"));
+      new SuspendDelayController(initial_dark_id, "dark", clock_.get()));
   dark_suspend_delay_controller_->AddObserver(this);
 
   int64_t retry_delay_ms = 0;
@@ -116,6 +122,50 @@ void Suspender::RequestSuspendWithExternalWakeupCount(uint64_t wakeup_count) {
   HandleEvent(Event::SUSPEND_REQUESTED);
 }
 
+base::TimeDelta Suspender::GetEarlyNotificationLeadTime() const {
+  return suspend_delay_controller_->GetEarlyNotificationLeadTime();
+}
+
+void Suspender::NotifySuspendSoon(base::TimeDelta time_until_suspend) {
+  if (state_ != State::IDLE)
+    return;
+
+  const std::vector<int> delay_ids =
+      suspend_delay_controller_->PrepareForSuspendSoon();
+  if (delay_ids.empty())
+    return;
+
+  dbus::Signal signal(kPowerManagerInterface, kSuspendImminentSoonSignal);
+  dbus::MessageWriter writer(&signal);
+  writer.AppendInt64(time_until_suspend.ToInternalValue());
+  dbus::MessageWriter array_writer(nullptr);
+  writer.OpenArray("i", &array_writer);
+  for (int delay_id : delay_ids)
+    array_writer.AppendInt32(delay_id);
+  writer.CloseContainer(&array_writer);
+  dbus_wrapper_->EmitSignal(&signal);
+}
+
+void Suspender::CancelSuspendSoon() {
+  if (state_ != State::IDLE)
+    return;
+
+  const std::vector<int> delay_ids =
+      suspend_delay_controller_->CancelSuspendSoon();
+  if (delay_ids.empty())
+    return;
+
+  dbus::Signal signal(kPowerManagerInterface,
+                      kSuspendImminentSoonCanceledSignal);
+  dbus::MessageWriter writer(&signal);
+  dbus::MessageWriter array_writer(nullptr);
+  writer.OpenArray("i", &array_writer);
+  for (int delay_id : delay_ids)
+    array_writer.AppendInt32(delay_id);
+  writer.CloseContainer(&array_writer);
+  dbus_wrapper_->EmitSignal(&signal);
+}
+
 void Suspender::RegisterSuspendDelay(
     dbus::MethodCall* method_call,
     dbus::ExportedObject::ResponseSender response_sender) {
@@ -202,6 +252,16 @@ void Suspender::RecordDarkResumeWakeReason(
   response_sender.Run(dbus::Response::FromMethodCall(method_call));
 }
 
+void Suspender::GetSuspendTraces(
+    dbus::MethodCall* method_call,
+    dbus::ExportedObject::ResponseSender response_sender) {
+  std::unique_ptr<dbus::Response> response =
+      dbus::Response::FromMethodCall(method_call);
+  dbus::MessageWriter writer(response.get());
+  writer.AppendString(tracer_.GetTracesString());
+  response_sender.Run(std::move(response));
+}
+
 void Suspender::HandleLidOpened() {
   HandleEvent(Event::USER_ACTIVITY);
 }
@@ -342,8 +402,11 @@ void Suspender::HandleEvent(Event event) {
     case State::WAITING_TO_RESUSPEND:
       switch (event) {
         case Event::SUSPEND_DELAYS_READY:
-          if (state_ == State::WAITING_FOR_SUSPEND_DELAYS)
+          if (state_ == State::WAITING_FOR_SUSPEND_DELAYS) {
+            tracer_.HandleDelaysReady(
+                suspend_delay_controller_->delay_traces());
             state_ = Suspend();
+          }
           break;
         case Event::READY_TO_RESUSPEND:
           if (state_ == State::WAITING_TO_RESUSPEND)
@@ -400,6 +463,7 @@ void Suspender::HandleEvent(Event event) {
 void Suspender::StartRequest() {
   suspend_request_id_++;
   LOG(INFO) << "Starting request " << suspend_request_id_;
+  tracer_.StartRequest(suspend_request_id_);
 
   if (suspend_request_supplied_wakeup_count_) {
     wakeup_count_ = suspend_request_wakeup_count_;
@@ -423,11 +487,13 @@ void Suspender::StartRequest() {
   dark_resume_->PrepareForSuspendRequest();
   delegate_->SetSuspendAnnounced(true);
   EmitSuspendImminentSignal(suspend_request_id_);
+  tracer_.HandleRequestAnnounced();
 }
 
 void Suspender::FinishRequest(bool success) {
   LOG(INFO) << "Finishing request " << suspend_request_id_ << " "
             << (success ? "" : "un") << "successfully";
+  tracer_.StartFinishingRequest();
   resuspend_timer_.Stop();
   suspend_delay_controller_->FinishSuspend(suspend_request_id_);
   dark_suspend_delay_controller_->FinishSuspend(dark_suspend_id_);
@@ -448,6 +514,9 @@ void Suspender::FinishRequest(bool success) {
                                          suspend_duration);
   }
   dark_resume_->UndoPrepareForSuspendRequest();
+
+  if (tracer_.in_request())
+    delegate_->GenerateSuspendTraceMetrics(tracer_.FinishRequest(success));
 }
 
 Suspender::State Suspender::Suspend() {
@@ -502,6 +571,7 @@ Suspender::State Suspender::Suspend() {
                  clock_->GetCurrentWallTime() - dark_resume_start_time_);
   }
   current_num_attempts_++;
+  tracer_.StartAttempt();
   const Delegate::SuspendResult result =
       delegate_->DoSuspend(wakeup_count_, wakeup_count_valid_, duration);
 
@@ -511,6 +581,8 @@ Suspender::State Suspender::Suspend() {
   // At this point, we've either resumed successfully or failed to suspend in
   // the first place.
   const bool in_dark_resume = dark_resume_->InDarkResume();
+  tracer_.FinishAttempt(result == Delegate::SuspendResult::SUCCESS &&
+                        in_dark_resume);
 
   // We first deal with the common case: the suspend was successful and we have
   // fully resumed.  We also check if an external wakeup count was provided and
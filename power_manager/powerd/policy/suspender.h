@@ -21,6 +21,7 @@
 #include <dbus/message.h>
 
 #include "power_manager/powerd/policy/suspend_delay_observer.h"
+#include "power_manager/powerd/policy/suspend_tracer.h"
 #include "power_manager/proto_bindings/suspend.pb.h"
 
 namespace power_manager {
@@ -154,6 +155,9 @@ class Suspender : public SuspendDelayObserver {
         const std::vector<DarkResumeInfo>& dark_resume_wake_durations,
         base::TimeDelta suspend_duration_) = 0;
 
+    // Reports metrics describing the phases of a completed suspend request.
+    virtual void GenerateSuspendTraceMetrics(const SuspendTrace& trace) = 0;
+
     // Shuts the system down in response to repeated failed suspend attempts.
     virtual void ShutDownForFailedSuspend() = 0;
 
@@ -179,6 +183,7 @@ class Suspender : public SuspendDelayObserver {
 
     // Sets the time used as "now".
     void SetCurrentWallTime(base::Time wall_time);
+    void SetCurrentTime(base::TimeTicks now);
 
     // Runs Suspender::HandleEvent(EVENT_READY_TO_RESUSPEND) if
     // |resuspend_timer_| is running. Returns false otherwise.
@@ -190,6 +195,8 @@ class Suspender : public SuspendDelayObserver {
 
     std::string GetDefaultWakeReason() const;
 
+    const SuspendTracer& tracer() const { return suspender_->tracer_; }
+
    private:
     Suspender* suspender_;  // weak
 
@@ -215,6 +222,20 @@ class Suspender : public SuspendDelayObserver {
   // http://crbug.com/218175).
   void RequestSuspendWithExternalWakeupCount(uint64_t wakeup_count);
 
+  // Returns how long before an anticipated suspend request
+  // NotifySuspendSoon() should be called, or zero if no registered suspend
+  // delays need advance notice.
+  base::TimeDelta GetEarlyNotificationLeadTime() const;
+
+  // Notifies suspend delays that have historically been slow to report
+  // readiness that a suspend request is expected after |time_until_suspend|.
+  void NotifySuspendSoon(base::TimeDelta time_until_suspend);
+
+  // Tells the delays notified by NotifySuspendSoon() that the anticipated
+  // request won't happen. Does nothing if no delays were notified or if a
+  // request has already started.
+  void CancelSuspendSoon();
+
   // Handlers for D-Bus messages.
   void RegisterSuspendDelay(
       dbus::MethodCall* method_call,
@@ -237,6 +258,8 @@ class Suspender : public SuspendDelayObserver {
   void RecordDarkResumeWakeReason(
       dbus::MethodCall* method_call,
       dbus::ExportedObject::ResponseSender response_sender);
+  void GetSuspendTraces(dbus::MethodCall* method_call,
+                        dbus::ExportedObject::ResponseSender response_sender);
 
   // Handles the lid being opened, user activity, or the system shutting down,
   // any of which may abort an in-progress suspend attempt.
@@ -334,6 +357,9 @@ class Suspender : public SuspendDelayObserver {
   std::unique_ptr<SuspendDelayController> suspend_delay_controller_;
   std::unique_ptr<SuspendDelayController> dark_suspend_delay_controller_;
 
+  // Records the duration of each phase of suspend requests.
+  SuspendTracer tracer_;
+
   // Current state of the object, updated just before returning control to the
   // event loop.
   State state_;
@@ -15,6 +15,7 @@
 #include "power_manager/common/action_recorder.h"
 #include "power_manager/common/fake_prefs.h"
 #include "power_manager/common/power_constants.h"
+#include "power_manager/powerd/policy/suspend_delay_controller.h"
 #include "power_manager/powerd/system/dark_resume_stub.h"
 #include "power_manager/powerd/system/dbus_wrapper_stub.h"
 
@@ -45,7 +46,8 @@ class TestDelegate : public Suspender::Delegate, public ActionRecorder {
         suspend_wakeup_count_valid_(false),
         suspend_was_successful_(false),
         num_suspend_attempts_(0),
-        suspend_canceled_while_in_dark_resume_(false) {}
+        suspend_canceled_while_in_dark_resume_(false),
+        num_suspend_traces_(0) {}
 
   void set_lid_closed(bool closed) { lid_closed_ = closed; }
   void set_report_success_for_read_wakeup_count(bool success) {
@@ -83,6 +85,8 @@ class TestDelegate : public Suspender::Delegate, public ActionRecorder {
   base::TimeDelta last_suspend_duration() const {
     return last_suspend_duration_;
   }
+  int num_suspend_traces() const { return num_suspend_traces_; }
+  const SuspendTrace& last_suspend_trace() const { return last_suspend_trace_; }
 
   // Delegate implementation:
   int GetInitialSuspendId() override { return 1; }
@@ -134,6 +138,13 @@ class TestDelegate : public Suspender::Delegate, public ActionRecorder {
     last_suspend_duration_ = suspend_duration;
   }
 
+  // Doesn't append an action, since this is called at the end of every
+  // request.
+  void GenerateSuspendTraceMetrics(const SuspendTrace& trace) override {
+    num_suspend_traces_++;
+    last_suspend_trace_ = trace;
+  }
+
   void ShutDownForFailedSuspend() override {
     AppendAction(kShutDown);
     RunAndResetCallback(&shutdown_callback_);
@@ -192,6 +203,11 @@ class TestDelegate : public Suspender::Delegate, public ActionRecorder {
   std::vector<Suspender::DarkResumeInfo> dark_resume_wake_durations_;
   base::TimeDelta last_suspend_duration_;
 
+  // Number of traces provided to GenerateSuspendTraceMetrics() and the most
+  // recent one.
+  int num_suspend_traces_;
+  SuspendTrace last_suspend_trace_;
+
   DISALLOW_COPY_AND_ASSIGN(TestDelegate);
 };
 
@@ -261,6 +277,12 @@ class SuspenderTest : public testing::Test {
     test_api_.set_last_dark_resume_wake_reason(wake_reason);
   }
 
+  // Sets the monotonic and wall times used by |suspender_|.
+  void SetCurrentTimes(base::TimeTicks now, base::Time wall_time) {
+    test_api_.SetCurrentTime(now);
+    test_api_.SetCurrentWallTime(wall_time);
+  }
+
   FakePrefs prefs_;
   TestDelegate delegate_;
   system::DBusWrapperStub dbus_wrapper_;
@@ -323,6 +345,139 @@ TEST_F(SuspenderTest, SuspendResume) {
   EXPECT_FALSE(test_api_.TriggerResuspendTimeout());
 }
 
+// Tests that the phases of a suspend request are traced.
+TEST_F(SuspenderTest, TraceSuspendRequest) {
+  Init();
+
+  const base::TimeTicks kRequestTime = base::TimeTicks::FromInternalValue(1000);
+  const base::Time kRequestWallTime = base::Time::FromInternalValue(5000);
+  SetCurrentTimes(kRequestTime, kRequestWallTime);
+  suspender_.RequestSuspend();
+  const int suspend_id = test_api_.suspend_id();
+  EXPECT_TRUE(test_api_.tracer().in_request());
+
+  // The system spends 300 ms in powerd_suspend and is asleep for 10 seconds.
+  const base::TimeDelta kDelaysDuration = base::TimeDelta::FromMilliseconds(20);
+  const base::TimeDelta kScriptDuration =
+      base::TimeDelta::FromMilliseconds(300);
+  const base::TimeDelta kAsleepDuration = base::TimeDelta::FromSeconds(10);
+  SetCurrentTimes(kRequestTime + kDelaysDuration,
+                  kRequestWallTime + kDelaysDuration);
+  delegate_.set_suspend_callback(base::Bind(
+      &SuspenderTest::SetCurrentTimes,
+      base::Unretained(this),
+      kRequestTime + kDelaysDuration + kScriptDuration,
+      kRequestWallTime + kDelaysDuration + kScriptDuration + kAsleepDuration));
+  AnnounceReadyForSuspend(suspend_id);
+  EXPECT_EQ(JoinActions(kPrepare, kSuspend, kUnprepare, NULL),
+            delegate_.GetActions());
+  EXPECT_FALSE(test_api_.tracer().in_request());
+
+  ASSERT_EQ(1, delegate_.num_suspend_traces());
+  const SuspendTrace& trace = delegate_.last_suspend_trace();
+  EXPECT_EQ(suspend_id, trace.suspend_id);
+  EXPECT_TRUE(trace.success);
+  EXPECT_EQ(kRequestWallTime.ToInternalValue(),
+            trace.start_time.ToInternalValue());
+  EXPECT_EQ(1, trace.num_attempts);
+  EXPECT_EQ(0, trace.num_dark_resumes);
+  EXPECT_EQ(0, trace.prepare_duration.ToInternalValue());
+  EXPECT_EQ(kDelaysDuration.ToInternalValue(),
+            trace.delays_duration.ToInternalValue());
+  EXPECT_EQ(kScriptDuration.ToInternalValue(),
+            trace.suspend_script_duration.ToInternalValue());
+  EXPECT_EQ(kAsleepDuration.ToInternalValue(),
+            trace.asleep_duration.ToInternalValue());
+  ASSERT_EQ(1u, test_api_.tracer().traces().size());
+
+  // A canceled request should also be traced.
+  suspender_.RequestSuspend();
+  suspender_.HandleUserActivity();
+  ASSERT_EQ(2, delegate_.num_suspend_traces());
+  EXPECT_FALSE(delegate_.last_suspend_trace().success);
+  EXPECT_EQ(0, delegate_.last_suspend_trace().num_attempts);
+  EXPECT_EQ(2u, test_api_.tracer().traces().size());
+}
+
+// Tests that slow suspend delays are notified before anticipated requests.
+TEST_F(SuspenderTest, NotifySuspendSoon) {
+  Init();
+
+  SuspendDelayController* controller = test_api_.suspend_delay_controller();
+  const std::string kClient = "client";
+  RegisterSuspendDelayRequest request;
+  request.set_timeout(base::TimeDelta::FromSeconds(8).ToInternalValue());
+  request.set_description("slow");
+  RegisterSuspendDelayReply reply;
+  controller->RegisterSuspendDelay(request, kClient, &reply);
+  const int delay_id = reply.delay_id();
+
+  // Without any history, no notice is needed.
+  EXPECT_EQ(0, suspender_.GetEarlyNotificationLeadTime().ToInternalValue());
+  dbus_wrapper_.ClearSentSignals();
+  suspender_.NotifySuspendSoon(base::TimeDelta::FromSeconds(5));
+  EXPECT_EQ(0u, dbus_wrapper_.num_sent_signals());
+
+  // Make the delay take two seconds to report readiness.
+  const base::TimeTicks kStartTime = base::TimeTicks::FromInternalValue(1000);
+  test_api_.SetCurrentTime(kStartTime);
+  suspender_.RequestSuspend();
+  const int suspend_id = test_api_.suspend_id();
+  const base::TimeDelta kLatency = base::TimeDelta::FromSeconds(2);
+  test_api_.SetCurrentTime(kStartTime + kLatency);
+  SuspendReadinessInfo info;
+  info.set_delay_id(delay_id);
+  info.set_suspend_id(suspend_id);
+  controller->HandleSuspendReadiness(info, kClient);
+  AnnounceReadyForSuspend(suspend_id);
+  EXPECT_EQ(JoinActions(kPrepare, kSuspend, kUnprepare, NULL),
+            delegate_.GetActions());
+  EXPECT_EQ(kLatency.ToInternalValue(),
+            suspender_.GetEarlyNotificationLeadTime().ToInternalValue());
+
+  // The delay should be notified now.
+  const base::TimeDelta kTimeUntilSuspend = base::TimeDelta::FromSeconds(5);
+  dbus_wrapper_.ClearSentSignals();
+  suspender_.NotifySuspendSoon(kTimeUntilSuspend);
+  std::unique_ptr<dbus::Signal> signal;
+  ASSERT_TRUE(dbus_wrapper_.GetSentSignal(
+      0, kSuspendImminentSoonSignal, nullptr, &signal));
+  dbus::MessageReader reader(signal.get());
+  int64_t time_until_suspend = 0;
+  ASSERT_TRUE(reader.PopInt64(&time_until_suspend));
+  EXPECT_EQ(kTimeUntilSuspend.ToInternalValue(), time_until_suspend);
+  dbus::MessageReader array_reader(nullptr);
+  ASSERT_TRUE(reader.PopArray(&array_reader));
+  int32_t notified_delay_id = 0;
+  ASSERT_TRUE(array_reader.PopInt32(&notified_delay_id));
+  EXPECT_EQ(delay_id, notified_delay_id);
+  EXPECT_FALSE(array_reader.HasMoreData());
+
+  // Canceling the notice should name the same delay, once.
+  dbus_wrapper_.ClearSentSignals();
+  suspender_.CancelSuspendSoon();
+  ASSERT_TRUE(dbus_wrapper_.GetSentSignal(
+      0, kSuspendImminentSoonCanceledSignal, nullptr, &signal));
+  dbus::MessageReader cancel_reader(signal.get());
+  dbus::MessageReader cancel_array_reader(nullptr);
+  ASSERT_TRUE(cancel_reader.PopArray(&cancel_array_reader));
+  notified_delay_id = 0;
+  ASSERT_TRUE(cancel_array_reader.PopInt32(&notified_delay_id));
+  EXPECT_EQ(delay_id, notified_delay_id);
+  EXPECT_FALSE(cancel_array_reader.HasMoreData());
+  dbus_wrapper_.ClearSentSignals();
+  suspender_.CancelSuspendSoon();
+  EXPECT_EQ(0u, dbus_wrapper_.num_sent_signals());
+
+  // Nothing should be sent while a request is already in progress.
+  suspender_.NotifySuspendSoon(kTimeUntilSuspend);
+  suspender_.RequestSuspend();
+  dbus_wrapper_.ClearSentSignals();
+  suspender_.NotifySuspendSoon(kTimeUntilSuspend);
+  suspender_.CancelSuspendSoon();
+  EXPECT_EQ(0u, dbus_wrapper_.num_sent_signals());
+}
+
 // Tests that Suspender doesn't pass a wakeup count to the delegate when it was
 // unable to fetch one.
 TEST_F(SuspenderTest, MissingWakeupCount) {
@@ -19,6 +19,12 @@ class AmbientLightObserver {
   // Called when the light level is measured. The measured level may be
   // unchanged from the previously-observed level.
   virtual void OnAmbientLightUpdated(AmbientLightSensorInterface* sensor) = 0;
+
+  // Returns true and sets |min_lux| and |max_lux| to the inclusive range of
+  // levels that currently wouldn't cause the observer to act, or returns false
+  // if the observer needs every reading. -1 leaves a side unbounded. The sensor
+  // may poll less often while the level stays within this range.
+  virtual bool GetStableLuxRange(int* min_lux, int* max_lux) const = 0;
 };
 
 }  // namespace system
@@ -5,17 +5,22 @@
 #include "power_manager/powerd/system/ambient_light_sensor.h"
 
 #include <fcntl.h>
+#include <linux/iio/events.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 #include <algorithm>
 #include <cerrno>
 #include <cmath>
 #include <cstring>
+#include <limits>
 
 #include <base/bind.h>
 #include <base/files/file_enumerator.h>
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
 #include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
 #include <base/strings/string_number_conversions.h>
 #include <base/strings/string_util.h>
 #include <base/strings/stringprintf.h>
@@ -34,18 +39,41 @@ const base::FilePath::CharType kDefaultDeviceListPath[] =
 // Default interval for polling the ambient light sensor.
 const int kDefaultPollIntervalMs = 1000;
 
+// Directory holding a device's node, named after its directory in
+// |kDefaultDeviceListPath|.
+const char kDevPath[] = "/dev";
+
+bool WriteSysfsInt(const base::FilePath& path, int value) {
+  std::string str = base::IntToString(value);
+  if (base::WriteFile(path, str.data(), str.size()) !=
+      static_cast<int>(str.size())) {
+    PLOG(ERROR) << "Unable to write " << str << " to " << path.value();
+    return false;
+  }
+  return true;
+}
+
 }  // namespace
 
 const int AmbientLightSensor::kNumInitAttemptsBeforeLogging = 5;
 const int AmbientLightSensor::kNumInitAttemptsBeforeGivingUp = 20;
+const int AmbientLightSensor::kNumStableReadingsBeforeBackoff = 3;
+const int AmbientLightSensor::kMaxPollIntervalMultiplier = 4;
 
 AmbientLightSensor::AmbientLightSensor()
     : device_list_path_(kDefaultDeviceListPath),
       poll_interval_ms_(kDefaultPollIntervalMs),
+      current_poll_interval_ms_(kDefaultPollIntervalMs),
+      num_stable_readings_(0),
+      event_fd_for_testing_(-1),
+      events_armed_(false),
       lux_value_(-1),
       num_init_attempts_(0) {}
 
-AmbientLightSensor::~AmbientLightSensor() {}
+AmbientLightSensor::~AmbientLightSensor() {
+  if (events_armed_)
+    DisarmEvents();
+}
 
 void AmbientLightSensor::Init() {
   StartTimer();
@@ -73,11 +101,86 @@ int AmbientLightSensor::GetAmbientLightLux() {
   return lux_value_;
 }
 
+void AmbientLightSensor::OnFileCanReadWithoutBlocking(int fd) {
+  DCHECK_EQ(fd, event_fd_.get());
+  struct iio_event_data event;
+  if (HANDLE_EINTR(read(fd, &event, sizeof(event))) != sizeof(event)) {
+    PLOG(ERROR) << "Unable to read IIO event";
+    return;
+  }
+  VLOG(1) << "Got ALS threshold event";
+
+  // The light level is changing; go back to polling quickly so that observers
+  // see enough readings to act on the change.
+  DisarmEvents();
+  current_poll_interval_ms_ = poll_interval_ms_;
+  num_stable_readings_ = 0;
+  ReadAls();
+}
+
+void AmbientLightSensor::OnFileCanWriteWithoutBlocking(int fd) {
+  NOTREACHED() << "Unexpected write on FD " << fd;
+}
+
 void AmbientLightSensor::StartTimer() {
-  poll_timer_.Start(FROM_HERE,
-                    base::TimeDelta::FromMilliseconds(poll_interval_ms_),
-                    this,
-                    &AmbientLightSensor::ReadAls);
+  poll_timer_.Start(
+      FROM_HERE,
+      base::TimeDelta::FromMilliseconds(current_poll_interval_ms_),
+      this,
+      &AmbientLightSensor::ReadAls);
+}
+
+void AmbientLightSensor::ScheduleNextRead() {
+  int min_lux = -1, max_lux = -1;
+  if (event_fd_.is_valid() &&
+      current_poll_interval_ms_ >=
+          poll_interval_ms_ * kMaxPollIntervalMultiplier &&
+      !events_armed_ && GetStableLuxRange(&min_lux, &max_lux)) {
+    if (ArmEvents(min_lux, max_lux)) {
+      VLOG(1) << "Waiting for ALS threshold event";
+      return;
+    }
+    LOG(WARNING) << "Falling back to polling ALS";
+    event_fd_.reset();
+  }
+  StartTimer();
+}
+
+bool AmbientLightSensor::GetStableLuxRange(int* min_lux, int* max_lux) {
+  if (!observers_.might_have_observers())
+    return false;
+
+  *min_lux = -1;
+  *max_lux = -1;
+  base::ObserverList<AmbientLightObserver>::Iterator it(&observers_);
+  AmbientLightObserver* observer = nullptr;
+  while ((observer = it.GetNext()) != nullptr) {
+    int observer_min = -1, observer_max = -1;
+    if (!observer->GetStableLuxRange(&observer_min, &observer_max))
+      return false;
+    if (observer_min != -1)
+      *min_lux = std::max(*min_lux, observer_min);
+    if (observer_max != -1 && (*max_lux == -1 || observer_max < *max_lux))
+      *max_lux = observer_max;
+  }
+  return *max_lux == -1 || *min_lux <= *max_lux;
+}
+
+void AmbientLightSensor::UpdatePollInterval(int lux) {
+  int min_lux = -1, max_lux = -1;
+  if (GetStableLuxRange(&min_lux, &max_lux) &&
+      (min_lux == -1 || lux >= min_lux) && (max_lux == -1 || lux <= max_lux)) {
+    num_stable_readings_++;
+    if (num_stable_readings_ >= kNumStableReadingsBeforeBackoff) {
+      current_poll_interval_ms_ =
+          std::min(current_poll_interval_ms_ * 2,
+                   poll_interval_ms_ * kMaxPollIntervalMultiplier);
+    }
+    return;
+  }
+
+  num_stable_readings_ = 0;
+  current_poll_interval_ms_ = poll_interval_ms_;
 }
 
 void AmbientLightSensor::ReadAls() {
@@ -107,11 +210,13 @@ void AmbientLightSensor::ReadCallback(const std::string& data) {
     VLOG(1) << "Read lux " << lux_value_;
     FOR_EACH_OBSERVER(
         AmbientLightObserver, observers_, OnAmbientLightUpdated(this));
+    // Observers have seen this reading, so their ranges reflect it.
+    UpdatePollInterval(value);
   } else {
     LOG(ERROR) << "Could not read lux value from ALS file contents: ["
                << trimmed_data << "]";
   }
-  StartTimer();
+  ScheduleNextRead();
 }
 
 void AmbientLightSensor::ErrorCallback() {
@@ -143,6 +248,8 @@ bool AmbientLightSensor::InitAlsFile() {
         continue;
       if (als_file_.Init(als_path.value())) {
         LOG(INFO) << "Using lux file " << als_path.value();
+        if (InitEvents(check_path, als_path))
+          LOG(INFO) << "Using threshold events of " << check_path.value();
         return true;
       }
     }
@@ -155,5 +262,98 @@ bool AmbientLightSensor::InitAlsFile() {
   return false;
 }
 
+bool AmbientLightSensor::InitEvents(const base::FilePath& device_dir,
+                                    const base::FilePath& als_path) {
+  // Thresholds are in raw units, so events are only usable if the raw value is
+  // what's being read.
+  const std::string kRawSuffix = "_raw";
+  std::string channel = als_path.BaseName().value();
+  if (!base::EndsWith(channel, kRawSuffix, base::CompareCase::SENSITIVE))
+    return false;
+  channel.resize(channel.size() - kRawSuffix.size());
+
+  base::FilePath events_dir = device_dir.Append("events");
+  base::FilePath falling_path =
+      events_dir.Append(channel + "_thresh_falling_value");
+  base::FilePath rising_path =
+      events_dir.Append(channel + "_thresh_rising_value");
+  if (!base::PathExists(falling_path) || !base::PathExists(rising_path))
+    return false;
+
+  std::vector<base::FilePath> enable_paths;
+  base::FilePath either_en_path =
+      events_dir.Append(channel + "_thresh_either_en");
+  if (base::PathExists(either_en_path)) {
+    enable_paths.push_back(either_en_path);
+  } else {
+    enable_paths.push_back(events_dir.Append(channel + "_thresh_falling_en"));
+    enable_paths.push_back(events_dir.Append(channel + "_thresh_rising_en"));
+    for (const auto& path : enable_paths) {
+      if (!base::PathExists(path))
+        return false;
+    }
+  }
+
+  int event_fd = event_fd_for_testing_;
+  event_fd_for_testing_ = -1;
+  if (event_fd < 0) {
+    base::FilePath dev_path =
+        base::FilePath(kDevPath).Append(device_dir.BaseName());
+    base::ScopedFD dev_fd(
+        HANDLE_EINTR(open(dev_path.value().c_str(), O_RDONLY | O_CLOEXEC)));
+    if (!dev_fd.is_valid()) {
+      PLOG(WARNING) << "Unable to open " << dev_path.value();
+      return false;
+    }
+    if (ioctl(dev_fd.get(), IIO_GET_EVENT_FD_IOCTL, &event_fd) < 0 ||
+        event_fd < 0) {
+      PLOG(WARNING) << "Unable to get event FD for " << dev_path.value();
+      return false;
+    }
+  }
+
+  event_fd_.reset(event_fd);
+  falling_threshold_path_ = falling_path;
+  rising_threshold_path_ = rising_path;
+  event_enable_paths_ = enable_paths;
+  return true;
+}
+
+bool AmbientLightSensor::ArmEvents(int min_lux, int max_lux) {
+  DCHECK(event_fd_.is_valid());
+  // An event fires when the level goes below the falling threshold or above
+  // the rising one. Unbounded sides get thresholds that are never crossed.
+  if (!WriteSysfsInt(falling_threshold_path_, std::max(min_lux, 0)) ||
+      !WriteSysfsInt(rising_threshold_path_,
+                     max_lux == -1 ? std::numeric_limits<int>::max()
+                                   : max_lux))
+    return false;
+  for (const auto& path : event_enable_paths_) {
+    if (!WriteSysfsInt(path, 1)) {
+      DisarmEvents();
+      return false;
+    }
+  }
+  if (!base::MessageLoopForIO::current()->WatchFileDescriptor(
+          event_fd_.get(),
+          true,
+          base::MessageLoopForIO::WATCH_READ,
+          &event_watcher_,
+          this)) {
+    LOG(ERROR) << "Unable to watch FD " << event_fd_.get();
+    DisarmEvents();
+    return false;
+  }
+  events_armed_ = true;
+  return true;
+}
+
+void AmbientLightSensor::DisarmEvents() {
+  event_watcher_.StopWatchingFileDescriptor();
+  for (const auto& path : event_enable_paths_)
+    WriteSysfsInt(path, 0);
+  events_armed_ = false;
+}
+
 }  // namespace system
 }  // namespace power_manager
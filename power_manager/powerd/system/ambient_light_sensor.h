@@ -7,10 +7,13 @@
 
 #include <list>
 #include <string>
+#include <vector>
 
 #include <base/compiler_specific.h>
 #include <base/files/file_path.h>
+#include <base/files/scoped_file.h>
 #include <base/macros.h>
+#include <base/message_loop/message_loop.h>
 #include <base/observer_list.h>
 #include <base/timer/timer.h>
 
@@ -38,13 +41,27 @@ class AmbientLightSensorInterface {
   DISALLOW_COPY_AND_ASSIGN(AmbientLightSensorInterface);
 };
 
-class AmbientLightSensor : public AmbientLightSensorInterface {
+// Reads the ambient light level from an IIO device.
+//
+// The sensor is polled while the light level is changing. Once readings have
+// stayed within the range that no observer would act on for a while, the poll
+// interval backs off, and if the device supports IIO threshold events, polling
+// stops entirely until the level leaves that range.
+class AmbientLightSensor : public AmbientLightSensorInterface,
+                           public base::MessageLoopForIO::Watcher {
  public:
   // Number of failed init attempts before AmbientLightSensor will start logging
   // warnings or stop trying entirely.
   static const int kNumInitAttemptsBeforeLogging;
   static const int kNumInitAttemptsBeforeGivingUp;
 
+  // Number of consecutive readings within the stable band before the poll
+  // interval starts backing off.
+  static const int kNumStableReadingsBeforeBackoff;
+
+  // The poll interval backs off to at most this multiple of the base interval.
+  static const int kMaxPollIntervalMultiplier;
+
   AmbientLightSensor();
   virtual ~AmbientLightSensor();
 
@@ -53,7 +70,15 @@ class AmbientLightSensor : public AmbientLightSensorInterface {
   }
   void set_poll_interval_ms_for_testing(int interval_ms) {
     poll_interval_ms_ = interval_ms;
+    current_poll_interval_ms_ = interval_ms;
+  }
+  int current_poll_interval_ms_for_testing() const {
+    return current_poll_interval_ms_;
   }
+  // Makes the sensor use |fd| as its IIO event FD instead of getting one from
+  // the device node. Takes ownership of |fd|.
+  void set_event_fd_for_testing(int fd) { event_fd_for_testing_ = fd; }
+  bool events_armed_for_testing() const { return events_armed_; }
 
   // Starts polling.  This is separate from c'tor so that tests can call
   // set_*_for_testing() first.
@@ -68,10 +93,27 @@ class AmbientLightSensor : public AmbientLightSensorInterface {
   void RemoveObserver(AmbientLightObserver* observer) override;
   int GetAmbientLightLux() override;
 
+  // base::MessageLoopForIO::Watcher implementation:
+  void OnFileCanReadWithoutBlocking(int fd) override;
+  void OnFileCanWriteWithoutBlocking(int fd) override;
+
  private:
-  // Starts |poll_timer_|.
+  // Starts |poll_timer_| with |current_poll_interval_ms_|.
   void StartTimer();
 
+  // Waits for the next reading, either by arming threshold events at the
+  // edges of GetStableLuxRange() or by starting |poll_timer_|.
+  void ScheduleNextRead();
+
+  // Sets |min_lux| and |max_lux| to the range of levels in which no observer
+  // would act, i.e. the intersection of their stable ranges. -1 leaves a side
+  // unbounded. Returns false if some observer needs every reading.
+  bool GetStableLuxRange(int* min_lux, int* max_lux);
+
+  // Adjusts |current_poll_interval_ms_| after reading |lux|. The interval
+  // backs off while readings stay within GetStableLuxRange().
+  void UpdatePollInterval(int lux);
+
   // Handler for a periodic event that reads the ambient light sensor.
   void ReadAls();
 
@@ -82,6 +124,17 @@ class AmbientLightSensor : public AmbientLightSensorInterface {
   // Initializes |als_file_|. Returns true on success.
   bool InitAlsFile();
 
+  // Sets up threshold events for the channel read from |als_path| in the IIO
+  // device directory |device_dir|. Returns false if the device doesn't
+  // support them.
+  bool InitEvents(const base::FilePath& device_dir,
+                  const base::FilePath& als_path);
+
+  // Programs thresholds that fire when the level leaves [|min_lux|, |max_lux|]
+  // and enables the events. -1 leaves a side unbounded.
+  bool ArmEvents(int min_lux, int max_lux);
+  void DisarmEvents();
+
   // Path containing backlight devices.  Typically under /sys, but can be
   // overridden by tests.
   base::FilePath device_list_path_;
@@ -89,9 +142,30 @@ class AmbientLightSensor : public AmbientLightSensorInterface {
   // Runs ReadAls().
   base::RepeatingTimer poll_timer_;
 
-  // Time between polls of the sensor file, in milliseconds.
+  // Time between polls of the sensor file while the light level is changing,
+  // in milliseconds.
   int poll_interval_ms_;
 
+  // Time until the next poll, in milliseconds. Grows from |poll_interval_ms_|
+  // while readings are stable.
+  int current_poll_interval_ms_;
+
+  // Number of consecutive readings within GetStableLuxRange().
+  int num_stable_readings_;
+
+  // Threshold event files of the lux channel. Unset if the device doesn't
+  // support threshold events.
+  base::FilePath falling_threshold_path_;
+  base::FilePath rising_threshold_path_;
+  std::vector<base::FilePath> event_enable_paths_;
+
+  // Event FD of the IIO device and its watcher. The watcher is only active
+  // while events are armed.
+  base::ScopedFD event_fd_;
+  int event_fd_for_testing_;
+  base::MessageLoopForIO::FileDescriptorWatcher event_watcher_;
+  bool events_armed_;
+
   // List of backlight controllers that are currently interested in updates from
   // this sensor.
   base::ObserverList<AmbientLightObserver> observers_;
@@ -4,11 +4,17 @@
 
 #include "power_manager/powerd/system/ambient_light_sensor.h"
 
+#include <linux/iio/events.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <memory>
+#include <string>
 
 #include <base/compiler_specific.h>
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
+#include <base/files/scoped_file.h>
 #include <base/files/scoped_temp_dir.h>
 #include <base/strings/string_number_conversions.h>
 #include <gtest/gtest.h>
@@ -41,14 +47,30 @@ class TestObserver : public AmbientLightObserver {
         base::TimeDelta::FromMilliseconds(kUpdateTimeoutMs));
   }
 
+  // Sets the range returned by GetStableLuxRange().
+  void set_stable_lux_range(int min_lux, int max_lux) {
+    has_stable_lux_range_ = true;
+    min_lux_ = min_lux;
+    max_lux_ = max_lux;
+  }
+
   // AmbientLightObserver implementation:
   void OnAmbientLightUpdated(AmbientLightSensorInterface* sensor) override {
     loop_runner_.StopLoop();
   }
+  bool GetStableLuxRange(int* min_lux, int* max_lux) const override {
+    *min_lux = min_lux_;
+    *max_lux = max_lux_;
+    return has_stable_lux_range_;
+  }
 
  private:
   TestMainLoopRunner loop_runner_;
 
+  bool has_stable_lux_range_ = false;
+  int min_lux_ = -1;
+  int max_lux_ = -1;
+
   DISALLOW_COPY_AND_ASSIGN(TestObserver);
 };
 
@@ -115,6 +137,109 @@ TEST_F(AmbientLightSensorTest, Basic) {
   EXPECT_EQ(200, sensor_->GetAmbientLightLux());
 }
 
+TEST_F(AmbientLightSensorTest, NoBackOffWithoutStableRange) {
+  // The observer wants every reading, so the interval never changes.
+  WriteLux(100);
+  for (int i = 0; i < AmbientLightSensor::kNumStableReadingsBeforeBackoff + 2;
+       ++i) {
+    ASSERT_TRUE(observer_.RunUntilAmbientLightUpdated());
+    EXPECT_EQ(kPollIntervalMs, sensor_->current_poll_interval_ms_for_testing());
+  }
+}
+
+TEST_F(AmbientLightSensorTest, BackOffWhileStable) {
+  const int kMaxIntervalMs =
+      kPollIntervalMs * AmbientLightSensor::kMaxPollIntervalMultiplier;
+  observer_.set_stable_lux_range(50, 150);
+
+  // The interval stays at its base value until enough stable readings have
+  // been seen, then doubles up to the maximum.
+  WriteLux(100);
+  for (int i = 0; i < AmbientLightSensor::kNumStableReadingsBeforeBackoff;
+       ++i) {
+    ASSERT_TRUE(observer_.RunUntilAmbientLightUpdated());
+    EXPECT_EQ(kPollIntervalMs, sensor_->current_poll_interval_ms_for_testing());
+  }
+  int expected_interval_ms = kPollIntervalMs;
+  while (expected_interval_ms < kMaxIntervalMs) {
+    // Changes within the observer's range still count as stable.
+    WriteLux(140);
+    ASSERT_TRUE(observer_.RunUntilAmbientLightUpdated());
+    expected_interval_ms = std::min(expected_interval_ms * 2, kMaxIntervalMs);
+    EXPECT_EQ(expected_interval_ms,
+              sensor_->current_poll_interval_ms_for_testing());
+  }
+  ASSERT_TRUE(observer_.RunUntilAmbientLightUpdated());
+  EXPECT_EQ(kMaxIntervalMs, sensor_->current_poll_interval_ms_for_testing());
+
+  // Leaving the range goes back to the base interval.
+  WriteLux(300);
+  ASSERT_TRUE(observer_.RunUntilAmbientLightUpdated());
+  EXPECT_EQ(300, sensor_->GetAmbientLightLux());
+  EXPECT_EQ(kPollIntervalMs, sensor_->current_poll_interval_ms_for_testing());
+}
+
+TEST_F(AmbientLightSensorTest, ThresholdEvents) {
+  // Set up a separate sensor whose raw channel supports threshold events.
+  base::ScopedTempDir device_list_dir;
+  ASSERT_TRUE(device_list_dir.CreateUniqueTempDir());
+  base::FilePath device_dir = device_list_dir.path().Append("iio:device0");
+  base::FilePath events_dir = device_dir.Append("events");
+  ASSERT_TRUE(base::CreateDirectory(events_dir));
+  data_file_ = device_dir.Append("in_illuminance_raw");
+  const base::FilePath falling_path =
+      events_dir.Append("in_illuminance_thresh_falling_value");
+  const base::FilePath rising_path =
+      events_dir.Append("in_illuminance_thresh_rising_value");
+  const base::FilePath enable_path =
+      events_dir.Append("in_illuminance_thresh_either_en");
+  for (const base::FilePath& path : {falling_path, rising_path, enable_path})
+    ASSERT_EQ(1, base::WriteFile(path, "0", 1));
+
+  // A pipe stands in for the IIO event FD.
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  base::ScopedFD event_write_fd(fds[1]);
+
+  sensor_->RemoveObserver(&observer_);
+  sensor_.reset(new AmbientLightSensor);
+  sensor_->set_device_list_path_for_testing(device_list_dir.path());
+  sensor_->set_poll_interval_ms_for_testing(kPollIntervalMs);
+  sensor_->set_event_fd_for_testing(fds[0]);
+  sensor_->AddObserver(&observer_);
+  observer_.set_stable_lux_range(50, 150);
+  sensor_->Init();
+
+  // Once polling has backed off completely, the sensor waits for an event
+  // at the edges of the observer's range instead.
+  WriteLux(100);
+  const int kMaxReadings = 20;
+  for (int i = 0; i < kMaxReadings && !sensor_->events_armed_for_testing();
+       ++i)
+    ASSERT_TRUE(observer_.RunUntilAmbientLightUpdated());
+  ASSERT_TRUE(sensor_->events_armed_for_testing());
+  EXPECT_FALSE(sensor_->TriggerPollTimerForTesting());
+  std::string value;
+  ASSERT_TRUE(base::ReadFileToString(falling_path, &value));
+  EXPECT_EQ("50", value);
+  ASSERT_TRUE(base::ReadFileToString(rising_path, &value));
+  EXPECT_EQ("150", value);
+  ASSERT_TRUE(base::ReadFileToString(enable_path, &value));
+  EXPECT_EQ("1", value);
+
+  // An event disarms the thresholds and reads the new level right away.
+  WriteLux(300);
+  struct iio_event_data event = {};
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(event)),
+            write(event_write_fd.get(), &event, sizeof(event)));
+  ASSERT_TRUE(observer_.RunUntilAmbientLightUpdated());
+  EXPECT_EQ(300, sensor_->GetAmbientLightLux());
+  EXPECT_FALSE(sensor_->events_armed_for_testing());
+  EXPECT_EQ(kPollIntervalMs, sensor_->current_poll_interval_ms_for_testing());
+  ASSERT_TRUE(base::ReadFileToString(enable_path, &value));
+  EXPECT_EQ("0", value);
+}
+
 TEST_F(AmbientLightSensorTest, GiveUpAfterTooManyFailures) {
   // Test that the timer is eventually stopped after many failures.
   base::DeleteFile(data_file_, false);
@@ -5,12 +5,18 @@
 #include "power_manager/powerd/system/async_file_reader.h"
 
 #include <fcntl.h>
-#include <sys/stat.h>
+#include <unistd.h>
 
-#include <cerrno>
-#include <cstdio>
+#include <utility>
+#include <vector>
 
+#include <base/bind.h>
+#include <base/files/scoped_file.h>
+#include <base/lazy_instance.h>
 #include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/task_runner_util.h>
+#include <base/threading/sequenced_worker_pool.h>
 
 #include "power_manager/common/util.h"
 
@@ -19,40 +25,136 @@ namespace system {
 
 namespace {
 
-// Since we don't know the file size in advance, we'll have to read successively
-// larger chunks.  Start with 4 KB and double the chunk size with each new read.
+// Since we don't know the file size in advance, start with a 4 KB buffer and
+// double it whenever a read fills it. The grown buffer is kept for later reads
+// of the same file.
 const size_t kInitialFileReadSize = 4096;
 
-// How often to poll for the AIO status.
-const int kPollMs = 100;
+// Maximum number of files that are read at the same time. Every file is read on
+// its own sequence, so a file whose reads block (e.g. the capacity of a
+// peripheral that went out of range) only delays later reads of that file, as
+// long as there are threads left for the others.
+const size_t kMaxReadThreads = 4;
+
+// Pool shared by all readers. It is never shut down; reads that are still
+// running when the process exits are abandoned.
+class ReadPool {
+ public:
+  ReadPool()
+      : pool_(new base::SequencedWorkerPool(kMaxReadThreads,
+                                            "async_file_reader")) {}
+
+  // Returns a new sequence for reading one file.
+  scoped_refptr<base::SequencedTaskRunner> CreateSequence() {
+    return pool_->GetSequencedTaskRunnerWithShutdownBehavior(
+        pool_->GetSequenceToken(),
+        base::SequencedWorkerPool::CONTINUE_ON_SHUTDOWN);
+  }
+
+ private:
+  scoped_refptr<base::SequencedWorkerPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReadPool);
+};
+
+base::LazyInstance<ReadPool>::Leaky g_read_pool = LAZY_INSTANCE_INITIALIZER;
 
 }  // namespace
 
+class AsyncFileReader::File : public base::RefCountedThreadSafe<File> {
+ public:
+  File(base::ScopedFD fd, const std::string& filename, size_t initial_read_size)
+      : fd_(std::move(fd)),
+        filename_(filename),
+        buffer_(initial_read_size),
+        task_runner_(g_read_pool.Get().CreateSequence()) {}
+
+  base::SequencedTaskRunner* task_runner() { return task_runner_.get(); }
+
+  // Reads the whole file from its start. If the read fails, the file is
+  // reopened and read once more: an FD whose device went away (e.g. after a
+  // driver reload) keeps failing with ENODEV even once the device is back.
+  Result Read() {
+    Result result;
+    result.success = ReadFromFd(&result.data);
+    if (result.success)
+      return result;
+
+    fd_.reset(HANDLE_EINTR(open(filename_.c_str(), O_RDONLY, 0)));
+    if (!fd_.is_valid()) {
+      PLOG(ERROR) << "Could not reopen file " << filename_;
+      return result;
+    }
+    result.success = ReadFromFd(&result.data);
+    return result;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<File>;
+  ~File() {}
+
+  // Reads the whole file from its start into |data| through |fd_|.
+  bool ReadFromFd(std::string* data) {
+    data->clear();
+    if (buffer_.empty())
+      buffer_.resize(1);
+    size_t size = 0;
+    while (true) {
+      ssize_t bytes_read = HANDLE_EINTR(pread(fd_.get(),
+                                              buffer_.data() + size,
+                                              buffer_.size() - size,
+                                              size));
+      if (bytes_read < 0) {
+        PLOG(ERROR) << "Error during read of file " << filename_;
+        return false;
+      }
+      size += bytes_read;
+      // Read more data only if the previous read filled the buffer.
+      if (bytes_read == 0 || size < buffer_.size())
+        break;
+      buffer_.resize(buffer_.size() * 2);
+    }
+    data->assign(buffer_.data(), size);
+    return true;
+  }
+
+  // Only used on |task_runner_|.
+  base::ScopedFD fd_;
+  const std::string filename_;
+  std::vector<char> buffer_;
+
+  // Sequence on which this file is read.
+  scoped_refptr<base::SequencedTaskRunner> task_runner_;
+
+  DISALLOW_COPY_AND_ASSIGN(File);
+};
+
 AsyncFileReader::AsyncFileReader()
     : read_in_progress_(false),
-      fd_(-1),
-      aio_buffer_(NULL),
-      initial_read_size_(kInitialFileReadSize) {}
+      initial_read_size_(kInitialFileReadSize),
+      weak_ptr_factory_(this) {}
 
-AsyncFileReader::~AsyncFileReader() {
-  Reset();
-  close(fd_);
-}
+AsyncFileReader::~AsyncFileReader() {}
 
 bool AsyncFileReader::Init(const std::string& filename) {
-  CHECK_EQ(fd_, -1) << "Attempting to open new file when a valid file "
-                    << "descriptor exists.";
-  fd_ = open(filename.c_str(), O_RDONLY, 0);
-  if (fd_ == -1) {
+  CHECK(!file_) << "Attempting to open new file when a valid file "
+                << "descriptor exists.";
+  base::ScopedFD fd(HANDLE_EINTR(open(filename.c_str(), O_RDONLY, 0)));
+  if (!fd.is_valid()) {
     PLOG(ERROR) << "Could not open file " << filename;
     return false;
   }
   filename_ = filename;
+  file_ = new File(std::move(fd), filename, initial_read_size_);
   return true;
 }
 
 bool AsyncFileReader::HasOpenedFile() const {
-  return (fd_ != -1);
+  return file_ != nullptr;
+}
+
+bool AsyncFileReader::HasReadInProgress() const {
+  return read_in_progress_;
 }
 
 void AsyncFileReader::StartRead(
@@ -60,67 +162,39 @@ void AsyncFileReader::StartRead(
     const base::Callback<void()>& error_cb) {
   Reset();
 
-  if (fd_ == -1) {
+  if (!file_) {
     LOG(ERROR) << "No file handle available.";
     if (!error_cb.is_null())
       error_cb.Run();
     return;
   }
 
-  if (!AsyncRead(initial_read_size_, 0)) {
-    if (!error_cb.is_null())
-      error_cb.Run();
-    return;
-  }
   read_cb_ = read_cb;
   error_cb_ = error_cb;
   read_in_progress_ = true;
+  base::PostTaskAndReplyWithResult(
+      file_->task_runner(),
+      FROM_HERE,
+      base::Bind(&File::Read, file_),
+      base::Bind(&AsyncFileReader::OnReadDone,
+                 weak_ptr_factory_.GetWeakPtr()));
 }
 
-void AsyncFileReader::UpdateState() {
-  if (!read_in_progress_) {
-    update_state_timer_.Reset();
-    return;
-  }
-
-  int status = aio_error(&aio_control_);
+void AsyncFileReader::OnReadDone(const Result& result) {
+  DCHECK(read_in_progress_);
 
-  // If the read is still in-progress, keep the timer running.
-  if (status == EINPROGRESS)
-    return;
+  // Reset() before running the callbacks, which may start another read.
+  base::Callback<void(const std::string&)> read_cb = read_cb_;
+  base::Callback<void()> error_cb = error_cb_;
+  Reset();
 
-  // Otherwise, we stop the timer.
-  update_state_timer_.Stop();
-
-  switch (status) {
-    case ECANCELED:
-      Reset();
-      break;
-    case 0: {
-      size_t size = aio_return(&aio_control_);
-      // Save the data that was read, and free the buffer.
-      stored_data_.insert(stored_data_.end(), aio_buffer_, aio_buffer_ + size);
-      delete[] aio_buffer_;
-      aio_buffer_ = NULL;
-
-      if (size == aio_control_.aio_nbytes) {
-        // Read more data if the previous read didn't reach the end of file.
-        if (AsyncRead(size * 2, aio_control_.aio_offset + size))
-          break;
-      }
-      if (!read_cb_.is_null())
-        read_cb_.Run(stored_data_);
-      Reset();
-      break;
-    }
-    default: {
-      LOG(ERROR) << "Error during read of file " << filename_
-                 << ", status=" << status;
-      if (!error_cb_.is_null())
-        error_cb_.Run();
-      Reset();
-      break;
-    }
+  if (result.success) {
+    if (!read_cb.is_null())
+      read_cb.Run(result.data);
+  } else {
+    LOG(ERROR) << "Error during read of file " << filename_;
+    if (!error_cb.is_null())
+      error_cb.Run();
   }
 }
 
@@ -128,49 +202,11 @@ void AsyncFileReader::Reset() {
   if (!read_in_progress_)
     return;
 
-  update_state_timer_.Stop();
-
-  int cancel_result = aio_cancel(fd_, &aio_control_);
-  if (cancel_result == -1) {
-    PLOG(ERROR) << "aio_cancel() failed";
-  } else if (cancel_result == AIO_NOTCANCELED) {
-    LOG(INFO) << "aio_cancel() returned AIO_NOTCANCELED; waiting for "
-              << "request to complete";
-    const aiocb* aiocb_list = {&aio_control_};
-    if (aio_suspend(&aiocb_list, 1, NULL) == -1)
-      PLOG(ERROR) << "aio_suspend() failed";
-  }
-
-  delete[] aio_buffer_;
-  aio_buffer_ = NULL;
-  stored_data_.clear();
+  weak_ptr_factory_.InvalidateWeakPtrs();
   read_cb_.Reset();
   error_cb_.Reset();
   read_in_progress_ = false;
 }
 
-bool AsyncFileReader::AsyncRead(int size, int offset) {
-  aio_buffer_ = new char[size];
-
-  memset(&aio_control_, 0, sizeof(aio_control_));
-  aio_control_.aio_nbytes = size;
-  aio_control_.aio_fildes = fd_;
-  aio_control_.aio_offset = offset;
-  aio_control_.aio_buf = aio_buffer_;
-
-  if (aio_read(&aio_control_) == -1) {
-    LOG(ERROR) << "Unable to access " << filename_;
-    delete[] aio_buffer_;
-    aio_buffer_ = NULL;
-    return false;
-  }
-
-  update_state_timer_.Start(FROM_HERE,
-                            base::TimeDelta::FromMilliseconds(kPollMs),
-                            this,
-                            &AsyncFileReader::UpdateState);
-  return true;
-}
-
 }  // namespace system
 }  // namespace power_manager
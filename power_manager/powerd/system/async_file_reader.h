@@ -5,20 +5,28 @@
 #ifndef POWER_MANAGER_POWERD_SYSTEM_ASYNC_FILE_READER_H_
 #define POWER_MANAGER_POWERD_SYSTEM_ASYNC_FILE_READER_H_
 
-#include <aio.h>
-#include <unistd.h>
-
 #include <string>
 
 #include <base/callback.h>
 #include <base/macros.h>
-#include <base/timer/timer.h>
+#include <base/memory/ref_counted.h>
+#include <base/memory/weak_ptr.h>
 
 namespace power_manager {
 namespace system {
 
+// Reads files without blocking the calling thread. Reads are performed with
+// blocking pread() calls on a small shared thread pool, one sequence per file,
+// and each result is posted back to the calling thread as soon as its read
+// completes. A file that is slow to read doesn't hold up reads of other files.
 class AsyncFileReader {
  public:
+  // Outcome of reading one file.
+  struct Result {
+    bool success = false;
+    std::string data;
+  };
+
   AsyncFileReader();
   ~AsyncFileReader();
 
@@ -39,50 +47,41 @@ class AsyncFileReader {
   // Indicates whether a file handle has been opened.
   bool HasOpenedFile() const;
 
+  // Indicates whether a read started by StartRead() hasn't completed yet.
+  bool HasReadInProgress() const;
+
  private:
   friend class AsyncFileReaderTest;
 
-  // Updates the state based on whether there is an ongoing file I/O.
-  void UpdateState();
-
-  // Goes back to the idle state, cleans up allocated resouces.
-  void Reset();
+  // The opened file, its read buffer and the sequence it is read on.
+  class File;
 
-  // Initiates an AIO read operation.  This is a helper function for
-  // StartRead().  Returns true if the AIO read was successfully enqueued.
-  bool AsyncRead(int size, int offset);
+  // Handles completion of a read started by StartRead().
+  void OnReadDone(const Result& result);
 
-  // Deletes |update_state_timeout_id_|'s timeout and resets it to 0 if set.
-  void CancelUpdateStateTimeout();
+  // Goes back to the idle state, dropping the result of an ongoing read.
+  void Reset();
 
-  // Flag indicating whether there is an active AIO read.
+  // Flag indicating whether there is an active read.
   bool read_in_progress_;
 
-  // AIO control object.
-  aiocb aio_control_;
-
   // Name of file from which to read.
   std::string filename_;
 
-  // File for AIO reads.
-  int fd_;
+  // The opened file, or null before Init() succeeds.
+  scoped_refptr<File> file_;
 
-  // Buffer for AIO reads.
-  char* aio_buffer_;
-
-  // Number of bytes to be read for the first chunk.  This is a variable instead
-  // of a constant so unit tests can modify it.
+  // Buffer size used for the first read of the file. Later reads use a buffer
+  // that grew to fit the file. This is a variable instead of a constant so unit
+  // tests can modify it.
   size_t initial_read_size_;
 
-  // Accumulator for data read by AIO.
-  std::string stored_data_;
-
   // Callbacks invoked when the read completes or encounters an error.
   base::Callback<void(const std::string&)> read_cb_;
   base::Callback<void()> error_cb_;
 
-  // Runs UpdateState().
-  base::RepeatingTimer update_state_timer_;
+  // Invalidated to drop the reply of an abandoned read.
+  base::WeakPtrFactory<AsyncFileReader> weak_ptr_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(AsyncFileReader);
 };
@@ -171,6 +171,50 @@ TEST_F(AsyncFileReaderTest, MultipleBlockReadFull) {
   EXPECT_EQ(ReadFile(), data_);
 }
 
+// Reading the same file again after it grew should return all of it.
+TEST_F(AsyncFileReaderTest, RepeatedReads) {
+  ASSERT_TRUE(WriteAndReadData(20, 32));
+  EXPECT_EQ(ReadFile(), data_);
+
+  EXPECT_FALSE(file_reader_->HasReadInProgress());
+
+  CreateFile(path_, 100);
+  file_reader_->StartRead(
+      base::Bind(&AsyncFileReaderTest::ReadCallback, base::Unretained(this)),
+      base::Bind(&AsyncFileReaderTest::ErrorCallback, base::Unretained(this)));
+  EXPECT_TRUE(file_reader_->HasReadInProgress());
+  ASSERT_TRUE(loop_runner_.StartLoop(
+      base::TimeDelta::FromMilliseconds(kMaxFileReadTimeMs)));
+  EXPECT_FALSE(file_reader_->HasReadInProgress());
+  EXPECT_FALSE(got_error_);
+  EXPECT_EQ(ReadFile(), data_);
+}
+
+// After a failed read, the file should be reopened so that a new file at the
+// same path can be read. A directory stands in for a sysfs file whose FD went
+// stale: pread() fails on it.
+TEST_F(AsyncFileReaderTest, ReopenAfterReadError) {
+  ASSERT_TRUE(base::CreateDirectory(path_));
+  ASSERT_TRUE(file_reader_->Init(path_.value()));
+  file_reader_->StartRead(
+      base::Bind(&AsyncFileReaderTest::ReadCallback, base::Unretained(this)),
+      base::Bind(&AsyncFileReaderTest::ErrorCallback, base::Unretained(this)));
+  ASSERT_TRUE(loop_runner_.StartLoop(
+      base::TimeDelta::FromMilliseconds(kMaxFileReadTimeMs)));
+  EXPECT_TRUE(got_error_);
+
+  got_error_ = false;
+  ASSERT_TRUE(base::DeleteFile(path_, false));
+  CreateFile(path_, 40);
+  file_reader_->StartRead(
+      base::Bind(&AsyncFileReaderTest::ReadCallback, base::Unretained(this)),
+      base::Bind(&AsyncFileReaderTest::ErrorCallback, base::Unretained(this)));
+  ASSERT_TRUE(loop_runner_.StartLoop(
+      base::TimeDelta::FromMilliseconds(kMaxFileReadTimeMs)));
+  EXPECT_FALSE(got_error_);
+  EXPECT_EQ(ReadFile(), data_);
+}
+
 // Initializing the reader with a nonexistent file should fail.
 TEST_F(AsyncFileReaderTest, InitWithMissingFile) {
   EXPECT_FALSE(file_reader_->Init(path_.value()));
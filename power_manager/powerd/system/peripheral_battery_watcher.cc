@@ -7,14 +7,15 @@
 #include <fcntl.h>
 
 #include <cerrno>
+#include <map>
 #include <string>
+#include <utility>
 
 #include <base/bind.h>
 #include <base/files/file_enumerator.h>
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
 #include <base/logging.h>
-#include <base/memory/ptr_util.h>
 #include <base/strings/string_number_conversions.h>
 #include <base/strings/string_util.h>
 #include <base/strings/stringprintf.h>
@@ -75,7 +76,10 @@ void PeripheralBatteryWatcher::GetBatteryList(
 }
 
 void PeripheralBatteryWatcher::ReadBatteryStatuses() {
-  battery_readers_.clear();
+  // Readers of batteries that are still present are kept so their open files
+  // and read buffers are reused.
+  std::map<base::FilePath, std::unique_ptr<AsyncFileReader>> old_readers;
+  old_readers.swap(battery_readers_);
 
   std::vector<base::FilePath> new_battery_list;
   GetBatteryList(&new_battery_list);
@@ -96,10 +100,20 @@ void PeripheralBatteryWatcher::ReadBatteryStatuses() {
     base::ReadFileToString(model_name_path, &model_name);
     base::TrimWhitespaceASCII(model_name, base::TRIM_TRAILING, &model_name);
 
-    battery_readers_.push_back(base::MakeUnique<AsyncFileReader>());
-    AsyncFileReader* reader = battery_readers_.back().get();
-
-    if (reader->Init(capacity_path.value())) {
+    std::unique_ptr<AsyncFileReader> reader;
+    auto it = old_readers.find(capacity_path);
+    if (it != old_readers.end()) {
+      reader = std::move(it->second);
+    } else {
+      reader.reset(new AsyncFileReader);
+      if (!reader->Init(capacity_path.value())) {
+        LOG(ERROR) << "Can't read battery capacity " << capacity_path.value();
+        continue;
+      }
+    }
+    // A battery whose previous read is still blocked is left alone: queueing
+    // another read behind it wouldn't complete any sooner.
+    if (!reader->HasReadInProgress()) {
       reader->StartRead(base::Bind(&PeripheralBatteryWatcher::ReadCallback,
                                    base::Unretained(this),
                                    path.value(),
@@ -108,9 +122,8 @@ void PeripheralBatteryWatcher::ReadBatteryStatuses() {
                                    base::Unretained(this),
                                    path.value(),
                                    model_name));
-    } else {
-      LOG(ERROR) << "Can't read battery capacity " << capacity_path.value();
     }
+    battery_readers_[capacity_path] = std::move(reader);
   }
   poll_timer_.Start(FROM_HERE,
                     base::TimeDelta::FromMilliseconds(poll_interval_ms_),
@@ -5,6 +5,7 @@
 #ifndef POWER_MANAGER_POWERD_SYSTEM_PERIPHERAL_BATTERY_WATCHER_H_
 #define POWER_MANAGER_POWERD_SYSTEM_PERIPHERAL_BATTERY_WATCHER_H_
 
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -64,8 +65,9 @@ class PeripheralBatteryWatcher {
   // Time between polls of the peripheral battery reading, in milliseconds.
   int poll_interval_ms_;
 
-  // AsyncFileReaders for different peripheral batteries.
-  std::vector<std::unique_ptr<AsyncFileReader>> battery_readers_;
+  // AsyncFileReaders for the capacity files of different peripheral batteries,
+  // keyed by path. Each battery is reported as soon as its own read completes.
+  std::map<base::FilePath, std::unique_ptr<AsyncFileReader>> battery_readers_;
 
   DISALLOW_COPY_AND_ASSIGN(PeripheralBatteryWatcher);
 };
@@ -3,12 +3,18 @@
 // found in the LICENSE file.
 
 #include <cstdio>
+#include <memory>
+#include <string>
 
 #include <base/at_exit.h>
 #include <base/files/file_path.h>
 #include <base/logging.h>
 #include <base/message_loop/message_loop.h>
 #include <brillo/flag_helper.h>
+#include <chromeos/dbus/service_constants.h>
+#include <dbus/bus.h>
+#include <dbus/message.h>
+#include <dbus/object_proxy.h>
 
 #include "power_manager/common/power_constants.h"
 #include "power_manager/common/prefs.h"
@@ -16,11 +22,52 @@
 #include "power_manager/powerd/system/power_supply.h"
 #include "power_manager/powerd/system/udev_stub.h"
 
+namespace {
+
+// Prints the summaries of recent suspend requests that powerd has traced.
+// Returns false if powerd couldn't be queried.
+bool PrintSuspendTraces() {
+  dbus::Bus::Options options;
+  options.bus_type = dbus::Bus::SYSTEM;
+  scoped_refptr<dbus::Bus> bus(new dbus::Bus(options));
+  CHECK(bus->Connect());
+  dbus::ObjectProxy* proxy = bus->GetObjectProxy(
+      power_manager::kPowerManagerServiceName,
+      dbus::ObjectPath(power_manager::kPowerManagerServicePath));
+
+  dbus::MethodCall method_call(power_manager::kPowerManagerInterface,
+                               power_manager::kGetSuspendTracesMethod);
+  std::unique_ptr<dbus::Response> response(proxy->CallMethodAndBlock(
+      &method_call, dbus::ObjectProxy::TIMEOUT_USE_DEFAULT));
+  if (!response) {
+    LOG(ERROR) << power_manager::kGetSuspendTracesMethod << " call failed";
+    return false;
+  }
+  dbus::MessageReader reader(response.get());
+  std::string traces;
+  if (!reader.PopString(&traces)) {
+    LOG(ERROR) << "Unable to read " << power_manager::kGetSuspendTracesMethod
+               << " response";
+    return false;
+  }
+  printf("%s", traces.c_str());
+  return true;
+}
+
+}  // namespace
+
 int main(int argc, char** argv) {
+  DEFINE_bool(suspend_traces,
+              false,
+              "Print powerd's traces of recent suspend requests instead of the "
+              "power status");
   brillo::FlagHelper::Init(argc, argv, "Print power information for tests.");
   base::AtExitManager at_exit_manager;
   base::MessageLoopForIO message_loop;
 
+  if (FLAGS_suspend_traces)
+    return PrintSuspendTraces() ? 0 : 1;
+
   power_manager::Prefs prefs;
   CHECK(prefs.Init(power_manager::util::GetPrefPaths(
       base::FilePath(power_manager::kReadWritePrefsDir),
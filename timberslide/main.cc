@@ -0,0 +1,42 @@
+// Copyright 2015 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include <base/files/file_path.h>
+#include <base/strings/string_split.h>
+#include <brillo/flag_helper.h>
+
+#include "timberslide/timberslide.h"
+
+namespace {
+
+const char kDeviceLogFile[] = "/sys/kernel/debug/cros_ec/console_log";
+
+const char kDefaultLogDirectory[] = "/var/log/";
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  DEFINE_string(device_log, kDeviceLogFile,
+                "Comma-separated list of files where the recent EC logs are "
+                "posted to.");
+  DEFINE_string(log_directory, kDefaultLogDirectory,
+                "Directory where the output logs should be.");
+  brillo::FlagHelper::Init(argc, argv,
+      "timberslide concatenates EC logs for use in debugging.");
+
+  std::vector<base::FilePath> device_logs;
+  for (const auto& path : base::SplitString(FLAGS_device_log,
+                                            ",",
+                                            base::TRIM_WHITESPACE,
+                                            base::SPLIT_WANT_NONEMPTY)) {
+    device_logs.push_back(base::FilePath(path));
+  }
+
+  timberslide::TimberSlide ts(device_logs,
+                              base::FilePath(FLAGS_log_directory));
+  return ts.Run();
+}
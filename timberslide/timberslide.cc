@@ -2,132 +2,240 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-#include <string>
+#include "timberslide/timberslide.h"
 
+#include <errno.h>
 #include <fcntl.h>
-#include <poll.h>
-#include <sys/stat.h>
-#include <sys/types.h>
+#include <unistd.h>
 
-#include <base/at_exit.h>
-#include <base/command_line.h>
-#include <brillo/daemons/daemon.h>
+#include <set>
+#include <utility>
+
+#include <base/bind.h>
 #include <base/files/file_util.h>
-#include <base/files/file_path.h>
 #include <base/logging.h>
-#include <base/message_loop/message_loop.h>
-#include <base/strings/string_util.h>
-#include <brillo/flag_helper.h>
+#include <base/posix/eintr_wrapper.h>
+
+namespace timberslide {
 
 namespace {
 
-const char kDeviceLogFile[] = "/sys/kernel/debug/cros_ec/console_log";
+const char kCurrentLogExtension[] = ".log";
+const char kPreviousLogExtension[] = ".previous";
 
-const char kDefaultLogDirectory[] = "/var/log/";
+const int64_t kMaxCurrentLogSize = 10 * 1024 * 1024;
 
-const char kCurrentLogFile[] = "cros_ec.log";
-const char kPreviousLogFile[] = "cros_ec.previous";
+// Size of each read from a device. The EC console buffer is much smaller than
+// this, so a single read normally empties it.
+const size_t kReadSize = 64 * 1024;
 
-const int kMaxCurrentLogSize = 10 * 1024 * 1024;
+// Maximum number of reads done for a device before returning to the message
+// loop.
+const int kMaxReadsPerDrain = 16;
 
-class TimberSlide : public brillo::Daemon,
-                    public base::MessageLoopForIO::Watcher {
- public:
-  TimberSlide(const base::FilePath& device_log,
-              const base::FilePath& log_dir):
-      device_log_(device_log),
-      total_size_(0) {
-    current_log_ = log_dir.Append(kCurrentLogFile);
-    previous_log_ = log_dir.Append(kPreviousLogFile);
-  }
+// Buffered data is written out once it reaches this size, and at the end of
+// each drain.
+const size_t kWriteBufferSize = 64 * 1024;
 
- private:
-  int OnInit() override {
-    LOG(INFO) << "Starting timberslide daemon";
-    if (!base::PathExists(device_log_)) {
-      LOG(FATAL) << "EC log does not exist!";
-      return 1;
-    }
+// How often logs are synced to disk.
+const int kSyncIntervalSec = 60;
+
+}  // namespace
 
-    RotateLogs(previous_log_, current_log_);
+LogFile::LogFile(const base::FilePath& current_log,
+                 const base::FilePath& previous_log,
+                 int64_t max_size)
+    : current_log_(current_log),
+      previous_log_(previous_log),
+      max_size_(max_size) {
+  buffer_.reserve(kWriteBufferSize);
+}
 
-    device_file_ = base::File(device_log_,
-                              base::File::FLAG_OPEN | base::File::FLAG_READ);
+LogFile::~LogFile() {
+  Sync();
+}
 
-    if (!device_file_.IsValid()) {
-      LOG(FATAL) << "Open error : " << device_file_.error_details();
-      return 1;
-    }
+bool LogFile::Open() {
+  return Rotate();
+}
+
+bool LogFile::Append(const char* data, size_t size) {
+  buffer_.append(data, size);
+  if (buffer_.size() >= kWriteBufferSize)
+    return Flush();
+  return true;
+}
 
-    CHECK(base::MessageLoopForIO::current()->WatchFileDescriptor(
-              device_file_.GetPlatformFile(), true,
-              base::MessageLoopForIO::WATCH_READ, &fd_watcher_, this));
-    return 0;
+bool LogFile::Flush() {
+  if (buffer_.empty())
+    return true;
+  if (!file_.IsValid())
+    return false;
+
+  if (!base::WriteFileDescriptor(
+          file_.GetPlatformFile(), buffer_.data(), buffer_.size())) {
+    PLOG(ERROR) << "Could not append to " << current_log_.value();
+    return false;
   }
+  size_ += buffer_.size();
+  buffer_.clear();
+  needs_sync_ = true;
+
+  if (size_ >= max_size_)
+    return Rotate();
+  return true;
+}
 
-  void OnFileCanWriteWithoutBlocking(int fd) override {
-    LOG(FATAL) << "Unexpected call to write event handler";
+bool LogFile::Sync() {
+  if (!Flush())
+    return false;
+  if (!needs_sync_)
+    return true;
+  needs_sync_ = false;
+  return file_.Flush();
+}
+
+bool LogFile::Rotate() {
+  if (file_.IsValid()) {
+    file_.Flush();
+    file_.Close();
   }
+  needs_sync_ = false;
+  size_ = 0;
 
-  void OnFileCanReadWithoutBlocking(int fd) override {
-    char buffer[4096];
-    int ret;
+  if (!base::DeleteFile(previous_log_, /* recursive = */ false)) {
+    LOG(ERROR) << "Could not delete " << previous_log_.value();
+    return false;
+  }
+  if (base::PathExists(current_log_) &&
+      !base::Move(current_log_, previous_log_)) {
+    LOG(ERROR) << "Could not move " << current_log_.value() << " to "
+               << previous_log_.value();
+    return false;
+  }
 
-    CHECK_EQ(fd, device_file_.GetPlatformFile());
+  file_.Initialize(current_log_,
+                   base::File::FLAG_CREATE_ALWAYS | base::File::FLAG_WRITE);
+  if (!file_.IsValid()) {
+    LOG(ERROR) << "Could not create " << current_log_.value() << ": "
+               << base::File::ErrorToString(file_.error_details());
+    return false;
+  }
+  return true;
+}
 
-    ret = TEMP_FAILURE_RETRY(
-        device_file_.ReadAtCurrentPosNoBestEffort(buffer, sizeof(buffer)));
-    if (ret == 0)
-      return;
+LogDrainer::LogDrainer(base::File device, std::unique_ptr<LogFile> log)
+    : device_(std::move(device)),
+      log_(std::move(log)),
+      read_buffer_(kReadSize) {}
+
+LogDrainer::~LogDrainer() {}
+
+bool LogDrainer::Watch() {
+  return base::MessageLoopForIO::current()->WatchFileDescriptor(
+      device_.GetPlatformFile(),
+      true,
+      base::MessageLoopForIO::WATCH_READ,
+      &watcher_,
+      this);
+}
 
+bool LogDrainer::Drain() {
+  for (int i = 0; i < kMaxReadsPerDrain; ++i) {
+    const int ret = HANDLE_EINTR(read(
+        device_.GetPlatformFile(), read_buffer_.data(), read_buffer_.size()));
     if (ret < 0) {
-      LOG(FATAL) << "Read error: " << base::File::ErrorToString(
-                                        base::File::OSErrorToFileError(errno));
-      return;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      PLOG(ERROR) << "Read error";
+      return false;
     }
+    if (ret == 0)
+      break;
+    if (!log_->Append(read_buffer_.data(), ret))
+      return false;
+    if (static_cast<size_t>(ret) < read_buffer_.size())
+      break;
+  }
+  return log_->Flush();
+}
+
+void LogDrainer::OnFileCanReadWithoutBlocking(int fd) {
+  CHECK_EQ(fd, device_.GetPlatformFile());
+  if (!Drain())
+    LOG(FATAL) << "Could not copy log to " << log_->current_log().value();
+}
+
+void LogDrainer::OnFileCanWriteWithoutBlocking(int fd) {
+  LOG(FATAL) << "Unexpected call to write event handler";
+}
 
-    if (!base::AppendToFile(current_log_, buffer, ret)) {
-      LOG(FATAL) << "Could not append log file!";
-      return;
+TimberSlide::TimberSlide(const std::vector<base::FilePath>& device_logs,
+                         const base::FilePath& log_dir)
+    : device_logs_(device_logs), log_dir_(log_dir) {}
+
+TimberSlide::~TimberSlide() {}
+
+// static
+std::string TimberSlide::GetLogName(const base::FilePath& device_log) {
+  return device_log.DirName().BaseName().value();
+}
+
+int TimberSlide::OnInit() {
+  LOG(INFO) << "Starting timberslide daemon";
+
+  std::set<std::string> log_names;
+  for (const auto& device_log : device_logs_) {
+    if (!base::PathExists(device_log)) {
+      LOG(FATAL) << "EC log " << device_log.value() << " does not exist!";
+      return 1;
     }
 
-    total_size_ += ret;
-    if (total_size_ >= kMaxCurrentLogSize) {
-      RotateLogs(previous_log_, current_log_);
-      total_size_ = 0;
+    const std::string name = GetLogName(device_log);
+    if (!log_names.insert(name).second) {
+      LOG(FATAL) << "Multiple EC logs named " << name;
+      return 1;
     }
-  }
 
-  void RotateLogs(const base::FilePath& previous_log,
-                  const base::FilePath& current_log) {
-    CHECK(base::DeleteFile(previous_log, /* recursive = */ false));
+    std::unique_ptr<LogFile> log(
+        new LogFile(log_dir_.Append(name + kCurrentLogExtension),
+                    log_dir_.Append(name + kPreviousLogExtension),
+                    kMaxCurrentLogSize));
+    if (!log->Open()) {
+      LOG(FATAL) << "Could not open log for " << device_log.value();
+      return 1;
+    }
 
-    if (base::PathExists(current_log))
-      CHECK(base::Move(current_log, previous_log));
+    base::File device(HANDLE_EINTR(open(device_log.value().c_str(),
+                                        O_RDONLY | O_NONBLOCK | O_CLOEXEC)));
+    if (!device.IsValid()) {
+      PLOG(FATAL) << "Open error for " << device_log.value();
+      return 1;
+    }
 
-    base::WriteFile(current_log, "", 0);
+    std::unique_ptr<LogDrainer> drainer(
+        new LogDrainer(std::move(device), std::move(log)));
+    CHECK(drainer->Watch());
+    drainers_.push_back(std::move(drainer));
   }
 
-  base::FilePath device_log_;
-  base::File device_file_;
-  base::FilePath current_log_;
-  base::FilePath previous_log_;
-  base::MessageLoopForIO::FileDescriptorWatcher fd_watcher_;
-  int total_size_;
-};
-
-}  // namespace
-
-int main(int argc, char* argv[]) {
-  DEFINE_string(device_log, kDeviceLogFile,
-                "File where the recent EC logs are posted to.");
-  DEFINE_string(log_directory, kDefaultLogDirectory,
-                "Directory where the output logs should be.");
-  brillo::FlagHelper::Init(argc, argv,
-      "timberslide concatenates EC logs for use in debugging.");
+  sync_timer_.Start(FROM_HERE,
+                    base::TimeDelta::FromSeconds(kSyncIntervalSec),
+                    base::Bind(&TimberSlide::SyncLogs, base::Unretained(this)));
+  return 0;
+}
 
-  TimberSlide ts((base::FilePath(FLAGS_device_log)),
-                 (base::FilePath(FLAGS_log_directory)));
+void TimberSlide::OnShutdown(int* exit_code) {
+  sync_timer_.Stop();
+  SyncLogs();
+  drainers_.clear();
+}
 
-  return ts.Run();
+void TimberSlide::SyncLogs() {
+  for (const auto& drainer : drainers_) {
+    if (!drainer->log()->Sync())
+      LOG(ERROR) << "Could not sync " << drainer->log()->current_log().value();
+  }
 }
+
+}  // namespace timberslide
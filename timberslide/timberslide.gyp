@@ -8,12 +8,45 @@
     },
   },
   'targets': [
+    {
+      'target_name': 'libtimberslide',
+      'type': 'static_library',
+      'sources': [
+        'timberslide.cc',
+      ],
+    },
     {
       'target_name': 'timberslide',
       'type': 'executable',
+      'dependencies': ['libtimberslide'],
       'sources': [
-        'timberslide.cc',
+        'main.cc',
       ],
     },
   ],
+  'conditions': [
+    ['USE_test == 1', {
+      'targets': [
+        {
+          'target_name': 'timberslide_testrunner',
+          'type': 'executable',
+          'includes': ['../common-mk/common_test.gypi'],
+          'dependencies': ['libtimberslide'],
+          'sources': [
+            'testrunner.cc',
+            'timberslide_unittest.cc',
+          ],
+        },
+        {
+          # Drains 64 MiB by default, which is too slow for the unit tests.
+          'target_name': 'timberslide_benchmark',
+          'type': 'executable',
+          'dependencies': ['libtimberslide'],
+          'sources': [
+            'timberslide_benchmark.cc',
+          ],
+        },
+      ],
+    }],
+  ],
 }
@@ -0,0 +1,137 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef TIMBERSLIDE_TIMBERSLIDE_H_
+#define TIMBERSLIDE_TIMBERSLIDE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/files/file.h>
+#include <base/files/file_path.h>
+#include <base/macros.h>
+#include <base/message_loop/message_loop.h>
+#include <base/timer/timer.h>
+#include <brillo/daemons/daemon.h>
+
+namespace timberslide {
+
+// LogFile appends to a log file through a descriptor that stays open for the
+// life of the object. Appended data is buffered and written out in large
+// chunks, and the file is moved aside to a "previous" file once it grows past
+// a maximum size.
+class LogFile {
+ public:
+  LogFile(const base::FilePath& current_log,
+          const base::FilePath& previous_log,
+          int64_t max_size);
+  ~LogFile();
+
+  const base::FilePath& current_log() const { return current_log_; }
+
+  // Moves any existing current log to the previous log and opens a new,
+  // empty current log.
+  bool Open();
+
+  // Buffers |size| bytes from |data|, writing the buffer out if it is full.
+  bool Append(const char* data, size_t size);
+
+  // Writes out any buffered data, rotating the log if it grew too large.
+  bool Flush();
+
+  // Flushes buffered data and syncs the file to disk if anything was written
+  // since the last sync.
+  bool Sync();
+
+ private:
+  // Moves the current log to the previous log and starts a new current log.
+  bool Rotate();
+
+  const base::FilePath current_log_;
+  const base::FilePath previous_log_;
+  const int64_t max_size_;
+
+  base::File file_;
+
+  // Number of bytes written to |file_|.
+  int64_t size_ = 0;
+
+  // Data that hasn't been written to |file_| yet.
+  std::string buffer_;
+
+  // True if data was written to |file_| since the last sync.
+  bool needs_sync_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(LogFile);
+};
+
+// LogDrainer copies everything that can be read from an EC console log device
+// into a LogFile.
+class LogDrainer : public base::MessageLoopForIO::Watcher {
+ public:
+  // |device| must have been opened in non-blocking mode.
+  LogDrainer(base::File device, std::unique_ptr<LogFile> log);
+  ~LogDrainer() override;
+
+  LogFile* log() { return log_.get(); }
+
+  // Starts draining the device whenever it becomes readable.
+  bool Watch();
+
+  // Reads from the device until it has no more data (or a bounded number of
+  // reads have been done, so that one busy device can't starve the others)
+  // and writes the data out to the log. Returns false on errors.
+  bool Drain();
+
+  // base::MessageLoopForIO::Watcher:
+  void OnFileCanReadWithoutBlocking(int fd) override;
+  void OnFileCanWriteWithoutBlocking(int fd) override;
+
+ private:
+  base::File device_;
+  std::unique_ptr<LogFile> log_;
+  std::vector<char> read_buffer_;
+  base::MessageLoopForIO::FileDescriptorWatcher watcher_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogDrainer);
+};
+
+// TimberSlide concatenates the console logs of one or more ECs into files in
+// a log directory, all serviced by the daemon's message loop.
+class TimberSlide : public brillo::Daemon {
+ public:
+  TimberSlide(const std::vector<base::FilePath>& device_logs,
+              const base::FilePath& log_dir);
+  ~TimberSlide() override;
+
+  // Returns the name used for the log files of |device_log|, e.g. "cros_ec"
+  // for /sys/kernel/debug/cros_ec/console_log.
+  static std::string GetLogName(const base::FilePath& device_log);
+
+ private:
+  // brillo::Daemon:
+  int OnInit() override;
+  void OnShutdown(int* exit_code) override;
+
+  // Syncs all logs to disk.
+  void SyncLogs();
+
+  const std::vector<base::FilePath> device_logs_;
+  const base::FilePath log_dir_;
+
+  std::vector<std::unique_ptr<LogDrainer>> drainers_;
+
+  // Runs SyncLogs() periodically.
+  base::RepeatingTimer sync_timer_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimberSlide);
+};
+
+}  // namespace timberslide
+
+#endif  // TIMBERSLIDE_TIMBERSLIDE_H_
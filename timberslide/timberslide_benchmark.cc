@@ -0,0 +1,85 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Writes --megabytes MiB (64 by default) of text into a pipe that stands in
+// for the EC console device, draining it into a 1 MiB rotating LogFile after
+// every 32 KiB, and prints the drain rate in MiB/s. The pipe delivers data
+// much faster than an EC does, so the rate is an upper bound on what
+// timberslide can keep up with; rotations and the final fsync are included.
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <base/command_line.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/logging.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/time/time.h>
+
+#include "timberslide/timberslide.h"
+
+namespace {
+
+const size_t kChunkSize = 16 * 1024;
+const int kChunksPerDrain = 2;
+const int64_t kMaxLogSize = 1024 * 1024;
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* cl = base::CommandLine::ForCurrentProcess();
+  int megabytes = 64;
+  if (cl->HasSwitch("megabytes") &&
+      (!base::StringToInt(cl->GetSwitchValueASCII("megabytes"), &megabytes) ||
+       megabytes <= 0)) {
+    printf("Usage: timberslide_benchmark [--megabytes=N]\n");
+    return 1;
+  }
+
+  base::ScopedTempDir temp_dir;
+  CHECK(temp_dir.CreateUniqueTempDir());
+  int fds[2];
+  PCHECK(pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0);
+  base::File device(fds[0]);
+  base::File writer(fds[1]);
+  PCHECK(fcntl(fds[1], F_SETFL, 0) == 0);
+
+  std::unique_ptr<timberslide::LogFile> log(new timberslide::LogFile(
+      temp_dir.path().Append("cros_ec.log"),
+      temp_dir.path().Append("cros_ec.previous"),
+      kMaxLogSize));
+  CHECK(log->Open());
+  timberslide::LogDrainer drainer(std::move(device), std::move(log));
+
+  const int num_chunks = megabytes * 1024 * 1024 / kChunkSize;
+  std::string chunk(kChunkSize, '\0');
+  for (size_t i = 0; i < kChunkSize; ++i)
+    chunk[i] = 'a' + i % 26;
+
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < num_chunks; ++i) {
+    CHECK(base::WriteFileDescriptor(
+        writer.GetPlatformFile(), chunk.data(), chunk.size()));
+    if ((i + 1) % kChunksPerDrain == 0)
+      CHECK(drainer.Drain());
+  }
+  CHECK(drainer.Drain());
+  CHECK(drainer.log()->Sync());
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  printf("Drained %d MiB in %" PRId64 " ms (%.1f MiB/s)\n",
+         megabytes,
+         elapsed.InMilliseconds(),
+         megabytes / std::max(elapsed.InSecondsF(), 1e-6));
+  return 0;
+}
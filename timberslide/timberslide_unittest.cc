@@ -0,0 +1,129 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "timberslide/timberslide.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/logging.h>
+#include <gtest/gtest.h>
+
+namespace timberslide {
+
+class TimberSlideTest : public testing::Test {
+ public:
+  TimberSlideTest() {}
+  ~TimberSlideTest() override {}
+
+  void SetUp() override {
+    CHECK(temp_dir_.CreateUniqueTempDir());
+    current_log_ = temp_dir_.path().Append("cros_ec.log");
+    previous_log_ = temp_dir_.path().Append("cros_ec.previous");
+  }
+
+ protected:
+  std::string ReadLog(const base::FilePath& path) {
+    std::string contents;
+    base::ReadFileToString(path, &contents);
+    return contents;
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath current_log_;
+  base::FilePath previous_log_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TimberSlideTest);
+};
+
+TEST_F(TimberSlideTest, GetLogName) {
+  EXPECT_EQ("cros_ec", TimberSlide::GetLogName(base::FilePath(
+                           "/sys/kernel/debug/cros_ec/console_log")));
+  EXPECT_EQ("cros_pd", TimberSlide::GetLogName(base::FilePath(
+                           "/sys/kernel/debug/cros_pd/console_log")));
+}
+
+TEST_F(TimberSlideTest, OpenRotatesExistingLog) {
+  ASSERT_EQ(3, base::WriteFile(current_log_, "old", 3));
+  ASSERT_EQ(5, base::WriteFile(previous_log_, "older", 5));
+
+  LogFile log(current_log_, previous_log_, 1024);
+  ASSERT_TRUE(log.Open());
+  EXPECT_EQ("old", ReadLog(previous_log_));
+  EXPECT_EQ("", ReadLog(current_log_));
+
+  // Appended data is buffered until it is flushed.
+  ASSERT_TRUE(log.Append("new", 3));
+  EXPECT_EQ("", ReadLog(current_log_));
+  ASSERT_TRUE(log.Flush());
+  EXPECT_EQ("new", ReadLog(current_log_));
+  ASSERT_TRUE(log.Sync());
+}
+
+TEST_F(TimberSlideTest, RotateWhenFull) {
+  LogFile log(current_log_, previous_log_, 8);
+  ASSERT_TRUE(log.Open());
+  ASSERT_TRUE(log.Append("0123", 4));
+  ASSERT_TRUE(log.Flush());
+  ASSERT_TRUE(log.Append("4567", 4));
+  ASSERT_TRUE(log.Flush());
+  EXPECT_EQ("01234567", ReadLog(previous_log_));
+  EXPECT_EQ("", ReadLog(current_log_));
+  ASSERT_TRUE(log.Append("89", 2));
+  ASSERT_TRUE(log.Flush());
+  EXPECT_EQ("89", ReadLog(current_log_));
+}
+
+// Pushes a stream of console output through a pipe standing in for the EC
+// device and checks that everything ends up in the logs.
+TEST_F(TimberSlideTest, DrainPipe) {
+  const size_t kChunkSize = 16 * 1024;
+  const int kNumChunks = 256;
+  const int kChunksPerDrain = 2;
+  const int64_t kMaxLogSize = 1024 * 1024;
+
+  int fds[2];
+  ASSERT_EQ(0, pipe2(fds, O_NONBLOCK | O_CLOEXEC));
+  base::File device(fds[0]);
+  base::File writer(fds[1]);
+  ASSERT_EQ(0, fcntl(fds[1], F_SETFL, 0));
+
+  std::unique_ptr<LogFile> log(
+      new LogFile(current_log_, previous_log_, kMaxLogSize));
+  ASSERT_TRUE(log->Open());
+  LogDrainer drainer(std::move(device), std::move(log));
+
+  // Nothing to read yet.
+  ASSERT_TRUE(drainer.Drain());
+
+  std::string stream;
+  std::string chunk(kChunkSize, '\0');
+  for (int i = 0; i < kNumChunks; ++i) {
+    for (size_t j = 0; j < kChunkSize; ++j)
+      chunk[j] = 'a' + (i + j) % 26;
+    ASSERT_TRUE(base::WriteFileDescriptor(
+        writer.GetPlatformFile(), chunk.data(), chunk.size()));
+    stream += chunk;
+    if ((i + 1) % kChunksPerDrain == 0)
+      ASSERT_TRUE(drainer.Drain());
+  }
+  ASSERT_TRUE(drainer.Drain());
+  ASSERT_TRUE(drainer.log()->Sync());
+
+  // The logs were rotated along the way, so only the tail of the stream is
+  // still on disk.
+  const std::string logs = ReadLog(previous_log_) + ReadLog(current_log_);
+  ASSERT_GE(stream.size(), logs.size());
+  EXPECT_GT(logs.size(), static_cast<size_t>(kMaxLogSize));
+  EXPECT_EQ(stream.substr(stream.size() - logs.size()), logs);
+}
+
+}  // namespace timberslide